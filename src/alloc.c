@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * alloc.c - pluggable allocators
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efivar.h"
+
+static void *
+libc_malloc(size_t size, void *ctx UNUSED)
+{
+	return malloc(size);
+}
+
+static void *
+libc_realloc(void *ptr, size_t size, void *ctx UNUSED)
+{
+	return realloc(ptr, size);
+}
+
+static void
+libc_free(void *ptr, void *ctx UNUSED)
+{
+	free(ptr);
+}
+
+static const efi_allocator_t libc_allocator = {
+	.malloc = libc_malloc,
+	.realloc = libc_realloc,
+	.free = libc_free,
+};
+
+/*
+ * The process-wide allocator is published as a pointer to a copy that
+ * never changes, so a thread in efi_malloc() sees either the old
+ * allocator or the new one, never a mix of the two.  Replaced copies
+ * can't be freed, since another thread may still be calling through
+ * one, so they're kept for the life of the process.
+ */
+static const efi_allocator_t *global_allocator = &libc_allocator;
+
+static __thread const efi_allocator_t *thread_allocator;
+
+static inline const efi_allocator_t *
+current(void)
+{
+	if (thread_allocator)
+		return thread_allocator;
+	return __atomic_load_n(&global_allocator, __ATOMIC_ACQUIRE);
+}
+
+static int
+validate(const efi_allocator_t *allocator)
+{
+	if (!allocator->malloc || !allocator->realloc || !allocator->free) {
+		errno = EINVAL;
+		efi_error("allocator is missing malloc, realloc, or free");
+		return -1;
+	}
+	return 0;
+}
+
+int PUBLIC
+efi_set_allocator(const efi_allocator_t *allocator)
+{
+	efi_allocator_t *copy;
+
+	if (!allocator) {
+		__atomic_store_n(&global_allocator, &libc_allocator,
+				 __ATOMIC_RELEASE);
+		return 0;
+	}
+	if (validate(allocator) < 0)
+		return -1;
+
+	copy = malloc(sizeof(*copy));
+	if (!copy) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	*copy = *allocator;
+	__atomic_store_n(&global_allocator, copy, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int PUBLIC
+efi_set_thread_allocator(const efi_allocator_t *allocator)
+{
+	if (allocator && validate(allocator) < 0)
+		return -1;
+	thread_allocator = allocator;
+	return 0;
+}
+
+const efi_allocator_t PUBLIC *
+efi_get_allocator(void)
+{
+	return current();
+}
+
+void PUBLIC *
+efi_malloc(size_t size)
+{
+	const efi_allocator_t *a = current();
+	void *ret = a->malloc(size ? size : 1, a->ctx);
+
+	if (!ret)
+		errno = ENOMEM;
+	return ret;
+}
+
+void PUBLIC *
+efi_calloc(size_t nmemb, size_t size)
+{
+	size_t total;
+	void *ret;
+
+	if (MUL(nmemb, size, &total)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	ret = efi_malloc(total);
+	if (ret)
+		memset(ret, 0, total);
+	return ret;
+}
+
+void PUBLIC *
+efi_realloc(void *ptr, size_t size)
+{
+	const efi_allocator_t *a = current();
+	void *ret = a->realloc(ptr, size ? size : 1, a->ctx);
+
+	if (!ret)
+		errno = ENOMEM;
+	return ret;
+}
+
+void PUBLIC *
+efi_reallocarray(void *ptr, size_t nmemb, size_t size)
+{
+	size_t total;
+
+	if (MUL(nmemb, size, &total)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return efi_realloc(ptr, total);
+}
+
+void PUBLIC
+efi_free(void *ptr)
+{
+	const efi_allocator_t *a;
+
+	if (!ptr)
+		return;
+	a = current();
+	a->free(ptr, a->ctx);
+}
+
+char PUBLIC *
+efi_strndup(const char *s, size_t n)
+{
+	size_t len = strnlen(s, n);
+	char *ret = efi_malloc(len + 1);
+
+	if (ret) {
+		memcpy(ret, s, len);
+		ret[len] = '\0';
+	}
+	return ret;
+}
+
+char PUBLIC *
+efi_strdup(const char *s)
+{
+	return efi_strndup(s, SIZE_MAX);
+}
+
+/*
+ * Each allocation is preceded by its size, so realloc() knows how much to
+ * copy.  Chunks are singly linked and only ever released all together.
+ */
+#define ARENA_DEFAULT_CHUNK	65536
+#define ARENA_ALIGN		(__alignof__(max_align_t))
+
+typedef struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+} arena_chunk_t;
+
+struct efi_arena {
+	efi_allocator_t allocator;
+	size_t chunk_size;
+	size_t used;
+	arena_chunk_t *chunks;
+};
+
+static arena_chunk_t *
+arena_add_chunk(struct efi_arena *arena, size_t min)
+{
+	size_t size = arena->chunk_size;
+	arena_chunk_t *chunk;
+
+	if (size < min)
+		size = min;
+	chunk = malloc(sizeof(*chunk) + size);
+	if (!chunk)
+		return NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	return chunk;
+}
+
+static void *
+arena_malloc(size_t size, void *ctx)
+{
+	struct efi_arena *arena = ctx;
+	arena_chunk_t *chunk = arena->chunks;
+	size_t need;
+	uint8_t *p;
+
+	if (ADD(size, ARENA_ALIGN, &need) ||
+	    ADD(need, ARENA_ALIGN - 1, &need))
+		return NULL;
+	need &= ~(ARENA_ALIGN - 1);
+
+	if (!chunk || chunk->size - chunk->used < need) {
+		chunk = arena_add_chunk(arena, need);
+		if (!chunk)
+			return NULL;
+	}
+
+	p = (uint8_t *)chunk->data + chunk->used;
+	chunk->used += need;
+	arena->used += need;
+	*(size_t *)p = size;
+	return p + ARENA_ALIGN;
+}
+
+static void *
+arena_realloc(void *ptr, size_t size, void *ctx)
+{
+	size_t old_size;
+	void *ret;
+
+	if (!ptr)
+		return arena_malloc(size, ctx);
+
+	old_size = *(size_t *)((uint8_t *)ptr - ARENA_ALIGN);
+	if (size <= old_size)
+		return ptr;
+
+	ret = arena_malloc(size, ctx);
+	if (ret)
+		memcpy(ret, ptr, old_size);
+	return ret;
+}
+
+static void
+arena_free(void *ptr UNUSED, void *ctx UNUSED)
+{
+}
+
+efi_arena_t PUBLIC *
+efi_arena_new(size_t chunk_size)
+{
+	struct efi_arena *arena;
+
+	arena = calloc(1, sizeof(*arena));
+	if (!arena) {
+		efi_error("could not allocate memory");
+		return NULL;
+	}
+	arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK;
+	arena->allocator.malloc = arena_malloc;
+	arena->allocator.realloc = arena_realloc;
+	arena->allocator.free = arena_free;
+	arena->allocator.ctx = arena;
+	return arena;
+}
+
+const efi_allocator_t NONNULL(1) PUBLIC *
+efi_arena_allocator(efi_arena_t *arena)
+{
+	return &arena->allocator;
+}
+
+size_t NONNULL(1) PUBLIC
+efi_arena_used(efi_arena_t *arena)
+{
+	return arena->used;
+}
+
+void NONNULL(1) PUBLIC
+efi_arena_reset(efi_arena_t *arena)
+{
+	arena_chunk_t *chunk, *next;
+
+	/* keep the newest chunk around for the next round */
+	chunk = arena->chunks;
+	if (!chunk)
+		return;
+	for (next = chunk->next; next; ) {
+		arena_chunk_t *tmp = next->next;
+		free(next);
+		next = tmp;
+	}
+	chunk->next = NULL;
+	chunk->used = 0;
+	arena->used = 0;
+}
+
+void PUBLIC
+efi_arena_free(efi_arena_t *arena)
+{
+	if (!arena)
+		return;
+	efi_arena_reset(arena);
+	free(arena->chunks);
+	free(arena);
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * alloc.h - allocation helpers built on efi_malloc() and friends
+ * Copyright 2026 The efivar Authors
+ *
+ * All three libraries allocate through these so that an allocator set
+ * with efi_set_allocator() or efi_set_thread_allocator() sees everything.
+ * The build tools don't link libefivar, so they get libc instead.
+ */
+#ifndef EFIVAR_PRIVATE_ALLOC_H_
+#define EFIVAR_PRIVATE_ALLOC_H_ 1
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef EFIVAR_BUILD_ENVIRONMENT
+#define efi_malloc(size) malloc(size)
+#define efi_calloc(nmemb, size) calloc(nmemb, size)
+#define efi_realloc(ptr, size) realloc(ptr, size)
+#define efi_reallocarray(ptr, nmemb, size) reallocarray(ptr, nmemb, size)
+#define efi_free(ptr) free(ptr)
+#define efi_strdup(s) strdup(s)
+#define efi_strndup(s, n) strndup(s, n)
+#endif
+
+static inline int UNUSED
+efi_vasprintf(char **strp, const char *fmt, va_list ap)
+{
+	va_list aq;
+	char *str;
+	int len;
+
+	va_copy(aq, ap);
+	len = vsnprintf(NULL, 0, fmt, aq);
+	va_end(aq);
+	if (len < 0)
+		return -1;
+
+	str = efi_malloc((size_t)len + 1);
+	if (!str)
+		return -1;
+	vsnprintf(str, (size_t)len + 1, fmt, ap);
+	*strp = str;
+	return len;
+}
+
+static inline int UNUSED PRINTF(2, 3)
+efi_asprintf(char **strp, const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = efi_vasprintf(strp, fmt, ap);
+	va_end(ap);
+	return rc;
+}
+
+#endif /* !EFIVAR_PRIVATE_ALLOC_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
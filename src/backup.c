@@ -0,0 +1,616 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * backup.c - content-addressed backups of variable stores
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <ctype.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "efivar.h"
+#include "sha256.h"
+#include "backup.h"
+
+/*
+ * A repository looks like:
+ *
+ *   objects/ab/cdef...	one payload, named by its SHA-256 in hex
+ *   hosts/<host>		that host's manifest
+ *
+ * A manifest is a header line and then one tab-separated line per
+ * variable: GUID, name, attributes, the size and mtime of its efivarfs
+ * file when it was read, and the SHA-256 of its data.  The size and
+ * mtime are only there so the next backup can tell the variable hasn't
+ * changed without reading it; they're 0 for other backends.
+ *
+ * Everything is written to a temporary file and renamed into place, so
+ * a backup that dies part way leaves the last manifest alone, and
+ * objects are never rewritten once they exist.
+ */
+#define MANIFEST_HEADER "efivar-backup-manifest 1"
+#define DIGEST_HEX_SIZE (SHA256_DIGEST_SIZE * 2 + 1)
+
+#define AUTHENTICATED_ATTRS \
+	(EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS | \
+	 EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)
+
+typedef struct {
+	efi_guid_t guid;
+	char *name;
+	uint32_t attributes;
+	uint64_t size;
+	int64_t mtime_sec;
+	long mtime_nsec;
+	uint8_t digest[SHA256_DIGEST_SIZE];
+} manifest_entry_t;
+
+typedef struct {
+	manifest_entry_t *entries;
+	size_t n_entries;
+	struct guid_map map;	/* guid/name -> index + 1 */
+} manifest_t;
+
+static void
+digest_to_hex(const uint8_t digest[SHA256_DIGEST_SIZE],
+	      char hex[DIGEST_HEX_SIZE])
+{
+	for (int i = 0; i < SHA256_DIGEST_SIZE; i++)
+		sprintf(hex + i * 2, "%02x", digest[i]);
+}
+
+static int
+hex_to_digest(const char *hex, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	if (strlen(hex) != DIGEST_HEX_SIZE - 1)
+		return -1;
+	for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+		unsigned int byte;
+
+		if (!isxdigit(hex[i * 2]) || !isxdigit(hex[i * 2 + 1]) ||
+		    sscanf(hex + i * 2, "%2x", &byte) != 1)
+			return -1;
+		digest[i] = byte;
+	}
+	return 0;
+}
+
+static int
+valid_host(const char *host)
+{
+	if (!host || !host[0] || host[0] == '.' || strchr(host, '/')) {
+		errno = EINVAL;
+		return 0;
+	}
+	return 1;
+}
+
+static int
+make_dir(const char *fmt, const char *repo, const char *sub)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), fmt, repo, sub) >= (int)sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if (mkdir(path, 0700) < 0 && errno != EEXIST)
+		return -1;
+	return 0;
+}
+
+/*
+ * Write data to path by way of a temporary file and rename(), so nobody
+ * ever sees half of it.
+ */
+static int
+write_file_atomic(const char *path, const void *data, size_t size)
+{
+	char tmppath[PATH_MAX + 8];
+	const uint8_t *p = data;
+	int fd, rc = 0;
+
+	snprintf(tmppath, sizeof(tmppath), "%s.XXXXXX", path);
+	fd = mkstemp(tmppath);
+	if (fd < 0)
+		return -1;
+	while (size) {
+		ssize_t sz = write(fd, p, size);
+
+		if (sz < 0 && errno == EINTR)
+			continue;
+		if (sz <= 0) {
+			rc = -1;
+			break;
+		}
+		p += sz;
+		size -= sz;
+	}
+	if (rc == 0)
+		rc = fsync(fd);
+	if (close(fd) < 0 || rc < 0 || rename(tmppath, path) < 0) {
+		int error = errno;
+
+		unlink(tmppath);
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+static int
+object_path(char *path, size_t size, const char *repo,
+	    const uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	char hex[DIGEST_HEX_SIZE];
+
+	digest_to_hex(digest, hex);
+	if (snprintf(path, size, "%s/objects/%.2s/%s", repo, hex, hex + 2)
+	    >= (int)size) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Returns 1 if the object was added, 0 if it was already there.
+ */
+static int
+store_object(const char *repo, const uint8_t digest[SHA256_DIGEST_SIZE],
+	     const uint8_t *data, size_t size)
+{
+	char path[PATH_MAX], hex[DIGEST_HEX_SIZE], prefix[3];
+	struct stat sb;
+
+	if (object_path(path, sizeof(path), repo, digest) < 0)
+		return -1;
+	if (stat(path, &sb) == 0)
+		return 0;
+	if (errno != ENOENT)
+		return -1;
+
+	digest_to_hex(digest, hex);
+	memcpy(prefix, hex, 2);
+	prefix[2] = '\0';
+	if (make_dir("%s/objects/%s", repo, prefix) < 0 ||
+	    write_file_atomic(path, data, size) < 0)
+		return -1;
+	return 1;
+}
+
+static int
+load_object(const char *repo, const uint8_t digest[SHA256_DIGEST_SIZE],
+	    uint8_t **data, size_t *size)
+{
+	uint8_t check[SHA256_DIGEST_SIZE];
+	char path[PATH_MAX];
+	int fd, rc;
+
+	if (object_path(path, sizeof(path), repo, digest) < 0)
+		return -1;
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	rc = read_file(fd, data, size);
+	close(fd);
+	if (rc < 0)
+		return -1;
+	/* read_file() counts the NUL it adds */
+	*size -= 1;
+
+	sha256(*data, *size, check);
+	if (memcmp(check, digest, sizeof(check))) {
+		efi_free(*data);
+		*data = NULL;
+		errno = EBADMSG;
+		return -1;
+	}
+	return 0;
+}
+
+static void
+manifest_fini(manifest_t *manifest)
+{
+	for (size_t i = 0; i < manifest->n_entries; i++)
+		free(manifest->entries[i].name);
+	free(manifest->entries);
+	guid_map_fini(&manifest->map);
+	memset(manifest, 0, sizeof(*manifest));
+}
+
+static int
+manifest_add(manifest_t *manifest, const manifest_entry_t *entry)
+{
+	manifest_entry_t *entries;
+
+	entries = reallocarray(manifest->entries, manifest->n_entries + 1,
+			       sizeof(*entries));
+	if (!entries)
+		return -1;
+	manifest->entries = entries;
+	entries[manifest->n_entries] = *entry;
+	manifest->n_entries += 1;
+	return 0;
+}
+
+/*
+ * The map is built once all the entries are in, so it can be sized for
+ * them up front.
+ */
+static int
+manifest_index(manifest_t *manifest)
+{
+	if (guid_map_init(&manifest->map, manifest->n_entries) < 0)
+		return -1;
+	for (size_t i = 0; i < manifest->n_entries; i++) {
+		manifest_entry_t *entry = &manifest->entries[i];
+
+		if (guid_map_insert(&manifest->map, &entry->guid,
+				    entry->name, (void *)(uintptr_t)(i + 1)) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static manifest_entry_t *
+manifest_find(manifest_t *manifest, const efi_guid_t *guid,
+	      const char *name)
+{
+	uintptr_t i;
+
+	i = (uintptr_t)guid_map_find(&manifest->map, guid, name);
+	return i ? &manifest->entries[i - 1] : NULL;
+}
+
+static int
+parse_manifest_line(char *line, manifest_entry_t *entry)
+{
+	char *fields[6], *saveptr = NULL, *end;
+	int n = 0;
+
+	line[strcspn(line, "\n")] = '\0';
+	for (char *tok = strtok_r(line, "\t", &saveptr); tok && n < 6;
+	     tok = strtok_r(NULL, "\t", &saveptr))
+		fields[n++] = tok;
+	if (n != 6)
+		return -1;
+
+	memset(entry, 0, sizeof(*entry));
+	if (efi_str_to_guid(fields[0], &entry->guid) < 0)
+		return -1;
+	errno = 0;
+	entry->attributes = strtoul(fields[2], &end, 16);
+	if (errno || *end)
+		return -1;
+	entry->size = strtoull(fields[3], &end, 10);
+	if (errno || *end)
+		return -1;
+	entry->mtime_sec = strtoll(fields[4], &end, 10);
+	if (errno || *end != '.')
+		return -1;
+	entry->mtime_nsec = strtol(end + 1, &end, 10);
+	if (errno || *end)
+		return -1;
+	if (hex_to_digest(fields[5], entry->digest) < 0)
+		return -1;
+	entry->name = strdup(fields[1]);
+	if (!entry->name)
+		return -1;
+	return 0;
+}
+
+/*
+ * A missing manifest is an empty one.
+ */
+static int
+read_manifest(const char *path, manifest_t *manifest)
+{
+	char *line = NULL;
+	size_t linesz = 0;
+	unsigned int lineno = 1;
+	FILE *f;
+	int rc = -1;
+
+	memset(manifest, 0, sizeof(*manifest));
+	f = fopen(path, "re");
+	if (!f) {
+		if (errno != ENOENT)
+			return -1;
+		return manifest_index(manifest);
+	}
+
+	if (getline(&line, &linesz, f) < 0 ||
+	    strncmp(line, MANIFEST_HEADER "\n", sizeof(MANIFEST_HEADER))) {
+		warnx("%s is not a backup manifest", path);
+		errno = EINVAL;
+		goto out;
+	}
+	while (getline(&line, &linesz, f) >= 0) {
+		manifest_entry_t entry;
+
+		lineno += 1;
+		if (parse_manifest_line(line, &entry) < 0 ||
+		    manifest_add(manifest, &entry) < 0) {
+			warnx("%s:%u: invalid manifest entry", path, lineno);
+			errno = EINVAL;
+			goto out;
+		}
+	}
+	rc = manifest_index(manifest);
+out:
+	if (rc < 0)
+		manifest_fini(manifest);
+	free(line);
+	fclose(f);
+	return rc;
+}
+
+static int
+write_manifest(const char *path, const manifest_t *manifest)
+{
+	char *buf = NULL;
+	size_t bufsz = 0;
+	FILE *f;
+	int rc;
+
+	f = open_memstream(&buf, &bufsz);
+	if (!f)
+		return -1;
+	fprintf(f, "%s\n", MANIFEST_HEADER);
+	for (size_t i = 0; i < manifest->n_entries; i++) {
+		const manifest_entry_t *entry = &manifest->entries[i];
+		char hex[DIGEST_HEX_SIZE];
+
+		digest_to_hex(entry->digest, hex);
+		fprintf(f, GUID_FORMAT "\t%s\t%08"PRIx32"\t%"PRIu64"\t"
+			"%"PRId64".%09ld\t%s\n",
+			GUID_FORMAT_ARGS(&entry->guid), entry->name,
+			entry->attributes, entry->size, entry->mtime_sec,
+			entry->mtime_nsec, hex);
+	}
+	if (fclose(f) != 0) {
+		free(buf);
+		return -1;
+	}
+	rc = write_file_atomic(path, buf, bufsz);
+	free(buf);
+	return rc;
+}
+
+/*
+ * Fill in the size and mtime of the variable's efivarfs file, or leave
+ * them 0 if there's no file to look at.
+ */
+static void
+stat_variable(efi_ctx_t *ctx, const efi_guid_t *guid, const char *name,
+	      manifest_entry_t *entry)
+{
+	char path[PATH_MAX];
+	struct stat sb;
+
+	if (strcmp(efi_ctx_get_ops_name(ctx), "efivarfs"))
+		return;
+	if (snprintf(path, sizeof(path), "%s/%s-" GUID_FORMAT,
+		     efi_ctx_get_path(ctx), name, GUID_FORMAT_ARGS(guid))
+	    >= (int)sizeof(path) ||
+	    stat(path, &sb) < 0)
+		return;
+	entry->size = sb.st_size;
+	entry->mtime_sec = sb.st_mtim.tv_sec;
+	entry->mtime_nsec = sb.st_mtim.tv_nsec;
+}
+
+int
+backup_variables(const char *repo, const char *host)
+{
+	manifest_t old, new;
+	char path[PATH_MAX];
+	efi_ctx_t *ctx;
+	efi_guid_t *guid = NULL;
+	char *name = NULL;
+	unsigned int n_read = 0, n_unchanged = 0, n_objects = 0;
+	size_t object_bytes = 0;
+	int rc, ret = -1;
+
+	if (!valid_host(host)) {
+		warnx("invalid host name \"%s\"", host ? host : "");
+		return -1;
+	}
+	if (snprintf(path, sizeof(path), "%s/hosts/%s", repo, host)
+	    >= (int)sizeof(path)) {
+		warnx("repository path is too long");
+		return -1;
+	}
+	if (make_dir("%s%s", repo, "") < 0 ||
+	    make_dir("%s/%s", repo, "objects") < 0 ||
+	    make_dir("%s/%s", repo, "hosts") < 0) {
+		warn("could not create repository at %s", repo);
+		return -1;
+	}
+	if (read_manifest(path, &old) < 0) {
+		warn("could not read %s", path);
+		return -1;
+	}
+	memset(&new, 0, sizeof(new));
+
+	ctx = efi_ctx_new(NULL, NULL);
+	if (!ctx) {
+		warn("could not find a variable store");
+		show_errors();
+		manifest_fini(&old);
+		return -1;
+	}
+
+	while ((rc = efi_ctx_get_next_variable_name(ctx, &guid, &name)) > 0) {
+		manifest_entry_t entry, *prev;
+		uint8_t *data = NULL;
+		size_t size = 0;
+		int added;
+
+		if (strpbrk(name, "\t\n")) {
+			warnx("skipping variable with unprintable name");
+			continue;
+		}
+
+		memset(&entry, 0, sizeof(entry));
+		entry.guid = *guid;
+		stat_variable(ctx, guid, name, &entry);
+		prev = manifest_find(&old, guid, name);
+		if (prev && entry.mtime_sec &&
+		    prev->size == entry.size &&
+		    prev->mtime_sec == entry.mtime_sec &&
+		    prev->mtime_nsec == entry.mtime_nsec) {
+			entry.attributes = prev->attributes;
+			memcpy(entry.digest, prev->digest,
+			       sizeof(entry.digest));
+			n_unchanged += 1;
+		} else {
+			if (efi_ctx_get_variable(ctx, *guid, name, &data,
+						 &size, &entry.attributes) < 0) {
+				warn("could not read " GUID_FORMAT "-%s",
+				     GUID_FORMAT_ARGS(guid), name);
+				show_errors();
+				continue;
+			}
+			n_read += 1;
+			sha256(data, size, entry.digest);
+			added = store_object(repo, entry.digest, data, size);
+			efi_free(data);
+			if (added < 0) {
+				warn("could not store " GUID_FORMAT "-%s",
+				     GUID_FORMAT_ARGS(guid), name);
+				goto out;
+			}
+			n_objects += added;
+			object_bytes += added ? size : 0;
+		}
+
+		entry.name = strdup(name);
+		if (!entry.name || manifest_add(&new, &entry) < 0) {
+			free(entry.name);
+			warn("could not allocate memory");
+			goto out;
+		}
+	}
+	if (rc < 0) {
+		warn("could not list variables");
+		show_errors();
+		goto out;
+	}
+
+	if (write_manifest(path, &new) < 0) {
+		warn("could not write %s", path);
+		goto out;
+	}
+	ret = 0;
+	printf("%s: %zd variables, %u read, %u unchanged, "
+	       "%u new objects (%zd bytes)\n", host, new.n_entries, n_read,
+	       n_unchanged, n_objects, object_bytes);
+out:
+	efi_ctx_free(ctx);
+	manifest_fini(&old);
+	manifest_fini(&new);
+	return ret;
+}
+
+int
+restore_variables(const char *repo, const char *host)
+{
+	manifest_t manifest;
+	char path[PATH_MAX];
+	efi_ctx_t *ctx;
+	unsigned int n_written = 0, n_unchanged = 0, n_skipped = 0;
+	unsigned int n_failed = 0;
+
+	if (!valid_host(host)) {
+		warnx("invalid host name \"%s\"", host ? host : "");
+		return -1;
+	}
+	if (snprintf(path, sizeof(path), "%s/hosts/%s", repo, host)
+	    >= (int)sizeof(path)) {
+		warnx("repository path is too long");
+		return -1;
+	}
+	if (access(path, F_OK) < 0 || read_manifest(path, &manifest) < 0) {
+		warn("could not read %s", path);
+		return -1;
+	}
+
+	ctx = efi_ctx_new(NULL, NULL);
+	if (!ctx) {
+		warn("could not find a variable store");
+		show_errors();
+		manifest_fini(&manifest);
+		return -1;
+	}
+
+	for (size_t i = 0; i < manifest.n_entries; i++) {
+		manifest_entry_t *entry = &manifest.entries[i];
+		uint8_t *data = NULL, *cur = NULL;
+		size_t size = 0, cursz = 0;
+		uint32_t curattrs = 0;
+
+		/*
+		 * Volatile variables are in the manifest so the next backup
+		 * doesn't have to read them again, but they're the firmware's
+		 * business to set on each boot.
+		 */
+		if (!(entry->attributes & EFI_VARIABLE_NON_VOLATILE)) {
+			n_skipped += 1;
+			continue;
+		}
+
+		if (load_object(repo, entry->digest, &data, &size) < 0) {
+			warn("could not load " GUID_FORMAT "-%s",
+			     GUID_FORMAT_ARGS(&entry->guid), entry->name);
+			n_failed += 1;
+			continue;
+		}
+
+		/*
+		 * Don't spend a flash write on anything that's already
+		 * right.
+		 */
+		if (efi_ctx_get_variable(ctx, entry->guid, entry->name, &cur,
+					 &cursz, &curattrs) == 0 &&
+		    curattrs == entry->attributes && cursz == size &&
+		    !memcmp(cur, data, size)) {
+			n_unchanged += 1;
+		} else if (entry->attributes & AUTHENTICATED_ATTRS) {
+			warnx("not restoring " GUID_FORMAT "-%s: "
+			      "it needs a signed update",
+			      GUID_FORMAT_ARGS(&entry->guid), entry->name);
+			n_failed += 1;
+		} else if (efi_ctx_set_variable(ctx, entry->guid, entry->name,
+						data, size, entry->attributes,
+						0644) < 0) {
+			warn("could not write " GUID_FORMAT "-%s",
+			     GUID_FORMAT_ARGS(&entry->guid), entry->name);
+			show_errors();
+			n_failed += 1;
+		} else {
+			n_written += 1;
+		}
+		efi_free(cur);
+		efi_free(data);
+	}
+
+	printf("%s: %u variables written, %u unchanged, %u volatile skipped, "
+	       "%u failed\n", host, n_written, n_unchanged, n_skipped,
+	       n_failed);
+	efi_ctx_free(ctx);
+	manifest_fini(&manifest);
+	return n_failed ? -1 : 0;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * backup.h - efivar --backup-repo and --restore-repo
+ * Copyright 2026 The efivar Authors
+ */
+
+#ifndef EFIVAR_BACKUP_H_
+#define EFIVAR_BACKUP_H_
+
+/*
+ * Save the variables in the default store to the repository at repo, as
+ * the manifest for host.  Each distinct payload is stored once under its
+ * SHA-256; the manifest lists each variable's GUID, name, attributes, and
+ * payload hash.  Variables whose efivarfs file has the same size and
+ * mtime as in host's last manifest aren't read again.
+ */
+extern int backup_variables(const char *repo, const char *host);
+
+/*
+ * Write back every non-volatile variable in host's manifest that doesn't
+ * already match.
+ */
+extern int restore_variables(const char *repo, const char *host);
+
+#endif /* !EFIVAR_BACKUP_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
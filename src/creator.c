@@ -29,6 +29,7 @@ find_file(const char * const filepath, char **devicep, char **relpathp)
 	FILE *mounts = NULL;
 	char linkbuf[PATH_MAX+1] = "";
 	ssize_t linklen = 0;
+	efi_trace_scope("find_file", "%s", filepath);
 
 	linklen = strlen(filepath);
 	if (linklen > PATH_MAX) {
@@ -100,15 +101,15 @@ find_file(const char * const filepath, char **devicep, char **relpathp)
 				continue;
 			if (strncmp(linkbuf, me->mnt_dir, mntlen))
 				continue;
-			*devicep = strdup(me->mnt_fsname);
+			*devicep = efi_strdup(me->mnt_fsname);
 			if (!*devicep) {
 				errno = ENOMEM;
 				efi_error("strdup failed");
 				goto err;
 			}
-			*relpathp = strdup(linkbuf + mntlen);
+			*relpathp = efi_strdup(linkbuf + mntlen);
 			if (!*relpathp) {
-				free(*devicep);
+				efi_free(*devicep);
 				*devicep = NULL;
 				errno = ENOMEM;
 				efi_error("strdup failed");
@@ -130,7 +131,7 @@ open_disk(struct device *dev, int flags)
 	char *diskpath = NULL;
 	int rc;
 
-	rc = asprintfa(&diskpath, "/dev/%s", dev->disk_name);
+	rc = asprintfa(&diskpath, "%s/%s", devfs_path(), dev->disk_name);
 	if (rc < 0) {
 		efi_error("could not allocate buffer");
 		return -1;
@@ -161,14 +162,38 @@ efi_va_generate_file_device_path_from_esp(uint8_t *buf, ssize_t size,
 {
 	ssize_t ret = -1, off = 0, sz;
 	struct device *dev = NULL;
+	const int cache_partition = partition;
+	const uint32_t cache_options = options;
+	uint8_t *cached = NULL;
 	int fd = -1;
 	int saved_errno;
+	efi_trace_scope("efi_generate_file_device_path_from_esp",
+			"%s partition %d %s", devpath, partition, relpath);
 
 	debug("partition:%d", partition);
 
 	if (buf && size)
 		memset(buf, '\0', size);
 
+	/*
+	 * Everything up to the File() node depends only on the disk, so
+	 * it may already be in the cache from earlier this boot.
+	 */
+	sz = dp_cache_lookup(devpath, partition, options, &cached);
+	if (sz >= 0) {
+		if (size && size < sz) {
+			efi_free(cached);
+			errno = ENOSPC;
+			efi_error("could not copy cached device path");
+			goto err;
+		}
+		if (buf && size)
+			memcpy(buf, cached, sz);
+		efi_free(cached);
+		off = sz;
+		goto make_file;
+	}
+
 	fd = open(devpath, O_RDONLY);
 	if (fd < 0) {
 		efi_error("could not open device for ESP");
@@ -224,6 +249,17 @@ efi_va_generate_file_device_path_from_esp(uint8_t *buf, ssize_t size,
 		dev->edd10_devicenum = va_arg(ap, uint32_t);
 	}
 
+	/*
+	 * Only a full path needs the probe chain; HD() and File() just need
+	 * the disk and partition that device_get() already found.
+	 */
+	if (!(options & (EFIBOOT_ABBREV_FILE|EFIBOOT_ABBREV_HD))) {
+		if (device_probe(dev) < 0) {
+			efi_error("could not get ESP disk info");
+			goto err;
+		}
+	}
+
 	if (!(options & (EFIBOOT_ABBREV_FILE|EFIBOOT_ABBREV_HD))
 	    && (dev->flags & DEV_ABBREV_ONLY)) {
 		efi_error_clear();
@@ -282,6 +318,11 @@ efi_va_generate_file_device_path_from_esp(uint8_t *buf, ssize_t size,
 		off += sz;
 	}
 
+	if (buf && size)
+		dp_cache_store(devpath, cache_partition, cache_options,
+			       dev->disk_name, buf, off);
+
+make_file:;
 	char *filepath = strdupa(relpath);
 	tilt_slashes(filepath);
 	sz = efidp_make_file(buf+off, size?size-off:0, filepath);
@@ -373,6 +414,7 @@ efi_generate_file_device_path(uint8_t *buf, ssize_t size,
 	char *relpath = NULL;
 	va_list ap;
 	int saved_errno;
+	efi_trace_scope("efi_generate_file_device_path", "%s", filepath);
 
 	rc = find_file(filepath, &child_devpath, &relpath);
 	if (rc < 0) {
@@ -417,11 +459,11 @@ efi_generate_file_device_path(uint8_t *buf, ssize_t size,
 err:
 	saved_errno = errno;
 	if (child_devpath)
-		free(child_devpath);
+		efi_free(child_devpath);
 	if (parent_devpath)
-		free(parent_devpath);
+		efi_free(parent_devpath);
 	if (relpath)
-		free(relpath);
+		efi_free(relpath);
 	errno = saved_errno;
 	return ret;
 }
@@ -493,6 +535,165 @@ efi_generate_ipv4_device_path(uint8_t *buf, ssize_t size,
 	return off;
 }
 
+/*
+ * Build [bus path]/MAC()[/IPv4() or /IPv6()]/End() for one interface.
+ * family is 0 for just the MAC path.  Pass size 0 to get the size needed.
+ */
+static ssize_t
+make_net_path(uint8_t *buf, ssize_t size, struct device *dev,
+	      struct net_interface *iface, int family)
+{
+	ssize_t off = 0;
+	ssize_t sz;
+
+	sz = make_blockdev_path(buf, size, dev);
+	if (sz < 0)
+		return -1;
+	off += sz;
+
+	sz = efidp_make_mac_addr(buf+off, size?size-off:0, iface->link_type,
+				 iface->mac_addr, iface->mac_addr_len);
+	if (sz < 0) {
+		efi_error("could not make MAC DP node");
+		return -1;
+	}
+	off += sz;
+
+	if (family == AF_INET) {
+		uint8_t len = iface->ipv4_prefix_len;
+		uint32_t netmask = len ? 0xffffffffu << (32 - len) : 0;
+
+		sz = efidp_make_ipv4(buf+off, size?size-off:0,
+				     iface->ipv4_addr, 0, 0, netmask,
+				     0, 0, 0, iface->ipv4_static);
+		if (sz < 0) {
+			efi_error("could not make IPV4 DP node");
+			return -1;
+		}
+		off += sz;
+	} else if (family == AF_INET6) {
+		sz = efidp_make_ipv6(buf+off, size?size-off:0,
+				     iface->has_ipv6 ? iface->ipv6_addr : NULL,
+				     NULL, NULL, iface->ipv6_prefix_len,
+				     0, 0, 0, iface->ipv6_origin);
+		if (sz < 0) {
+			efi_error("could not make IPV6 DP node");
+			return -1;
+		}
+		off += sz;
+	}
+
+	sz = efidp_make_end_entire(buf+off, size?size-off:0);
+	if (sz < 0) {
+		efi_error("could not make EndEntire DP node");
+		return -1;
+	}
+	off += sz;
+
+	return off;
+}
+
+static int
+alloc_net_path(uint8_t **bufp, ssize_t *sizep, struct device *dev,
+	       struct net_interface *iface, int family)
+{
+	ssize_t sz;
+	uint8_t *buf;
+
+	sz = make_net_path(NULL, 0, dev, iface, family);
+	if (sz < 0)
+		return -1;
+	buf = efi_malloc(sz);
+	if (!buf) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	sz = make_net_path(buf, sz, dev, iface, family);
+	if (sz < 0) {
+		efi_free(buf);
+		return -1;
+	}
+	*bufp = buf;
+	*sizep = sz;
+	return 0;
+}
+
+void PUBLIC
+efi_free_net_device_paths(efi_net_device_paths_t *paths, size_t n)
+{
+	if (!paths)
+		return;
+	for (size_t i = 0; i < n; i++) {
+		efi_free(paths[i].mac_path);
+		efi_free(paths[i].ipv4_path);
+		efi_free(paths[i].ipv6_path);
+	}
+	efi_free(paths);
+}
+
+ssize_t NONNULL(1) PUBLIC
+efi_generate_net_device_paths(efi_net_device_paths_t **pathsp)
+{
+	struct net_interface *ifaces = NULL;
+	size_t n_ifaces = 0, n = 0;
+	efi_net_device_paths_t *paths = NULL;
+	int rc;
+
+	rc = get_net_interfaces(&ifaces, &n_ifaces);
+	if (rc < 0) {
+		efi_error("could not list network interfaces");
+		return -1;
+	}
+
+	paths = efi_calloc(n_ifaces ? n_ifaces : 1, sizeof(*paths));
+	if (!paths) {
+		efi_error("could not allocate memory");
+		efi_free(ifaces);
+		return -1;
+	}
+
+	for (size_t i = 0; i < n_ifaces; i++) {
+		struct net_interface *iface = &ifaces[i];
+		efi_net_device_paths_t *p = &paths[n];
+		struct device *dev;
+
+		if (iface->mac_addr_len == 0)
+			continue;
+
+		dev = device_get_net(iface->ifname);
+		if (!dev) {
+			debug("skipping %s", iface->ifname);
+			efi_error_clear();
+			continue;
+		}
+
+		memcpy(p->ifname, iface->ifname, sizeof(p->ifname));
+		p->ifindex = iface->ifindex;
+		p->link_type = iface->link_type;
+		rc = alloc_net_path(&p->mac_path, &p->mac_path_size,
+				    dev, iface, 0);
+		if (rc >= 0)
+			rc = alloc_net_path(&p->ipv4_path, &p->ipv4_path_size,
+					    dev, iface, AF_INET);
+		if (rc >= 0)
+			rc = alloc_net_path(&p->ipv6_path, &p->ipv6_path_size,
+					    dev, iface, AF_INET6);
+		device_free(dev);
+		if (rc < 0) {
+			efi_error("could not make device paths for %s",
+				  iface->ifname);
+			efi_free_net_device_paths(paths, n + 1);
+			efi_free(ifaces);
+			return -1;
+		}
+		n += 1;
+	}
+
+	efi_free(ifaces);
+	*pathsp = paths;
+	return n;
+}
+
 uint32_t PUBLIC
 efi_get_libefiboot_version(void)
 {
@@ -0,0 +1,672 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * daemon.c - read variables from efivard's shared snapshot
+ * Copyright 2026 The efivar Authors
+ *
+ * Reads are answered from the snapshot efivard maps into every client,
+ * so they cost neither the kernel's per-user rate limit nor our own
+ * sleep.  Everything else, and anything the daemon can't help with, is
+ * handed to the efivarfs backend.
+ */
+
+#include "fix_coverity.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "efivar.h"
+#include "efivard.h"
+
+/*
+ * If efivard dies without telling anyone, the generation page just stops
+ * moving; re-ask it this often so we notice and fall back.
+ */
+#define DAEMON_SNAPSHOT_MAX_AGE		5
+/* after a failed connect(), stick with efivarfs for this long */
+#define DAEMON_RETRY_INTERVAL		5
+
+typedef struct {
+	int refcount;
+	void *map;
+	size_t size;
+	const efivard_snapshot_header_t *hdr;
+	const efivard_snapshot_entry_t *entries;
+} snapshot_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	snapshot_t *snap;
+	const volatile uint64_t *generation;
+	size_t generation_size;
+	time_t fetched;
+	time_t retry_after;
+	/* after our own writes, don't trust snapshots at this generation */
+	uint64_t stale_generation;
+
+	/* get_next_variable_name() walks one snapshot from start to end */
+	snapshot_t *iter_snap;
+	uint32_t iter_pos;
+} daemon_state_t;
+
+static time_t
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec;
+}
+
+static void
+snapshot_put(snapshot_t *snap)
+{
+	if (!snap || --snap->refcount > 0)
+		return;
+	munmap(snap->map, snap->size);
+	efi_free(snap);
+}
+
+static const char *
+daemon_socket_path(void)
+{
+	const char *path = secure_getenv("EFIVARD_SOCKET");
+
+	return path ? path : EFIVARD_SOCKET_PATH;
+}
+
+static int
+snapshot_validate(snapshot_t *snap)
+{
+	const efivard_snapshot_header_t *hdr = snap->map;
+	size_t entries_end;
+
+	if (snap->size < sizeof(*hdr) ||
+	    hdr->magic != EFIVARD_MAGIC ||
+	    hdr->version != EFIVARD_SNAPSHOT_VERSION ||
+	    hdr->size != snap->size)
+		return -1;
+
+	if (MUL(hdr->n_entries, sizeof(efivard_snapshot_entry_t), &entries_end) ||
+	    ADD(entries_end, sizeof(*hdr), &entries_end) ||
+	    entries_end > snap->size)
+		return -1;
+
+	snap->hdr = hdr;
+	snap->entries = (void *)((uint8_t *)snap->map + sizeof(*hdr));
+
+	for (uint32_t i = 0; i < hdr->n_entries; i++) {
+		const efivard_snapshot_entry_t *ent = &snap->entries[i];
+		const char *name = (char *)snap->map + ent->name_offset;
+		uint64_t end;
+
+		if ((uint64_t)ent->name_offset + ent->name_size >= snap->size ||
+		    name[ent->name_size] != '\0')
+			return -1;
+		if (ADD(ent->data_offset, ent->data_size, &end) ||
+		    end > snap->size)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int
+receive_fds(int sd, efivard_reply_t *reply, int fds[2])
+{
+	char cbuf[CMSG_SPACE(sizeof(int) * 2)];
+	struct iovec iov = {
+		.iov_base = reply,
+		.iov_len = sizeof(*reply),
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+	};
+	struct cmsghdr *cmsg;
+	ssize_t rc;
+
+	fds[0] = fds[1] = -1;
+	memset(cbuf, 0, sizeof(cbuf));
+
+	rc = recvmsg(sd, &msg, MSG_CMSG_CLOEXEC);
+	if (rc < 0) {
+		efi_error("recvmsg() failed");
+		return -1;
+	}
+	if ((size_t)rc != sizeof(*reply) || reply->magic != EFIVARD_MAGIC) {
+		errno = EPROTO;
+		efi_error("bad reply from efivard");
+		return -1;
+	}
+	if (reply->status != 0) {
+		errno = reply->status;
+		efi_error("efivard could not provide a snapshot");
+		return -1;
+	}
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 2)) {
+		errno = EPROTO;
+		efi_error("efivard did not send snapshot descriptors");
+		return -1;
+	}
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * 2);
+	return 0;
+}
+
+static int
+map_fd(int fd, int required_seals, void **map, size_t *size)
+{
+	struct stat sb;
+	int seals;
+
+	seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || (seals & required_seals) != required_seals) {
+		errno = EPERM;
+		efi_error("efivard sent an insufficiently sealed memfd");
+		return -1;
+	}
+	if (fstat(fd, &sb) < 0) {
+		efi_error("fstat() failed");
+		return -1;
+	}
+	*size = sb.st_size;
+	*map = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	if (*map == MAP_FAILED) {
+		efi_error("mmap() failed");
+		return -1;
+	}
+	return 0;
+}
+
+/* called with state->lock held */
+static int
+fetch_snapshot(daemon_state_t *state)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX, };
+	efivard_request_t req = {
+		.magic = EFIVARD_MAGIC,
+		.op = EFIVARD_OP_GET_SNAPSHOT,
+	};
+	efivard_reply_t reply;
+	struct timeval tv = { .tv_sec = 1, };
+	const char *path = daemon_socket_path();
+	snapshot_t *snap = NULL;
+	void *genmap = NULL;
+	size_t gensize = 0;
+	int fds[2] = { -1, -1 };
+	int sd = -1;
+	int ret = -1;
+	__typeof__(errno) errno_value;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		efi_error("socket path \"%s\" is too long", path);
+		goto err;
+	}
+	strcpy(addr.sun_path, path);
+
+	sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sd < 0) {
+		efi_error("socket() failed");
+		goto err;
+	}
+	setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(sd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	if (connect(sd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		efi_error("connect(%s) failed", path);
+		goto err;
+	}
+	if (send(sd, &req, sizeof(req), MSG_NOSIGNAL) != sizeof(req)) {
+		efi_error("send() failed");
+		goto err;
+	}
+	if (receive_fds(sd, &reply, fds) < 0)
+		goto err;
+
+	snap = efi_calloc(1, sizeof(*snap));
+	if (!snap) {
+		efi_error("could not allocate memory");
+		goto err;
+	}
+	if (map_fd(fds[0], F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW,
+		   &snap->map, &snap->size) < 0)
+		goto err;
+	if (snapshot_validate(snap) < 0) {
+		errno = EPROTO;
+		efi_error("efivard sent a malformed snapshot");
+		goto err;
+	}
+	if (map_fd(fds[1], F_SEAL_SHRINK, &genmap, &gensize) < 0)
+		goto err;
+	if (gensize < sizeof(uint64_t)) {
+		errno = EPROTO;
+		efi_error("efivard sent a malformed generation page");
+		goto err;
+	}
+
+	snap->refcount = 1;
+	snapshot_put(state->snap);
+	state->snap = snap;
+	snap = NULL;
+	if (state->generation)
+		munmap((void *)state->generation, state->generation_size);
+	state->generation = genmap;
+	state->generation_size = gensize;
+	genmap = NULL;
+	state->fetched = now();
+	ret = 0;
+err:
+	errno_value = errno;
+	if (genmap && genmap != MAP_FAILED)
+		munmap(genmap, gensize);
+	if (snap) {
+		if (snap->map && snap->map != MAP_FAILED)
+			munmap(snap->map, snap->size);
+		efi_free(snap);
+	}
+	for (int i = 0; i < 2; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	if (sd >= 0)
+		close(sd);
+	errno = errno_value;
+	return ret;
+}
+
+static daemon_state_t *
+get_state(struct efi_ctx *ctx)
+{
+	daemon_state_t *state = ctx->priv;
+
+	if (state)
+		return state;
+
+	/*
+	 * The default context gets here from more than one thread, so
+	 * whoever loses the race frees their copy.
+	 */
+	state = efi_calloc(1, sizeof(*state));
+	if (!state)
+		return NULL;
+	pthread_mutex_init(&state->lock, NULL);
+	if (!__atomic_compare_exchange_n(&ctx->priv, &(void *){ NULL }, state,
+					 false, __ATOMIC_ACQ_REL,
+					 __ATOMIC_ACQUIRE)) {
+		pthread_mutex_destroy(&state->lock);
+		efi_free(state);
+		state = ctx->priv;
+	}
+	return state;
+}
+
+/*
+ * Return a reference to a current snapshot, or NULL if the caller should
+ * go to efivarfs instead.
+ */
+static snapshot_t *
+current_snapshot(struct efi_ctx *ctx)
+{
+	daemon_state_t *state = get_state(ctx);
+	snapshot_t *snap = NULL;
+	time_t t;
+
+	if (!state)
+		return NULL;
+
+	pthread_mutex_lock(&state->lock);
+	t = now();
+	if (state->snap) {
+		uint64_t gen = __atomic_load_n(state->generation,
+					       __ATOMIC_ACQUIRE);
+
+		if (gen == EFIVARD_GENERATION_GONE ||
+		    gen != state->snap->hdr->generation ||
+		    t - state->fetched >= DAEMON_SNAPSHOT_MAX_AGE) {
+			snapshot_put(state->snap);
+			state->snap = NULL;
+		}
+	}
+	if (!state->snap && t >= state->retry_after) {
+		if (fetch_snapshot(state) < 0) {
+			state->retry_after = t + DAEMON_RETRY_INTERVAL;
+			efi_error_clear();
+		}
+	}
+	if (state->snap &&
+	    state->snap->hdr->generation != state->stale_generation) {
+		snap = state->snap;
+		snap->refcount += 1;
+	}
+	pthread_mutex_unlock(&state->lock);
+
+	return snap;
+}
+
+static void
+release_snapshot(struct efi_ctx *ctx, snapshot_t *snap)
+{
+	daemon_state_t *state = ctx->priv;
+
+	pthread_mutex_lock(&state->lock);
+	snapshot_put(snap);
+	pthread_mutex_unlock(&state->lock);
+}
+
+/*
+ * Our own write will show up in a later generation; until then, reads
+ * go to efivarfs so we see what we just wrote.
+ */
+static void
+note_write(struct efi_ctx *ctx)
+{
+	daemon_state_t *state = get_state(ctx);
+
+	if (!state)
+		return;
+	pthread_mutex_lock(&state->lock);
+	if (state->snap)
+		state->stale_generation = state->snap->hdr->generation;
+	pthread_mutex_unlock(&state->lock);
+}
+
+static int
+entry_cmp(const char *name, const efi_guid_t *guid, snapshot_t *snap,
+	  const efivard_snapshot_entry_t *ent)
+{
+	int rc = strcmp(name, (char *)snap->map + ent->name_offset);
+
+	if (rc)
+		return rc;
+	return memcmp(guid, &ent->guid, sizeof(*guid));
+}
+
+static const efivard_snapshot_entry_t *
+find_entry(snapshot_t *snap, efi_guid_t *guid, const char *name)
+{
+	uint32_t lo = 0, hi = snap->hdr->n_entries;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int rc = entry_cmp(name, guid, snap, &snap->entries[mid]);
+
+		if (rc == 0)
+			return &snap->entries[mid];
+		if (rc < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Look the variable up; returns 1 with *entp set, 0 if the variable
+ * doesn't exist, or -1 if the caller needs to ask efivarfs.
+ */
+static int
+lookup(struct efi_ctx *ctx, efi_guid_t *guid, const char *name,
+       snapshot_t **snapp, const efivard_snapshot_entry_t **entp)
+{
+	snapshot_t *snap = current_snapshot(ctx);
+	const efivard_snapshot_entry_t *ent;
+
+	if (!snap)
+		return -1;
+
+	ent = find_entry(snap, guid, name);
+	if (ent && (ent->flags & EFIVARD_ENTRY_PRIVATE)) {
+		release_snapshot(ctx, snap);
+		return -1;
+	}
+
+	*snapp = snap;
+	*entp = ent;
+	return ent ? 1 : 0;
+}
+
+static int
+daemon_probe(struct efi_ctx *ctx)
+{
+	snapshot_t *snap = current_snapshot(ctx);
+
+	if (!snap) {
+		efi_error("efivard is not available at %s",
+			  daemon_socket_path());
+		return 0;
+	}
+	release_snapshot(ctx, snap);
+	return 1;
+}
+
+static const char *
+daemon_get_default_path(void)
+{
+	return efivarfs_ops.get_default_path();
+}
+
+static int
+daemon_get_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		    uint8_t **data, size_t *data_size, uint32_t *attributes)
+{
+	const efivard_snapshot_entry_t *ent = NULL;
+	snapshot_t *snap = NULL;
+	uint8_t *buf;
+	int rc;
+
+	rc = lookup(ctx, &guid, name, &snap, &ent);
+	if (rc < 0)
+		return efivarfs_ops.get_variable(ctx, guid, name, data,
+						 data_size, attributes);
+	if (rc == 0) {
+		release_snapshot(ctx, snap);
+		errno = ENOENT;
+		efi_error("variable not found in efivard snapshot");
+		return -1;
+	}
+
+	/* like read_file(), pad out 1 extra byte to NUL it */
+	buf = efi_malloc(ent->data_size + 1);
+	if (!buf) {
+		release_snapshot(ctx, snap);
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	memcpy(buf, (uint8_t *)snap->map + ent->data_offset, ent->data_size);
+	buf[ent->data_size] = '\0';
+
+	*data = buf;
+	*data_size = ent->data_size;
+	*attributes = ent->attributes;
+	release_snapshot(ctx, snap);
+	return 0;
+}
+
+static int
+daemon_get_variable_attributes(struct efi_ctx *ctx, efi_guid_t guid,
+			       const char *name, uint32_t *attributes)
+{
+	const efivard_snapshot_entry_t *ent = NULL;
+	snapshot_t *snap = NULL;
+	int rc;
+
+	rc = lookup(ctx, &guid, name, &snap, &ent);
+	if (rc < 0)
+		return efivarfs_ops.get_variable_attributes(ctx, guid, name,
+							    attributes);
+	if (rc == 0) {
+		release_snapshot(ctx, snap);
+		errno = ENOENT;
+		efi_error("variable not found in efivard snapshot");
+		return -1;
+	}
+
+	*attributes = ent->attributes;
+	release_snapshot(ctx, snap);
+	return 0;
+}
+
+static int
+daemon_get_variable_size(struct efi_ctx *ctx, efi_guid_t guid,
+			 const char *name, size_t *size)
+{
+	const efivard_snapshot_entry_t *ent = NULL;
+	snapshot_t *snap = NULL;
+	int rc;
+
+	rc = lookup(ctx, &guid, name, &snap, &ent);
+	if (rc < 0)
+		return efivarfs_ops.get_variable_size(ctx, guid, name, size);
+	if (rc == 0) {
+		release_snapshot(ctx, snap);
+		errno = ENOENT;
+		efi_error("variable not found in efivard snapshot");
+		return -1;
+	}
+
+	*size = ent->data_size;
+	release_snapshot(ctx, snap);
+	return 0;
+}
+
+static int
+daemon_get_next_variable_name(struct efi_ctx *ctx, efi_guid_t **guid,
+			      char **name)
+{
+	daemon_state_t *state;
+	const efivard_snapshot_entry_t *ent;
+
+	if ((*guid == NULL && *name != NULL) ||
+	    (*guid != NULL && *name == NULL)) {
+		errno = EINVAL;
+		efi_error("invalid arguments");
+		return -1;
+	}
+
+	state = get_state(ctx);
+	if (!state || (!state->iter_snap && ctx->dir)) {
+		/* we're already in the middle of an efivarfs walk */
+		return efivarfs_ops.get_next_variable_name(ctx, guid, name);
+	}
+
+	if (!state->iter_snap) {
+		state->iter_snap = current_snapshot(ctx);
+		if (!state->iter_snap)
+			return efivarfs_ops.get_next_variable_name(ctx, guid,
+								   name);
+		state->iter_pos = 0;
+	}
+
+	if (state->iter_pos >= state->iter_snap->hdr->n_entries) {
+		release_snapshot(ctx, state->iter_snap);
+		state->iter_snap = NULL;
+		return 0;
+	}
+
+	ent = &state->iter_snap->entries[state->iter_pos++];
+	strncpy(ctx->next_name,
+		(char *)state->iter_snap->map + ent->name_offset,
+		sizeof(ctx->next_name) - 1);
+	ctx->next_name[sizeof(ctx->next_name) - 1] = '\0';
+	ctx->next_guid = ent->guid;
+	*guid = &ctx->next_guid;
+	*name = ctx->next_name;
+	return 1;
+}
+
+static int
+daemon_set_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		    const uint8_t *data, size_t data_size, uint32_t attributes,
+		    mode_t mode)
+{
+	int rc;
+
+	rc = efivarfs_ops.set_variable(ctx, guid, name, data, data_size,
+				       attributes, mode);
+	note_write(ctx);
+	return rc;
+}
+
+static int
+daemon_append_variable(struct efi_ctx *ctx, efi_guid_t guid,
+		       const char *name, const uint8_t *data,
+		       size_t data_size, uint32_t attributes)
+{
+	int rc;
+
+	rc = efivarfs_ops.append_variable(ctx, guid, name, data, data_size,
+					  attributes);
+	note_write(ctx);
+	return rc;
+}
+
+static int
+daemon_del_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name)
+{
+	int rc;
+
+	rc = efivarfs_ops.del_variable(ctx, guid, name);
+	note_write(ctx);
+	return rc;
+}
+
+static int
+daemon_chmod_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		      mode_t mode)
+{
+	int rc;
+
+	rc = efivarfs_ops.chmod_variable(ctx, guid, name, mode);
+	note_write(ctx);
+	return rc;
+}
+
+static void
+daemon_fini(struct efi_ctx *ctx)
+{
+	daemon_state_t *state = ctx->priv;
+
+	if (!state)
+		return;
+
+	snapshot_put(state->iter_snap);
+	snapshot_put(state->snap);
+	if (state->generation)
+		munmap((void *)state->generation, state->generation_size);
+	pthread_mutex_destroy(&state->lock);
+	efi_free(state);
+	ctx->priv = NULL;
+}
+
+struct efi_var_operations daemon_ops = {
+	.name = "daemon",
+	.probe = daemon_probe,
+	.get_default_path = daemon_get_default_path,
+	.set_variable = daemon_set_variable,
+	.append_variable = daemon_append_variable,
+	.del_variable = daemon_del_variable,
+	.get_variable = daemon_get_variable,
+	.get_variable_attributes = daemon_get_variable_attributes,
+	.get_variable_size = daemon_get_variable_size,
+	.get_next_variable_name = daemon_get_next_variable_name,
+	.chmod_variable = daemon_chmod_variable,
+	.fini = daemon_fini,
+	.by_name_only = true,
+};
+
+// vim:fenc=utf-8:tw=75:noet
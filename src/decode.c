@@ -0,0 +1,446 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * decode.c - typed views of well-known variables for efivar --decode
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efisec.h"
+#include "decode.h"
+
+typedef struct {
+	const efi_guid_t *guid;
+	const char *name;	/* "####" stands for four hex digits */
+	var_type_t type;
+	const char *type_name;
+} var_decoder_t;
+
+static const var_decoder_t decoders[] = {
+	{ &efi_guid_global, "AuditMode", VAR_BOOL, "boolean" },
+	{ &efi_guid_global, "Boot####", VAR_LOAD_OPTION, "load option" },
+	{ &efi_guid_global, "BootCurrent", VAR_BOOT_NUMBER, "boot entry number" },
+	{ &efi_guid_global, "BootNext", VAR_BOOT_NUMBER, "boot entry number" },
+	{ &efi_guid_global, "BootOrder", VAR_U16_LIST, "boot entry order" },
+	{ &efi_guid_global, "ConIn", VAR_DEVICE_PATH, "device path" },
+	{ &efi_guid_global, "ConInDev", VAR_DEVICE_PATH, "device path" },
+	{ &efi_guid_global, "ConOut", VAR_DEVICE_PATH, "device path" },
+	{ &efi_guid_global, "ConOutDev", VAR_DEVICE_PATH, "device path" },
+	{ &efi_guid_global, "DeployedMode", VAR_BOOL, "boolean" },
+	{ &efi_guid_global, "Driver####", VAR_LOAD_OPTION, "load option" },
+	{ &efi_guid_global, "DriverOrder", VAR_U16_LIST, "driver order" },
+	{ &efi_guid_global, "ErrOut", VAR_DEVICE_PATH, "device path" },
+	{ &efi_guid_global, "ErrOutDev", VAR_DEVICE_PATH, "device path" },
+	{ &efi_guid_global, "KEK", VAR_SIGNATURE_LIST, "signature list" },
+	{ &efi_guid_global, "OsIndications", VAR_U64_FLAGS, "OS indications" },
+	{ &efi_guid_global, "OsIndicationsSupported", VAR_U64_FLAGS, "OS indications" },
+	{ &efi_guid_global, "PK", VAR_SIGNATURE_LIST, "signature list" },
+	{ &efi_guid_global, "SecureBoot", VAR_BOOL, "boolean" },
+	{ &efi_guid_global, "SetupMode", VAR_BOOL, "boolean" },
+	{ &efi_guid_global, "SysPrep####", VAR_LOAD_OPTION, "load option" },
+	{ &efi_guid_global, "SysPrepOrder", VAR_U16_LIST, "sysprep order" },
+	{ &efi_guid_global, "Timeout", VAR_U16, "seconds" },
+	{ &efi_guid_security, "db", VAR_SIGNATURE_LIST, "signature list" },
+	{ &efi_guid_security, "dbr", VAR_SIGNATURE_LIST, "signature list" },
+	{ &efi_guid_security, "dbt", VAR_SIGNATURE_LIST, "signature list" },
+	{ &efi_guid_security, "dbx", VAR_SIGNATURE_LIST, "signature list" },
+};
+#define N_DECODERS (sizeof(decoders) / sizeof(decoders[0]))
+
+#define DECODER_SLOTS 64
+static struct guid_map_slot decoder_slots[DECODER_SLOTS];
+static struct guid_map decoder_map;
+static bool decoders_indexed;
+
+static const var_decoder_t *
+find_decoder(const efi_guid_t *guid, const char *name)
+{
+	const var_decoder_t *decoder;
+	size_t len = strlen(name);
+
+	if (!decoders_indexed) {
+		guid_map_init_fixed(&decoder_map, decoder_slots,
+				    DECODER_SLOTS);
+		for (size_t i = 0; i < N_DECODERS; i++)
+			guid_map_insert(&decoder_map, decoders[i].guid,
+					decoders[i].name,
+					(void *)&decoders[i]);
+		decoders_indexed = true;
+	}
+
+	decoder = guid_map_find(&decoder_map, guid, name);
+	if (decoder)
+		return decoder;
+
+	/*
+	 * Boot0001 and friends are keyed as Boot####, so that's one more
+	 * lookup rather than a scan of the patterns.
+	 */
+	if (len >= 4 && len < 32 &&
+	    isxdigit(name[len - 4]) && isxdigit(name[len - 3]) &&
+	    isxdigit(name[len - 2]) && isxdigit(name[len - 1])) {
+		char pattern[32];
+
+		memcpy(pattern, name, len - 4);
+		memcpy(pattern + len - 4, "####", 5);
+		return guid_map_find(&decoder_map, guid, pattern);
+	}
+	return NULL;
+}
+
+static inline uint16_t
+get_u16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static int
+decode_load_option(var_view_t *view)
+{
+	efi_load_option *opt = (efi_load_option *)view->data;
+	unsigned char *optional_data = NULL;
+	size_t optional_data_size = 0;
+	size_t desc_off = sizeof(uint32_t) + sizeof(uint16_t);
+
+	if (view->size < desc_off || !efi_loadopt_is_valid(opt, view->size))
+		return -1;
+	if (efi_loadopt_optional_data(opt, view->size, &optional_data,
+				      &optional_data_size) < 0)
+		return -1;
+
+	view->load_option.opt = opt;
+	view->load_option.attributes = efi_loadopt_attrs(opt);
+	view->load_option.description = view->data + desc_off;
+	view->load_option.description_len =
+		ucs2len(view->data + desc_off, (view->size - desc_off) / 2);
+	view->load_option.dp = efi_loadopt_path(opt, view->size);
+	view->load_option.dp_size = efi_loadopt_pathlen(opt, view->size);
+	view->load_option.optional_data = optional_data;
+	view->load_option.optional_data_size = optional_data_size;
+	return 0;
+}
+
+int
+decode_variable(const efi_guid_t *guid, const char *name, uint8_t *data,
+		size_t size, var_view_t *view)
+{
+	const var_decoder_t *decoder;
+	int rc = 0;
+
+	decoder = find_decoder(guid, name);
+	if (!decoder)
+		return 0;
+
+	memset(view, 0, sizeof(*view));
+	view->type = decoder->type;
+	view->type_name = decoder->type_name;
+	view->data = data;
+	view->size = size;
+
+	switch (decoder->type) {
+	case VAR_BOOL:
+		if (size != 1)
+			rc = -1;
+		else
+			view->boolean = data[0];
+		break;
+	case VAR_U16:
+	case VAR_BOOT_NUMBER:
+		if (size != sizeof(uint16_t))
+			rc = -1;
+		else
+			view->u16 = get_u16(data);
+		break;
+	case VAR_U16_LIST:
+		if (size % sizeof(uint16_t)) {
+			rc = -1;
+		} else {
+			view->u16_list.values = data;
+			view->u16_list.n = size / sizeof(uint16_t);
+		}
+		break;
+	case VAR_U64_FLAGS:
+		if (size != sizeof(uint64_t)) {
+			rc = -1;
+		} else {
+			for (int i = 7; i >= 0; i--)
+				view->u64 = view->u64 << 8 | data[i];
+		}
+		break;
+	case VAR_DEVICE_PATH:
+		if (size < sizeof(efidp_header) ||
+		    !efidp_is_valid((const_efidp)data, size)) {
+			rc = -1;
+		} else {
+			view->device_path.dp = (const_efidp)data;
+			view->device_path.size = size;
+		}
+		break;
+	case VAR_LOAD_OPTION:
+		rc = decode_load_option(view);
+		break;
+	case VAR_SIGNATURE_LIST:
+		break;
+	}
+
+	if (rc < 0) {
+		errno = EINVAL;
+		efi_error("%s is not a valid %s", name, decoder->type_name);
+		return -1;
+	}
+	return 1;
+}
+
+void
+json_string(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(out, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(out, "\\u%04x", *p);
+		else
+			fputc(*p, out);
+	}
+	fputc('"', out);
+}
+
+void
+json_hex(FILE *out, const uint8_t *data, size_t size)
+{
+	fputc('"', out);
+	for (size_t i = 0; i < size; i++)
+		fprintf(out, "%02x", data[i]);
+	fputc('"', out);
+}
+
+static char *
+format_device_path(const_efidp dp, ssize_t size)
+{
+	ssize_t sz;
+	char *buf;
+
+	sz = efidp_format_device_path(NULL, 0, dp, size);
+	if (sz <= 0)
+		return NULL;
+	buf = calloc(1, sz + 1);
+	if (!buf)
+		return NULL;
+	if (efidp_format_device_path((unsigned char *)buf, sz + 1, dp,
+				     size) < 0) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+static const char * const os_indications[] = {
+	"boot-to-fw-ui",
+	"timestamp-revocation",
+	"file-capsule-delivery-supported",
+	"fmp-capsule-supported",
+	"capsule-result-var-supported",
+	"start-os-recovery",
+	"start-platform-recovery",
+	"json-config-data-refresh",
+};
+#define N_OS_INDICATIONS (sizeof(os_indications) / sizeof(os_indications[0]))
+
+static void
+render_flags(FILE *out, uint64_t value, decode_format_t format)
+{
+	const char *sep = "";
+
+	if (format == DECODE_JSON)
+		fprintf(out, "{\"value\":%"PRIu64",\"flags\":[", value);
+	else
+		fprintf(out, "\t0x%016"PRIx64"\n", value);
+
+	for (size_t i = 0; i < N_OS_INDICATIONS; i++) {
+		if (!(value & (1ull << i)))
+			continue;
+		if (format == DECODE_JSON)
+			fprintf(out, "%s\"%s\"", sep, os_indications[i]);
+		else
+			fprintf(out, "\t%s\n", os_indications[i]);
+		sep = ",";
+	}
+
+	if (format == DECODE_JSON)
+		fprintf(out, "]}");
+}
+
+static int
+render_load_option(FILE *out, const var_view_t *view,
+		   decode_format_t format)
+{
+	uint32_t attrs = view->load_option.attributes;
+	unsigned char *desc;
+	char *path = NULL;
+
+	desc = ucs2_to_utf8(view->load_option.description,
+			    view->load_option.description_len + 1);
+	if (!desc)
+		return -1;
+	if (view->load_option.dp_size)
+		path = format_device_path(view->load_option.dp,
+					  view->load_option.dp_size);
+
+	if (format == DECODE_JSON) {
+		fprintf(out, "{\"attributes\":%"PRIu32",\"active\":%s,"
+			"\"hidden\":%s,\"description\":", attrs,
+			(attrs & LOAD_OPTION_ACTIVE) ? "true" : "false",
+			(attrs & LOAD_OPTION_HIDDEN) ? "true" : "false");
+		json_string(out, (char *)desc);
+		fprintf(out, ",\"path\":");
+		if (path)
+			json_string(out, path);
+		else
+			fprintf(out, "null");
+		fprintf(out, ",\"optional_data\":");
+		json_hex(out, view->load_option.optional_data,
+			 view->load_option.optional_data_size);
+		fprintf(out, "}");
+	} else {
+		fprintf(out, "\tAttributes: 0x%08"PRIx32"%s%s\n", attrs,
+			(attrs & LOAD_OPTION_ACTIVE) ? " Active" : "",
+			(attrs & LOAD_OPTION_HIDDEN) ? " Hidden" : "");
+		fprintf(out, "\tDescription: %s\n", desc);
+		fprintf(out, "\tPath: %s\n", path ? path : "(invalid)");
+		if (view->load_option.optional_data_size) {
+			fprintf(out, "\tOptional Data: ");
+			for (size_t i = 0;
+			     i < view->load_option.optional_data_size; i++)
+				fprintf(out, "%02x",
+					view->load_option.optional_data[i]);
+			fprintf(out, "\n");
+		}
+	}
+
+	efi_free(desc);
+	free(path);
+	return 0;
+}
+
+static int
+render_signature_list(FILE *out, const var_view_t *view,
+		      decode_format_t format)
+{
+	esl_iter *iter = NULL;
+	const char *sep = "";
+	int rc;
+
+	if (format == DECODE_JSON)
+		fprintf(out, "[");
+	if (view->size == 0)
+		goto done;
+
+	rc = esl_iter_new(&iter, view->data, view->size);
+	if (rc < 0)
+		return -1;
+
+	while (true) {
+		efi_guid_t type, owner;
+		uint8_t *data = NULL;
+		size_t len = 0;
+		char *type_name = NULL, *owner_name = NULL;
+
+		rc = esl_iter_next(iter, &type, &owner, &data, &len);
+		if (rc == ESL_ITER_DONE)
+			break;
+		if (rc < 0) {
+			esl_iter_end(iter);
+			return -1;
+		}
+
+		if (efi_guid_to_name(&type, &type_name) < 0 ||
+		    efi_guid_to_id_guid(&owner, &owner_name) < 0) {
+			efi_free(type_name);
+			esl_iter_end(iter);
+			return -1;
+		}
+
+		if (format == DECODE_JSON) {
+			fprintf(out, "%s{\"type\":", sep);
+			json_string(out, type_name);
+			fprintf(out, ",\"owner\":\""GUID_FORMAT"\",\"data\":",
+				GUID_FORMAT_ARGS(&owner));
+			json_hex(out, data, len);
+			fprintf(out, "}");
+			sep = ",";
+		} else if (!efi_guid_cmp(&type, &efi_guid_x509_cert)) {
+			fprintf(out, "\t%s %s (%zd bytes)\n", type_name,
+				owner_name, len);
+		} else {
+			fprintf(out, "\t%s %s ", type_name, owner_name);
+			for (size_t i = 0; i < len; i++)
+				fprintf(out, "%02x", data[i]);
+			fprintf(out, "\n");
+		}
+		efi_free(type_name);
+		efi_free(owner_name);
+	}
+	esl_iter_end(iter);
+done:
+	if (format == DECODE_JSON)
+		fprintf(out, "]");
+	return 0;
+}
+
+int
+render_variable(FILE *out, const var_view_t *view, decode_format_t format)
+{
+	bool json = format == DECODE_JSON;
+	char *path;
+
+	switch (view->type) {
+	case VAR_BOOL:
+		fprintf(out, json ? "%s" : "\t%s\n",
+			view->boolean ? "true" : "false");
+		break;
+	case VAR_U16:
+		fprintf(out, json ? "%"PRIu16 : "\t%"PRIu16"\n", view->u16);
+		break;
+	case VAR_BOOT_NUMBER:
+		fprintf(out, json ? "%"PRIu16 : "\tBoot%04X\n", view->u16);
+		break;
+	case VAR_U16_LIST:
+		fprintf(out, json ? "[" : "\t");
+		for (size_t i = 0; i < view->u16_list.n; i++) {
+			uint16_t n = get_u16(view->u16_list.values + i * 2);
+
+			fprintf(out, json ? "%s%"PRIu16 : "%s%04X",
+				i ? "," : "", n);
+		}
+		fprintf(out, json ? "]" : "\n");
+		break;
+	case VAR_U64_FLAGS:
+		render_flags(out, view->u64, format);
+		break;
+	case VAR_DEVICE_PATH:
+		path = format_device_path(view->device_path.dp,
+					  view->device_path.size);
+		if (!path)
+			return -1;
+		if (json)
+			json_string(out, path);
+		else
+			fprintf(out, "\t%s\n", path);
+		free(path);
+		break;
+	case VAR_LOAD_OPTION:
+		return render_load_option(out, view, format);
+	case VAR_SIGNATURE_LIST:
+		return render_signature_list(out, view, format);
+	}
+	return 0;
+}
+
+// vim:fenc=utf-8:tw=75:noet
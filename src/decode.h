@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * decode.h - typed views of well-known variables for efivar --decode
+ * Copyright 2026 The efivar Authors
+ */
+
+#ifndef EFIVAR_DECODE_H_
+#define EFIVAR_DECODE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <efivar/efivar.h>
+#include <efivar/efiboot.h>
+
+typedef enum {
+	DECODE_PRETTY,
+	DECODE_JSON,
+} decode_format_t;
+
+typedef enum {
+	VAR_BOOL,		/* SecureBoot, SetupMode, ... */
+	VAR_U16,		/* Timeout */
+	VAR_BOOT_NUMBER,	/* BootCurrent, BootNext */
+	VAR_U16_LIST,		/* BootOrder, DriverOrder */
+	VAR_U64_FLAGS,		/* OsIndications */
+	VAR_DEVICE_PATH,	/* ConIn, ConOut, ErrOut */
+	VAR_LOAD_OPTION,	/* Boot####, Driver#### */
+	VAR_SIGNATURE_LIST,	/* PK, KEK, db, dbx */
+} var_type_t;
+
+#define LOAD_OPTION_ACTIVE		0x00000001
+#define LOAD_OPTION_FORCE_RECONNECT	0x00000002
+#define LOAD_OPTION_HIDDEN		0x00000008
+
+/*
+ * A view of a variable's data as its type.  Everything here points into
+ * the data it was made from, so it's only good as long as that is.
+ * Multi-byte values in the data are little-endian and may be unaligned,
+ * so lists are left as bytes.
+ */
+typedef struct {
+	var_type_t type;
+	const char *type_name;
+	uint8_t *data;
+	size_t size;
+	union {
+		bool boolean;
+		uint16_t u16;
+		uint64_t u64;
+		struct {
+			const uint8_t *values;
+			size_t n;
+		} u16_list;
+		struct {
+			const_efidp dp;
+			ssize_t size;
+		} device_path;
+		struct {
+			efi_load_option *opt;
+			uint32_t attributes;
+			const uint8_t *description;	/* UCS-2 */
+			size_t description_len;		/* in characters */
+			const_efidp dp;
+			uint16_t dp_size;
+			const uint8_t *optional_data;
+			size_t optional_data_size;
+		} load_option;
+	};
+} var_view_t;
+
+/*
+ * Make a view of data if guid/name is a variable we know the type of.
+ * Names like Boot0001 match the decoder for Boot####.  Returns 1 with
+ * *view filled in, 0 if there's no decoder for it, or -1 with errno set
+ * if there is one but the data doesn't fit the type.
+ */
+extern int decode_variable(const efi_guid_t *guid, const char *name,
+			   uint8_t *data, size_t size, var_view_t *view);
+
+/*
+ * Print a view, either as indented lines or as one JSON value.
+ */
+extern int render_variable(FILE *out, const var_view_t *view,
+			   decode_format_t format);
+
+extern void json_string(FILE *out, const char *s);
+extern void json_hex(FILE *out, const uint8_t *data, size_t size);
+
+#endif /* !EFIVAR_DECODE_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
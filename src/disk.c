@@ -168,7 +168,7 @@ msdos_disk_get_partition_info (int fd, int write_signature,
 	return 0;
 }
 
-static int
+int HIDDEN
 get_partition_info(int fd, uint32_t options,
 		   uint32_t part, uint64_t *start, uint64_t *size,
 		   partition_signature_t *signature, uint8_t *mbr_type,
@@ -9,6 +9,12 @@
 
 extern bool HIDDEN is_partitioned(int fd);
 
+extern int HIDDEN get_partition_info(int fd, uint32_t options, uint32_t part,
+				     uint64_t *start, uint64_t *size,
+				     partition_signature_t *signature,
+				     uint8_t *mbr_type,
+				     uint8_t *signature_type);
+
 extern HIDDEN ssize_t make_hd_dn(uint8_t *buf, ssize_t size, int fd,
 				 int32_t partition, uint32_t options);
 
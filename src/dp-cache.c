@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * dp-cache.c - boot-scoped cache of ESP device paths
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "efiboot.h"
+
+/*
+ * Each entry is one file, named for the device, partition, and options it
+ * was generated with.  Entries are replaced with rename(), so readers
+ * never need a lock; anything that doesn't validate is just a miss.
+ *
+ * An entry is only good for the boot it was made in, and only while the
+ * first two sectors of the disk - the (protective) MBR and the GPT header,
+ * which carries the CRC of the partition entries - are unchanged.
+ */
+
+#define DP_CACHE_MAGIC		0x63706465u	/* "edpc" */
+#define DP_CACHE_VERSION	1
+
+struct dp_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	char boot_id[40];
+	uint64_t dev;
+	int32_t partition;
+	uint32_t options;
+	char disk_name[64];
+	uint32_t validator;
+	uint32_t dp_size;
+	uint32_t crc;		/* of the header with crc = 0, and dp */
+};
+
+static const char *
+cache_dir(void)
+{
+	const char *env = secure_getenv(DP_CACHE_ENV);
+
+	if (!env || !env[0] || !strcmp(env, "0"))
+		return NULL;
+	if (env[0] == '/')
+		return env;
+	return DP_CACHE_DEFAULT_DIR;
+}
+
+static int
+get_boot_id(char *boot_id, size_t size)
+{
+	ssize_t sz;
+	int fd;
+
+	memset(boot_id, 0, size);
+	fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	sz = read(fd, boot_id, size - 1);
+	close(fd);
+	if (sz < 36)
+		return -1;
+	boot_id[36] = '\0';
+	return 0;
+}
+
+static int
+get_dev(const char * const devpath, uint64_t *dev)
+{
+	struct stat sb;
+
+	if (stat(devpath, &sb) < 0)
+		return -1;
+	*dev = S_ISBLK(sb.st_mode) ? sb.st_rdev : sb.st_dev;
+	return 0;
+}
+
+/*
+ * crc32 of the first two sectors of the disk
+ */
+static int
+get_validator(const char * const disk_name, uint32_t *validator)
+{
+	char path[PATH_MAX];
+	uint8_t *buf;
+	ssize_t sz;
+	int sector_size;
+	int fd;
+
+	if (snprintf(path, sizeof(path), "%s/%s", devfs_path(), disk_name) >=
+	    (int)sizeof(path))
+		return -1;
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	sector_size = get_sector_size(fd);
+	buf = alloca(sector_size * 2);
+	sz = pread(fd, buf, sector_size * 2, 0);
+	close(fd);
+	if (sz != sector_size * 2)
+		return -1;
+	*validator = efi_crc32(buf, sz);
+	return 0;
+}
+
+static bool
+cacheable(uint32_t options)
+{
+	/*
+	 * Writing a signature changes the disk, and EDD 1.0 paths depend
+	 * on a device number passed in by the caller.
+	 */
+	return !(options & (EFIBOOT_OPTIONS_WRITE_SIGNATURE |
+			    EFIBOOT_ABBREV_EDD10));
+}
+
+static int
+cache_path(char *path, size_t size, const char * const dir, uint64_t dev,
+	   int partition, uint32_t options)
+{
+	int rc;
+
+	rc = snprintf(path, size, "%s/dp-%"PRIx64"-%d-%"PRIx32,
+		      dir, dev, partition, options);
+	if (rc < 0 || (size_t)rc >= size)
+		return -1;
+	return 0;
+}
+
+static uint32_t
+entry_crc(struct dp_cache_header *hdr, const uint8_t * const dp)
+{
+	uint32_t saved = hdr->crc;
+	uint32_t crc;
+
+	hdr->crc = 0;
+	crc = crc32(hdr, sizeof(*hdr), ~0L);
+	crc = crc32(dp, hdr->dp_size, crc) ^ ~0L;
+	hdr->crc = saved;
+	return crc;
+}
+
+ssize_t HIDDEN
+dp_cache_lookup(const char * const devpath, int partition, uint32_t options,
+		uint8_t **dp)
+{
+	const char *dir = cache_dir();
+	char path[PATH_MAX];
+	char boot_id[40];
+	struct dp_cache_header *hdr;
+	struct stat sb;
+	uint8_t *buf = NULL;
+	uint32_t validator;
+	uint64_t dev;
+	ssize_t sz, ret = -1;
+	int fd;
+
+	if (!dir || !cacheable(options))
+		return -1;
+	if (get_dev(devpath, &dev) < 0 ||
+	    cache_path(path, sizeof(path), dir, dev, partition, options) < 0)
+		return -1;
+
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &sb) < 0 ||
+	    (sb.st_uid != 0 && sb.st_uid != geteuid()) ||
+	    sb.st_size < (off_t)sizeof(*hdr) || sb.st_size > 65536)
+		goto out;
+
+	buf = efi_malloc(sb.st_size);
+	if (!buf)
+		goto out;
+	sz = read(fd, buf, sb.st_size);
+	if (sz != sb.st_size)
+		goto out;
+
+	hdr = (struct dp_cache_header *)buf;
+	if (hdr->magic != DP_CACHE_MAGIC ||
+	    hdr->version != DP_CACHE_VERSION ||
+	    hdr->dev != dev ||
+	    hdr->partition != partition ||
+	    hdr->options != options ||
+	    hdr->dp_size != sz - sizeof(*hdr) ||
+	    hdr->crc != entry_crc(hdr, buf + sizeof(*hdr)))
+		goto out;
+
+	hdr->boot_id[sizeof(hdr->boot_id) - 1] = '\0';
+	hdr->disk_name[sizeof(hdr->disk_name) - 1] = '\0';
+	if (get_boot_id(boot_id, sizeof(boot_id)) < 0 ||
+	    strcmp(boot_id, hdr->boot_id))
+		goto out;
+	if (get_validator(hdr->disk_name, &validator) < 0 ||
+	    validator != hdr->validator)
+		goto out;
+
+	debug("cache hit for %s in %s", devpath, path);
+	memmove(buf, buf + sizeof(*hdr), hdr->dp_size);
+	*dp = buf;
+	buf = NULL;
+	ret = sz - sizeof(*hdr);
+out:
+	if (ret < 0)
+		debug("cache miss for %s", devpath);
+	efi_free(buf);
+	close(fd);
+	return ret;
+}
+
+void HIDDEN
+dp_cache_store(const char * const devpath, int partition, uint32_t options,
+	       const char * const disk_name,
+	       const uint8_t * const dp, size_t dpsz)
+{
+	const char *dir = cache_dir();
+	char path[PATH_MAX];
+	char tmppath[PATH_MAX + 8];
+	struct dp_cache_header hdr;
+	uint64_t dev;
+	int fd, rc;
+
+	if (!dir || !cacheable(options) || !disk_name ||
+	    strlen(disk_name) >= sizeof(hdr.disk_name) || dpsz > 65536)
+		return;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = DP_CACHE_MAGIC;
+	hdr.version = DP_CACHE_VERSION;
+	hdr.partition = partition;
+	hdr.options = options;
+	hdr.dp_size = dpsz;
+	strcpy(hdr.disk_name, disk_name);
+	if (get_boot_id(hdr.boot_id, sizeof(hdr.boot_id)) < 0 ||
+	    get_dev(devpath, &dev) < 0 ||
+	    get_validator(disk_name, &hdr.validator) < 0 ||
+	    cache_path(path, sizeof(path), dir, dev, partition, options) < 0)
+		return;
+	hdr.dev = dev;
+	hdr.crc = entry_crc(&hdr, dp);
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+		return;
+
+	snprintf(tmppath, sizeof(tmppath), "%s.XXXXXX", path);
+	fd = mkstemp(tmppath);
+	if (fd < 0)
+		return;
+	rc = (fchmod(fd, 0644) < 0 ||
+	      write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+	      write(fd, dp, dpsz) != (ssize_t)dpsz) ? -1 : 0;
+	if (close(fd) < 0 || rc < 0 || rename(tmppath, path) < 0)
+		unlink(tmppath);
+	else
+		debug("cached %zd bytes for %s in %s", dpsz, devpath, path);
+}
+
+// vim:fenc=utf-8:tw=75:noet
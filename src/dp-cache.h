@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * dp-cache.h - boot-scoped cache of ESP device paths
+ * Copyright 2026 The efivar Authors
+ */
+#ifndef _EFIBOOT_DP_CACHE_H
+#define _EFIBOOT_DP_CACHE_H
+
+/*
+ * Set LIBEFIBOOT_DP_CACHE to 1 to cache in /run/efivar, or to a directory
+ * to cache there instead.  Setuid and setcap programs don't cache.
+ */
+#define DP_CACHE_ENV		"LIBEFIBOOT_DP_CACHE"
+#define DP_CACHE_DEFAULT_DIR	"/run/efivar"
+
+/*
+ * Look for the device part of an ESP's device path, i.e. everything
+ * before File().  Returns the size and sets *dp, or -1 on a miss.
+ */
+extern ssize_t HIDDEN dp_cache_lookup(const char * const devpath,
+				      int partition, uint32_t options,
+				      uint8_t **dp);
+extern void HIDDEN dp_cache_store(const char * const devpath,
+				  int partition, uint32_t options,
+				  const char * const disk_name,
+				  const uint8_t * const dp, size_t dpsz);
+
+#endif /* _EFIBOOT_DP_CACHE_H */
+
+// vim:fenc=utf-8:tw=75:noet
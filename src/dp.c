@@ -72,7 +72,7 @@ efidp_duplicate_extra(const_efidp dp, efidp *out, size_t extra)
 		return -1;
 	}
 
-	new = calloc(1, plus);
+	new = efi_calloc(1, plus);
 	if (!new) {
 		efi_error("allocation failed");
 		return -1;
@@ -162,7 +162,7 @@ efidp_append_path(const_efidp dp0, const_efidp dp1, efidp *out)
 		return -1;
 	}
 
-	new = malloc(newsz);
+	new = efi_malloc(newsz);
 	if (!new) {
 		efi_error("allocation failed");
 		return -1;
@@ -225,7 +225,7 @@ efidp_append_node(const_efidp dp, const_efidp dn, efidp *out)
 		return -1;
 	}
 
-	efidp new = malloc(newsz);
+	efidp new = efi_malloc(newsz);
 	if (!new) {
 		efi_error("allocation failed");
 		return -1;
@@ -276,7 +276,7 @@ efidp_append_instance(const_efidp dp, const_efidp dpi, efidp *out)
 	}
 	le->subtype = EFIDP_END_INSTANCE;
 
-	efidp new = malloc(lsz + rsz + sizeof (end_entire));
+	efidp new = efi_malloc(lsz + rsz + sizeof (end_entire));
 	if (!new)
 		return -1;
 
@@ -49,7 +49,7 @@
 #define onstack(buf, len) ({						\
 		char *__newbuf = alloca(len);				\
 		memcpy(__newbuf, buf, len);				\
-		free(buf);						\
+		efi_free(buf);						\
 		(void *)__newbuf;					\
 	})
 
@@ -24,6 +24,7 @@
 #include "efivar.h"
 #include "esl-iter.h"
 #include "secdb.h"
+#include "sha256.h"
 #include "x509.h"
 
 #endif /* !PRIVATE_EFISEC_H_ */
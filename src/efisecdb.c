@@ -135,6 +135,25 @@ secdb_errx(int status, const char * const fmt, ...)
 	exit(status);
 }
 
+static int
+write_all(int fd, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size) {
+		ssize_t sz = write(fd, p, size);
+
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += sz;
+		size -= sz;
+	}
+	return 0;
+}
+
 static void NORETURN
 usage(int status)
 {
@@ -148,6 +167,20 @@ usage(int status)
 		"  -h, --hash=<hash>         hash value to add (\n"
 		"  -t, --type=<hash-type>    hash type to add (\"help\" lists options)\n"
 		"  -c, --certificate=<file>  certificate file to add\n"
+		"  -C, --compact             merge compatible signature lists\n"
+		"  -D, --append-delta=<var>  append only entries missing from variable <var>\n"
+		"  -S, --auth=<file>         authentication header for --append-delta\n"
+		"  -F, --filter              copy entries from the input files to the output\n"
+		"                            one list at a time, keeping only those that\n"
+		"                            match the filter options below, and dropping\n"
+		"                            any hashes or certs given with --remove\n"
+		"  -k, --keep-owner=<GUID>   keep only entries owned by GUID\n"
+		"  -x, --drop-owner=<GUID>   drop entries owned by GUID\n"
+		"  -T, --keep-type=<type>    keep only entries of type (e.g. sha256)\n"
+		"  -P, --split-owners        write each owner's entries to <outfile>.<GUID>\n"
+		"  -I, --write-index=<file>  write a lookup index of the output database\n"
+		"  -Q, --query-index=<file>  report whether each hash or cert is in the\n"
+		"                            index, checking it against any input file\n"
 		"  -L, --list-guids          list well known guids\n",
 		program_invocation_short_name);
 	exit(status);
@@ -176,9 +209,6 @@ add_action(list_t *list, action_type_t action_type, const efi_guid_t *owner,
 {
 	action_t *action;
 
-	if (action_type == ADD && efi_guid_is_empty(owner))
-		errx(1, "no owner spefified for --add");
-
 	action = calloc(1, sizeof(action_t));
 	if (!action)
 		err(1, "could not allocate memory");
@@ -250,6 +280,449 @@ list_guids(void)
 	}
 }
 
+static const struct {
+	const char * const name;
+	const efi_guid_t * const guid;
+} secdb_variables[] = {
+	{ "PK", &efi_guid_global },
+	{ "KEK", &efi_guid_global },
+	{ "db", &efi_guid_security },
+	{ "dbx", &efi_guid_security },
+	{ "dbt", &efi_guid_security },
+	{ "dbr", &efi_guid_security },
+};
+
+/*
+ * Take either a well known variable name, like "dbx", or GUID-Name
+ */
+static void
+parse_variable_name(const char *arg, efi_guid_t *guid, const char **name)
+{
+	char guidstr[37];	// 36 characters of GUID and a NUL
+	int rc;
+
+	for (unsigned int i = 0;
+	     i < sizeof(secdb_variables) / sizeof(secdb_variables[0]); i++) {
+		if (!strcmp(arg, secdb_variables[i].name)) {
+			*guid = *secdb_variables[i].guid;
+			*name = secdb_variables[i].name;
+			return;
+		}
+	}
+
+	if (strlen(arg) < sizeof(guidstr) + 1 ||
+	    arg[sizeof(guidstr) - 1] != '-')
+		secdb_errx(1, "invalid variable \"%s\"", arg);
+	memcpy(guidstr, arg, sizeof(guidstr) - 1);
+	guidstr[sizeof(guidstr) - 1] = '\0';
+	rc = efi_str_to_guid(guidstr, guid);
+	if (rc < 0)
+		secdb_errx(1, "invalid variable GUID \"%s\"", guidstr);
+	*name = arg + sizeof(guidstr);
+}
+
+/*
+ * Read the AUTHENTICATION_2 descriptor to put in front of the delta.  The
+ * file can be just the descriptor or a whole signed update; in the latter
+ * case its payload has to be exactly the delta we'd write, or the
+ * signature won't match.
+ */
+static size_t
+get_auth_header(const char *authfile, uint8_t **authp,
+		const uint8_t *delta, size_t deltasz)
+{
+	efi_secdb_format_t format;
+	uint8_t *auth = NULL;
+	ssize_t authsz;
+	size_t offset = 0;
+	int rc;
+
+	authsz = get_file(&auth, "%s", authfile);
+	if (authsz < 0)
+		secdb_err(1, "could not read \"%s\"", authfile);
+	authsz -= 1;
+
+	rc = efi_secdb_sniff_format(auth, authsz, &format, &offset);
+	if (rc < 0 || format != EFI_SECDB_FORMAT_AUTH2)
+		secdb_errx(1, "\"%s\" does not start with an authentication header",
+			   authfile);
+	if ((size_t)authsz > offset &&
+	    ((size_t)authsz - offset != deltasz ||
+	     memcmp(auth + offset, delta, deltasz)))
+		secdb_errx(1, "signed payload in \"%s\" does not match the entries to append",
+			   authfile);
+
+	*authp = auth;
+	return offset;
+}
+
+/*
+ * Compute the entries in want that the live variable doesn't have yet,
+ * and either append just those to it or, with outfile, write them there
+ * to be signed.
+ */
+static int
+append_delta(efi_secdb_t *want, const char *variable, const char *authfile,
+	     const char *outfile, bool force)
+{
+	efi_secdb_t *have = NULL, *delta = NULL;
+	efi_guid_t guid;
+	const char *name = NULL;
+	uint8_t *data = NULL, *auth = NULL, *buf;
+	size_t datasz = 0, authsz = 0;
+	uint32_t attributes = EFI_VARIABLE_NON_VOLATILE |
+			      EFI_VARIABLE_BOOTSERVICE_ACCESS |
+			      EFI_VARIABLE_RUNTIME_ACCESS |
+			      EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS;
+	void *output = NULL;
+	size_t size = 0;
+	int rc;
+
+	parse_variable_name(variable, &guid, &name);
+
+	rc = efi_get_variable(guid, name, &data, &datasz, &attributes);
+	if (rc < 0 && errno != ENOENT)
+		secdb_err(1, "could not read variable \"%s\"", variable);
+	if (rc >= 0 && datasz > 0) {
+		rc = efi_secdb_parse_any(data, datasz, &have);
+		if (rc < 0)
+			secdb_err(1, "could not parse variable \"%s\"", variable);
+	}
+	efi_error_clear();
+	efi_free(data);
+
+	rc = efi_secdb_delta(want, have, &delta);
+	efi_secdb_free(have);
+	if (rc < 0)
+		secdb_err(1, "could not compute entries to append");
+
+	rc = efi_secdb_realize(delta, &output, &size);
+	efi_secdb_free(delta);
+	if (rc < 0)
+		secdb_err(1, "could not realize signature list");
+	if (size == 0) {
+		printf("%s: %s is already up to date\n",
+		       program_invocation_short_name, variable);
+		efi_free(output);
+		return 0;
+	}
+
+	if (authfile)
+		authsz = get_auth_header(authfile, &auth, output, size);
+
+	buf = malloc(authsz + size);
+	if (!buf)
+		err(1, "could not allocate memory");
+	if (authsz)
+		memcpy(buf, auth, authsz);
+	memcpy(buf + authsz, output, size);
+	free(auth);
+	efi_free(output);
+
+	if (outfile) {
+		int flags = O_WRONLY | O_CREAT | O_TRUNC | (force ? 0 : O_EXCL);
+		int outfd = open(outfile, flags, 0600);
+
+		if (outfd < 0)
+			err(1, "could not open \"%s\"", outfile);
+		if (write_all(outfd, buf, authsz + size) < 0) {
+			unlink(outfile);
+			err(1, "could not write signature list");
+		}
+		close(outfd);
+	} else {
+		rc = efi_append_variable(guid, name, buf, authsz + size,
+					 attributes);
+		if (rc < 0)
+			secdb_err(1, "could not append to \"%s\"", variable);
+	}
+	printf("%s: %s %zd bytes of new entries for %s\n",
+	       program_invocation_short_name,
+	       outfile ? "wrote" : "appended", size, variable);
+	free(buf);
+
+	return 0;
+}
+
+/*
+ * --filter predicates; an entry has to pass all of them to be kept.
+ */
+struct filter {
+	efi_guid_t *keep_owners;
+	size_t n_keep_owners;
+	efi_guid_t *drop_owners;
+	size_t n_drop_owners;
+	efi_secdb_type_t *keep_types;
+	size_t n_keep_types;
+
+	/* with --split-owners, the owner whose file is being written */
+	const efi_guid_t *split_owner;
+	/* and while looking for owners, the ones found so far */
+	efi_guid_t *owners;
+	size_t n_owners;
+};
+
+static struct filter filter;
+
+static void
+free_filter(void)
+{
+	free(filter.keep_owners);
+	free(filter.drop_owners);
+	free(filter.keep_types);
+	free(filter.owners);
+	memset(&filter, 0, sizeof(filter));
+}
+
+static void
+add_guid(efi_guid_t **guids, size_t *n, const efi_guid_t *guid)
+{
+	efi_guid_t *new;
+
+	new = realloc(*guids, (*n + 1) * sizeof(*guid));
+	if (!new)
+		err(1, "could not allocate memory");
+	new[*n] = *guid;
+	*guids = new;
+	*n += 1;
+}
+
+static bool
+has_guid(const efi_guid_t *guids, size_t n, const efi_guid_t *guid)
+{
+	for (size_t i = 0; i < n; i++) {
+		if (efi_guid_equal(&guids[i], guid))
+			return true;
+	}
+	return false;
+}
+
+static void
+add_filter_owner(efi_guid_t **guids, size_t *n, const char *arg)
+{
+	efi_guid_t guid;
+
+	if (efi_id_guid_to_guid(arg, &guid) < 0)
+		secdb_errx(1, "could not parse guid \"%s\"", arg);
+	add_guid(guids, n, &guid);
+}
+
+static void
+add_filter_type(const char *arg)
+{
+	efi_secdb_type_t *new;
+	efi_guid_t guid;
+	int type;
+
+	if (efi_id_guid_to_guid(arg, &guid) < 0 ||
+	    (type = secdb_entry_type_from_guid(&guid)) < 0)
+		secdb_errx(1, "invalid signature type \"%s\"", arg);
+
+	new = realloc(filter.keep_types,
+		      (filter.n_keep_types + 1) * sizeof(*new));
+	if (!new)
+		err(1, "could not allocate memory");
+	new[filter.n_keep_types++] = type;
+	filter.keep_types = new;
+}
+
+static int
+filter_entry(const efi_guid_t * const owner,
+	     const efi_secdb_type_t algorithm,
+	     const efi_secdb_data_t * const data,
+	     const size_t datasz,
+	     void *closure)
+{
+	struct filter *f = closure;
+	list_t *pos;
+	size_t i;
+
+	if (f->split_owner &&
+	    (!owner || !efi_guid_equal(owner, f->split_owner)))
+		return 0;
+	if (f->n_keep_owners &&
+	    (!owner || !has_guid(f->keep_owners, f->n_keep_owners, owner)))
+		return 0;
+	if (owner && has_guid(f->drop_owners, f->n_drop_owners, owner))
+		return 0;
+
+	for (i = 0; i < f->n_keep_types; i++) {
+		if (f->keep_types[i] == algorithm)
+			break;
+	}
+	if (f->n_keep_types && i == f->n_keep_types)
+		return 0;
+
+	for_each_action(pos, &actions) {
+		action_t *action = list_entry(pos, action_t, list);
+
+		if (action->algorithm != algorithm ||
+		    action->datasz != datasz ||
+		    memcmp(action->data, data, datasz))
+			continue;
+		if (efi_guid_is_empty(&action->owner) ||
+		    (owner && efi_guid_equal(owner, &action->owner)))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Note the owner of each entry that would be kept, but don't keep any.
+ */
+static int
+collect_owner(const efi_guid_t * const owner,
+	      const efi_secdb_type_t algorithm,
+	      const efi_secdb_data_t * const data,
+	      const size_t datasz,
+	      void *closure)
+{
+	struct filter *f = closure;
+
+	if (owner && filter_entry(owner, algorithm, data, datasz, f) &&
+	    !has_guid(f->owners, f->n_owners, owner))
+		add_guid(&f->owners, &f->n_owners, owner);
+	return 0;
+}
+
+typedef struct {
+	const char *name;
+	uint8_t *data;
+	size_t datasz;
+} mapped_file_t;
+
+/*
+ * Map the input files rather than reading them, so --filter's memory use
+ * doesn't depend on how big they are.
+ */
+static mapped_file_t *
+map_input_files(list_t *infiles, size_t *n)
+{
+	mapped_file_t *files = NULL;
+	list_t *pos;
+
+	*n = 0;
+	for_each_ptr(pos, infiles) {
+		ptrlist_t *entry = list_entry(pos, ptrlist_t, list);
+		mapped_file_t *new;
+		struct stat sb;
+		void *data = NULL;
+		int infd;
+
+		infd = open(entry->ptr, O_RDONLY);
+		if (infd < 0)
+			err(1, "could not open \"%s\"", (char *)entry->ptr);
+		if (fstat(infd, &sb) < 0)
+			err(1, "could not stat \"%s\"", (char *)entry->ptr);
+		if (sb.st_size > 0) {
+			data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE,
+				    infd, 0);
+			if (data == MAP_FAILED)
+				err(1, "could not map \"%s\"",
+				    (char *)entry->ptr);
+		}
+		close(infd);
+
+		new = realloc(files, (*n + 1) * sizeof(*files));
+		if (!new)
+			err(1, "could not allocate memory");
+		files = new;
+		files[*n].name = entry->ptr;
+		files[*n].data = data;
+		files[*n].datasz = sb.st_size;
+		*n += 1;
+	}
+
+	return files;
+}
+
+static size_t
+filter_files(mapped_file_t *files, size_t n, efi_secdb_filter_t *fn,
+	     int outfd, const char *outfile)
+{
+	size_t total = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		size_t size = 0;
+		int rc;
+
+		if (!files[i].datasz)
+			continue;
+		rc = efi_secdb_filter_stream(files[i].data, files[i].datasz,
+					     fn, &filter, outfd, &size);
+		if (rc < 0) {
+			if (outfile)
+				unlink(outfile);
+			secdb_err(1, "could not filter \"%s\"", files[i].name);
+		}
+		total += size;
+	}
+
+	return total;
+}
+
+static int
+open_output(const char *outfile, bool force)
+{
+	int flags = O_WRONLY | O_CREAT | O_TRUNC | (force ? 0 : O_EXCL);
+	int outfd;
+
+	debug("adding output file %s", outfile);
+	outfd = open(outfile, flags, 0600);
+	if (outfd < 0)
+		err(1, "could not open \"%s\"", outfile);
+	return outfd;
+}
+
+/*
+ * --filter: stream the input files to the output(s) without ever
+ * building a secdb.
+ */
+static int
+filter_input_files(list_t *infiles, const char *outfile, bool force,
+		   bool split)
+{
+	mapped_file_t *files;
+	size_t n, size;
+	int outfd;
+
+	files = map_input_files(infiles, &n);
+
+	if (!split) {
+		outfd = open_output(outfile, force);
+		size = filter_files(files, n, filter_entry, outfd, outfile);
+		close(outfd);
+		debug("wrote %zd bytes to %s", size, outfile);
+	} else {
+		filter_files(files, n, collect_owner, -1, NULL);
+		for (size_t i = 0; i < filter.n_owners; i++) {
+			char *guidstr = NULL;
+			char *path = NULL;
+
+			if (efi_guid_to_str(&filter.owners[i], &guidstr) < 0 ||
+			    asprintf(&path, "%s.%s", outfile, guidstr) < 0)
+				err(1, "could not allocate memory");
+			filter.split_owner = &filter.owners[i];
+			outfd = open_output(path, force);
+			size = filter_files(files, n, filter_entry, outfd, path);
+			close(outfd);
+			printf("%s: wrote %zd bytes to %s\n",
+			       program_invocation_short_name, size, path);
+			free(path);
+			free(guidstr);
+		}
+		filter.split_owner = NULL;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (files[i].datasz)
+			munmap(files[i].data, files[i].datasz);
+	}
+	free(files);
+	return 0;
+}
+
 /*
  * The return value here is the UNIX shell convention, 0 is success, > 0 is
  * failure.
@@ -281,23 +754,13 @@ parse_input_files(list_t *infiles, efi_secdb_t **secdb, bool dump)
 		siglistsz -= 1;
 		close(infd);
 
-		rc = efi_secdb_parse(siglist, siglistsz, secdb);
-		efi_error_clear();
+		rc = efi_secdb_parse_any(siglist, siglistsz, secdb);
 		if (rc < 0) {
-			/* haaaack city */
-			debug("*****************************");
-			debug(" starting over with offset 4");
-			debug("*****************************");
-			if (siglistsz > 4 && !(*(uint32_t *)siglist & ~0x7ffu))
-				rc = efi_secdb_parse(&siglist[4], siglistsz-4,
-						     secdb);
-			if (rc < 0) {
-				secdb_warnx("could not parse input file \"%s\"", infile);
-				if (!dump)
-					exit(1);
-				status = 1;
-				break;
-			}
+			secdb_warnx("could not parse input file \"%s\"", infile);
+			if (!dump)
+				exit(1);
+			status = 1;
+			break;
 		}
 		xfree(siglist);
 		list_del(&entry->list);
@@ -307,6 +770,117 @@ parse_input_files(list_t *infiles, efi_secdb_t **secdb, bool dump)
 	return status;
 }
 
+/*
+ * --write-index: checkers may have the old index mapped, so the new one
+ * is written beside it and renamed into place rather than truncating it
+ * under them.
+ */
+static void
+write_index(efi_secdb_t *secdb, const char *indexfile,
+	    const char *sourcefile, bool force)
+{
+	uint8_t *source = NULL;
+	ssize_t sourcesz = 0;
+	void *output = NULL;
+	size_t size = 0;
+	char *tmpfile = NULL;
+	int fd, rc;
+
+	if (!force && access(indexfile, F_OK) == 0)
+		errx(1, "could not open \"%s\": %s", indexfile,
+		     strerror(EEXIST));
+
+	if (sourcefile) {
+		sourcesz = get_file(&source, "%s", sourcefile);
+		if (sourcesz < 0)
+			err(1, "could not read \"%s\"", sourcefile);
+		sourcesz -= 1;
+	}
+
+	rc = efi_secdb_index_build(secdb, source, sourcesz, &output, &size);
+	xfree(source);
+	if (rc < 0)
+		secdb_err(1, "could not build index");
+
+	if (asprintf(&tmpfile, "%s.XXXXXX", indexfile) < 0)
+		err(1, "could not allocate memory");
+	fd = mkstemp(tmpfile);
+	if (fd < 0)
+		err(1, "could not create \"%s\"", tmpfile);
+	if (fchmod(fd, 0644) < 0 || write_all(fd, output, size) < 0 ||
+	    close(fd) < 0 || rename(tmpfile, indexfile) < 0) {
+		unlink(tmpfile);
+		err(1, "could not write \"%s\"", indexfile);
+	}
+	free(tmpfile);
+	free(output);
+}
+
+static const char *
+algorithm_name(efi_secdb_type_t algorithm)
+{
+	if (algorithm == X509_CERT)
+		return "x509";
+	for (int i = 0; i < n_hash_params; i++)
+		if (hash_params[i].algorithm == algorithm)
+			return hash_params[i].name;
+	return "unknown";
+}
+
+/*
+ * --query-index: report whether each hash or certificate on the command
+ * line is in the index, after making sure it describes the input file if
+ * one was given.
+ */
+static int
+query_index(const char *indexfile, list_t *infiles)
+{
+	efi_secdb_index_t *index = NULL;
+	list_t *pos;
+	int rc;
+
+	rc = efi_secdb_index_open(indexfile, &index);
+	if (rc < 0)
+		secdb_err(1, "could not open index \"%s\"", indexfile);
+
+	for_each_ptr(pos, infiles) {
+		ptrlist_t *entry = list_entry(pos, ptrlist_t, list);
+		char *infile = entry->ptr;
+		uint8_t *data = NULL;
+		ssize_t datasz;
+
+		datasz = get_file(&data, "%s", infile);
+		if (datasz < 0)
+			err(1, "could not read \"%s\"", infile);
+		rc = efi_secdb_index_is_current(index, data, datasz - 1);
+		xfree(data);
+		if (rc == 0)
+			errx(1, "index \"%s\" is out of date for \"%s\"",
+			     indexfile, infile);
+	}
+
+	for_each_action(pos, &actions) {
+		action_t *action = list_entry(pos, action_t, list);
+
+		rc = efi_secdb_index_contains(index, action->algorithm,
+					      (efi_secdb_data_t *)action->data,
+					      action->datasz);
+		if (rc < 0)
+			secdb_err(1, "could not query index");
+		printf("%s %s ", rc ? "present" : "absent",
+		       algorithm_name(action->algorithm));
+		if (action->algorithm == X509_CERT)
+			printf("(%zd bytes)\n", action->datasz);
+		else
+			for (size_t i = 0; i < action->datasz; i++)
+				printf("%02x%s", action->data[i],
+				       i + 1 == action->datasz ? "\n" : "");
+	}
+
+	efi_secdb_index_close(index);
+	return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -320,28 +894,47 @@ main(int argc, char *argv[])
 	int verbose = 0;
 	bool dump = false;
 	bool annotate = false;
+	bool compact = false;
+	bool wants_remove_actions = false;
+	char *append_variable = NULL;
+	char *authfile = NULL;
 	bool wants_add_actions = false;
 	bool did_list_guids = false;
+	bool do_filter = false;
+	bool split_owners = false;
 	bool do_sort = true;
 	bool do_sort_data = false;
 	bool sort_descending = false;
 	int status = 0;
 	char *outfile = NULL;
+	char *indexfile = NULL;
+	char *queryfile = NULL;
+	char *index_source = NULL;
 
-	const char sopts[] = ":aAc:dfg:h:i:Lo:rs:t:v?";
+	const char sopts[] = ":aAc:CdD:fFg:h:i:I:k:Lo:PQ:rs:S:t:T:vx:?";
 	const struct option lopts[] = {
 		{"add", no_argument, NULL, 'a' },
 		{"annotate", no_argument, NULL, 'A' },
+		{"append-delta", required_argument, NULL, 'D' },
+		{"auth", required_argument, NULL, 'S' },
 		{"certificate", required_argument, NULL, 'c' },
+		{"compact", no_argument, NULL, 'C' },
+		{"drop-owner", required_argument, NULL, 'x' },
 		{"dump", no_argument, NULL, 'd' },
+		{"filter", no_argument, NULL, 'F' },
 		{"force", no_argument, NULL, 'f' },
 		{"owner-guid", required_argument, NULL, 'g' },
 		{"hash", required_argument, NULL, 'h' },
 		{"infile", required_argument, NULL, 'i' },
+		{"write-index", required_argument, NULL, 'I' },
+		{"keep-owner", required_argument, NULL, 'k' },
+		{"keep-type", required_argument, NULL, 'T' },
 		{"list-guids", no_argument, NULL, 'L' },
 		{"outfile", required_argument, NULL, 'o' },
+		{"query-index", required_argument, NULL, 'Q' },
 		{"remove", no_argument, NULL, 'r' },
 		{"sort", required_argument, NULL, 's' },
+		{"split-owners", no_argument, NULL, 'P' },
 		{"type", required_argument, NULL, 't' },
 		{"verbose", no_argument, NULL, 'v' },
 		{"usage", no_argument, NULL, '?' },
@@ -355,6 +948,7 @@ main(int argc, char *argv[])
 	atexit(free_actions);
 	atexit(free_infiles);
 	atexit(maybe_free_secdb);
+	atexit(free_filter);
 
 	/*
 	 * parse the command line.
@@ -394,14 +988,27 @@ main(int argc, char *argv[])
 			      mode == ADD ? "adding" : "removing", datasz);
 			if (mode == ADD)
 				wants_add_actions = true;
+			else
+				wants_remove_actions = true;
 			add_action(&actions, mode, &owner, X509_CERT, data, datasz);
 			break;
+		case 'C':
+			compact = true;
+			break;
 		case 'd':
 			dump = true;
 			break;
+		case 'D':
+			if (optarg == NULL)
+				secdb_errx(1, "--append-delta requires a value");
+			append_variable = optarg;
+			break;
 		case 'f':
 			force = true;
 			break;
+		case 'F':
+			do_filter = true;
+			break;
 		case 'g':
 			if (optarg == NULL)
 				secdb_errx(1, "--owner-guid requires a value");
@@ -425,6 +1032,8 @@ main(int argc, char *argv[])
 			debug("%s hash %s", mode == ADD ? "adding" : "removing", optarg);
 			if (mode == ADD)
 				wants_add_actions = true;
+			else
+				wants_remove_actions = true;
 			add_action(&actions, mode, &owner,
 				   hash_params[hash_index].algorithm,
 				   data, datasz);
@@ -434,6 +1043,17 @@ main(int argc, char *argv[])
 				secdb_errx(1, "--infile requires a value");
 			ptrlist_add(&infiles, optarg);
 			break;
+		case 'I':
+			if (optarg == NULL)
+				secdb_errx(1, "--write-index requires a value");
+			indexfile = optarg;
+			break;
+		case 'k':
+			if (optarg == NULL)
+				secdb_errx(1, "--keep-owner requires a value");
+			add_filter_owner(&filter.keep_owners,
+					 &filter.n_keep_owners, optarg);
+			break;
 		case 'L':
 			list_guids();
 			did_list_guids = true;
@@ -445,6 +1065,14 @@ main(int argc, char *argv[])
 				secdb_errx(1, "--outfile requires a value");
 			outfile = optarg;
 			break;
+		case 'P':
+			split_owners = true;
+			break;
+		case 'Q':
+			if (optarg == NULL)
+				secdb_errx(1, "--query-index requires a value");
+			queryfile = optarg;
+			break;
 		case 'r':
 			mode = REMOVE;
 			break;
@@ -476,11 +1104,21 @@ sort_err:
 				goto sort_err;
 			}
 			break;
+		case 'S':
+			if (optarg == NULL)
+				secdb_errx(1, "--auth requires a value");
+			authfile = optarg;
+			break;
 		case 't':
 			if (optarg == NULL)
 				secdb_errx(1, "--type requires a value");
 			set_hash_parameters(optarg, &hash_index);
 			break;
+		case 'T':
+			if (optarg == NULL)
+				secdb_errx(1, "--keep-type requires a value");
+			add_filter_type(optarg);
+			break;
 		case 'v':
 			if (optarg) {
 				long v;
@@ -492,6 +1130,12 @@ sort_err:
 				verbose += 1;
 			}
 			break;
+		case 'x':
+			if (optarg == NULL)
+				secdb_errx(1, "--drop-owner requires a value");
+			add_filter_owner(&filter.drop_owners,
+					 &filter.n_drop_owners, optarg);
+			break;
 		case '?':
 			usage(0);
 			break;
@@ -508,7 +1152,41 @@ sort_err:
 		setvbuf(stdout, NULL, _IONBF, 0);
 	}
 
-	if (!outfile && !dump) {
+	if (append_variable && wants_remove_actions)
+		secdb_errx(1, "--append-delta cannot remove entries");
+	if (authfile && !append_variable)
+		secdb_errx(1, "--auth requires --append-delta");
+	if ((filter.n_keep_owners || filter.n_drop_owners ||
+	     filter.n_keep_types || split_owners) && !do_filter)
+		errx(1, "filter options require --filter");
+
+	if (queryfile) {
+		if (outfile || indexfile || dump || compact || append_variable ||
+		    do_filter || wants_remove_actions)
+			errx(1, "--query-index can only be combined with --infile, --hash, and --certificate");
+		return query_index(queryfile, &infiles);
+	}
+
+	for_each_action(pos, &actions) {
+		action_t *action = list_entry(pos, action_t, list);
+
+		if (action->action == ADD && efi_guid_is_empty(&action->owner))
+			errx(1, "no owner spefified for --add");
+	}
+
+	if (do_filter) {
+		if (!outfile)
+			errx(1, "no output file specified");
+		if (list_empty(&infiles))
+			errx(1, "--filter requires input files");
+		if (wants_add_actions || dump || compact || append_variable ||
+		    indexfile)
+			errx(1, "--filter can only be combined with --remove");
+		return filter_input_files(&infiles, outfile, force,
+					  split_owners);
+	}
+
+	if (!outfile && !dump && !append_variable && !indexfile) {
 		if (did_list_guids)
 			return 0;
 		errx(1, "no output file specified");
@@ -525,6 +1203,18 @@ sort_err:
 	efi_secdb_set_bool(secdb, EFI_SECDB_SORT_DATA, do_sort_data);
 	efi_secdb_set_bool(secdb, EFI_SECDB_SORT_DESCENDING, sort_descending);
 
+	/*
+	 * An index of one unmodified input file records that file's digest,
+	 * so it can be checked against the file (or variable) later;
+	 * otherwise it records the digest of the database we write out.
+	 */
+	if (list_size(&infiles) == 1 && !wants_add_actions &&
+	    !wants_remove_actions && !compact) {
+		ptrlist_t *entry = list_entry(infiles.next, ptrlist_t, list);
+
+		index_source = entry->ptr;
+	}
+
 	status = parse_input_files(&infiles, &secdb, dump);
 	if (status == 0) {
 		for_each_action_safe(pos, tmp, &actions) {
@@ -549,9 +1239,27 @@ sort_err:
 		}
 	}
 
+	if (status == 0 && compact) {
+		size_t before = 0, after = 0;
+
+		rc = efi_secdb_compact(secdb, &before, &after);
+		if (rc < 0)
+			secdb_err(1, "could not compact signature lists");
+		fprintf(stderr, "%s: compacted %zd bytes to %zd, saving %zd\n",
+			program_invocation_short_name, before, after,
+			before - after);
+	}
+
 	if (dump)
 		secdb_dump(secdb, annotate);
 
+	if (status == 0 && append_variable)
+		return append_delta(secdb, append_variable, authfile, outfile,
+				    force);
+
+	if (status == 0 && indexfile)
+		write_index(secdb, indexfile, index_source, force);
+
 	if (!outfile)
 		exit(status);
 
@@ -581,7 +1289,7 @@ sort_err:
 		secdb_err(1, "could not realize signature list");
 	}
 
-	rc = write(outfd, output, size);
+	rc = write_all(outfd, output, size);
 	if (rc < 0) {
 		unlink(outfile);
 		err(1, "could not write signature list");
@@ -13,18 +13,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 
 extern char *optarg;
 extern int optind, opterr, optopt;
 
 #include "efivar.h"
 #include "efivar/efivar-guids.h"
+#include "backup.h"
+#include "decode.h"
+#include "profile.h"
 
 #define ACTION_USAGE		0x00
 #define ACTION_LIST		0x01
@@ -35,12 +40,18 @@ extern int optind, opterr, optopt;
 #define ACTION_PRINT_DEC	0x20
 #define ACTION_IMPORT		0x40
 #define ACTION_EXPORT		0x80
+#define ACTION_PROFILE		0x100
+#define ACTION_WRITE_STATS	0x200
+#define ACTION_BACKUP		0x400
+#define ACTION_RESTORE		0x800
 
 #define EDIT_APPEND	0
 #define EDIT_WRITE	1
 
 #define SHOW_VERBOSE	0
 #define SHOW_DECIMAL	1
+#define SHOW_DECODED	2
+#define SHOW_JSON	3
 
 static const char *attribute_names[] = {
 	"Non-Volatile",
@@ -81,14 +92,35 @@ err:
 	}
 }
 
+static void show_variable_data(efi_guid_t guid, const char *name,
+			       uint32_t attributes, uint8_t *data,
+			       size_t data_size, int display_type);
+
 static void
-list_all_variables(void)
+list_all_variables(int display_type)
 {
 	efi_guid_t *guid = NULL;
 	char *name = NULL;
 	int rc;
-	while ((rc = efi_get_next_variable_name(&guid, &name)) > 0)
-		 printf(GUID_FORMAT "-%s\n", GUID_FORMAT_ARGS(guid), name);
+	while ((rc = efi_get_next_variable_name(&guid, &name)) > 0) {
+		uint8_t *data = NULL;
+		size_t data_size = 0;
+		uint32_t attributes = 0;
+
+		if (display_type != SHOW_JSON) {
+			printf(GUID_FORMAT "-%s\n", GUID_FORMAT_ARGS(guid), name);
+			continue;
+		}
+		if (efi_get_variable(*guid, name, &data, &data_size,
+				     &attributes) < 0) {
+			warn("could not read " GUID_FORMAT "-%s",
+			     GUID_FORMAT_ARGS(guid), name);
+			continue;
+		}
+		show_variable_data(*guid, name, attributes, data, data_size,
+				   SHOW_JSON);
+		free(data);
+	}
 
 	if (rc < 0) {
 		fprintf(stderr, "efivar: error listing variables: %m\n");
@@ -97,6 +129,122 @@ list_all_variables(void)
 	}
 }
 
+typedef struct {
+	const efi_guid_t *guid;		/* NULL when totalling by executable */
+	const char *name;		/* variable or executable */
+	uint64_t counts[WRITE_LEDGER_DEL + 1];
+	uint64_t bytes;
+	int64_t last;
+} write_stat_t;
+
+static uint64_t
+write_stat_total(const write_stat_t *stat)
+{
+	return stat->counts[WRITE_LEDGER_SET] +
+	       stat->counts[WRITE_LEDGER_APPEND] +
+	       stat->counts[WRITE_LEDGER_DEL];
+}
+
+static int
+write_stat_cmp(const void *a, const void *b)
+{
+	uint64_t ta = write_stat_total(a), tb = write_stat_total(b);
+
+	return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+/*
+ * Total the ledger entries by variable, or by executable.
+ */
+static write_stat_t *
+total_write_stats(write_ledger_entry_t **entries, size_t n, bool by_exe,
+		  size_t *nstats)
+{
+	write_stat_t *stats = calloc(n ? n : 1, sizeof(*stats));
+	size_t i, j;
+
+	if (!stats)
+		err(1, "could not allocate memory");
+
+	*nstats = 0;
+	for (i = 0; i < n; i++) {
+		write_ledger_entry_t *entry = entries[i];
+		const char *name = by_exe ? entry->exe : entry->name;
+
+		for (j = 0; j < *nstats; j++) {
+			if (!strcmp(stats[j].name, name) &&
+			    (by_exe || efi_guid_equal(stats[j].guid,
+						      &entry->guid)))
+				break;
+		}
+		if (j == *nstats) {
+			stats[j].guid = by_exe ? NULL : &entry->guid;
+			stats[j].name = name;
+			*nstats += 1;
+		}
+		if (entry->op >= WRITE_LEDGER_SET &&
+		    entry->op <= WRITE_LEDGER_DEL)
+			stats[j].counts[entry->op] += entry->count;
+		stats[j].bytes += entry->bytes;
+		stats[j].last = MAX(stats[j].last, entry->last);
+	}
+
+	qsort(stats, *nstats, sizeof(*stats), write_stat_cmp);
+	return stats;
+}
+
+static void
+print_write_stats(const char *title, const char *what, write_stat_t *stats,
+		  size_t n)
+{
+	printf("%s:\n", title);
+	printf("%9s %9s %9s %12s  %-19s  %s\n", "sets", "appends", "deletes",
+	       "bytes", "last write", what);
+	for (size_t i = 0; i < n; i++) {
+		time_t last = stats[i].last;
+		char when[20] = "";
+
+		strftime(when, sizeof(when), "%F %T", localtime(&last));
+		printf("%9"PRIu64" %9"PRIu64" %9"PRIu64" %12"PRIu64"  %-19s  ",
+		       stats[i].counts[WRITE_LEDGER_SET],
+		       stats[i].counts[WRITE_LEDGER_APPEND],
+		       stats[i].counts[WRITE_LEDGER_DEL],
+		       stats[i].bytes, when);
+		if (stats[i].guid)
+			printf(GUID_FORMAT "-", GUID_FORMAT_ARGS(stats[i].guid));
+		printf("%s\n", stats[i].name);
+	}
+}
+
+/*
+ * Report what's in the write ledger, worst offenders first.
+ */
+static void
+show_write_stats(void)
+{
+	const char *path = write_ledger_path() ?: WRITE_LEDGER_DEFAULT_PATH;
+	write_ledger_entry_t **entries = NULL;
+	write_stat_t *stats;
+	size_t n = 0, nstats;
+
+	if (write_ledger_load(path, &entries, &n) < 0) {
+		fprintf(stderr, "efivar: could not read write ledger \"%s\": %m\n",
+			path);
+		show_errors();
+		exit(1);
+	}
+
+	stats = total_write_stats(entries, n, false, &nstats);
+	print_write_stats("Writes by variable", "variable", stats, nstats);
+	free(stats);
+	printf("\n");
+	stats = total_write_stats(entries, n, true, &nstats);
+	print_write_stats("Writes by executable", "executable", stats, nstats);
+	free(stats);
+
+	write_ledger_free(entries, n);
+}
+
 static void
 parse_name(const char *guid_name, char **name, efi_guid_t *guid)
 {
@@ -159,12 +307,89 @@ bad_name:
 	*name = name_buf;
 }
 
+static void
+show_hexdump(uint8_t *data, size_t data_size)
+{
+	uint32_t index = 0;
+	while (index < data_size) {
+		char charbuf[] = "................";
+		printf("%08x  ", index);
+		/* print the hex values, and render the ascii bits into
+		 * charbuf */
+		while (index < data_size) {
+			printf("%02x ", data[index]);
+			if (index % 8 == 7)
+				printf(" ");
+			if (safe_to_print(data[index]))
+				charbuf[index % 16] = data[index];
+			index++;
+			if (index % 16 == 0)
+				break;
+		}
+
+		/* If we're above data_size, finish out the line with
+		 * space, and also finish out charbuf with space */
+		while (index >= data_size && index % 16 != 0) {
+			if (index % 8 == 7)
+				printf(" ");
+			printf("   ");
+			charbuf[index % 16] = ' ';
+
+			index++;
+			if (index % 16 == 0)
+				break;
+		}
+		printf("|%s|\n", charbuf);
+	}
+}
+
+/*
+ * One JSON object per variable: the decoded value when we know its type,
+ * and the raw data as hex either way.
+ */
+static void
+show_variable_json(efi_guid_t guid, const char *name, uint32_t attributes,
+		   uint8_t *data, size_t data_size)
+{
+	const char *sep = "";
+	var_view_t view;
+	int rc;
+
+	printf("{\"guid\":\""GUID_FORMAT"\",\"name\":",
+	       GUID_FORMAT_ARGS(&guid));
+	json_string(stdout, name);
+	printf(",\"attributes\":[");
+	for (int i = 0; attribute_names[i][0] != '\0'; i++) {
+		if (attributes & (1 << i)) {
+			printf("%s", sep);
+			json_string(stdout, attribute_names[i]);
+			sep = ",";
+		}
+	}
+	printf("]");
+
+	rc = decode_variable(&guid, name, data, data_size, &view);
+	if (rc > 0) {
+		printf(",\"type\":");
+		json_string(stdout, view.type_name);
+		printf(",\"value\":");
+		if (render_variable(stdout, &view, DECODE_JSON) < 0)
+			printf("null");
+	}
+	printf(",\"data\":");
+	json_hex(stdout, data, data_size);
+	printf("}\n");
+}
+
 static void
 show_variable_data(efi_guid_t guid, const char *name, uint32_t attributes,
 		   uint8_t *data, size_t data_size,
 		   int display_type)
 {
-	if (display_type == SHOW_VERBOSE) {
+	if (display_type == SHOW_VERBOSE || display_type == SHOW_DECODED) {
+		var_view_t view;
+		int rc = 0;
+
 		printf("GUID: "GUID_FORMAT "\n", GUID_FORMAT_ARGS(&guid));
 		printf("Name: \"%s\"\n", name);
 		printf("Attributes:\n");
@@ -172,39 +397,22 @@ show_variable_data(efi_guid_t guid, const char *name, uint32_t attributes,
 			if(attributes & (1 << i))
 				printf("\t%s\n", attribute_names[i]);
 		}
-		printf("Value:\n");
 
-		uint32_t index = 0;
-		while (index < data_size) {
-			char charbuf[] = "................";
-			printf("%08x  ", index);
-			/* print the hex values, and render the ascii bits into
-			 * charbuf */
-			while (index < data_size) {
-				printf("%02x ", data[index]);
-				if (index % 8 == 7)
-					printf(" ");
-				if (safe_to_print(data[index]))
-					charbuf[index % 16] = data[index];
-				index++;
-				if (index % 16 == 0)
-					break;
-			}
-
-			/* If we're above data_size, finish out the line with
-			 * space, and also finish out charbuf with space */
-			while (index >= data_size && index % 16 != 0) {
-				if (index % 8 == 7)
-					printf(" ");
-				printf("   ");
-				charbuf[index % 16] = ' ';
-
-				index++;
-				if (index % 16 == 0)
-					break;
-			}
-			printf("|%s|\n", charbuf);
+		if (display_type == SHOW_DECODED)
+			rc = decode_variable(&guid, name, data, data_size,
+					     &view);
+		if (rc > 0) {
+			printf("Value (%s):\n", view.type_name);
+			if (render_variable(stdout, &view, DECODE_PRETTY) == 0)
+				return;
+			printf("\t(could not decode)\n");
+		} else if (rc < 0) {
+			warnx("could not decode \"%s\": %m", name);
 		}
+		printf("Value:\n");
+		show_hexdump(data, data_size);
+	} else if (display_type == SHOW_JSON) {
+		show_variable_json(guid, name, attributes, data, data_size);
 	} else if (display_type == SHOW_DECIMAL) {
 		uint32_t index = 0;
 		while (index < data_size) {
@@ -436,6 +644,9 @@ usage(int ret)
 		"  -D, --dmpstore                    use DMPSTORE format when exporting\n"
 		"  -d, --print-decimal               print variable in decimal values specified\n"
 		"                                    by --name\n"
+		"      --decode                      print well-known variables as their type\n"
+		"                                    rather than as a hex dump\n"
+		"      --json                        print variables as JSON objects\n"
 		"  -n, --name=<guid-name>            variable to manipulate, in the form\n"
 		"                                    8be4df61-93ca-11d2-aa0d-00e098032b8c-Boot0000\n"
 		"  -a, --append                      append to variable specified by --name\n"
@@ -443,7 +654,19 @@ usage(int ret)
 		"  -e, --export=<file>               export variable to <file>\n"
 		"  -i, --import=<file>               import variable from <file\n"
 		"  -L, --list-guids                  show internal guid list\n"
-		"  -w, --write                       write to variable specified by --name\n\n"
+		"  -w, --write                       write to variable specified by --name\n"
+		"  -P, --profile                     time reads of all variables, or the one\n"
+		"                                    specified by --name\n"
+		"  -c, --iterations=<count>          reads per variable when profiling\n"
+		"  -W, --profile-writes              also time writes of scratch variables\n"
+		"  -S, --write-stats                 report variable writes recorded in the\n"
+		"                                    ledger enabled by $LIBEFIVAR_WRITE_LEDGER\n"
+		"      --backup-repo=<dir>           back up variables to the repository in\n"
+		"                                    <dir>\n"
+		"      --restore-repo=<dir>          restore variables from the repository\n"
+		"                                    in <dir>\n"
+		"      --host=<name>                 host to back up or restore as (default\n"
+		"                                    is this host's name)\n\n"
 		"Help options:\n"
 		"  -?, --help                        Show this help message\n"
 		"      --usage                       Display brief usage message\n",
@@ -467,23 +690,38 @@ int main(int argc, char *argv[])
 	uint32_t attributes = EFI_VARIABLE_NON_VOLATILE
 			      | EFI_VARIABLE_BOOTSERVICE_ACCESS
 			      | EFI_VARIABLE_RUNTIME_ACCESS;
-	char *sopts = "aA:Dde:f:i:Llpn:vw?";
+	unsigned int iterations = 10;
+	bool profile_writes = false;
+	int display_type = SHOW_VERBOSE;
+	char *repo = NULL;
+	char *host = NULL;
+	char hostname[HOST_NAME_MAX + 1];
+	char *sopts = "aA:c:Dde:f:i:LlPpn:SvWw?";
 	struct option lopts[] = {
 		{"append", no_argument, 0, 'a'},
 		{"attributes", required_argument, 0, 'A'},
+		{"backup-repo", required_argument, 0, 0},
+		{"iterations", required_argument, 0, 'c'},
 		{"datafile", required_argument, 0, 'f'},
+		{"decode", no_argument, 0, 0},
 		{"dmpstore", no_argument, 0, 'D'},
 		{"export", required_argument, 0, 'e'},
 		{"help", no_argument, 0, '?'},
+		{"host", required_argument, 0, 0},
 		{"import", required_argument, 0, 'i'},
+		{"json", no_argument, 0, 0},
 		{"list", no_argument, 0, 'l'},
 		{"list-guids", no_argument, 0, 'L'},
 		{"name", required_argument, 0, 'n'},
 		{"print", no_argument, 0, 'p'},
 		{"print-decimal", no_argument, 0, 'd'},
+		{"profile", no_argument, 0, 'P'},
+		{"profile-writes", no_argument, 0, 'W'},
+		{"restore-repo", required_argument, 0, 0},
 		{"usage", no_argument, 0, 0},
 		{"verbose", no_argument, 0, 'v'},
 		{"write", no_argument, 0, 'w'},
+		{"write-stats", no_argument, 0, 'S'},
 		{0, 0, 0, 0}
 	};
 
@@ -498,6 +736,13 @@ int main(int argc, char *argv[])
 			case 'a':
 				action |= ACTION_APPEND;
 				break;
+			case 'c':
+				errno = 0;
+				iterations = strtoul(optarg, NULL, 0);
+				if (errno || !iterations)
+					errx(1, "invalid argument for -c: %s",
+					     optarg);
+				break;
 			case 'D':
 				dmpstore = true;
 				break;
@@ -524,12 +769,21 @@ int main(int argc, char *argv[])
 			case 'n':
 				guid_name = optarg;
 				break;
+			case 'P':
+				action |= ACTION_PROFILE;
+				break;
 			case 'p':
 				action |= ACTION_PRINT;
 				break;
+			case 'S':
+				action |= ACTION_WRITE_STATS;
+				break;
 			case 'v':
 				verbose += 1;
 				break;
+			case 'W':
+				profile_writes = true;
+				break;
 			case 'w':
 				action |= ACTION_WRITE;
 				break;
@@ -537,23 +791,36 @@ int main(int argc, char *argv[])
 				usage(EXIT_SUCCESS);
 				break;
 			case 0:
-				if (strcmp(lopts[i].name, "usage"))
+				if (!strcmp(lopts[i].name, "decode")) {
+					display_type = SHOW_DECODED;
+				} else if (!strcmp(lopts[i].name, "json")) {
+					display_type = SHOW_JSON;
+				} else if (!strcmp(lopts[i].name, "backup-repo")) {
+					action |= ACTION_BACKUP;
+					repo = optarg;
+				} else if (!strcmp(lopts[i].name, "restore-repo")) {
+					action |= ACTION_RESTORE;
+					repo = optarg;
+				} else if (!strcmp(lopts[i].name, "host")) {
+					host = optarg;
+				} else {
 					usage(EXIT_SUCCESS);
+				}
 				break;
 		}
 	}
 
 	efi_set_verbose(verbose, stderr);
 
-	if (guid_name && !outfile)
+	if (guid_name && !outfile && !(action & ACTION_PROFILE))
 		action |= ACTION_PRINT;
 
 	switch (action) {
 		case ACTION_LIST:
-			list_all_variables();
+			list_all_variables(display_type);
 			break;
 		case ACTION_PRINT:
-			show_variable(guid_name, SHOW_VERBOSE);
+			show_variable(guid_name, display_type);
 			break;
 		case ACTION_PRINT_DEC | ACTION_PRINT:
 			show_variable(guid_name, SHOW_DECIMAL);
@@ -617,9 +884,9 @@ int main(int argc, char *argv[])
 				char *name;
 				efi_guid_t *guid;
 				uint64_t attributes;
-				int display_type = (action & ACTION_PRINT_DEC)
-					? SHOW_VERBOSE|SHOW_DECIMAL
-					: SHOW_VERBOSE;
+
+				if (action & ACTION_PRINT_DEC)
+					display_type = SHOW_DECIMAL;
 
 
 				prepare_data(infile, &data, &data_size);
@@ -679,6 +946,39 @@ int main(int argc, char *argv[])
 				efi_variable_free(var, false);
 				break;
 			}
+		case ACTION_PROFILE:
+			{
+				efi_guid_t guid = efi_guid_empty;
+				char *name = NULL;
+				int rc;
+
+				if (guid_name)
+					parse_name(guid_name, &name, &guid);
+				rc = profile_variables(&guid, name, iterations,
+						       profile_writes);
+				free(name);
+				if (rc < 0)
+					exit(1);
+				break;
+			}
+		case ACTION_WRITE_STATS:
+			show_write_stats();
+			break;
+		case ACTION_BACKUP:
+		case ACTION_RESTORE:
+			if (!host) {
+				if (gethostname(hostname, sizeof(hostname)) < 0)
+					err(1, "could not get host name");
+				hostname[sizeof(hostname) - 1] = '\0';
+				host = hostname;
+			}
+			if (action == ACTION_BACKUP &&
+			    backup_variables(repo, host) < 0)
+				exit(1);
+			if (action == ACTION_RESTORE &&
+			    restore_variables(repo, host) < 0)
+				exit(1);
+			break;
 		case ACTION_USAGE:
 		default:
 			usage(EXIT_FAILURE);
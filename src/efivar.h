@@ -14,6 +14,8 @@
 #include <efivar/efivar.h>
 
 #include "compiler.h"
+#include "probes.h"
+#include "alloc.h"
 #include "diag.h"
 #include "list.h"
 #include "util.h"
@@ -21,10 +23,14 @@
 #include "efivar_endian.h"
 #include "lib.h"
 #include "guid.h"
+#include "guid-map.h"
+#include "ledger.h"
+#include "trace.h"
 #include "generics.h"
 #include "dp.h"
 #include "gpt.h"
 #include "disk.h"
+#include "dp-cache.h"
 #include "linux.h"
 #include "crc32.h"
 #include "hexdump.h"
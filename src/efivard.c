@@ -0,0 +1,653 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * efivard - serve EFI variables to unprivileged processes
+ * Copyright 2026 The efivar Authors
+ *
+ * Non-root readers of efivarfs are rate limited by the kernel, and
+ * libefivar sleeps to stay under that limit.  efivard reads the store
+ * once, with whatever privilege it was started with, and hands every
+ * client a sealed memfd snapshot of the world-readable variables.
+ * Clients use it through LIBEFIVAR_OPS=daemon; see efivard.h for the
+ * protocol.
+ */
+
+#include "fix_coverity.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char *optarg;
+extern int optind, opterr, optopt;
+
+#include "efivar.h"
+#include "efivard.h"
+
+typedef struct {
+	efi_guid_t guid;
+	char *name;
+	uint8_t *data;
+	size_t data_size;
+	uint32_t attributes;
+	uint32_t flags;
+} var_t;
+
+typedef struct {
+	efi_ctx_t *ctx;
+	uint64_t generation;
+	volatile uint64_t *generation_page;
+	int generation_fd;		/* read-only, for clients */
+	int snapshot_fd;
+	uint8_t *snapshot;		/* what snapshot_fd holds */
+	size_t snapshot_size;
+} state_t;
+
+static volatile sig_atomic_t exiting;
+static int verbose;
+
+static void
+handle_signal(int signum UNUSED)
+{
+	exiting = 1;
+}
+
+static int
+var_cmp(const void *ap, const void *bp)
+{
+	const var_t *a = ap, *b = bp;
+	int rc = strcmp(a->name, b->name);
+
+	if (rc)
+		return rc;
+	return memcmp(&a->guid, &b->guid, sizeof(a->guid));
+}
+
+static void
+free_vars(var_t *vars, size_t n_vars)
+{
+	for (size_t i = 0; i < n_vars; i++) {
+		efi_free(vars[i].name);
+		efi_free(vars[i].data);
+	}
+	efi_free(vars);
+}
+
+static int
+read_vars(efi_ctx_t *ctx, var_t **varsp, size_t *n_varsp)
+{
+	const char *path = efi_ctx_get_path(ctx);
+	efi_guid_t *guid = NULL;
+	char *name = NULL;
+	var_t *vars = NULL;
+	size_t n_vars = 0;
+	int rc;
+
+	while ((rc = efi_ctx_get_next_variable_name(ctx, &guid, &name)) > 0) {
+		var_t *new_vars, *var;
+		struct stat sb;
+		char *filename = NULL;
+
+		new_vars = efi_reallocarray(vars, n_vars + 1, sizeof(*vars));
+		if (!new_vars)
+			goto err;
+		vars = new_vars;
+		var = &vars[n_vars];
+		memset(var, 0, sizeof(*var));
+		var->guid = *guid;
+		var->name = efi_strdup(name);
+		if (!var->name)
+			goto err;
+		n_vars += 1;
+
+		if (efi_asprintf(&filename, "%s%s-" GUID_FORMAT, path, name,
+				 GUID_FORMAT_ARGS(guid)) < 0)
+			goto err;
+		rc = stat(filename, &sb);
+		efi_free(filename);
+		if (rc < 0 && errno == ENOENT) {
+			/* deleted while we were looking; inotify will tell us */
+			n_vars -= 1;
+			efi_free(var->name);
+			continue;
+		}
+		if (rc < 0 || !(sb.st_mode & S_IROTH)) {
+			var->flags |= EFIVARD_ENTRY_PRIVATE;
+			continue;
+		}
+
+		rc = efi_ctx_get_variable(ctx, *guid, name, &var->data,
+					  &var->data_size, &var->attributes);
+		if (rc < 0) {
+			if (errno == ENOENT) {
+				n_vars -= 1;
+				efi_free(var->name);
+				continue;
+			}
+			var->flags |= EFIVARD_ENTRY_PRIVATE;
+		}
+	}
+	if (rc < 0)
+		goto err;
+
+	qsort(vars, n_vars, sizeof(*vars), var_cmp);
+	*varsp = vars;
+	*n_varsp = n_vars;
+	return 0;
+err:
+	free_vars(vars, n_vars);
+	return -1;
+}
+
+/*
+ * Lay the variables out as efivard.h describes.  The generation is left
+ * as 0 so two images can be compared; the caller fills it in.
+ */
+static uint8_t *
+serialize_vars(var_t *vars, size_t n_vars, size_t *sizep)
+{
+	efivard_snapshot_header_t *hdr;
+	efivard_snapshot_entry_t *entries;
+	size_t size, offset;
+	uint8_t *buf;
+
+	size = sizeof(*hdr) + n_vars * sizeof(*entries);
+	for (size_t i = 0; i < n_vars; i++)
+		size += strlen(vars[i].name) + 1 + vars[i].data_size;
+
+	buf = efi_calloc(1, size);
+	if (!buf)
+		return NULL;
+
+	hdr = (efivard_snapshot_header_t *)buf;
+	hdr->magic = EFIVARD_MAGIC;
+	hdr->version = EFIVARD_SNAPSHOT_VERSION;
+	hdr->size = size;
+	hdr->n_entries = n_vars;
+	entries = (efivard_snapshot_entry_t *)(buf + sizeof(*hdr));
+
+	offset = sizeof(*hdr) + n_vars * sizeof(*entries);
+	for (size_t i = 0; i < n_vars; i++) {
+		size_t namesz = strlen(vars[i].name);
+
+		entries[i].guid = vars[i].guid;
+		entries[i].attributes = vars[i].attributes;
+		entries[i].flags = vars[i].flags;
+		entries[i].name_offset = offset;
+		entries[i].name_size = namesz;
+		memcpy(buf + offset, vars[i].name, namesz + 1);
+		offset += namesz + 1;
+
+		entries[i].data_offset = offset;
+		entries[i].data_size = vars[i].data_size;
+		if (vars[i].data_size)
+			memcpy(buf + offset, vars[i].data, vars[i].data_size);
+		offset += vars[i].data_size;
+	}
+
+	*sizep = size;
+	return buf;
+}
+
+static int
+seal_snapshot(const uint8_t *buf, size_t size)
+{
+	int fd;
+	size_t written = 0;
+
+	fd = memfd_create("efivard-snapshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		warn("memfd_create() failed");
+		return -1;
+	}
+	while (written < size) {
+		ssize_t rc = write(fd, buf + written, size - written);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			warn("could not write snapshot");
+			goto err;
+		}
+		written += rc;
+	}
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+				   F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+		warn("could not seal snapshot");
+		goto err;
+	}
+	return fd;
+err:
+	close(fd);
+	return -1;
+}
+
+/*
+ * Re-read the store.  If it differs from what we're serving, replace the
+ * snapshot and bump the generation so clients come back for it.
+ */
+static int
+refresh(state_t *state)
+{
+	var_t *vars = NULL;
+	size_t n_vars = 0;
+	uint8_t *buf;
+	size_t size;
+	int fd;
+
+	if (read_vars(state->ctx, &vars, &n_vars) < 0) {
+		warn("could not read variables");
+		return -1;
+	}
+	buf = serialize_vars(vars, n_vars, &size);
+	free_vars(vars, n_vars);
+	if (!buf) {
+		warn("could not build snapshot");
+		return -1;
+	}
+
+	if (state->snapshot && size == state->snapshot_size &&
+	    !memcmp(buf, state->snapshot, size)) {
+		efi_free(buf);
+		return 0;
+	}
+
+	((efivard_snapshot_header_t *)buf)->generation = state->generation + 1;
+	fd = seal_snapshot(buf, size);
+	((efivard_snapshot_header_t *)buf)->generation = 0;
+	if (fd < 0) {
+		efi_free(buf);
+		return -1;
+	}
+
+	if (state->snapshot_fd >= 0)
+		close(state->snapshot_fd);
+	efi_free(state->snapshot);
+	state->snapshot_fd = fd;
+	state->snapshot = buf;
+	state->snapshot_size = size;
+	state->generation += 1;
+	__atomic_store_n(state->generation_page, state->generation,
+			 __ATOMIC_RELEASE);
+	if (verbose)
+		warnx("serving generation %"PRIu64" (%zu variables, %zu bytes)",
+		      state->generation, n_vars, size);
+	return 0;
+}
+
+static int
+setup_generation_page(state_t *state)
+{
+	char *procpath = NULL;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	int fd;
+
+	fd = memfd_create("efivard-generation", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		err(1, "memfd_create() failed");
+	if (ftruncate(fd, pagesize) < 0)
+		err(1, "ftruncate() failed");
+	state->generation_page = mmap(NULL, pagesize, PROT_READ | PROT_WRITE,
+				      MAP_SHARED, fd, 0);
+	if (state->generation_page == MAP_FAILED)
+		err(1, "mmap() failed");
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+		err(1, "could not seal generation page");
+
+	/*
+	 * Clients get a read-only descriptor, so they can't mmap it
+	 * writable and lie to each other about the generation.
+	 */
+	if (efi_asprintf(&procpath, "/proc/self/fd/%d", fd) < 0)
+		err(1, "could not allocate memory");
+	state->generation_fd = open(procpath, O_RDONLY | O_CLOEXEC);
+	if (state->generation_fd < 0)
+		err(1, "could not open %s", procpath);
+	efi_free(procpath);
+	close(fd);
+	return 0;
+}
+
+static int
+setup_socket(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX, };
+	int sd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		errx(1, "socket path \"%s\" is too long", path);
+	strcpy(addr.sun_path, path);
+
+	if (!strcmp(path, EFIVARD_SOCKET_PATH) &&
+	    mkdir(EFIVARD_SOCKET_DIR, 0755) < 0 && errno != EEXIST)
+		err(1, "could not create %s", EFIVARD_SOCKET_DIR);
+
+	sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (sd < 0)
+		err(1, "socket() failed");
+	unlink(path);
+	if (bind(sd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		err(1, "could not bind to %s", path);
+	if (chmod(path, 0666) < 0)
+		err(1, "could not chmod %s", path);
+	if (listen(sd, 64) < 0)
+		err(1, "listen() failed");
+	return sd;
+}
+
+/*
+ * Clients are served from the poll() loop without ever blocking on one
+ * of them: each is read as its bytes arrive, and answered once the whole
+ * request is in.  The reply is small enough to fit in an empty socket
+ * buffer, so if sendmsg() can't take it, the client is broken and gets
+ * dropped.  So does one that hasn't finished its request in time.
+ */
+#define EFIVARD_MAX_CLIENTS		64
+#define EFIVARD_CLIENT_TIMEOUT		1000	/* ms */
+
+typedef struct {
+	int sd;
+	int64_t deadline;
+	size_t received;
+	efivard_request_t req;
+} client_t;
+
+static int64_t
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void
+reply_client(state_t *state, client_t *client)
+{
+	efivard_reply_t reply = {
+		.magic = EFIVARD_MAGIC,
+		.generation = state->generation,
+	};
+	char cbuf[CMSG_SPACE(sizeof(int) * 2)];
+	struct iovec iov = {
+		.iov_base = &reply,
+		.iov_len = sizeof(reply),
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+
+	if (client->req.op != EFIVARD_OP_GET_SNAPSHOT) {
+		reply.status = EOPNOTSUPP;
+	} else if (state->snapshot_fd < 0) {
+		reply.status = EAGAIN;
+	} else {
+		int fds[2] = { state->snapshot_fd, state->generation_fd };
+		struct cmsghdr *cmsg;
+
+		memset(cbuf, 0, sizeof(cbuf));
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	}
+
+	if (sendmsg(client->sd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) < 0 &&
+	    verbose)
+		warn("sendmsg() failed");
+}
+
+/*
+ * Read whatever the client has sent.  Returns true once the client is
+ * finished with, one way or another, and should be closed.
+ */
+static bool
+service_client(state_t *state, client_t *client)
+{
+	ssize_t rc;
+
+	rc = recv(client->sd, (uint8_t *)&client->req + client->received,
+		  sizeof(client->req) - client->received, MSG_DONTWAIT);
+	if (rc < 0)
+		return errno != EAGAIN && errno != EWOULDBLOCK &&
+		       errno != EINTR;
+	if (rc == 0)
+		return true;
+
+	client->received += rc;
+	if (client->received < sizeof(client->req))
+		return false;
+
+	if (client->req.magic == EFIVARD_MAGIC)
+		reply_client(state, client);
+	return true;
+}
+
+static void
+accept_clients(int listen_sd, client_t *clients, size_t *n_clients)
+{
+	while (*n_clients < EFIVARD_MAX_CLIENTS) {
+		int sd = accept4(listen_sd, NULL, NULL,
+				 SOCK_CLOEXEC | SOCK_NONBLOCK);
+		client_t *client;
+
+		if (sd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+			    errno != EINTR && verbose)
+				warn("accept() failed");
+			return;
+		}
+
+		client = &clients[(*n_clients)++];
+		memset(client, 0, sizeof(*client));
+		client->sd = sd;
+		client->deadline = now_ms() + EFIVARD_CLIENT_TIMEOUT;
+	}
+}
+
+static void
+drop_client(client_t *clients, size_t *n_clients, size_t i)
+{
+	close(clients[i].sd);
+	clients[i] = clients[--*n_clients];
+}
+
+static void __attribute__((__noreturn__))
+usage(int ret)
+{
+	FILE *out = ret == 0 ? stdout : stderr;
+	fprintf(out,
+		"Usage: %s [OPTION...]\n"
+		"  -p, --path=<dir>                  efivarfs directory to serve\n"
+		"  -s, --socket=<path>               listen on <path> instead of\n"
+		"                                    " EFIVARD_SOCKET_PATH "\n"
+		"  -t, --ttl=<seconds>               also re-read the store this often, to\n"
+		"                                    notice changes made by firmware\n"
+		"  -v, --verbose                     be more verbose\n\n"
+		"Help options:\n"
+		"  -?, --help                        Show this help message\n"
+		"      --usage                       Display brief usage message\n",
+		program_invocation_short_name);
+	exit(ret);
+}
+
+int
+main(int argc, char *argv[])
+{
+	state_t state = {
+		.generation = EFIVARD_GENERATION_GONE,
+		.snapshot_fd = -1,
+	};
+	const char *socket_path = NULL;
+	const char *store_path = NULL;
+	long ttl = 0;
+	int64_t next_refresh;
+	client_t clients[EFIVARD_MAX_CLIENTS];
+	size_t n_clients = 0;
+	int listen_sd, inotify_fd;
+	struct sigaction sa = { .sa_handler = handle_signal, };
+	int c = 0;
+	int i = 0;
+	char *sopts = "p:s:t:v?";
+	struct option lopts[] = {
+		{"help", no_argument, 0, '?'},
+		{"path", required_argument, 0, 'p'},
+		{"socket", required_argument, 0, 's'},
+		{"ttl", required_argument, 0, 't'},
+		{"usage", no_argument, 0, 0},
+		{"verbose", no_argument, 0, 'v'},
+		{0, 0, 0, 0}
+	};
+
+	while ((c = getopt_long(argc, argv, sopts, lopts, &i)) != -1) {
+		switch (c) {
+			case 'p':
+				store_path = optarg;
+				break;
+			case 's':
+				socket_path = optarg;
+				break;
+			case 't':
+				errno = 0;
+				ttl = strtol(optarg, NULL, 0);
+				if (errno || ttl < 0 || ttl > INT_MAX / 1000)
+					errx(1, "invalid argument for -t: %s",
+					     optarg);
+				break;
+			case 'v':
+				verbose += 1;
+				break;
+			case '?':
+				usage(EXIT_SUCCESS);
+				break;
+			case 0:
+				if (strcmp(lopts[i].name, "usage"))
+					usage(EXIT_SUCCESS);
+				break;
+		}
+	}
+
+	efi_set_verbose(verbose, stderr);
+
+	if (!socket_path)
+		socket_path = getenv("EFIVARD_SOCKET");
+	if (!socket_path)
+		socket_path = EFIVARD_SOCKET_PATH;
+
+	state.ctx = efi_ctx_new("efivarfs", store_path);
+	if (!state.ctx)
+		err(1, "could not open variable store");
+	/* this is the whole point */
+	efi_ctx_set_ratelimit(state.ctx, 0);
+
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0)
+		err(1, "inotify_init1() failed");
+	if (inotify_add_watch(inotify_fd, efi_ctx_get_path(state.ctx),
+			      IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB |
+			      IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO) < 0)
+		err(1, "could not watch %s", efi_ctx_get_path(state.ctx));
+
+	setup_generation_page(&state);
+	if (refresh(&state) < 0)
+		errx(1, "could not build the initial snapshot");
+
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	listen_sd = setup_socket(socket_path);
+	next_refresh = ttl ? now_ms() + ttl * 1000 : -1;
+
+	while (!exiting) {
+		struct pollfd pfds[2 + EFIVARD_MAX_CLIENTS];
+		int64_t t = now_ms(), wake = next_refresh;
+		bool rescan = false;
+		int timeout;
+		int rc;
+
+		pfds[0] = (struct pollfd){
+			.fd = n_clients < EFIVARD_MAX_CLIENTS ? listen_sd : -1,
+			.events = POLLIN,
+		};
+		pfds[1] = (struct pollfd){ .fd = inotify_fd, .events = POLLIN, };
+		for (size_t j = 0; j < n_clients; j++) {
+			pfds[2 + j] = (struct pollfd){
+				.fd = clients[j].sd,
+				.events = POLLIN,
+			};
+			if (wake < 0 || clients[j].deadline < wake)
+				wake = clients[j].deadline;
+		}
+		timeout = wake < 0 ? -1 : wake <= t ? 0 : (int)(wake - t);
+
+		rc = poll(pfds, 2 + n_clients, timeout);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			err(1, "poll() failed");
+		}
+
+		t = now_ms();
+		if (next_refresh >= 0 && t >= next_refresh) {
+			rescan = true;
+			next_refresh = t + ttl * 1000;
+		}
+		if (rescan || (pfds[1].revents & POLLIN)) {
+			char buf[4096]
+				__attribute__((__aligned__(__alignof__(struct inotify_event))));
+
+			/* a whole burst of events needs only one re-read */
+			while (read(inotify_fd, buf, sizeof(buf)) > 0)
+				;
+			refresh(&state);
+		}
+
+		/*
+		 * Walk backwards so dropping a client, which moves the last
+		 * one into its slot, doesn't skip anyone still to be seen.
+		 */
+		for (size_t j = n_clients; j > 0; j--) {
+			size_t k = j - 1;
+
+			if ((pfds[2 + k].revents &&
+			     service_client(&state, &clients[k])) ||
+			    t >= clients[k].deadline)
+				drop_client(clients, &n_clients, k);
+		}
+
+		if (pfds[0].revents & POLLIN)
+			accept_clients(listen_sd, clients, &n_clients);
+	}
+
+	while (n_clients)
+		drop_client(clients, &n_clients, n_clients - 1);
+	__atomic_store_n(state.generation_page, EFIVARD_GENERATION_GONE,
+			 __ATOMIC_RELEASE);
+	unlink(socket_path);
+	close(listen_sd);
+	close(inotify_fd);
+	efi_ctx_free(state.ctx);
+	return 0;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * efivard.h - protocol shared by efivard and the "daemon" backend
+ *
+ * A client connects to the daemon's socket and sends one
+ * efivard_request_t.  The daemon answers with one efivard_reply_t and,
+ * on success, two file descriptors passed with SCM_RIGHTS:
+ *
+ *  - a sealed memfd holding the snapshot: an efivard_snapshot_header_t,
+ *    n_entries efivard_snapshot_entry_t sorted by name and then guid,
+ *    and the names and data they point to.  Offsets are from the start
+ *    of the memfd.
+ *  - a read-only fd for the generation page, which holds a single
+ *    uint64_t the daemon bumps whenever the store changes.  A snapshot
+ *    is current as long as its header's generation matches the page.
+ *    EFIVARD_GENERATION_GONE means the daemon has shut down.
+ */
+
+#ifndef EFIVARD_H_
+#define EFIVARD_H_ 1
+
+#include <stdint.h>
+
+#include <efivar/efivar-types.h>
+
+#define EFIVARD_SOCKET_DIR		"/run/efivar"
+#define EFIVARD_SOCKET_PATH		EFIVARD_SOCKET_DIR "/efivard.sock"
+
+#define EFIVARD_MAGIC			0x64726176U	/* "vard" */
+#define EFIVARD_SNAPSHOT_VERSION	1
+
+#define EFIVARD_OP_GET_SNAPSHOT		1
+
+#define EFIVARD_GENERATION_GONE		0
+
+typedef struct {
+	uint32_t magic;
+	uint32_t op;
+} efivard_request_t;
+
+typedef struct {
+	uint32_t magic;
+	int32_t status;		/* 0 or a positive errno value */
+	uint64_t generation;
+} efivard_reply_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t generation;
+	uint64_t size;
+	uint32_t n_entries;
+	uint32_t reserved;
+} efivard_snapshot_header_t;
+
+/*
+ * The variable isn't world readable, so the daemon doesn't hand out its
+ * contents; clients have to go read it themselves.
+ */
+#define EFIVARD_ENTRY_PRIVATE		0x1
+
+typedef struct {
+	efi_guid_t guid;
+	uint32_t attributes;
+	uint32_t flags;
+	uint32_t name_offset;
+	uint32_t name_size;	/* not counting the NUL */
+	uint64_t data_offset;
+	uint64_t data_size;
+} efivard_snapshot_entry_t;
+
+#endif /* !EFIVARD_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -82,16 +82,28 @@ fini_efivarfs_path(void)
 	}
 }
 
+/*
+ * LIBEFIVAR_ESP_PATH, with a trailing slash like EFIVARFS_PATH, is
+ * searched instead of the usual ESP mount points, so VarToFile updates
+ * can be tested without one.
+ */
 static int
 get_esp_filepath(const char *filename, char *filepath, size_t sz)
 {
+	const char *esp_path = secure_getenv("LIBEFIVAR_ESP_PATH");
+	const char * const *paths = esp_paths;
 	size_t num_paths = sizeof(esp_paths) / sizeof(esp_paths[0]);
 	size_t rc;
 
+	if (esp_path) {
+		paths = &esp_path;
+		num_paths = 1;
+	}
+
 	for (size_t i = 0; i < num_paths; ++i) {
 		struct stat buffer;
 
-		rc = snprintf(filepath, sz, "%s%s", esp_paths[i], filename);
+		rc = snprintf(filepath, sz, "%s%s", paths[i], filename);
 		if (rc >= sz) {
 			fprintf(stderr, "Error: Filepath too big. Max allowed %ld\n", sz);
 			return -1;
@@ -103,15 +115,20 @@ get_esp_filepath(const char *filename, char *filepath, size_t sz)
 	return -1;
 }
 
+static int efivarfs_get_variable(struct efi_ctx *ctx, efi_guid_t guid,
+				 const char *name, uint8_t **data,
+				 size_t *data_size, uint32_t *attributes);
+
 static int
-get_esp_filename(char *filename, size_t sz)
+get_esp_filename(struct efi_ctx *ctx, char *filename, size_t sz)
 {
 	size_t size;
 	uint32_t attr;
 	uint8_t *data = NULL;
 	int rc = 0;
 
-	rc = efi_get_variable(GUID_FILE_STORE_VARS, NAME_RTSV, &data, &size, &attr);
+	rc = efivarfs_get_variable(ctx, GUID_FILE_STORE_VARS, NAME_RTSV, &data,
+				   &size, &attr);
 	if (rc < 0)
 		/*
 		 * Return an error here so we can bail out and not try to
@@ -121,102 +138,180 @@ get_esp_filename(char *filename, size_t sz)
 
 	if (size > sz) {
 		fprintf(stderr, "Error: Filename too big. Max allowed %ld\n", sz);
-		free(data);
+		efi_free(data);
 		return -1;
 	}
 
 	memcpy(filename, data, sz);
-	free(data);
+	efi_free(data);
 
 	return 0;
 }
 
-#define make_efivarfs_path(str, guid, name) ({				\
-		asprintf(str, "%s%s-" GUID_FORMAT, get_efivarfs_path(),	\
+#define make_efivarfs_path(ctx, str, guid, name) ({			\
+		efi_asprintf(str, "%s%s-" GUID_FORMAT, ctx_path(ctx),	\
 			name, GUID_FORMAT_ARGS(&(guid)));		\
 	})
 
+/*
+ * VarToFile is usually tens of KB, and a variable update changes a few
+ * hundred bytes of it, so by default we only rewrite the blocks of the
+ * ESP copy that differ, followed by one fdatasync().  Setting
+ * LIBEFIVAR_VARTOFILE_WRITE=full rewrites the whole file instead.
+ */
+#define VARTOFILE_BLOCK_SIZE	4096
+
+static bool
+var_file_full_write(void)
+{
+	const char *mode = secure_getenv("LIBEFIVAR_VARTOFILE_WRITE");
+
+	return mode && !strcmp(mode, "full");
+}
+
+static int
+pwrite_all(int fd, const uint8_t *buf, size_t size, off_t off)
+{
+	while (size) {
+		ssize_t sz = pwrite(fd, buf, size, off);
+
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += sz;
+		size -= sz;
+		off += sz;
+	}
+	return 0;
+}
+
+/*
+ * Returns true if the size bytes at off in fd aren't the same as buf,
+ * including when the file is too short to have them.
+ */
+static bool
+block_differs(int fd, const uint8_t *buf, size_t size, off_t off)
+{
+	uint8_t old[VARTOFILE_BLOCK_SIZE];
+	size_t done = 0;
+
+	while (done < size) {
+		ssize_t sz = pread(fd, old + done, size - done, off + done);
+
+		if (sz < 0 && errno == EINTR)
+			continue;
+		if (sz <= 0)
+			return true;
+		done += sz;
+	}
+	return memcmp(old, buf, size) != 0;
+}
+
 static void
-write_file(const char *filepath) {
-	size_t bytes_read;
-	unsigned char buffer[1024];
-	FILE *output_file = NULL;
-	FILE *var2file = NULL;
+write_file(struct efi_ctx *ctx, const char *filepath) {
+	uint8_t *data = NULL;
+	size_t size = 0, dirty_start = 0, written = 0;
+	uint32_t attributes;
+	bool full = var_file_full_write();
+	bool dirty = false;
 	bool fail = false;
-	char *path;
+	struct stat sb;
+	int fd = -1;
 	int rc;
 
-	rc = make_efivarfs_path(&path, GUID_FILE_STORE_VARS, "VarToFile");
+	rc = efivarfs_get_variable(ctx, GUID_FILE_STORE_VARS, "VarToFile",
+				   &data, &size, &attributes);
 	if (rc < 0) {
-		efi_error("make_efivarfs_path failed");
-		exit(1);
-	}
-
-	var2file = fopen(path, "rb");
-	if (!var2file) {
-		fprintf(stderr, "Error: Could not open file '%s'\n", path);
+		fprintf(stderr, "Error: Could not read VarToFile\n");
 		goto err;
 	}
 
-	output_file = fopen(filepath, "wb");
-	if (!output_file) {
+	fd = open(filepath, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+	if (fd < 0 || fstat(fd, &sb) < 0) {
 		fprintf(stderr, "Error: Could not open file '%s'\n", filepath);
 		goto err;
 	}
 
-	if (fread(buffer, 1, 4, var2file) < 4) {
-		fprintf(stderr, "Error: Could not skip first 4 bytes or '%s' file is too small\n", filepath);
-		fail = true;
-		goto err;
-	}
-
-	while ((bytes_read = fread(buffer, 1, sizeof(buffer), var2file)) > 0) {
-		size_t total_written = 0;
-		while (total_written < bytes_read) {
-			size_t written = fwrite(buffer + total_written, 1, bytes_read - total_written, output_file);
-			if (!written) {
-				fprintf(stderr, "Error: Could not write data to ESP '%s' file\n", filepath);
-				fail = true;
-				goto err;
-			}
-			total_written += written;
+	/*
+	 * Walk the new contents a block at a time, and write each run of
+	 * differing blocks with one pwrite().
+	 */
+	for (size_t off = 0; off <= size; off += VARTOFILE_BLOCK_SIZE) {
+		size_t len = size - off < VARTOFILE_BLOCK_SIZE ?
+			     size - off : VARTOFILE_BLOCK_SIZE;
+		bool differs = len && (full ||
+			block_differs(fd, data + off, len, off));
+
+		if (differs && !dirty) {
+			dirty = true;
+			dirty_start = off;
+		} else if (!differs && dirty) {
+			dirty = false;
+			if (pwrite_all(fd, data + dirty_start, off - dirty_start,
+				       dirty_start) < 0)
+				goto write_err;
+			written += off - dirty_start;
 		}
 	}
+	if (dirty) {
+		if (pwrite_all(fd, data + dirty_start, size - dirty_start,
+			       dirty_start) < 0)
+			goto write_err;
+		written += size - dirty_start;
+	}
 
+	if ((size_t)sb.st_size > size && ftruncate(fd, size) < 0)
+		goto write_err;
+	if ((written || (size_t)sb.st_size != size) && fdatasync(fd) < 0)
+		goto write_err;
+
+	debug("wrote %zu of %zu bytes to '%s'", written, size, filepath);
+	EFIVAR_PROBE3(var_file_write, filepath, size, written);
+	goto err;
+
+write_err:
+	fprintf(stderr, "Error: Could not write data to ESP '%s' file\n",
+		filepath);
+	fail = true;
 err:
-	if (path)
-		free(path);
-	if (var2file)
-		fclose(var2file);
-	if (output_file)
-		fclose(output_file);
+	if (data)
+		efi_free(data);
+	if (fd >= 0)
+		close(fd);
 
 	if (fail)
 		exit(1);
 }
 
 static void
-efi_update_var_file(void)
+efi_update_var_file(struct efi_ctx *ctx)
 {
 	int rc = 0;
 	char filename[PATH_MAX / 4] = { 0 };
 	char filepath[PATH_MAX] = { 0 };
+	efi_trace_scope("efi_update_var_file", NULL);
 
-	rc = get_esp_filename(filename, sizeof(filename));
+	rc = get_esp_filename(ctx, filename, sizeof(filename));
 	if (rc < 0)
 		return;
 
 	rc = get_esp_filepath(filename, filepath, sizeof(filepath));
-	if (!rc)
-		write_file(filepath);
-	else
+	if (!rc) {
+		EFIVAR_PROBE1(var_file_update_start, filepath);
+		efi_trace_begin("write_file", "%s", filepath);
+		write_file(ctx, filepath);
+		efi_trace_end();
+		EFIVAR_PROBE1(var_file_update_done, filepath);
+	} else
 		fprintf(stderr, "Error: '%s' file not found in ESP partition. EFI variable changes won't persist reboots\n", filename);
 }
 
 static int
-efivarfs_probe(void)
+efivarfs_probe(struct efi_ctx *ctx)
 {
-	const char *path = get_efivarfs_path();
+	const char *path = ctx_path(ctx);
 
 	int rc = 0;
 	struct statfs buf;
@@ -320,14 +415,15 @@ efivarfs_set_immutable(char *path, int immutable)
 }
 
 static int
-efivarfs_get_variable_size(efi_guid_t guid, const char *name, size_t *size)
+efivarfs_get_variable_size(struct efi_ctx *ctx, efi_guid_t guid,
+			   const char *name, size_t *size)
 {
 	char *path = NULL;
 	int rc = 0;
 	int ret = -1;
 	__typeof__(errno) errno_value;
 
-	rc = make_efivarfs_path(&path, guid, name);
+	rc = make_efivarfs_path(ctx, &path, guid, name);
 	if (rc < 0) {
 		efi_error("make_efivarfs_path failed");
 		goto err;
@@ -347,15 +443,15 @@ err:
 	errno_value = errno;
 
 	if (path)
-		free(path);
+		efi_free(path);
 
 	errno = errno_value;
 	return ret;
 }
 
 static int
-efivarfs_get_variable_attributes(efi_guid_t guid, const char *name,
-			    uint32_t *attributes)
+efivarfs_get_variable_attributes(struct efi_ctx *ctx, efi_guid_t guid,
+				 const char *name, uint32_t *attributes)
 {
 	int ret = -1;
 
@@ -363,21 +459,22 @@ efivarfs_get_variable_attributes(efi_guid_t guid, const char *name,
 	size_t data_size;
 	uint32_t attribs;
 
-	ret = efi_get_variable(guid, name, &data, &data_size, &attribs);
+	ret = efivarfs_get_variable(ctx, guid, name, &data, &data_size,
+				    &attribs);
 	if (ret < 0) {
-		efi_error("efi_get_variable failed");
+		efi_error("efivarfs_get_variable failed");
 		return ret;
 	}
 
 	*attributes = attribs;
 	if (data)
-		free(data);
+		efi_free(data);
 	return ret;
 }
 
 static int
-efivarfs_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
-		  size_t *data_size, uint32_t *attributes)
+efivarfs_get_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		      uint8_t **data, size_t *data_size, uint32_t *attributes)
 {
 	__typeof__(errno) errno_value;
 	int ret = -1;
@@ -387,18 +484,9 @@ efivarfs_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 	int fd = -1;
 	char *path = NULL;
 	int rc;
-	int ratelimit;
-
-	/*
-	 * The kernel rate limiter hits us if we go faster than 100 efi
-	 * variable reads per second as non-root.  So if we're not root, just
-	 * delay this long after each read.  The user is not going to notice.
-	 *
-	 * 1s / 100 = 10000us.
-	 */
-	ratelimit = geteuid() == 0 ? 0 : 10000;
+	useconds_t ratelimit = ctx_ratelimit(ctx);
 
-	rc = make_efivarfs_path(&path, guid, name);
+	rc = make_efivarfs_path(ctx, &path, guid, name);
 	if (rc < 0) {
 		efi_error("make_efivarfs_path failed");
 		goto err;
@@ -410,14 +498,14 @@ efivarfs_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 		goto err;
 	}
 
-	usleep(ratelimit);
+	ratelimit_sleep(ratelimit);
 	rc = read(fd, &ret_attributes, sizeof (ret_attributes));
 	if (rc < 0) {
 		efi_error("read failed");
 		goto err;
 	}
 
-	usleep(ratelimit);
+	ratelimit_sleep(ratelimit);
 	rc = read_file(fd, &ret_data, &size);
 	if (rc < 0) {
 		efi_error("read_file failed");
@@ -436,17 +524,17 @@ err:
 		close(fd);
 
 	if (path)
-		free(path);
+		efi_free(path);
 
 	errno = errno_value;
 	return ret;
 }
 
 static int
-efivarfs_del_variable(efi_guid_t guid, const char *name)
+efivarfs_del_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name)
 {
 	char *path;
-	int rc = make_efivarfs_path(&path, guid, name);
+	int rc = make_efivarfs_path(ctx, &path, guid, name);
 	if (rc < 0) {
 		efi_error("make_efivarfs_path failed");
 		return -1;
@@ -456,31 +544,84 @@ efivarfs_del_variable(efi_guid_t guid, const char *name)
 	rc = unlink(path);
 	if (rc < 0)
 		efi_error("unlink failed");
+	else
+		write_ledger_record(WRITE_LEDGER_DEL, &guid, name, 0);
 
-	efi_update_var_file();
+	efi_update_var_file(ctx);
 
 	__typeof__(errno) errno_value = errno;
-	free(path);
+	efi_free(path);
 	errno = errno_value;
 
 	return rc;
 }
 
+/*
+ * Whether a variable's file is immutable doesn't change behind our back
+ * very often, so remember what we found the last time we wrote it.  This
+ * is only a hint for which path to try first; both paths cope with it
+ * being wrong.  Each slot holds (crc32 of guid and name) << 8 | state,
+ * and is read and written whole so threads sharing a context can't see
+ * a torn entry.
+ */
+#define IMMUTABLE_UNKNOWN	0
+#define IMMUTABLE_NO		1
+#define IMMUTABLE_YES		2
+
+static uint32_t
+immutable_cache_key(efi_guid_t *guid, const char *name)
+{
+	return crc32(name, strlen(name), efi_crc32(guid, sizeof(*guid)));
+}
+
 static int
-efivarfs_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
-		      size_t data_size, uint32_t attributes, mode_t mode)
+immutable_cache_get(struct efi_ctx *ctx, uint32_t key)
 {
-	char *path;
+	uint64_t *slot = &ctx->efivarfs_immutable[key % EFIVARFS_IMMUTABLE_SLOTS];
+	uint64_t entry = __atomic_load_n(slot, __ATOMIC_RELAXED);
+
+	if ((entry >> 8) != key)
+		return IMMUTABLE_UNKNOWN;
+	return entry & 0xff;
+}
+
+static void
+immutable_cache_set(struct efi_ctx *ctx, uint32_t key, int state)
+{
+	uint64_t *slot = &ctx->efivarfs_immutable[key % EFIVARFS_IMMUTABLE_SLOTS];
+
+	__atomic_store_n(slot, ((uint64_t)key << 8) | state, __ATOMIC_RELAXED);
+}
+
+/*
+ * efivarfs takes the attributes and the data as one write() -- it only
+ * implements ->write, so a writev() would reach it as one write per
+ * iovec and the first one would set a variable with no data.  Build the
+ * image on the stack when it's small, which most variables are.
+ */
+#define SET_VARIABLE_STACK_SIZE	4096
+
+static int
+efivarfs_set_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		      const uint8_t *data, size_t data_size, uint32_t attributes,
+		      mode_t mode)
+{
+	char path[PATH_MAX];
+	uint8_t stack_buf[SET_VARIABLE_STACK_SIZE];
+	uint8_t *buf = stack_buf;
 	size_t alloc_size;
-	uint8_t *buf;
+	uint32_t cache_key;
+	int cache_state;
 	int rfd = -1;
 	struct stat rfd_stat;
 	unsigned long orig_attrs = 0;
 	int restore_immutable_fd = -1;
 	int wfd = -1;
+	bool created = false;
 	int open_wflags;
 	int ret = -1;
 	int save_errno;
+	int rc;
 
 	if (strlen(name) > 1024) {
 		errno = EINVAL;
@@ -494,102 +635,146 @@ efivarfs_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
 		return -1;
 	}
 
-	if (make_efivarfs_path(&path, guid, name) < 0) {
-		efi_error("make_efivarfs_path failed");
+	rc = snprintf(path, sizeof(path), "%s%s-" GUID_FORMAT, ctx_path(ctx),
+		      name, GUID_FORMAT_ARGS(&guid));
+	if (rc < 0 || (size_t)rc >= sizeof(path)) {
+		errno = ENAMETOOLONG;
+		efi_error("variable path is too long");
 		return -1;
 	}
 
 	alloc_size = sizeof (attributes) + data_size;
-	buf = malloc(alloc_size);
-	if (buf == NULL) {
-		efi_error("malloc(%zu) failed", alloc_size);
-		goto err;
-	}
-
-	/*
-	 * Open the file first in read-only mode. This is necessary when the
-	 * variable exists and it is also protected -- then we first have to
-	 * *attempt* to clear the immutable flag from the file. For clearing
-	 * the flag, we can only open the file read-only. In other cases,
-	 * opening the file for reading is not necessary, but it doesn't hurt
-	 * either.
-	 */
-	rfd = open(path, O_RDONLY);
-	if (rfd != -1) {
-		/* save the containing device and the inode number for later */
-		if (fstat(rfd, &rfd_stat) == -1) {
-			efi_error("fstat() failed on r/o fd %d", rfd);
-			goto err;
+	if (alloc_size > sizeof(stack_buf)) {
+		buf = efi_malloc(alloc_size);
+		if (buf == NULL) {
+			efi_error("efi_malloc(%zu) failed", alloc_size);
+			return -1;
 		}
-
-		/* if the file is indeed immutable, clear and remember it */
-		if (efivarfs_make_fd_mutable(rfd, &orig_attrs) == 0 &&
-		    (orig_attrs & FS_IMMUTABLE_FL))
-			restore_immutable_fd = rfd;
 	}
+	memcpy(buf, &attributes, sizeof (attributes));
+	memcpy(buf + sizeof (attributes), data, data_size);
 
-	/*
-	 * Open the variable file for writing now. First, use O_APPEND
-	 * dependent on the input attributes. Second, the file either doesn't
-	 * exist here, or it does and we made an attempt to make it mutable
-	 * above. If the file was created afresh between the two open()s, then
-	 * we catch that with O_EXCL. If the file was removed between the two
-	 * open()s, we catch that with lack of O_CREAT. If the file was
-	 * *replaced* between the two open()s, we'll catch that later with
-	 * fstat() comparison.
-	 */
 	open_wflags = O_WRONLY;
 	if (attributes & EFI_VARIABLE_APPEND_WRITE)
 		open_wflags |= O_APPEND;
-	if (rfd == -1)
-		open_wflags |= O_CREAT | O_EXCL;
-
-	wfd = open(path, open_wflags, mode);
-	if (wfd == -1) {
-		efi_error("failed to %s %s for %s",
-			  rfd == -1 ? "create" : "open",
-			  path,
-			  ((attributes & EFI_VARIABLE_APPEND_WRITE) ?
-			   "appending" : "writing"));
-		goto err;
-	}
 
 	/*
-	 * If we couldn't open the file for reading, then we have to attempt
-	 * making it mutable now -- in case we created a protected file (for
-	 * writing or appending), then the kernel made it immutable
-	 * immediately, and the write() below would fail otherwise.
+	 * Most writes either create a new variable or rewrite one that isn't
+	 * protected.  A variable this context has written before most likely
+	 * still exists, so that takes a single O_WRONLY open(), falling back
+	 * to creating it if it's gone.  Anything else is tried as a create
+	 * first, which costs a second open() if it turns out to exist.  If
+	 * the variable exists and is immutable, opening it for writing fails
+	 * with EPERM and we take the long way round below.
 	 */
-	if (rfd == -1) {
-		if (efivarfs_make_fd_mutable(wfd, &orig_attrs) == 0 &&
-		    (orig_attrs & FS_IMMUTABLE_FL))
-			restore_immutable_fd = wfd;
-	} else {
-		/* make sure rfd and wfd refer to the same file */
-		struct stat wfd_stat;
+	cache_key = immutable_cache_key(&guid, name);
+	cache_state = immutable_cache_get(ctx, cache_key);
+	if (cache_state != IMMUTABLE_YES) {
+		if (cache_state == IMMUTABLE_NO)
+			wfd = open(path, open_wflags);
+		if (wfd < 0 &&
+		    (cache_state != IMMUTABLE_NO || errno == ENOENT)) {
+			wfd = open(path, open_wflags | O_CREAT | O_EXCL, mode);
+			if (wfd >= 0)
+				created = true;
+			else if (errno == EEXIST)
+				wfd = open(path, open_wflags);
+		}
 
-		if (fstat(wfd, &wfd_stat) == -1) {
-			efi_error("fstat() failed on w/o fd %d", wfd);
+		if (wfd < 0 && errno != EPERM) {
+			efi_error("failed to open %s for %s", path,
+				  ((attributes & EFI_VARIABLE_APPEND_WRITE) ?
+				   "appending" : "writing"));
 			goto err;
 		}
-		if (rfd_stat.st_dev != wfd_stat.st_dev ||
-		    rfd_stat.st_ino != wfd_stat.st_ino) {
-			errno = EINVAL;
-			efi_error("r/o fd %d and w/o fd %d refer to different "
-				  "files", rfd, wfd);
+	}
+
+	if (wfd < 0) {
+		/*
+		 * The variable exists and is protected, so we have to
+		 * *attempt* to clear the immutable flag from the file first,
+		 * and for that we can only open the file read-only.
+		 */
+		rfd = open(path, O_RDONLY);
+		if (rfd != -1) {
+			/* save the containing device and the inode number */
+			if (fstat(rfd, &rfd_stat) == -1) {
+				efi_error("fstat() failed on r/o fd %d", rfd);
+				goto err;
+			}
+
+			/* if the file is indeed immutable, clear and remember it */
+			if (efivarfs_make_fd_mutable(rfd, &orig_attrs) == 0 &&
+			    (orig_attrs & FS_IMMUTABLE_FL))
+				restore_immutable_fd = rfd;
+		}
+
+		/*
+		 * If the file was created afresh between the two open()s,
+		 * then we catch that with O_EXCL.  If the file was removed
+		 * between the two open()s, we catch that with lack of
+		 * O_CREAT.  If the file was *replaced* between the two
+		 * open()s, we catch that with fstat() comparison.
+		 */
+		if (rfd == -1)
+			open_wflags |= O_CREAT | O_EXCL;
+
+		wfd = open(path, open_wflags, mode);
+		if (wfd == -1) {
+			efi_error("failed to %s %s for %s",
+				  rfd == -1 ? "create" : "open",
+				  path,
+				  ((attributes & EFI_VARIABLE_APPEND_WRITE) ?
+				   "appending" : "writing"));
 			goto err;
 		}
-	}
 
-	memcpy(buf, &attributes, sizeof (attributes));
-	memcpy(buf + sizeof (attributes), data, data_size);
+		if (rfd == -1) {
+			created = true;
+		} else {
+			/* make sure rfd and wfd refer to the same file */
+			struct stat wfd_stat;
 
-	if (write(wfd, buf, alloc_size) == -1) {
+			if (fstat(wfd, &wfd_stat) == -1) {
+				efi_error("fstat() failed on w/o fd %d", wfd);
+				goto err;
+			}
+			if (rfd_stat.st_dev != wfd_stat.st_dev ||
+			    rfd_stat.st_ino != wfd_stat.st_ino) {
+				errno = EINVAL;
+				efi_error("r/o fd %d and w/o fd %d refer to different "
+					  "files", rfd, wfd);
+				goto err;
+			}
+		}
+	}
+
+	rc = write(wfd, buf, alloc_size);
+	if (rc == -1 && (errno == EPERM || errno == EACCES) &&
+	    restore_immutable_fd == -1) {
+		/*
+		 * If we created a protected variable, the kernel made it
+		 * immutable immediately; clear that and try again.
+		 */
+		if (efivarfs_make_fd_mutable(wfd, &orig_attrs) == 0 &&
+		    (orig_attrs & FS_IMMUTABLE_FL)) {
+			restore_immutable_fd = wfd;
+			rc = write(wfd, buf, alloc_size);
+		}
+	}
+	if (rc == -1) {
 		efi_error("writing to fd %d failed", wfd);
 		goto err;
 	}
 
-	efi_update_var_file();
+	immutable_cache_set(ctx, cache_key, restore_immutable_fd == -1 ?
+					    IMMUTABLE_NO : IMMUTABLE_YES);
+
+	write_ledger_record((attributes & EFI_VARIABLE_APPEND_WRITE) ?
+			    WRITE_LEDGER_APPEND : WRITE_LEDGER_SET,
+			    &guid, name, data_size);
+
+	efi_update_var_file(ctx);
 
 	/* we're done */
 	ret = 0;
@@ -598,50 +783,55 @@ err:
 	save_errno = errno;
 
 	/* if we're exiting with error and created the file, remove it */
-	if (ret == -1 && rfd == -1 && wfd != -1 && unlink(path) == -1)
+	if (ret == -1 && created && unlink(path) == -1)
 		efi_error("failed to unlink %s", path);
 
-	ioctl(restore_immutable_fd, FS_IOC_SETFLAGS, &orig_attrs);
+	if (restore_immutable_fd != -1)
+		ioctl(restore_immutable_fd, FS_IOC_SETFLAGS, &orig_attrs);
 
 	if (wfd >= 0)
 		close(wfd);
 	if (rfd >= 0)
 		close(rfd);
 
-	free(buf);
-	free(path);
+	if (buf != stack_buf)
+		efi_free(buf);
 
 	errno = save_errno;
 	return ret;
 }
 
 static int
-efivarfs_append_variable(efi_guid_t guid, const char *name, const uint8_t *data,
-	size_t data_size, uint32_t attributes)
+efivarfs_append_variable(struct efi_ctx *ctx, efi_guid_t guid,
+			 const char *name, const uint8_t *data,
+			 size_t data_size, uint32_t attributes)
 {
 	int rc;
 	attributes |= EFI_VARIABLE_APPEND_WRITE;
-	rc = efivarfs_set_variable(guid, name, data, data_size, attributes, 0);
+	rc = efivarfs_set_variable(ctx, guid, name, data, data_size,
+				   attributes, 0);
 	if (rc < 0)
 		efi_error("efivarfs_set_variable failed");
 	return rc;
 }
 
 static int
-efivarfs_get_next_variable_name(efi_guid_t **guid, char **name)
+efivarfs_get_next_variable_name(struct efi_ctx *ctx, efi_guid_t **guid,
+				char **name)
 {
 	int rc;
-	rc = generic_get_next_variable_name(get_efivarfs_path(), guid, name);
+	rc = generic_get_next_variable_name(ctx, ctx_path(ctx), guid, name);
 	if (rc < 0)
 		efi_error("generic_get_next_variable_name failed");
 	return rc;
 }
 
 static int
-efivarfs_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
+efivarfs_chmod_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+			mode_t mode)
 {
 	char *path;
-	int rc = make_efivarfs_path(&path, guid, name);
+	int rc = make_efivarfs_path(ctx, &path, guid, name);
 	if (rc < 0) {
 		efi_error("make_efivarfs_path failed");
 		return -1;
@@ -651,7 +841,7 @@ efivarfs_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
 	int saved_errno = errno;
 	if (rc < 0)
 		efi_error("chmod(%s,0%o) failed", path, mode);
-	free(path);
+	efi_free(path);
 	errno = saved_errno;
 	return -1;
 }
@@ -659,6 +849,7 @@ efivarfs_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
 struct efi_var_operations efivarfs_ops = {
 	.name = "efivarfs",
 	.probe = efivarfs_probe,
+	.get_default_path = get_efivarfs_path,
 	.set_variable = efivarfs_set_variable,
 	.append_variable = efivarfs_append_variable,
 	.del_variable = efivarfs_del_variable,
@@ -6,24 +6,6 @@
 
 #include "efisec.h"
 
-typedef struct esl_list_iter esl_list_iter;
-extern int esl_list_iter_new(esl_list_iter **iter, uint8_t *buf, size_t len);
-extern int esl_list_iter_end(esl_list_iter *iter);
-extern int esl_list_iter_next(esl_list_iter *iter,
-					    efi_guid_t *type,
-					    efi_signature_data_t **data,
-					    size_t *len);
-extern int esl_list_iter_next_with_size_correction(
-					esl_list_iter *iter, efi_guid_t *type,
-					efi_signature_data_t **data,
-					size_t *len, bool correct_size);
-extern int esl_list_list_start(esl_list_iter *iter, void **buf);
-extern int esl_list_list_size(esl_list_iter *iter, size_t *bufsz);
-extern int esl_list_signature_list_size(esl_list_iter *iter, size_t *sls);
-extern int esl_list_header_size(esl_list_iter *iter, size_t *slh);
-extern int esl_list_sig_size(esl_list_iter *iter, size_t *ss);
-extern int esl_list_get_type(esl_list_iter *iter, efi_guid_t *type);
-
 struct esl_iter {
 	esl_list_iter *iter;
 	int line;
@@ -47,7 +29,7 @@ esl_iter_new(esl_iter **iter, uint8_t *buf, size_t len)
 		return -1;
 	}
 
-	*iter = calloc(1, sizeof(esl_iter));
+	*iter = efi_calloc(1, sizeof(esl_iter));
 	if (!*iter) {
 		efi_error("memory allocation failed for %zd bytes", sizeof(esl_iter));
 		return -1;
@@ -56,7 +38,7 @@ esl_iter_new(esl_iter **iter, uint8_t *buf, size_t len)
 	rc = esl_list_iter_new(&(*iter)->iter, buf, len);
 	if (rc < 0) {
 		int error = errno;
-		free(*iter);
+		efi_free(*iter);
 		errno = error;
 		efi_error("esl_list_iter_new() failed");
 		return -1;
@@ -76,7 +58,7 @@ esl_iter_end(esl_iter *iter)
 	}
 	if (iter->iter)
 		esl_list_iter_end(iter->iter);
-	free(iter);
+	efi_free(iter);
 	return 0;
 }
 
@@ -276,7 +258,7 @@ esl_list_iter_new(esl_list_iter **iter, uint8_t *buf, size_t len)
 		return -1;
 	}
 
-	*iter = calloc(1, sizeof(esl_list_iter));
+	*iter = efi_calloc(1, sizeof(esl_list_iter));
 	if (!*iter)
 		return -1;
 
@@ -293,7 +275,7 @@ esl_list_iter_end(esl_list_iter *iter)
 		errno = EINVAL;
 		return -1;
 	}
-	free(iter);
+	efi_free(iter);
 	return 0;
 }
 
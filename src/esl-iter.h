@@ -79,4 +79,29 @@ intptr_t
 esd_get_esl_offset(esl_iter *iter)
 	__attribute__((__nonnull__(1)));
 
+/*
+ * esl_list_iter - iterate over whole efi_signature_lists rather than
+ * their entries.  esl_list_iter_next() returns 1 and sets type, data
+ * (the first signature), and len (the signature size) for each list, or
+ * 0 when there are no more; the esl_list_*() accessors describe the list
+ * it last returned.
+ */
+typedef struct esl_list_iter esl_list_iter;
+extern int esl_list_iter_new(esl_list_iter **iter, uint8_t *buf, size_t len);
+extern int esl_list_iter_end(esl_list_iter *iter);
+extern int esl_list_iter_next(esl_list_iter *iter,
+					    efi_guid_t *type,
+					    efi_signature_data_t **data,
+					    size_t *len);
+extern int esl_list_iter_next_with_size_correction(
+					esl_list_iter *iter, efi_guid_t *type,
+					efi_signature_data_t **data,
+					size_t *len, bool correct_size);
+extern int esl_list_list_start(esl_list_iter *iter, void **buf);
+extern int esl_list_list_size(esl_list_iter *iter, size_t *bufsz);
+extern int esl_list_signature_list_size(esl_list_iter *iter, size_t *sls);
+extern int esl_list_header_size(esl_list_iter *iter, size_t *slh);
+extern int esl_list_sig_size(esl_list_iter *iter, size_t *ss);
+extern int esl_list_get_type(esl_list_iter *iter, efi_guid_t *type);
+
 #endif /* PRIVATE_ESL_ITER_H_ */
@@ -142,7 +142,7 @@ overflow:
 		goto oom;
 	ptr += namesz;
 
-	var.guid = malloc(sizeof (efi_guid_t));
+	var.guid =efi_malloc(sizeof (efi_guid_t));
 	if (!var.guid)
 		goto oom;
 	memcpy(var.guid, ptr, sizeof (efi_guid_t));
@@ -152,7 +152,7 @@ overflow:
 	ptr += sizeof(uint32_t);
 
 	var.data_size = datasz;
-	var.data = malloc(datasz);
+	var.data =efi_malloc(datasz);
 	if (!var.data) {
 		efi_error("Could not allocate %"PRIu32" bytes", datasz);
 		goto oom;
@@ -160,7 +160,7 @@ overflow:
 	memcpy(var.data, ptr, datasz);
 
 	if (!*var_out) {
-		*var_out =malloc(sizeof (var));
+		*var_out =efi_malloc(sizeof (var));
 		if (!*var_out)
 			goto oom;
 		memcpy(*var_out, &var, sizeof (var));
@@ -172,13 +172,13 @@ oom:
 	saved_errno = errno;
 
 	if (var.guid)
-		free(var.guid);
+		efi_free(var.guid);
 
 	if (var.name)
-		free(var.name);
+		efi_free(var.name);
 
 	if (var.data)
-		free(var.data);
+		efi_free(var.data);
 
 	errno = saved_errno;
 	efi_error("Could not allocate memory");
@@ -225,7 +225,7 @@ efi_variable_import_efivar(uint8_t *data, size_t datasz, efi_variable_t **var_ou
 		ptr += sizeof (uint64_t);
 		debug("var.attrs:0x%08"PRIx64, var.attrs);
 
-		var.guid = malloc(sizeof (efi_guid_t));
+		var.guid =efi_malloc(sizeof (efi_guid_t));
 		if (!var.guid)
 			return -1;
 		*var.guid = *(efi_guid_t *)ptr;
@@ -249,7 +249,7 @@ efi_variable_import_efivar(uint8_t *data, size_t datasz, efi_variable_t **var_ou
 		    data_len < 1 ||
 		    data_len > (datasz - name_len)) {
 			int saved_errno = errno;
-			free(var.guid);
+			efi_free(var.guid);
 			errno = saved_errno;
 			return -1;
 		}
@@ -261,16 +261,16 @@ efi_variable_import_efivar(uint8_t *data, size_t datasz, efi_variable_t **var_ou
 
 		if (memcmp(data + datasz - sizeof (uint32_t), &crc,
 			   sizeof (uint32_t))) {
-			free(var.guid);
+			efi_free(var.guid);
 			errno = EINVAL;
 			efi_error("crc32 did not match");
 			return -1;
 		}
 
-		var.name = calloc(1, name_len + 1);
+		var.name = efi_calloc(1, name_len + 1);
 		if (!var.name) {
 			int saved_errno = errno;
-			free(var.guid);
+			efi_free(var.guid);
 			errno = saved_errno;
 			return -1;
 		}
@@ -282,23 +282,23 @@ efi_variable_import_efivar(uint8_t *data, size_t datasz, efi_variable_t **var_ou
 		debug("name:%s", var.name);
 
 		var.data_size = data_len;
-		var.data = malloc(data_len);
+		var.data =efi_malloc(data_len);
 		if (!var.data) {
 			int saved_errno = errno;
-			free(var.guid);
-			free(var.name);
+			efi_free(var.guid);
+			efi_free(var.name);
 			errno = saved_errno;
 			return -1;
 		}
 		memcpy(var.data, ptr, data_len);
 
 		if (!*var_out) {
-			*var_out =malloc(sizeof (var));
+			*var_out =efi_malloc(sizeof (var));
 			if (!*var_out) {
 				int saved_errno = errno;
-				free(var.guid);
-				free(var.name);
-				free(var.data);
+				efi_free(var.guid);
+				efi_free(var.name);
+				efi_free(var.data);
 				errno = saved_errno;
 				return -1;
 			}
@@ -594,7 +594,7 @@ overflow:
 efi_variable_t PUBLIC *
 efi_variable_alloc(void)
 {
-	efi_variable_t *var = calloc(1, sizeof (efi_variable_t));
+	efi_variable_t *var = efi_calloc(1, sizeof (efi_variable_t));
 	if (!var)
 		return NULL;
 
@@ -610,17 +610,17 @@ efi_variable_free(efi_variable_t *var, int free_data)
 
 	if (free_data) {
 		if (var->guid)
-			free(var->guid);
+			efi_free(var->guid);
 
 		if (var->name)
-			free(var->name);
+			efi_free(var->name);
 
 		if (var->data && var->data_size)
-			free(var->data);
+			efi_free(var->data);
 	}
 
 	memset(var, '\0', sizeof (*var));
-	free(var);
+	efi_free(var);
 }
 
 int NONNULL(1, 2) PUBLIC
@@ -16,14 +16,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-static DIR *dir;
-
 static inline int UNUSED
-generic_get_next_variable_name(const char *path, efi_guid_t **guid, char **name)
+generic_get_next_variable_name(struct efi_ctx *ctx, const char *path,
+			       efi_guid_t **guid, char **name)
 {
-	static char ret_name[NAME_MAX+1];
-	static efi_guid_t ret_guid;
-
 	if (!guid || !name) {
 		errno = EINVAL;
 		efi_error("invalid arguments");
@@ -40,18 +36,19 @@ generic_get_next_variable_name(const char *path, efi_guid_t **guid, char **name)
 	}
 
 	/* if dir is NULL, we're also starting over */
-	if (!dir) {
-		dir = opendir(path);
-		if (!dir) {
+	if (!ctx->dir) {
+		ctx->dir = opendir(path);
+		if (!ctx->dir) {
 			efi_error("opendir(%s) failed", path);
 			return -1;
 		}
 
-		int fd = dirfd(dir);
+		int fd = dirfd(ctx->dir);
 		if (fd < 0) {
 			__typeof__(errno) errno_value = errno;
 			efi_error("dirfd failed");
-			closedir(dir);
+			closedir(ctx->dir);
+			ctx->dir = NULL;
 			errno = errno_value;
 			return -1;
 		}
@@ -73,10 +70,10 @@ generic_get_next_variable_name(const char *path, efi_guid_t **guid, char **name)
 	size_t guidlen = strlen(guidtext);
 
 	while (1) {
-		de = readdir(dir);
+		de = readdir(ctx->dir);
 		if (de == NULL) {
-			closedir(dir);
-			dir = NULL;
+			closedir(ctx->dir);
+			ctx->dir = NULL;
 			return 0;
 		}
 		/* a proper entry must have space for a guid, a dash, and
@@ -85,40 +82,31 @@ generic_get_next_variable_name(const char *path, efi_guid_t **guid, char **name)
 		if (namelen < guidlen + 2)
 			continue;
 
-		int rc = text_to_guid(de->d_name +namelen -guidlen, &ret_guid);
+		int rc = text_to_guid(de->d_name +namelen -guidlen,
+				      &ctx->next_guid);
 		if (rc < 0) {
-			closedir(dir);
-			dir = NULL;
+			closedir(ctx->dir);
+			ctx->dir = NULL;
 			errno = EINVAL;
 			efi_error("text_to_guid failed");
 			return -1;
 		}
 
-		strncpy(ret_name, de->d_name, sizeof(ret_name));
-		ret_name[namelen - guidlen - 1] = '\0';
+		strncpy(ctx->next_name, de->d_name, sizeof(ctx->next_name));
+		ctx->next_name[namelen - guidlen - 1] = '\0';
 
-		*guid = &ret_guid;
-		*name = ret_name;
+		*guid = &ctx->next_guid;
+		*name = ctx->next_name;
 		break;
 	}
 
 	return 1;
 }
 
-static void DESTRUCTOR close_dir(void);
-static void DESTRUCTOR
-close_dir(void)
-{
-	if (dir != NULL) {
-		closedir(dir);
-		dir = NULL;
-	}
-}
-
 /* this is a simple read/delete/write implementation of "update".  Good luck.
  * -- pjones */
 static int UNUSED FLATTEN
-generic_append_variable(efi_guid_t guid, const char *name,
+generic_append_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
 		       const uint8_t *new_data, size_t new_data_size,
 		       uint32_t new_attributes)
 {
@@ -127,42 +115,44 @@ generic_append_variable(efi_guid_t guid, const char *name,
 	size_t data_size = 0;
 	uint32_t attributes = 0;
 
-	rc = efi_get_variable(guid, name, &data, &data_size, &attributes);
+	rc = efi_ctx_get_variable(ctx, guid, name, &data, &data_size,
+				  &attributes);
 	if (rc >= 0) {
 		if ((attributes | EFI_VARIABLE_APPEND_WRITE) !=
 				(new_attributes | EFI_VARIABLE_APPEND_WRITE)) {
-			free(data);
+			efi_free(data);
 			errno = EINVAL;
 			return -1;
 		}
-		uint8_t *d = malloc(data_size + new_data_size);
+		uint8_t *d = efi_malloc(data_size + new_data_size);
 		size_t ds = data_size + new_data_size;
 		memcpy(d, data, data_size);
 		memcpy(d + data_size, new_data, new_data_size);
 		attributes &= ~EFI_VARIABLE_APPEND_WRITE;
-		rc = efi_del_variable(guid, name);
+		rc = efi_ctx_del_variable(ctx, guid, name);
 		if (rc < 0) {
-			efi_error("efi_del_variable failed");
-			free(data);
-			free(d);
+			efi_error("efi_ctx_del_variable failed");
+			efi_free(data);
+			efi_free(d);
 			return rc;
 		}
 		/* if this doesn't work, we accidentally deleted.  There's
 		 * really not much to do about it, so return the error and
 		 * let our caller attempt to clean up :/
 		 */
-		rc = efi_set_variable(guid, name, d, ds, attributes, 0600);
+		rc = efi_ctx_set_variable(ctx, guid, name, d, ds, attributes,
+					  0600);
 		if (rc < 0)
-			efi_error("efi_set_variable failed");
-		free(d);
-		free(data);
+			efi_error("efi_ctx_set_variable failed");
+		efi_free(d);
+		efi_free(data);
 	} else if (rc < 0 && errno == ENOENT) {
 		attributes = new_attributes & ~EFI_VARIABLE_APPEND_WRITE;
-		rc = efi_set_variable(guid, name, new_data, new_data_size,
-				      attributes, 0600);
+		rc = efi_ctx_set_variable(ctx, guid, name, new_data,
+					  new_data_size, attributes, 0600);
 	}
 	if (rc < 0)
-		efi_error("efi_set_variable failed");
+		efi_error("efi_ctx_set_variable failed");
 	return rc;
 }
 
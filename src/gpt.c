@@ -192,6 +192,8 @@ read_lba(int fd, uint64_t lba, void *buffer, size_t bytes)
 	size_t iobuf_size;
 	int rc;
 	off_t new_offset;
+	efi_trace_scope("read_lba", "fd %d lba %"PRIu64" bytes %zu", fd, lba,
+			bytes);
 
 	iobuf_size = lcm(bytes, sector_size);
 	rc = posix_memalign(&iobuf, sector_size, iobuf_size);
@@ -216,6 +218,7 @@ read_lba(int fd, uint64_t lba, void *buffer, size_t bytes)
 	if (!bytesread && !(last_lba(fd) & 1) && lba == last_lba(fd)) {
 		bytesread = read_lastoddsector(fd, buffer, bytes);
 	}
+	EFIVAR_PROBE4(gpt_read_lba, fd, lba, bytes, bytesread);
 	return bytesread;
 }
 
@@ -236,13 +239,13 @@ alloc_read_gpt_entries(int fd, uint32_t nptes, uint32_t ptesz, uint64_t ptelba)
 	if (!count)
 		return NULL;
 
-	pte = (gpt_entry *)malloc(count);
+	pte = (gpt_entry *)efi_malloc(count);
 	if (!pte)
 		return NULL;
 
 	memset(pte, 0, count);
 	if (!read_lba(fd, ptelba, pte, count)) {
-		free(pte);
+		efi_free(pte);
 		return NULL;
 	}
 	return pte;
@@ -263,13 +266,13 @@ alloc_read_gpt_header(int fd, uint64_t lba)
 	gpt_header *gpt;
 
 	gpt = (gpt_header *)
-	    malloc(sizeof (gpt_header));
+	    efi_malloc(sizeof (gpt_header));
 	if (!gpt)
 		return NULL;
 
 	memset(gpt, 0, sizeof (*gpt));
 	if (!read_lba(fd, lba, gpt, sizeof (gpt_header))) {
-		free(gpt);
+		efi_free(gpt);
 		return NULL;
 	}
 
@@ -362,7 +365,7 @@ is_gpt_valid(int fd, uint64_t lba,
 		efi_error("GUID Partition Table Header magic is wrong: %"PRIx64" != %"PRIx64,
 			  (uint64_t)le64_to_cpu((*gpt)->magic),
 			  GPT_HEADER_MAGIC);
-		free(*gpt);
+		efi_free(*gpt);
 		*gpt = NULL;
 		return rc;
 	}
@@ -373,7 +376,7 @@ is_gpt_valid(int fd, uint64_t lba,
 	if (hdrsz < hdrmin || hdrsz > logical_block_size) {
 		efi_error("GUID Partition Table Header size is invalid (%d < %d < %d)",
 			  hdrmin, hdrsz, logical_block_size);
-		free (*gpt);
+		efi_free(*gpt);
 		*gpt = NULL;
 		return rc;
 	}
@@ -386,7 +389,7 @@ is_gpt_valid(int fd, uint64_t lba,
 		efi_error("GPTH CRC check failed, %x != %x.",
 			  origcrc, crc);
 		(*gpt)->header_crc32 = cpu_to_le32(origcrc);
-		free(*gpt);
+		efi_free(*gpt);
 		*gpt = NULL;
 		return 0;
 	}
@@ -400,7 +403,7 @@ is_gpt_valid(int fd, uint64_t lba,
 		efi_error("lba %"PRIx64" != lba %"PRIx64".",
 			  mylba, lba);
 err:
-		free(*gpt);
+		efi_free(*gpt);
 		*gpt = NULL;
 		return 0;
 	}
@@ -466,7 +469,7 @@ err:
 	}
 
 	if (!(*ptes = alloc_read_gpt_entries(fd, nptes, ptesz, ptelba))) {
-		free(*gpt);
+		efi_free(*gpt);
 		*gpt = NULL;
 		return 0;
 	}
@@ -475,9 +478,9 @@ err:
 	crc = efi_crc32(*ptes, nptes * ptesz);
 	if (crc != le32_to_cpu((*gpt)->partition_entry_array_crc32)) {
 		efi_error("GUID Partitition Entry Array CRC check failed.");
-		free(*gpt);
+		efi_free(*gpt);
 		*gpt = NULL;
-		free(*ptes);
+		efi_free(*ptes);
 		*ptes = NULL;
 		return 0;
 	}
@@ -624,12 +627,12 @@ find_valid_gpt(int fd, gpt_header ** gpt, gpt_entry ** ptes,
 	}
 
 	/* This will be added to the EFI Spec. per Intel after v1.02. */
-	legacymbr = malloc(sizeof (*legacymbr));
+	legacymbr = efi_malloc(sizeof (*legacymbr));
 	if (legacymbr) {
 		memset(legacymbr, 0, sizeof (*legacymbr));
 		read_lba(fd, 0, (uint8_t *) legacymbr, sizeof (*legacymbr));
 		good_pmbr = is_pmbr_valid(legacymbr);
-		free(legacymbr);
+		efi_free(legacymbr);
 		legacymbr=NULL;
 	}
 
@@ -661,19 +664,19 @@ find_valid_gpt(int fd, gpt_header ** gpt, gpt_entry ** ptes,
 	errno = 0;
  fail:
 	if (pgpt && (pgpt != *gpt || ret < 0)) {
-		free(pgpt);
+		efi_free(pgpt);
 		pgpt=NULL;
 	}
 	if (pptes && (pptes != *ptes || ret < 0)) {
-		free(pptes);
+		efi_free(pptes);
 		pptes=NULL;
 	}
 	if (agpt && (agpt != *gpt || ret < 0)) {
-		free(agpt);
+		efi_free(agpt);
 		agpt=NULL;
 	}
 	if (aptes && (aptes != *ptes || ret < 0)) {
-		free(aptes);
+		efi_free(aptes);
 		aptes=NULL;
 	}
 	if (ret < 0) {
@@ -704,6 +707,8 @@ gpt_disk_get_partition_info(int fd, uint32_t num, uint64_t * start,
 	gpt_header *gpt = NULL;
 	gpt_entry *ptes = NULL, *p;
 	int rc = 0;
+	efi_trace_scope("gpt_disk_get_partition_info", "fd %d partition %u",
+			fd, num);
 
 	rc = find_valid_gpt(fd, &gpt, &ptes, ignore_pmbr_error,
 			    logical_block_size);
@@ -725,8 +730,8 @@ gpt_disk_get_partition_info(int fd, uint32_t num, uint64_t * start,
 		errno = EINVAL;
 		rc = -1;
 	}
-	free(ptes);
-	free(gpt);
+	efi_free(ptes);
+	efi_free(gpt);
 
 	return rc;
 }
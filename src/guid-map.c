@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * guid-map.c - open addressing hash map keyed by GUID, or GUID and name
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <errno.h>
+
+#include "efivar.h"
+
+/*
+ * Linear probing, kept at most 3/4 full.  Slots remember the full hash,
+ * so most mismatches cost one compare, and growing doesn't rehash.
+ */
+
+static uint32_t
+key_hash(const efi_guid_t *guid, const char *name)
+{
+	uint32_t h = efi_guid_hash_(guid);
+
+	if (name) {
+		/* FNV-1a over the name, seeded with the GUID's hash */
+		h ^= 0x811c9dc5u;
+		for (const unsigned char *c = (const unsigned char *)name;
+		     *c; c++) {
+			h ^= *c;
+			h *= 0x01000193u;
+		}
+		h ^= h >> 16;
+	}
+	return h;
+}
+
+static bool
+key_equal(const struct guid_map_slot *slot, uint32_t hash,
+	  const efi_guid_t *guid, const char *name)
+{
+	if (slot->hash != hash || !efi_guid_equal_(&slot->guid, guid))
+		return false;
+	if (!slot->name || !name)
+		return slot->name == name;
+	return !strcmp(slot->name, name);
+}
+
+static struct guid_map_slot *
+find_slot(const struct guid_map *map, uint32_t hash,
+	  const efi_guid_t *guid, const char *name)
+{
+	size_t mask = map->size - 1;
+
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		struct guid_map_slot *slot = &map->slots[i];
+
+		if (!slot->value || key_equal(slot, hash, guid, name))
+			return slot;
+	}
+}
+
+int HIDDEN
+guid_map_init(struct guid_map *map, size_t capacity)
+{
+	size_t size = 8;
+
+	while (size < capacity + capacity / 3 + 1) {
+		if (MUL(size, 2, &size)) {
+			errno = EOVERFLOW;
+			efi_error("guid map capacity %zu is too large",
+				  capacity);
+			return -1;
+		}
+	}
+
+	memset(map, 0, sizeof(*map));
+	map->slots = efi_calloc(size, sizeof(map->slots[0]));
+	if (!map->slots) {
+		efi_error("could not allocate guid map");
+		return -1;
+	}
+	map->size = size;
+	return 0;
+}
+
+void HIDDEN
+guid_map_init_fixed(struct guid_map *map, struct guid_map_slot *slots,
+		    size_t size)
+{
+	memset(slots, 0, size * sizeof(slots[0]));
+	map->slots = slots;
+	map->size = size;
+	map->count = 0;
+	map->fixed = true;
+}
+
+void HIDDEN
+guid_map_fini(struct guid_map *map)
+{
+	if (!map->fixed)
+		efi_free(map->slots);
+	memset(map, 0, sizeof(*map));
+}
+
+static int
+grow(struct guid_map *map)
+{
+	struct guid_map_slot *old = map->slots;
+	size_t old_size = map->size;
+	struct guid_map_slot *slots;
+	size_t size;
+
+	if (map->fixed) {
+		errno = ENOSPC;
+		efi_error("fixed guid map is full");
+		return -1;
+	}
+	if (MUL(old_size, 2, &size)) {
+		errno = EOVERFLOW;
+		efi_error("guid map is too large");
+		return -1;
+	}
+	slots = efi_calloc(size, sizeof(slots[0]));
+	if (!slots) {
+		efi_error("could not grow guid map");
+		return -1;
+	}
+
+	map->slots = slots;
+	map->size = size;
+	for (size_t i = 0; i < old_size; i++) {
+		struct guid_map_slot *slot;
+
+		if (!old[i].value)
+			continue;
+		slot = find_slot(map, old[i].hash, &old[i].guid, old[i].name);
+		*slot = old[i];
+	}
+	efi_free(old);
+	return 0;
+}
+
+int HIDDEN
+guid_map_insert(struct guid_map *map, const efi_guid_t *guid,
+		const char *name, void *value)
+{
+	uint32_t hash = key_hash(guid, name);
+	struct guid_map_slot *slot;
+
+	if (!value) {
+		errno = EINVAL;
+		efi_error("guid map values may not be NULL");
+		return -1;
+	}
+
+	slot = find_slot(map, hash, guid, name);
+	if (slot->value) {
+		slot->value = value;
+		return 0;
+	}
+
+	if ((map->count + 1) * 4 > map->size * 3) {
+		if (grow(map) < 0)
+			return -1;
+		slot = find_slot(map, hash, guid, name);
+	}
+
+	slot->guid = *guid;
+	slot->name = name;
+	slot->value = value;
+	slot->hash = hash;
+	map->count += 1;
+	return 0;
+}
+
+void HIDDEN *
+guid_map_find(const struct guid_map *map, const efi_guid_t *guid,
+	      const char *name)
+{
+	if (!map->size)
+		return NULL;
+	return find_slot(map, key_hash(guid, name), guid, name)->value;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * guid-map.h - open addressing hash map keyed by GUID, or GUID and name
+ * Copyright 2026 The efivar Authors
+ */
+#ifndef EFIVAR_GUID_MAP_H_
+#define EFIVAR_GUID_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Keys are a GUID plus an optional name; a NULL name and "" are different
+ * keys.  Names aren't copied, so they have to outlive the map.  Values
+ * can't be NULL, since that's what a miss looks like.
+ *
+ * A map either owns its slots, which grow as needed, or is laid over a
+ * fixed array the caller provides, which is useful for tables that live
+ * as long as the library does and shouldn't come from efi_malloc().
+ */
+struct guid_map_slot {
+	efi_guid_t guid;
+	const char *name;
+	void *value;
+	uint32_t hash;
+};
+
+struct guid_map {
+	struct guid_map_slot *slots;
+	size_t size;		/* always a power of two */
+	size_t count;
+	bool fixed;
+};
+
+extern int HIDDEN guid_map_init(struct guid_map *map, size_t capacity);
+extern void HIDDEN guid_map_init_fixed(struct guid_map *map,
+				       struct guid_map_slot *slots,
+				       size_t size);
+extern void HIDDEN guid_map_fini(struct guid_map *map);
+
+/*
+ * Add or replace guid/name -> value.  Returns 0, or -1 with errno set if
+ * the map couldn't grow.
+ */
+extern int HIDDEN guid_map_insert(struct guid_map *map,
+				  const efi_guid_t *guid, const char *name,
+				  void *value);
+extern void HIDDEN *guid_map_find(const struct guid_map *map,
+				  const efi_guid_t *guid, const char *name);
+
+#endif /* !EFIVAR_GUID_MAP_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -8,6 +8,7 @@
 
 #include <dlfcn.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "efivar.h"
@@ -22,10 +23,22 @@ efi_guid_cmp(const efi_guid_t *a, const efi_guid_t *b)
 	return efi_guid_cmp_(a, b);
 }
 
+int NONNULL(1, 2) PUBLIC
+efi_guid_equal(const efi_guid_t *a, const efi_guid_t *b)
+{
+	return efi_guid_equal_(a, b);
+}
+
+uint32_t NONNULL(1) PUBLIC
+efi_guid_hash(const efi_guid_t *guid)
+{
+	return efi_guid_hash_(guid);
+}
+
 int NONNULL(1) PUBLIC
 efi_guid_is_zero(const efi_guid_t *guid)
 {
-	return !efi_guid_cmp(guid,&efi_guid_zero);
+	return efi_guid_equal_(guid, &efi_guid_zero);
 }
 
 int
@@ -50,7 +63,7 @@ efi_guid_to_str(const efi_guid_t *guid, char **sp)
 		rc = snprintf(*sp, GUID_LENGTH_WITH_NUL, GUID_FORMAT,
 			      GUID_FORMAT_ARGS(guid));
 	} else {
-		rc = asprintf(&ret, GUID_FORMAT, GUID_FORMAT_ARGS(guid));
+		rc = efi_asprintf(&ret, GUID_FORMAT, GUID_FORMAT_ARGS(guid));
 		if (rc >= 0)
 			*sp = ret;
 	}
@@ -77,19 +90,73 @@ cmpnamep(const void *p1, const void *p2)
 	return strncmp(gn1->name, gn2->name, sizeof(gn1->name));
 }
 
+/*
+ * Hash indexes of the well known GUID table, by GUID and by name.  They
+ * live as long as the library, so they're laid over static slots rather
+ * than allocated; if the table ever outgrows them we just keep using
+ * bsearch().
+ */
+#define WELL_KNOWN_SLOTS 256
+static struct guid_map_slot well_known_guid_slots[WELL_KNOWN_SLOTS];
+static struct guid_map_slot well_known_name_slots[WELL_KNOWN_SLOTS];
+static struct guid_map well_known_guids;
+static struct guid_map well_known_names;
+static pthread_once_t well_known_once = PTHREAD_ONCE_INIT;
+static bool well_known_indexed;
+
+static void
+index_well_known(void)
+{
+	const struct efivar_guidname *gn;
+
+	guid_map_init_fixed(&well_known_guids, well_known_guid_slots,
+			    WELL_KNOWN_SLOTS);
+	guid_map_init_fixed(&well_known_names, well_known_name_slots,
+			    WELL_KNOWN_SLOTS);
+
+	for (uint64_t i = 0; i < efi_n_well_known_guids; i++) {
+		gn = &efi_well_known_guids[i];
+		if (guid_map_insert(&well_known_guids, &gn->guid, NULL,
+				    (void *)gn) < 0)
+			goto err;
+	}
+	for (uint64_t i = 0; i < efi_n_well_known_names; i++) {
+		gn = &efi_well_known_names[i];
+		if (guid_map_insert(&well_known_names, &efi_guid_zero,
+				    gn->name, (void *)gn) < 0)
+			goto err;
+	}
+	well_known_indexed = true;
+	return;
+err:
+	efi_error_clear();
+}
+
+static bool
+have_well_known_index(void)
+{
+	pthread_once(&well_known_once, index_well_known);
+	return well_known_indexed;
+}
+
 static int NONNULL(1, 2)
 _get_common_guidname(const efi_guid_t *guid, struct efivar_guidname **result)
 {
-	struct efivar_guidname key;
-	memset(&key, '\0', sizeof(key));
-	memcpy(&key.guid, guid, sizeof(*guid));
-
 	struct efivar_guidname *tmp;
-	tmp = bsearch(&key,
-		      &efi_well_known_guids[0],
-		      efi_n_well_known_guids,
-		      sizeof(efi_well_known_guids[0]),
-		      cmpguidp);
+
+	if (have_well_known_index()) {
+		tmp = guid_map_find(&well_known_guids, guid, NULL);
+	} else {
+		struct efivar_guidname key;
+
+		memset(&key, '\0', sizeof(key));
+		memcpy(&key.guid, guid, sizeof(*guid));
+		tmp = bsearch(&key,
+			      &efi_well_known_guids[0],
+			      efi_n_well_known_guids,
+			      sizeof(efi_well_known_guids[0]),
+			      cmpguidp);
+	}
 	if (!tmp) {
 		*result = NULL;
 		errno = ENOENT;
@@ -107,7 +174,7 @@ efi_guid_to_name(efi_guid_t *guid, char **name)
 	struct efivar_guidname *result;
 	int rc = _get_common_guidname(guid, &result);
 	if (rc >= 0) {
-		*name = strndup(result->name, sizeof(result->name) -1);
+		*name = efi_strndup(result->name, sizeof(result->name) -1);
 		return *name ? (int)strlen(*name) : -1;
 	}
 	rc = efi_guid_to_str(guid, name);
@@ -122,7 +189,7 @@ efi_guid_to_symbol(efi_guid_t *guid, char **symbol)
 	struct efivar_guidname *result;
 	int rc = _get_common_guidname(guid, &result);
 	if (rc >= 0) {
-		*symbol = strndup(result->symbol, sizeof(result->symbol) -1);
+		*symbol = efi_strndup(result->symbol, sizeof(result->symbol) -1);
 		return *symbol ? (int)strlen(*symbol) : -1;
 	}
 	efi_error_clear();
@@ -147,7 +214,7 @@ efi_guid_to_id_guid(const efi_guid_t *guid, char **sp)
 					result->symbol + strlen("efi_guid_"));
 		}
 
-		rc = asprintf(&ret, "{%s}",
+		rc = efi_asprintf(&ret, "{%s}",
 				result->symbol + strlen("efi_guid_"));
 		if (rc >= 0)
 			*sp = ret;
@@ -160,7 +227,7 @@ efi_guid_to_id_guid(const efi_guid_t *guid, char **sp)
 		return snprintf(*sp, GUID_LENGTH_WITH_NUL+2, "{"GUID_FORMAT"}",
 				GUID_FORMAT_ARGS(guid));
 	}
-	rc = asprintf(&ret, "{"GUID_FORMAT"}", GUID_FORMAT_ARGS(guid));
+	rc = efi_asprintf(&ret, "{"GUID_FORMAT"}", GUID_FORMAT_ARGS(guid));
 	if (rc >= 0)
 		*sp = ret;
 	return rc;
@@ -202,11 +269,15 @@ efi_name_to_guid(const char *name, efi_guid_t *guid)
 	key.name[sizeof(key.name) - 1] = '\0';
 
 	struct efivar_guidname *result;
-	result = bsearch(&key,
-			 &efi_well_known_names[0],
-			 efi_n_well_known_names,
-			 sizeof(efi_well_known_names[0]),
-			 cmpnamep);
+	if (have_well_known_index())
+		result = guid_map_find(&well_known_names, &efi_guid_zero,
+				       key.name);
+	else
+		result = bsearch(&key,
+				 &efi_well_known_names[0],
+				 efi_n_well_known_names,
+				 sizeof(efi_well_known_names[0]),
+				 cmpnamep);
 	if (result != NULL) {
 		memcpy(guid, &result->guid, sizeof(*guid));
 		return 0;
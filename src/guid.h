@@ -9,6 +9,8 @@
 #include <endian.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "efivar_endian.h"
@@ -207,6 +209,43 @@ efi_guid_cmp_(const efi_guid_t *a, const efi_guid_t *b)
 	return 0;
 }
 
+/*
+ * Equality doesn't care about field order or byte order, so it's just
+ * two 64-bit loads per side rather than efi_guid_cmp_()'s field walk.
+ */
+static inline bool NONNULL(1, 2) UNUSED
+efi_guid_equal_(const efi_guid_t *a, const efi_guid_t *b)
+{
+	uint64_t a0, a1, b0, b1;
+
+	memcpy(&a0, (const uint8_t *)a, sizeof(a0));
+	memcpy(&a1, (const uint8_t *)a + 8, sizeof(a1));
+	memcpy(&b0, (const uint8_t *)b, sizeof(b0));
+	memcpy(&b1, (const uint8_t *)b + 8, sizeof(b1));
+	return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+}
+
+/*
+ * Fold the two halves together and run them through the murmur3
+ * finalizer.  The value depends on the host byte order, so it's only
+ * good for in-memory tables.
+ */
+static inline uint32_t NONNULL(1) UNUSED
+efi_guid_hash_(const efi_guid_t *guid)
+{
+	uint64_t h0, h1, h;
+
+	memcpy(&h0, (const uint8_t *)guid, sizeof(h0));
+	memcpy(&h1, (const uint8_t *)guid + 8, sizeof(h1));
+	h = h0 ^ (h1 * 0x9e3779b97f4a7c15ull);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return (uint32_t)h;
+}
+
 static inline int NONNULL(1, 2) UNUSED
 efi_str_to_guid_(const char *s, efi_guid_t *guid)
 {
@@ -35,6 +35,7 @@ override _CPPFLAGS := $(CPPFLAGS)
 override CPPFLAGS = $(_CPPFLAGS) -DLIBEFIVAR_VERSION=$(VERSION) \
 	    -D_GNU_SOURCE \
 	    -D_FILE_OFFSET_BITS=64 \
+	    $(if $(filter 0,$(ENABLE_SDT)),-DEFIVAR_DISABLE_SDT) \
 	    -I$(TOPDIR)/src/include/
 CFLAGS ?= $(OPTIMIZE) $(DEBUGINFO) $(WARNINGS) $(ERRORS)
 CFLAGS_GCC ?= -specs=$(TOPDIR)/src/include/gcc.specs \
@@ -126,4 +127,8 @@ NAME=efivar
 # building/installing docs.
 ENABLE_DOCS ?= 1
 
+# USDT probes are built in when <sys/sdt.h> is available.  Set
+# ENABLE_SDT=0 to leave them out regardless.
+ENABLE_SDT ?= 1
+
 # vim:ft=make
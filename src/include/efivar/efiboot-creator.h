@@ -47,6 +47,36 @@ extern ssize_t efi_generate_ipv4_device_path(uint8_t *buf, ssize_t size,
 	__attribute__((__nonnull__ (3,4,5,6,7)))
 	__attribute__((__visibility__ ("default")));
 
+/*
+ * Device paths for booting from one network interface.  Each path is the
+ * NIC's bus path and its MAC() node, followed by an IPv4() or IPv6() node
+ * for the ipv4 and ipv6 paths, and ends with End().  The IP nodes carry
+ * the interface's first global address, or zeros if it has none.
+ */
+typedef struct {
+	char ifname[16];
+	int ifindex;
+	uint16_t link_type;	/* ARPHRD_* */
+	uint8_t *mac_path;
+	ssize_t mac_path_size;
+	uint8_t *ipv4_path;
+	ssize_t ipv4_path_size;
+	uint8_t *ipv6_path;
+	ssize_t ipv6_path_size;
+} efi_net_device_paths_t;
+
+/*
+ * Find every network interface with a hardware address on a bus we can
+ * describe, using one netlink link dump and one address dump.  Returns the
+ * number of entries in *paths.
+ */
+extern ssize_t efi_generate_net_device_paths(efi_net_device_paths_t **paths)
+	__attribute__((__nonnull__ (1)))
+	__attribute__((__visibility__ ("default")));
+extern void efi_free_net_device_paths(efi_net_device_paths_t *paths,
+				      size_t n)
+	__attribute__((__visibility__ ("default")));
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * efiboot-resolve.h - find the Linux device and file an EFI device path
+ * names
+ * Copyright 2026 The efivar Authors
+ */
+#ifndef _EFIBOOT_RESOLVE_H
+#define _EFIBOOT_RESOLVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * An index of every block device on the system, keyed by the partition
+ * GUID or MBR signature that an HD() node would name it by.  Building it
+ * reads sysfs, /proc/self/mountinfo, and each disk's partition table once;
+ * disks that can't be opened are indexed without signatures.
+ */
+typedef struct efi_resolver efi_resolver_t;
+
+extern efi_resolver_t *efi_resolver_new(void)
+	__attribute__((__visibility__ ("default")));
+extern void efi_resolver_free(efi_resolver_t *resolver)
+	__attribute__((__visibility__ ("default")));
+
+#define EFI_RESOLVED_DEVICE	0x00000001 /* device names the disk or partition */
+#define EFI_RESOLVED_PREFIX	0x00000002 /* the path before HD() matches it */
+#define EFI_RESOLVED_MOUNTED	0x00000004 /* mountpoint is where it's mounted */
+#define EFI_RESOLVED_FILE	0x00000008 /* path names the File() target */
+#define EFI_RESOLVED_EXISTS	0x00000010 /* and stat(2) found it there */
+
+typedef struct {
+	uint32_t flags;
+	int partition;		/* from HD(), or 0 for a whole disk */
+	char *device;		/* e.g. "/dev/nvme0n1p1" */
+	char *mountpoint;
+	char *path;		/* mountpoint plus the File() path */
+	int file_errno;		/* why stat(path) failed, if it did */
+} efi_resolved_path_t;
+
+/*
+ * Find the block device and file that dp refers to.  The result is filled
+ * in as far as it can be and flags say how far that was; this returns -1
+ * only when dp itself can't be parsed or memory runs out.
+ */
+extern int efi_resolve_device_path(efi_resolver_t *resolver,
+				   const_efidp dp, ssize_t limit,
+				   efi_resolved_path_t *resolved)
+	__attribute__((__nonnull__ (1, 2, 4)))
+	__attribute__((__visibility__ ("default")));
+extern void efi_free_resolved_path(efi_resolved_path_t *resolved)
+	__attribute__((__visibility__ ("default")));
+
+typedef struct {
+	uint16_t number;	/* the #### in Boot#### */
+	uint32_t attributes;	/* the load option's LOAD_OPTION_* bits */
+	char *description;
+	int error;		/* errno if the variable couldn't be parsed */
+	efi_resolved_path_t resolved;
+} efi_boot_resolution_t;
+
+/*
+ * Resolve the device path of every Boot#### variable using one index.
+ * Returns the number of entries in *entries, sorted by number.
+ */
+extern ssize_t efi_resolve_boot_entries(efi_boot_resolution_t **entries)
+	__attribute__((__nonnull__ (1)))
+	__attribute__((__visibility__ ("default")));
+extern void efi_free_boot_resolutions(efi_boot_resolution_t *entries,
+				      size_t n)
+	__attribute__((__visibility__ ("default")));
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* _EFIBOOT_RESOLVE_H */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -19,6 +19,7 @@
 
 #include <efivar/efiboot-creator.h>
 #include <efivar/efiboot-loadopt.h>
+#include <efivar/efiboot-resolve.h>
 
 #ifdef __cplusplus
 extern "C" {
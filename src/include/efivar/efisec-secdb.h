@@ -57,6 +57,32 @@ extern int efi_secdb_set_bool(efi_secdb_t *secdb,
 extern int efi_secdb_parse(uint8_t *data,
 			   size_t datasz,
 			   efi_secdb_t **secdbp);
+
+typedef enum {
+	EFI_SECDB_FORMAT_UNKNOWN = 0,
+	EFI_SECDB_FORMAT_ESL,		// bare EFI_SIGNATURE_LISTs
+	EFI_SECDB_FORMAT_ESL_ATTRS,	// ESLs after a 32-bit attribute word,
+					// as read from efivarfs
+	EFI_SECDB_FORMAT_AUTH2,		// ESLs after an
+					// EFI_VARIABLE_AUTHENTICATION_2 header
+	EFI_SECDB_FORMAT_EXPORT,	// efi_variable_export() output
+} efi_secdb_format_t;
+
+/*
+ * Look at the first few headers of data and guess what it is.  For the
+ * ESL formats, *offset is set to where the first ESL starts.  Returns 0
+ * and EFI_SECDB_FORMAT_UNKNOWN if nothing matched.
+ */
+extern int efi_secdb_sniff_format(const uint8_t *data,
+				  size_t datasz,
+				  efi_secdb_format_t *format,
+				  size_t *offset);
+/*
+ * Like efi_secdb_parse(), but accepts any of the formats above.
+ */
+extern int efi_secdb_parse_any(uint8_t *data,
+			       size_t datasz,
+			       efi_secdb_t **secdbp);
 extern int efi_secdb_add_entry(efi_secdb_t *secdb,
 			       const efi_guid_t *owner,
 			       efi_secdb_type_t algorithm,
@@ -71,6 +97,21 @@ extern int efi_secdb_realize(efi_secdb_t *secdb,
 			     /* caller owns out */
 			     void **out,
 			     size_t *outsize);
+/*
+ * Merge signature lists that share an algorithm, signature size, and
+ * header, dropping duplicate signatures.  before and after, if not NULL,
+ * are set to the realized size in bytes.
+ */
+extern int efi_secdb_compact(efi_secdb_t *secdb,
+			     size_t *before,
+			     size_t *after);
+/*
+ * Make *deltap a new secdb holding every entry in want whose algorithm and
+ * signature data don't appear anywhere in have.  have may be NULL.
+ */
+extern int efi_secdb_delta(efi_secdb_t *want,
+			   efi_secdb_t *have,
+			   efi_secdb_t **deltap);
 extern void efi_secdb_free(efi_secdb_t *secdb);
 
 typedef enum {
@@ -94,6 +135,120 @@ extern int efi_secdb_visit_entries(efi_secdb_t *secdb,
 				   efi_secdb_visitor_t *visitor,
 				   void *closure);
 
+/*
+ * Return 1 to keep a signature, 0 to drop it, or -1 with errno set to
+ * stop.  owner is NULL for types without one; algorithm is
+ * MAX_SECDB_TYPE for types libefisec doesn't know.
+ */
+typedef int (efi_secdb_filter_t)(const efi_guid_t * const owner,
+				 const efi_secdb_type_t algorithm,
+				 const efi_secdb_data_t * const data,
+				 const size_t datasz,
+				 void *closure);
+
+/*
+ * Write the signature lists in data (in any format efi_secdb_parse_any()
+ * accepts) to outfd, keeping only the signatures filter keeps, and
+ * leaving out lists that end up empty.  No efi_secdb_t is built; apart
+ * from data itself, memory use is bounded by the largest single list.
+ * outsize, if not NULL, is set to the number of bytes written.  If outfd
+ * is -1 nothing is written, but filter and outsize still work.
+ */
+extern int efi_secdb_filter_stream(uint8_t *data,
+				   size_t datasz,
+				   efi_secdb_filter_t *filter,
+				   void *closure,
+				   int outfd,
+				   size_t *outsize);
+
+/*
+ * A read-only index for checking signatures against a database without
+ * parsing it: one sorted array per algorithm, with certificates keyed
+ * by the SHA-256 of their DER encoding, meant to be mapped by any number
+ * of processes at once.
+ *
+ * efi_secdb_index_build() makes one from secdb, recording the SHA-256 of
+ * source (or, if source is NULL, of the realized secdb) so that checkers
+ * can tell with efi_secdb_index_is_current() whether it still describes
+ * the database they care about.  The caller owns *out.
+ */
+typedef struct efi_secdb_index efi_secdb_index_t;
+
+extern int efi_secdb_index_build(efi_secdb_t *secdb,
+				 const uint8_t *source,
+				 size_t sourcesz,
+				 void **out,
+				 size_t *outsize);
+extern int efi_secdb_index_open(const char *path,
+				efi_secdb_index_t **indexp);
+/*
+ * Returns 1 if the index has a signature with this algorithm and data,
+ * and 0 if not, without allocating.  For the X509 hash types only the
+ * hash is compared; the revocation time may be left off of data.
+ */
+extern int efi_secdb_index_contains(const efi_secdb_index_t *index,
+				    efi_secdb_type_t algorithm,
+				    const efi_secdb_data_t *data,
+				    size_t datasz);
+extern int efi_secdb_index_is_current(const efi_secdb_index_t *index,
+				      const uint8_t *source,
+				      size_t sourcesz);
+extern void efi_secdb_index_close(efi_secdb_index_t *index);
+
+/*
+ * An immutable, reference-counted copy of a secdb: its realized signature
+ * lists and an index of them, in one allocation.  efi_secdb_freeze()
+ * returns one holding a single reference; efi_secdb_snapshot_get() and
+ * efi_secdb_snapshot_put() take and drop more.  Everything that reads a
+ * snapshot is safe to call from any number of threads without locking.
+ *
+ * To change one, thaw it into a new secdb, edit that, and freeze it
+ * again.
+ */
+typedef struct efi_secdb_snapshot efi_secdb_snapshot_t;
+
+extern int efi_secdb_freeze(efi_secdb_t *secdb,
+			    efi_secdb_snapshot_t **snapshotp);
+extern efi_secdb_snapshot_t *
+	efi_secdb_snapshot_get(efi_secdb_snapshot_t *snapshot);
+extern void efi_secdb_snapshot_put(efi_secdb_snapshot_t *snapshot);
+/*
+ * Like efi_secdb_index_contains().
+ */
+extern int efi_secdb_snapshot_contains(const efi_secdb_snapshot_t *snapshot,
+				       efi_secdb_type_t algorithm,
+				       const efi_secdb_data_t *data,
+				       size_t datasz);
+/*
+ * *data points into the snapshot, and is only good while a reference
+ * to it is held.
+ */
+extern int efi_secdb_snapshot_data(const efi_secdb_snapshot_t *snapshot,
+				   const uint8_t **data,
+				   size_t *datasz);
+extern int efi_secdb_snapshot_visit_entries(const efi_secdb_snapshot_t *snapshot,
+					    efi_secdb_visitor_t *visitor,
+					    void *closure);
+extern int efi_secdb_snapshot_thaw(const efi_secdb_snapshot_t *snapshot,
+				   efi_secdb_t **secdbp);
+
+/*
+ * A place to publish the snapshot readers should use.
+ * efi_secdb_current_acquire() returns a reference to the latest one (or
+ * NULL before the first publish) without blocking;
+ * efi_secdb_current_publish() takes its own reference to snapshot, swaps
+ * it in, and drops the old one once no reader can still be picking it
+ * up.  Readers holding the old one keep using it until they put it.
+ */
+typedef struct efi_secdb_current efi_secdb_current_t;
+
+extern int efi_secdb_current_new(efi_secdb_current_t **currentp);
+extern efi_secdb_snapshot_t *
+	efi_secdb_current_acquire(efi_secdb_current_t *current);
+extern int efi_secdb_current_publish(efi_secdb_current_t *current,
+				     efi_secdb_snapshot_t *snapshot);
+extern void efi_secdb_current_free(efi_secdb_current_t *current);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * efivar-alloc.h - control where libefivar, libefiboot and libefisec
+ * get their memory
+ *
+ * Everything these libraries allocate on a caller's behalf comes from
+ * the current allocator: the calling thread's, if one was set with
+ * efi_set_thread_allocator(), otherwise the process-wide one from
+ * efi_set_allocator(), otherwise libc.  Memory a library call hands back
+ * (variable data, strings, device paths, secdbs...) must be released with
+ * efi_free() while the same allocator is in effect.
+ *
+ * The error stack from efi_error_get() is the exception; it outlives any
+ * one call and always comes from libc.
+ */
+
+#ifndef EFIVAR_ALLOC_H_
+#define EFIVAR_ALLOC_H_ 1
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	void *(*malloc)(size_t size, void *ctx);
+	/* realloc(NULL, size, ctx) must behave like malloc() */
+	void *(*realloc)(void *ptr, size_t size, void *ctx);
+	void (*free)(void *ptr, void *ctx);
+	void *ctx;
+} efi_allocator_t;
+
+/*
+ * Set the process-wide allocator, or go back to libc with NULL.  The
+ * structure is copied, and the switch is atomic: a call running in
+ * another thread uses either the old allocator or the new one, never
+ * parts of both.  Memory must still be freed by the allocator that
+ * allocated it, so release what the old one handed out before switching,
+ * or switch back to release it.  Use efi_set_thread_allocator() to scope
+ * an allocator to part of a program.
+ */
+extern int efi_set_allocator(const efi_allocator_t *allocator);
+/*
+ * Set this thread's allocator, or go back to the process-wide one with
+ * NULL.  The structure is not copied and must stay valid until it's
+ * replaced.
+ */
+extern int efi_set_thread_allocator(const efi_allocator_t *allocator);
+extern const efi_allocator_t *efi_get_allocator(void)
+			__attribute__((__returns_nonnull__));
+
+extern void *efi_malloc(size_t size)
+			__attribute__((__malloc__))
+			__attribute__((__alloc_size__ (1)));
+extern void *efi_calloc(size_t nmemb, size_t size)
+			__attribute__((__malloc__))
+			__attribute__((__alloc_size__ (1, 2)));
+extern void *efi_realloc(void *ptr, size_t size)
+			__attribute__((__alloc_size__ (2)));
+extern void *efi_reallocarray(void *ptr, size_t nmemb, size_t size)
+			__attribute__((__alloc_size__ (2, 3)));
+extern void efi_free(void *ptr);
+extern char *efi_strdup(const char *s)
+			__attribute__((__malloc__))
+			__attribute__((__nonnull__ (1)));
+extern char *efi_strndup(const char *s, size_t n)
+			__attribute__((__malloc__))
+			__attribute__((__nonnull__ (1)));
+
+/*
+ * A bump allocator for bulk work: allocations come from large chunks,
+ * efi_free() of a single allocation does nothing, and everything is
+ * released at once by efi_arena_reset() or efi_arena_free().  An arena
+ * is not thread safe; give each thread its own.  chunk_size of 0 picks
+ * a default.
+ */
+typedef struct efi_arena efi_arena_t;
+
+extern efi_arena_t *efi_arena_new(size_t chunk_size);
+extern const efi_allocator_t *efi_arena_allocator(efi_arena_t *arena)
+			__attribute__((__nonnull__ (1)));
+extern size_t efi_arena_used(efi_arena_t *arena)
+			__attribute__((__nonnull__ (1)));
+extern void efi_arena_reset(efi_arena_t *arena)
+			__attribute__((__nonnull__ (1)));
+extern void efi_arena_free(efi_arena_t *arena);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* EFIVAR_ALLOC_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * efivar-ctx.h - explicit variable store contexts
+ *
+ * An efi_ctx_t names one variable store: the backend used to talk to it,
+ * the directory it lives in, and the per-store state (the
+ * efi_ctx_get_next_variable_name() iterator and the read rate limit)
+ * that the plain efi_*() API keeps for the one store it auto-detects.
+ * Separate contexts may be used from separate threads concurrently.
+ */
+
+#ifndef EFIVAR_CTX_H_
+#define EFIVAR_CTX_H_ 1
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct efi_ctx efi_ctx_t;
+
+/*
+ * ops_name is a backend name as accepted by LIBEFIVAR_OPS ("efivarfs",
+ * "vars").  If it is NULL, the backends are probed against path in the
+ * same order libefivar uses at startup.  If path is NULL, the backend's
+ * usual location (including EFIVARFS_PATH or VARS_PATH) is used.
+ */
+extern efi_ctx_t *efi_ctx_new(const char *ops_name, const char *path);
+extern void efi_ctx_free(efi_ctx_t *ctx);
+extern efi_ctx_t *efi_ctx_default(void)
+			__attribute__((__returns_nonnull__));
+
+extern const char *efi_ctx_get_ops_name(efi_ctx_t *ctx)
+			__attribute__((__nonnull__ (1)));
+extern const char *efi_ctx_get_path(efi_ctx_t *ctx)
+			__attribute__((__nonnull__ (1)));
+/*
+ * Microseconds to sleep around each variable read.  A negative value
+ * restores the default, which is 10ms when not running as root, to stay
+ * under the kernel's 100 reads per second limit.
+ */
+extern int efi_ctx_set_ratelimit(efi_ctx_t *ctx, long usecs)
+			__attribute__((__nonnull__ (1)));
+
+extern int efi_ctx_variables_supported(efi_ctx_t *ctx)
+			__attribute__((__nonnull__ (1)));
+extern int efi_ctx_get_variable_size(efi_ctx_t *ctx, efi_guid_t guid,
+				     const char *name, size_t *size)
+			__attribute__((__nonnull__ (1, 3, 4)));
+extern int efi_ctx_get_variable_attributes(efi_ctx_t *ctx, efi_guid_t guid,
+					   const char *name,
+					   uint32_t *attributes)
+			__attribute__((__nonnull__ (1, 3, 4)));
+extern int efi_ctx_get_variable_exists(efi_ctx_t *ctx, efi_guid_t guid,
+				       const char *name)
+			__attribute__((__nonnull__ (1, 3)));
+extern int efi_ctx_get_variable(efi_ctx_t *ctx, efi_guid_t guid,
+				const char *name, uint8_t **data,
+				size_t *data_size, uint32_t *attributes)
+			__attribute__((__nonnull__ (1, 3, 4, 5, 6)));
+extern int efi_ctx_del_variable(efi_ctx_t *ctx, efi_guid_t guid,
+				const char *name)
+			__attribute__((__nonnull__ (1, 3)));
+extern int efi_ctx_set_variable(efi_ctx_t *ctx, efi_guid_t guid,
+				const char *name, const uint8_t *data,
+				size_t data_size, uint32_t attributes,
+				mode_t mode)
+			__attribute__((__nonnull__ (1, 3, 4)));
+extern int efi_ctx_append_variable(efi_ctx_t *ctx, efi_guid_t guid,
+				   const char *name, const uint8_t *data,
+				   size_t data_size, uint32_t attributes)
+			__attribute__((__nonnull__ (1, 3, 4)));
+extern int efi_ctx_get_next_variable_name(efi_ctx_t *ctx, efi_guid_t **guid,
+					  char **name)
+			__attribute__((__nonnull__ (1, 2, 3)));
+extern int efi_ctx_chmod_variable(efi_ctx_t *ctx, efi_guid_t guid,
+				  const char *name, mode_t mode)
+			__attribute__((__nonnull__ (1, 3)));
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* EFIVAR_CTX_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
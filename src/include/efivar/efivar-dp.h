@@ -476,6 +476,15 @@ typedef struct {
 #define EFIDP_IPv6_ORIGIN_STATIC	0x00
 #define EFIDP_IPv6_ORIGIN_AUTOCONF	0x01
 #define EFIDP_IPv6_ORIGIN_STATEFUL	0x02
+/* addresses are 16 bytes in network order, or NULL for all zeros; the
+ * rest is in host byte order */
+extern ssize_t efidp_make_ipv6(uint8_t *buf, ssize_t size,
+			       const uint8_t * const local,
+			       const uint8_t * const remote,
+			       const uint8_t * const gateway,
+			       uint8_t prefix_length,
+			       uint16_t local_port, uint16_t remote_port,
+			       uint16_t protocol, uint8_t addr_origin);
 
 #define EFIDP_MSG_VLAN		0x14
 typedef struct {
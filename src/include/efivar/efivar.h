@@ -77,6 +77,10 @@ extern int efi_symbol_to_guid(const char *symbol, efi_guid_t *guid)
 extern int efi_guid_is_zero(const efi_guid_t *guid);
 extern int efi_guid_is_empty(const efi_guid_t *guid);
 extern int efi_guid_cmp(const efi_guid_t *a, const efi_guid_t *b);
+extern int efi_guid_equal(const efi_guid_t *a, const efi_guid_t *b)
+			 __attribute__((__nonnull__ (1, 2)));
+extern uint32_t efi_guid_hash(const efi_guid_t *guid)
+			     __attribute__((__nonnull__ (1)));
 
 /* import / export functions */
 typedef struct efi_variable efi_variable_t;
@@ -140,6 +144,12 @@ extern int efi_error_set(const char *filename,
 extern void efi_error_clear(void);
 extern void efi_error_pop(void);
 extern void efi_set_loglevel(int level);
+extern void efi_trace_begin(const char *name, const char *fmt, ...)
+			__attribute__((__visibility__ ("default")))
+			__attribute__((__nonnull__ (1)))
+			__attribute__((__format__ (printf, 2, 3)));
+extern void efi_trace_end(void)
+			__attribute__((__visibility__ ("default")));
 #else
 static inline int
 __attribute__((__nonnull__ (2, 3, 4, 5, 6)))
@@ -183,6 +193,22 @@ efi_set_loglevel(int level __attribute__((__unused__)))
 {
 	return;
 }
+
+static inline void
+__attribute__((__nonnull__ (1)))
+__attribute__((__format__ (printf, 2, 3)))
+efi_trace_begin(const char *name __attribute__((__unused__)),
+		const char *fmt __attribute__((__unused__)),
+		...)
+{
+	return;
+}
+
+static inline void
+efi_trace_end(void)
+{
+	return;
+}
 #endif
 
 #define efi_error_real__(errval, file, function, line, fmt, args...) \
@@ -207,6 +233,8 @@ extern uint32_t efi_get_libefivar_version(void)
 } /* extern "C" */
 #endif
 
+#include <efivar/efivar-alloc.h>
+#include <efivar/efivar-ctx.h>
 #include <efivar/efivar-dp.h>
 #include <efivar/efivar-time.h>
 
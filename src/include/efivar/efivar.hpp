@@ -0,0 +1,919 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * efivar.hpp - header-only C++20 interface to libefivar, libefiboot, and
+ * libefisec
+ * Copyright 2026 The efivar Authors
+ *
+ * Nothing here copies variable data.  Buffers the libraries allocate are
+ * adopted by move-only owners that hand them back to efi_free(), and
+ * everything else is a std::span or std::string_view over memory the
+ * caller already has.  Errors come back as efivar::result<T>, which is
+ * std::expected<T, std::error_code> where the standard library has it,
+ * and a small stand-in with the same accessors where it doesn't.  The
+ * error code is errno in std::generic_category(); efi_error_get() still
+ * has the details.
+ *
+ * Link with whichever of -lefivar, -lefiboot, and -lefisec you use; the
+ * parts for libefiboot and libefisec are only declared when their headers
+ * are found.
+ */
+#ifndef EFIVAR_HPP_
+#define EFIVAR_HPP_ 1
+
+#if !defined(__cplusplus) || __cplusplus < 202002L
+#error "efivar.hpp requires C++20"
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <version>
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+#include <expected>
+#define EFIVAR_HPP_HAVE_EXPECTED 1
+#else
+#include <variant>
+#endif
+
+#include <efivar/efivar.h>
+#include <efivar/efivar-alloc.h>
+#include <efivar/efivar-ctx.h>
+
+#if __has_include(<efivar/efiboot.h>)
+#include <efivar/efiboot.h>
+#define EFIVAR_HPP_HAVE_EFIBOOT 1
+#endif
+
+#if __has_include(<efivar/efisec.h>)
+#include <efivar/efisec.h>
+#define EFIVAR_HPP_HAVE_EFISEC 1
+#endif
+
+namespace efivar {
+
+/*
+ * Results
+ */
+#ifdef EFIVAR_HPP_HAVE_EXPECTED
+template <typename T>
+using result = std::expected<T, std::error_code>;
+using unexpected = std::unexpected<std::error_code>;
+#else
+class unexpected {
+public:
+	explicit unexpected(std::error_code ec) noexcept : ec_(ec) { }
+	const std::error_code &error() const noexcept { return ec_; }
+private:
+	std::error_code ec_;
+};
+
+template <typename T>
+class result {
+public:
+	result(const T &value) : v_(std::in_place_index<0>, value) { }
+	result(T &&value) : v_(std::in_place_index<0>, std::move(value)) { }
+	result(const unexpected &u) : v_(std::in_place_index<1>, u.error()) { }
+
+	bool has_value() const noexcept { return v_.index() == 0; }
+	explicit operator bool() const noexcept { return has_value(); }
+
+	T &value() &
+	{
+		check();
+		return std::get<0>(v_);
+	}
+	const T &value() const &
+	{
+		check();
+		return std::get<0>(v_);
+	}
+	T &&value() &&
+	{
+		check();
+		return std::get<0>(std::move(v_));
+	}
+	T &operator*() & noexcept { return *std::get_if<0>(&v_); }
+	const T &operator*() const & noexcept { return *std::get_if<0>(&v_); }
+	T &&operator*() && noexcept { return std::move(*std::get_if<0>(&v_)); }
+	T *operator->() noexcept { return std::get_if<0>(&v_); }
+	const T *operator->() const noexcept { return std::get_if<0>(&v_); }
+	const std::error_code &error() const noexcept
+	{
+		return *std::get_if<1>(&v_);
+	}
+
+private:
+	void check() const
+	{
+		if (!has_value())
+			throw std::system_error(error());
+	}
+	std::variant<T, std::error_code> v_;
+};
+
+template <>
+class result<void> {
+public:
+	result() noexcept = default;
+	result(const unexpected &u) noexcept : ec_(u.error()), ok_(false) { }
+
+	bool has_value() const noexcept { return ok_; }
+	explicit operator bool() const noexcept { return ok_; }
+	void value() const
+	{
+		if (!ok_)
+			throw std::system_error(ec_);
+	}
+	void operator*() const noexcept { }
+	const std::error_code &error() const noexcept { return ec_; }
+
+private:
+	std::error_code ec_;
+	bool ok_ = true;
+};
+#endif
+
+namespace detail {
+inline std::error_code
+errno_code(int err = errno) noexcept
+{
+	return std::error_code(err ? err : EIO, std::generic_category());
+}
+
+inline unexpected
+fail(int err = errno) noexcept
+{
+	return unexpected(errno_code(err));
+}
+} /* namespace detail */
+
+/*
+ * Owners for libefivar allocations
+ */
+
+/*
+ * A move-only owner of a byte buffer allocated with efi_malloc(), like
+ * the data efi_get_variable() returns.
+ */
+class buffer {
+public:
+	buffer() noexcept = default;
+	buffer(const buffer &) = delete;
+	buffer &operator=(const buffer &) = delete;
+	buffer(buffer &&other) noexcept
+		: data_(std::exchange(other.data_, nullptr)),
+		  size_(std::exchange(other.size_, 0))
+	{ }
+	buffer &operator=(buffer &&other) noexcept
+	{
+		if (this != &other) {
+			efi_free(data_);
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+	~buffer() { efi_free(data_); }
+
+	/* Take ownership of p, which must have come from efi_malloc(). */
+	static buffer adopt(void *p, std::size_t size) noexcept
+	{
+		buffer b;
+		b.data_ = static_cast<std::uint8_t *>(p);
+		b.size_ = p ? size : 0;
+		return b;
+	}
+	/* Give up ownership; the caller must efi_free() the result. */
+	std::uint8_t *release() noexcept
+	{
+		size_ = 0;
+		return std::exchange(data_, nullptr);
+	}
+
+	std::uint8_t *data() noexcept { return data_; }
+	const std::uint8_t *data() const noexcept { return data_; }
+	std::size_t size() const noexcept { return size_; }
+	bool empty() const noexcept { return size_ == 0; }
+	std::span<std::uint8_t> bytes() noexcept { return { data_, size_ }; }
+	std::span<const std::uint8_t> bytes() const noexcept
+	{
+		return { data_, size_ };
+	}
+	operator std::span<const std::uint8_t>() const noexcept
+	{
+		return bytes();
+	}
+
+private:
+	std::uint8_t *data_ = nullptr;
+	std::size_t size_ = 0;
+};
+
+/*
+ * A move-only owner of a NUL terminated string allocated with
+ * efi_malloc(), like the ones efi_guid_to_str() returns.
+ */
+class cstring {
+public:
+	cstring() noexcept = default;
+	cstring(const cstring &) = delete;
+	cstring &operator=(const cstring &) = delete;
+	cstring(cstring &&other) noexcept
+		: s_(std::exchange(other.s_, nullptr))
+	{ }
+	cstring &operator=(cstring &&other) noexcept
+	{
+		if (this != &other) {
+			efi_free(s_);
+			s_ = std::exchange(other.s_, nullptr);
+		}
+		return *this;
+	}
+	~cstring() { efi_free(s_); }
+
+	static cstring adopt(char *s) noexcept
+	{
+		cstring c;
+		c.s_ = s;
+		return c;
+	}
+	char *release() noexcept { return std::exchange(s_, nullptr); }
+
+	const char *c_str() const noexcept { return s_ ? s_ : ""; }
+	std::string_view view() const noexcept { return c_str(); }
+	operator std::string_view() const noexcept { return view(); }
+
+private:
+	char *s_ = nullptr;
+};
+
+/*
+ * GUIDs
+ */
+
+/* For std::unordered_map<efi_guid_t, T, efivar::guid_hash,
+ * efivar::guid_equal> and friends. */
+struct guid_hash {
+	std::size_t operator()(const efi_guid_t &guid) const noexcept
+	{
+		return efi_guid_hash(&guid);
+	}
+};
+
+struct guid_equal {
+	bool operator()(const efi_guid_t &a, const efi_guid_t &b) const noexcept
+	{
+		return efi_guid_equal(&a, &b);
+	}
+};
+
+inline result<efi_guid_t>
+guid_from_string(const char *s) noexcept
+{
+	efi_guid_t guid;
+
+	if (efi_str_to_guid(s, &guid) < 0)
+		return detail::fail();
+	return guid;
+}
+
+inline result<cstring>
+to_string(const efi_guid_t &guid) noexcept
+{
+	char *s = nullptr;
+
+	if (efi_guid_to_str(&guid, &s) < 0)
+		return detail::fail();
+	return cstring::adopt(s);
+}
+
+/*
+ * Variables
+ */
+
+struct variable {
+	buffer data;
+	std::uint32_t attributes = 0;
+};
+
+inline result<variable>
+get_variable(efi_ctx_t *ctx, const efi_guid_t &guid, const char *name) noexcept
+{
+	std::uint8_t *data = nullptr;
+	std::size_t size = 0;
+	std::uint32_t attributes = 0;
+
+	if (efi_ctx_get_variable(ctx, guid, name, &data, &size,
+				 &attributes) < 0)
+		return detail::fail();
+	return variable { buffer::adopt(data, size), attributes };
+}
+
+inline result<variable>
+get_variable(const efi_guid_t &guid, const char *name) noexcept
+{
+	return get_variable(efi_ctx_default(), guid, name);
+}
+
+inline result<void>
+set_variable(efi_ctx_t *ctx, const efi_guid_t &guid, const char *name,
+	     std::span<const std::uint8_t> data, std::uint32_t attributes,
+	     mode_t mode = 0600) noexcept
+{
+	if (efi_ctx_set_variable(ctx, guid, name, data.data(), data.size(),
+				 attributes, mode) < 0)
+		return detail::fail();
+	return {};
+}
+
+inline result<void>
+set_variable(const efi_guid_t &guid, const char *name,
+	     std::span<const std::uint8_t> data, std::uint32_t attributes,
+	     mode_t mode = 0600) noexcept
+{
+	return set_variable(efi_ctx_default(), guid, name, data, attributes,
+			    mode);
+}
+
+inline result<void>
+append_variable(efi_ctx_t *ctx, const efi_guid_t &guid, const char *name,
+		std::span<const std::uint8_t> data,
+		std::uint32_t attributes) noexcept
+{
+	if (efi_ctx_append_variable(ctx, guid, name, data.data(), data.size(),
+				    attributes) < 0)
+		return detail::fail();
+	return {};
+}
+
+inline result<void>
+append_variable(const efi_guid_t &guid, const char *name,
+		std::span<const std::uint8_t> data,
+		std::uint32_t attributes) noexcept
+{
+	return append_variable(efi_ctx_default(), guid, name, data,
+			       attributes);
+}
+
+inline result<void>
+del_variable(efi_ctx_t *ctx, const efi_guid_t &guid, const char *name) noexcept
+{
+	if (efi_ctx_del_variable(ctx, guid, name) < 0)
+		return detail::fail();
+	return {};
+}
+
+inline result<void>
+del_variable(const efi_guid_t &guid, const char *name) noexcept
+{
+	return del_variable(efi_ctx_default(), guid, name);
+}
+
+/*
+ * Variable enumeration:
+ *
+ *   efivar::variable_names names;
+ *   for (auto &&v : names)
+ *           use(v.guid, v.name);
+ *   if (names.error())
+ *           ...
+ *
+ * The guid and name point into the context's iterator state, so they're
+ * only good until the next increment.  A context has one iterator, so
+ * only one variable_names per context may be live at a time; one that's
+ * destroyed before reaching the end finishes the walk so the next one
+ * starts over.
+ */
+struct variable_name {
+	const efi_guid_t &guid;
+	std::string_view name;
+};
+
+class variable_names {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = variable_name;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() noexcept = default;
+		variable_name operator*() const noexcept
+		{
+			return { *owner_->guid_, owner_->name_ };
+		}
+		iterator &operator++() noexcept
+		{
+			owner_->next();
+			return *this;
+		}
+		void operator++(int) noexcept { ++*this; }
+		bool operator==(std::default_sentinel_t) const noexcept
+		{
+			return !owner_ || owner_->done_;
+		}
+
+	private:
+		friend class variable_names;
+		explicit iterator(variable_names *owner) noexcept
+			: owner_(owner)
+		{ }
+		variable_names *owner_ = nullptr;
+	};
+
+	explicit variable_names(efi_ctx_t *ctx = efi_ctx_default()) noexcept
+		: ctx_(ctx)
+	{ }
+	variable_names(const variable_names &) = delete;
+	variable_names &operator=(const variable_names &) = delete;
+	~variable_names()
+	{
+		while (started_ && !done_)
+			next();
+	}
+
+	iterator begin() noexcept
+	{
+		if (!started_) {
+			started_ = true;
+			next();
+		}
+		return iterator(this);
+	}
+	std::default_sentinel_t end() const noexcept { return {}; }
+
+	/* Set if the walk stopped because of an error. */
+	const std::error_code &error() const noexcept { return ec_; }
+
+private:
+	void next() noexcept
+	{
+		int rc;
+
+		if (done_)
+			return;
+		rc = efi_ctx_get_next_variable_name(ctx_, &guid_, &name_);
+		if (rc <= 0) {
+			if (rc < 0)
+				ec_ = detail::errno_code();
+			done_ = true;
+		}
+	}
+
+	efi_ctx_t *ctx_;
+	efi_guid_t *guid_ = nullptr;
+	char *name_ = nullptr;
+	std::error_code ec_;
+	bool started_ = false;
+	bool done_ = false;
+};
+
+#ifdef EFIVAR_HPP_HAVE_EFIBOOT
+/*
+ * Device paths
+ */
+
+/*
+ * A view of a device path in someone else's buffer.  nodes() walks it
+ * one node at a time, up to the first End Entire node.
+ */
+class device_path_view {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = const_efidp;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() noexcept = default;
+		const_efidp operator*() const noexcept { return node_; }
+		iterator &operator++() noexcept
+		{
+			const_efidp next = nullptr;
+
+			if (efidp_next_node(node_, &next) <= 0)
+				node_ = nullptr;
+			else
+				node_ = next;
+			return *this;
+		}
+		iterator operator++(int) noexcept
+		{
+			iterator old = *this;
+			++*this;
+			return old;
+		}
+		bool operator==(const iterator &) const noexcept = default;
+
+	private:
+		friend class device_path_view;
+		explicit iterator(const_efidp node) noexcept : node_(node) { }
+		const_efidp node_ = nullptr;
+	};
+
+	device_path_view() noexcept = default;
+	explicit device_path_view(std::span<const std::uint8_t> bytes) noexcept
+		: bytes_(bytes)
+	{ }
+
+	bool valid() const noexcept
+	{
+		return !bytes_.empty() &&
+		       efidp_is_valid(dp(), static_cast<ssize_t>(bytes_.size()));
+	}
+	const_efidp dp() const noexcept
+	{
+		return reinterpret_cast<const_efidp>(bytes_.data());
+	}
+	std::span<const std::uint8_t> bytes() const noexcept { return bytes_; }
+
+	/* Only meaningful when valid(). */
+	iterator begin() const noexcept
+	{
+		return iterator(bytes_.empty() ? nullptr : dp());
+	}
+	iterator end() const noexcept { return iterator(); }
+
+	result<std::string> format() const
+	{
+		ssize_t limit = static_cast<ssize_t>(bytes_.size());
+		ssize_t sz;
+		std::string s;
+
+		sz = efidp_format_device_path(nullptr, 0, dp(), limit);
+		if (sz < 0)
+			return detail::fail();
+		s.resize(static_cast<std::size_t>(sz));
+		sz = efidp_format_device_path(
+			reinterpret_cast<unsigned char *>(s.data()),
+			s.size() + 1, dp(), limit);
+		if (sz < 0)
+			return detail::fail();
+		s.resize(std::strlen(s.c_str()));
+		return s;
+	}
+
+private:
+	std::span<const std::uint8_t> bytes_;
+};
+
+/*
+ * Load options
+ */
+
+/*
+ * A view of an EFI_LOAD_OPTION, e.g. the data of a Boot#### variable.
+ * Check valid() before using anything else.
+ */
+class load_option_view {
+public:
+	load_option_view() noexcept = default;
+	explicit load_option_view(std::span<const std::uint8_t> bytes) noexcept
+		: bytes_(bytes)
+	{ }
+
+	bool valid() const noexcept
+	{
+		return !bytes_.empty() &&
+		       efi_loadopt_is_valid(opt(), bytes_.size());
+	}
+	std::uint32_t attributes() const noexcept
+	{
+		return efi_loadopt_attrs(opt());
+	}
+
+	/*
+	 * The UCS-2 description, without its terminating NUL, in place.
+	 * It follows the 32-bit attributes and the 16-bit path length.
+	 * The elements may not be aligned, so read them with memcpy().
+	 */
+	std::span<const std::uint8_t> description() const noexcept
+	{
+		constexpr std::size_t off = 6;
+		std::size_t n = off;
+		std::uint16_t c;
+
+		if (bytes_.size() < off)
+			return {};
+		while (n + sizeof(c) <= bytes_.size()) {
+			std::memcpy(&c, bytes_.data() + n, sizeof(c));
+			if (c == 0)
+				break;
+			n += sizeof(c);
+		}
+		return bytes_.subspan(off, n - off);
+	}
+
+	/*
+	 * The description as UTF-8.  This one has to copy, since
+	 * efi_loadopt_desc() converts into a buffer it reuses.
+	 */
+	std::string description_utf8() const
+	{
+		const unsigned char *p;
+
+		p = efi_loadopt_desc(opt(), static_cast<ssize_t>(bytes_.size()));
+		return p ? std::string(reinterpret_cast<const char *>(p)) : "";
+	}
+
+	device_path_view path() const noexcept
+	{
+		ssize_t limit = static_cast<ssize_t>(bytes_.size());
+		efidp dp = efi_loadopt_path(opt(), limit);
+		std::uint16_t len = efi_loadopt_pathlen(opt(), limit);
+
+		if (!dp)
+			return {};
+		return device_path_view(
+			{ reinterpret_cast<const std::uint8_t *>(dp), len });
+	}
+
+	std::span<const std::uint8_t> optional_data() const noexcept
+	{
+		unsigned char *data = nullptr;
+		std::size_t len = 0;
+
+		if (efi_loadopt_optional_data(opt(), bytes_.size(), &data,
+					      &len) < 0 || !data)
+			return {};
+		return { data, len };
+	}
+
+private:
+	efi_load_option *opt() const noexcept
+	{
+		/* libefiboot doesn't write through these. */
+		return reinterpret_cast<efi_load_option *>(
+			const_cast<std::uint8_t *>(bytes_.data()));
+	}
+	std::span<const std::uint8_t> bytes_;
+};
+#endif /* EFIVAR_HPP_HAVE_EFIBOOT */
+
+#ifdef EFIVAR_HPP_HAVE_EFISEC
+/*
+ * EFI_SIGNATURE_LISTs
+ */
+
+/*
+ * One EFI_SIGNATURE_DATA.  The GUIDs are copied out, since nothing in
+ * an ESL is aligned; data points into the list.
+ */
+struct esl_entry {
+	efi_guid_t type;
+	efi_guid_t owner;
+	std::span<const std::uint8_t> data;
+};
+
+/*
+ * The entries of a buffer of concatenated EFI_SIGNATURE_LISTs, such as
+ * the data of db or dbx, walked in place:
+ *
+ *   efivar::esl_entries entries(var->data);
+ *   for (const auto &e : entries)
+ *           ...
+ *   if (entries.error())
+ *           ...
+ *
+ * The walk stops at the first list that doesn't add up, and error() is
+ * then EINVAL.
+ */
+class esl_entries {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = esl_entry;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() noexcept = default;
+		const esl_entry &operator*() const noexcept { return cur_; }
+		const esl_entry *operator->() const noexcept { return &cur_; }
+		iterator &operator++() noexcept
+		{
+			advance();
+			return *this;
+		}
+		iterator operator++(int) noexcept
+		{
+			iterator old = *this;
+			advance();
+			return old;
+		}
+		bool operator==(const iterator &other) const noexcept
+		{
+			return pos_ == other.pos_;
+		}
+
+	private:
+		friend class esl_entries;
+		iterator(const esl_entries *owner, std::size_t list,
+			 std::size_t pos) noexcept
+			: owner_(owner), list_(list), pos_(pos)
+		{
+			load();
+		}
+
+		/*
+		 * list_ is the offset of the current list, pos_ of the
+		 * current entry; pos_ == npos is the end.
+		 */
+		void load() noexcept
+		{
+			efi_signature_list_t esl;
+			std::span<const std::uint8_t> all = owner_->bytes_;
+
+			while (pos_ != npos) {
+				std::memcpy(&esl, all.data() + list_,
+					    sizeof(esl));
+				std::size_t end = list_ +
+						  esl.signature_list_size;
+				if (pos_ + esl.signature_size <= end) {
+					cur_.type = esl.signature_type;
+					std::memcpy(&cur_.owner,
+						    all.data() + pos_,
+						    sizeof(cur_.owner));
+					cur_.data = all.subspan(
+						pos_ + sizeof(efi_guid_t),
+						esl.signature_size -
+						sizeof(efi_guid_t));
+					return;
+				}
+				/* this list is used up; find the next */
+				list_ = end;
+				pos_ = owner_->first_entry(list_);
+			}
+		}
+
+		void advance() noexcept
+		{
+			efi_signature_list_t esl;
+
+			std::memcpy(&esl, owner_->bytes_.data() + list_,
+				    sizeof(esl));
+			pos_ += esl.signature_size;
+			load();
+		}
+
+		static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+		const esl_entries *owner_ = nullptr;
+		std::size_t list_ = 0;
+		std::size_t pos_ = npos;
+		esl_entry cur_ { };
+	};
+
+	explicit esl_entries(std::span<const std::uint8_t> bytes) noexcept
+		: bytes_(bytes)
+	{ }
+
+	iterator begin() const noexcept
+	{
+		return iterator(this, 0, first_entry(0));
+	}
+	iterator end() const noexcept { return iterator(); }
+	const std::error_code &error() const noexcept { return ec_; }
+
+private:
+	/*
+	 * Check the list at off and return the offset of its first entry,
+	 * or npos at the end of the buffer or on a bad list.
+	 */
+	std::size_t first_entry(std::size_t off) const noexcept
+	{
+		efi_signature_list_t esl;
+
+		if (off == bytes_.size())
+			return iterator::npos;
+		if (bytes_.size() - off < sizeof(esl))
+			return bad();
+		std::memcpy(&esl, bytes_.data() + off, sizeof(esl));
+		if (esl.signature_list_size > bytes_.size() - off ||
+		    esl.signature_size <= sizeof(efi_guid_t) ||
+		    sizeof(esl) + std::size_t(esl.signature_header_size) >
+		    esl.signature_list_size ||
+		    (esl.signature_list_size - sizeof(esl) -
+		     esl.signature_header_size) % esl.signature_size)
+			return bad();
+		return off + sizeof(esl) + esl.signature_header_size;
+	}
+	std::size_t bad() const noexcept
+	{
+		ec_ = detail::errno_code(EINVAL);
+		return iterator::npos;
+	}
+
+	std::span<const std::uint8_t> bytes_;
+	mutable std::error_code ec_;
+};
+
+/*
+ * A move-only owner of an efi_secdb_t.
+ */
+class secdb {
+public:
+	secdb() noexcept = default;
+	secdb(const secdb &) = delete;
+	secdb &operator=(const secdb &) = delete;
+	secdb(secdb &&other) noexcept
+		: db_(std::exchange(other.db_, nullptr))
+	{ }
+	secdb &operator=(secdb &&other) noexcept
+	{
+		if (this != &other) {
+			if (db_)
+				efi_secdb_free(db_);
+			db_ = std::exchange(other.db_, nullptr);
+		}
+		return *this;
+	}
+	~secdb()
+	{
+		if (db_)
+			efi_secdb_free(db_);
+	}
+
+	static secdb adopt(efi_secdb_t *db) noexcept
+	{
+		secdb s;
+		s.db_ = db;
+		return s;
+	}
+	static result<secdb> create() noexcept
+	{
+		efi_secdb_t *db = efi_secdb_new();
+
+		if (!db)
+			return detail::fail();
+		return adopt(db);
+	}
+	/* Any format efi_secdb_parse_any() accepts. */
+	static result<secdb> parse(std::span<std::uint8_t> data) noexcept
+	{
+		efi_secdb_t *db = nullptr;
+
+		if (efi_secdb_parse_any(data.data(), data.size(), &db) < 0)
+			return detail::fail();
+		return adopt(db);
+	}
+
+	efi_secdb_t *get() const noexcept { return db_; }
+	efi_secdb_t *release() noexcept
+	{
+		return std::exchange(db_, nullptr);
+	}
+
+	result<buffer> realize() const noexcept
+	{
+		void *out = nullptr;
+		std::size_t size = 0;
+
+		if (efi_secdb_realize(db_, &out, &size) < 0)
+			return detail::fail();
+		return buffer::adopt(out, size);
+	}
+
+	/*
+	 * Call fn(owner, algorithm, data) for each entry; fn returns
+	 * false to stop early.
+	 */
+	template <typename Fn>
+	result<void> visit(Fn &&fn) const
+	{
+		auto visitor = [](unsigned int, unsigned int,
+				  const efi_guid_t * const owner,
+				  const efi_secdb_type_t algorithm,
+				  const void * const, const std::size_t,
+				  const efi_secdb_data_t * const data,
+				  const std::size_t datasz,
+				  void *closure) -> efi_secdb_visitor_status_t {
+			auto &f = *static_cast<std::remove_reference_t<Fn> *>(
+					closure);
+			std::span<const std::uint8_t> bytes(
+				reinterpret_cast<const std::uint8_t *>(data),
+				datasz);
+			return f(*owner, algorithm, bytes) ? CONTINUE : BREAK;
+		};
+		if (efi_secdb_visit_entries(db_, visitor, &fn) < 0)
+			return detail::fail();
+		return {};
+	}
+
+private:
+	efi_secdb_t *db_ = nullptr;
+};
+#endif /* EFIVAR_HPP_HAVE_EFISEC */
+
+} /* namespace efivar */
+
+#endif /* !EFIVAR_HPP_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,426 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * ledger.c - persistent counts of variable writes
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "efivar.h"
+
+/*
+ * The ledger is a file of records, each appended with a single write()
+ * to a descriptor opened O_APPEND, so writers never need a lock and
+ * never see each other's records interleaved.  A record written by a
+ * single variable write has count 1; compaction replaces runs of them
+ * with one record per (guid, name, executable, operation) holding the
+ * totals.
+ *
+ * Compaction takes a lock on <ledger>.lock so only one process does it
+ * at a time.  Records appended while it runs are copied over before and
+ * after the rename; one landing in the gap between the last copy and
+ * the writer reopening the file can be lost, which is fine for a count
+ * of how hard the flash is being worked.
+ */
+
+#define WRITE_LEDGER_MAGIC	0x67646c65u	/* "eldg" */
+
+struct write_ledger_record {
+	uint32_t magic;
+	uint32_t size;		/* header, name, exe, and padding */
+	uint64_t count;
+	uint64_t bytes;
+	int64_t last;
+	efi_guid_t guid;
+	uint16_t name_len;	/* neither includes a NUL */
+	uint16_t exe_len;
+	uint32_t op;
+};
+
+#define record_size(name_len, exe_len) \
+	ALIGN_UP(sizeof(struct write_ledger_record) + (name_len) + (exe_len), 8)
+
+const char HIDDEN *
+write_ledger_path(void)
+{
+	const char *env = secure_getenv(WRITE_LEDGER_ENV);
+
+	if (!env || !env[0] || !strcmp(env, "0"))
+		return NULL;
+	if (env[0] == '/')
+		return env;
+	return WRITE_LEDGER_DEFAULT_PATH;
+}
+
+static char exe[PATH_MAX];
+static pthread_once_t exe_once = PTHREAD_ONCE_INIT;
+
+static void
+find_exe(void)
+{
+	ssize_t sz;
+
+	sz = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (sz < 0)
+		sz = snprintf(exe, sizeof(exe), "%s",
+			      program_invocation_name);
+	exe[MIN((size_t)sz, sizeof(exe) - 1)] = '\0';
+}
+
+/*
+ * Records that share a key are merged.  Keys go in a guid_map as the
+ * guid plus "op\texe\tname".
+ */
+struct aggregate {
+	struct guid_map map;
+	write_ledger_entry_t **entries;
+	size_t n;
+	size_t alloc;
+};
+
+static int
+aggregate_add(struct aggregate *agg, const struct write_ledger_record *rec,
+	      const char *name, const char *exe_name)
+{
+	write_ledger_entry_t *entry;
+	char *key = NULL;
+	int rc;
+
+	rc = efi_asprintf(&key, "%u\t%.*s\t%.*s", rec->op,
+		      rec->exe_len, exe_name, rec->name_len, name);
+	if (rc < 0) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+
+	entry = guid_map_find(&agg->map, &rec->guid, key);
+	if (entry) {
+		efi_free(key);
+		entry->count += rec->count;
+		entry->bytes += rec->bytes;
+		entry->last = MAX(entry->last, rec->last);
+		return 0;
+	}
+
+	if (agg->n == agg->alloc) {
+		size_t alloc = agg->alloc ? agg->alloc * 2 : 64;
+		write_ledger_entry_t **entries;
+
+		entries = efi_reallocarray(agg->entries, alloc,
+					   sizeof(*entries));
+		if (!entries) {
+			efi_free(key);
+			efi_error("could not allocate memory");
+			return -1;
+		}
+		agg->entries = entries;
+		agg->alloc = alloc;
+	}
+
+	entry = efi_calloc(1, sizeof(*entry));
+	if (!entry) {
+		efi_free(key);
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	entry->guid = rec->guid;
+	entry->name = efi_strndup(name, rec->name_len);
+	entry->exe = efi_strndup(exe_name, rec->exe_len);
+	entry->op = rec->op;
+	entry->count = rec->count;
+	entry->bytes = rec->bytes;
+	entry->last = rec->last;
+	agg->entries[agg->n++] = entry;
+
+	/* the map owns key from here; aggregate_fini() frees it */
+	if (!entry->name || !entry->exe ||
+	    guid_map_insert(&agg->map, &entry->guid, key, entry) < 0) {
+		efi_free(key);
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	return 0;
+}
+
+static void
+aggregate_fini(struct aggregate *agg)
+{
+	for (size_t i = 0; i < agg->map.size; i++)
+		efi_free((char *)agg->map.slots[i].name);
+	guid_map_fini(&agg->map);
+}
+
+/*
+ * Read records from *offset to the end of fd into agg.  *offset is left
+ * after the last whole record, so a record that's still being written
+ * or a torn one at the end isn't counted.
+ */
+static int
+read_records(int fd, off_t *offset, struct aggregate *agg)
+{
+	struct stat sb;
+	uint8_t *buf;
+	size_t bufsz, pos = 0;
+	ssize_t sz;
+	int rc = 0;
+
+	if (fstat(fd, &sb) < 0) {
+		efi_error("could not stat write ledger");
+		return -1;
+	}
+	if (sb.st_size <= *offset)
+		return 0;
+	bufsz = sb.st_size - *offset;
+	buf = efi_malloc(bufsz);
+	if (!buf) {
+		efi_error("could not allocate %zd bytes", bufsz);
+		return -1;
+	}
+	sz = pread(fd, buf, bufsz, *offset);
+	if (sz < 0) {
+		efi_error("could not read write ledger");
+		efi_free(buf);
+		return -1;
+	}
+	bufsz = sz;
+
+	while (bufsz - pos >= sizeof(struct write_ledger_record)) {
+		struct write_ledger_record rec;
+		const char *name;
+
+		memcpy(&rec, buf + pos, sizeof(rec));
+		if (rec.magic != WRITE_LEDGER_MAGIC ||
+		    rec.size != record_size(rec.name_len, rec.exe_len)) {
+			debug("bad write ledger record at %jd",
+			      (intmax_t)(*offset + pos));
+			break;
+		}
+		if (rec.size > bufsz - pos)
+			break;
+
+		name = (const char *)buf + pos + sizeof(rec);
+		rc = aggregate_add(agg, &rec, name, name + rec.name_len);
+		if (rc < 0)
+			break;
+		pos += rec.size;
+	}
+
+	*offset += pos;
+	efi_free(buf);
+	return rc;
+}
+
+static int
+write_entry(int fd, const efi_guid_t *guid, const char *name,
+	    const char *exe_name, write_ledger_op_t op, uint64_t count,
+	    uint64_t bytes, int64_t last)
+{
+	struct write_ledger_record rec;
+	uint8_t buf[record_size(1024, PATH_MAX)];
+	size_t name_len = strnlen(name, 1024);
+	size_t exe_len = strnlen(exe_name, PATH_MAX);
+	ssize_t sz;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = WRITE_LEDGER_MAGIC;
+	rec.size = record_size(name_len, exe_len);
+	rec.count = count;
+	rec.bytes = bytes;
+	rec.last = last;
+	rec.guid = *guid;
+	rec.name_len = name_len;
+	rec.exe_len = exe_len;
+	rec.op = op;
+
+	memset(buf, 0, rec.size);
+	memcpy(buf, &rec, sizeof(rec));
+	memcpy(buf + sizeof(rec), name, name_len);
+	memcpy(buf + sizeof(rec) + name_len, exe_name, exe_len);
+
+	sz = write(fd, buf, rec.size);
+	if (sz < 0)
+		return -1;
+	if ((size_t)sz != rec.size) {
+		errno = ENOSPC;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Copy whatever's past *offset in from to the end of to.
+ */
+static int
+copy_tail(int from, off_t *offset, int to)
+{
+	uint8_t buf[4096];
+	ssize_t sz;
+
+	while ((sz = pread(from, buf, sizeof(buf), *offset)) > 0) {
+		if (write(to, buf, sz) != sz)
+			return -1;
+		*offset += sz;
+	}
+	return sz < 0 ? -1 : 0;
+}
+
+static void
+compact(const char *path)
+{
+	struct aggregate agg;
+	char lockpath[PATH_MAX];
+	char tmppath[PATH_MAX];
+	off_t offset = 0;
+	int lockfd, fd, tmpfd = -1;
+	int rc = -1;
+
+	if (snprintf(lockpath, sizeof(lockpath), "%s.lock", path) >=
+	    (int)sizeof(lockpath) ||
+	    snprintf(tmppath, sizeof(tmppath), "%s.XXXXXX", path) >=
+	    (int)sizeof(tmppath))
+		return;
+
+	lockfd = open(lockpath, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+	if (lockfd < 0)
+		return;
+	if (flock(lockfd, LOCK_EX|LOCK_NB) < 0) {
+		close(lockfd);
+		return;
+	}
+
+	memset(&agg, 0, sizeof(agg));
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0 || guid_map_init(&agg.map, 64) < 0)
+		goto out;
+
+	/* someone else may have just done this */
+	if (lseek(fd, 0, SEEK_END) <= WRITE_LEDGER_COMPACT_SIZE)
+		goto out;
+
+	if (read_records(fd, &offset, &agg) < 0)
+		goto out;
+
+	tmpfd = mkostemp(tmppath, O_APPEND|O_CLOEXEC);
+	if (tmpfd < 0)
+		goto out;
+	for (size_t i = 0; i < agg.n; i++) {
+		write_ledger_entry_t *entry = agg.entries[i];
+
+		if (write_entry(tmpfd, &entry->guid, entry->name, entry->exe,
+				entry->op, entry->count, entry->bytes,
+				entry->last) < 0)
+			goto out;
+	}
+	if (copy_tail(fd, &offset, tmpfd) < 0 ||
+	    fchmod(tmpfd, 0644) < 0 ||
+	    rename(tmppath, path) < 0)
+		goto out;
+	copy_tail(fd, &offset, tmpfd);
+	debug("compacted write ledger %s to %zd records", path, agg.n);
+	rc = 0;
+out:
+	if (tmpfd >= 0) {
+		close(tmpfd);
+		if (rc < 0)
+			unlink(tmppath);
+	}
+	if (fd >= 0)
+		close(fd);
+	write_ledger_free(agg.entries, agg.n);
+	aggregate_fini(&agg);
+	flock(lockfd, LOCK_UN);
+	close(lockfd);
+}
+
+void HIDDEN
+write_ledger_record(write_ledger_op_t op, const efi_guid_t *guid,
+		    const char *name, size_t bytes)
+{
+	const char *path = write_ledger_path();
+	int saved_errno = errno;
+	struct stat sb;
+	int fd;
+
+	if (!path)
+		return;
+
+	pthread_once(&exe_once, find_exe);
+
+	fd = open(path, O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC, 0644);
+	if (fd < 0 && errno == ENOENT &&
+	    !strcmp(path, WRITE_LEDGER_DEFAULT_PATH)) {
+		mkdir("/var/lib/efivar", 0755);
+		fd = open(path, O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC, 0644);
+	}
+	if (fd < 0) {
+		debug("could not open write ledger %s: %m", path);
+		goto out;
+	}
+
+	if (write_entry(fd, guid, name, exe, op, 1, bytes, time(NULL)) < 0)
+		debug("could not write to write ledger %s: %m", path);
+	else if (fstat(fd, &sb) == 0 && sb.st_size > WRITE_LEDGER_COMPACT_SIZE)
+		compact(path);
+	close(fd);
+out:
+	errno = saved_errno;
+}
+
+int HIDDEN
+write_ledger_load(const char *path, write_ledger_entry_t ***entriesp,
+		  size_t *np)
+{
+	struct aggregate agg;
+	off_t offset = 0;
+	int fd, rc;
+
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
+		efi_error("could not open write ledger \"%s\"", path);
+		return -1;
+	}
+
+	memset(&agg, 0, sizeof(agg));
+	rc = guid_map_init(&agg.map, 64);
+	if (rc >= 0)
+		rc = read_records(fd, &offset, &agg);
+	close(fd);
+	aggregate_fini(&agg);
+	if (rc < 0) {
+		write_ledger_free(agg.entries, agg.n);
+		return -1;
+	}
+
+	*entriesp = agg.entries;
+	*np = agg.n;
+	return 0;
+}
+
+void HIDDEN
+write_ledger_free(write_ledger_entry_t **entries, size_t n)
+{
+	if (!entries)
+		return;
+	for (size_t i = 0; i < n; i++) {
+		efi_free(entries[i]->name);
+		efi_free(entries[i]->exe);
+		efi_free(entries[i]);
+	}
+	efi_free(entries);
+}
+
+// vim:fenc=utf-8:tw=75:noet
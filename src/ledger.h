@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * ledger.h - persistent counts of variable writes
+ * Copyright 2026 The efivar Authors
+ */
+#ifndef EFIVAR_LEDGER_H_
+#define EFIVAR_LEDGER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Set LIBEFIVAR_WRITE_LEDGER to 1 to record every variable write made
+ * through efivarfs in /var/lib/efivar/write-ledger, or to a path to record
+ * them there instead.  It's ignored in setuid and setcap programs.
+ */
+#define WRITE_LEDGER_ENV		"LIBEFIVAR_WRITE_LEDGER"
+#define WRITE_LEDGER_DEFAULT_PATH	"/var/lib/efivar/write-ledger"
+
+/*
+ * Once the ledger is bigger than this, the writer that notices folds it
+ * down to one record per variable, executable, and operation.
+ */
+#define WRITE_LEDGER_COMPACT_SIZE	(256 * 1024)
+
+typedef enum {
+	WRITE_LEDGER_SET = 1,
+	WRITE_LEDGER_APPEND,
+	WRITE_LEDGER_DEL,
+} write_ledger_op_t;
+
+typedef struct {
+	efi_guid_t guid;
+	char *name;
+	char *exe;
+	write_ledger_op_t op;
+	uint64_t count;
+	uint64_t bytes;
+	int64_t last;		/* time(2) of the most recent write */
+} write_ledger_entry_t;
+
+/*
+ * The ledger's path if LIBEFIVAR_WRITE_LEDGER turns it on, or else NULL.
+ */
+extern const char HIDDEN *write_ledger_path(void);
+
+/*
+ * Note one write of bytes to guid-name by this process.  This never
+ * fails and never changes errno; if the ledger can't be written, the
+ * write just isn't counted.
+ */
+extern void HIDDEN write_ledger_record(write_ledger_op_t op,
+				       const efi_guid_t *guid,
+				       const char *name, size_t bytes);
+
+/*
+ * Read the ledger at path, merging records for the same variable,
+ * executable, and operation.  *entriesp is an array of *np entries that
+ * must be freed with write_ledger_free().
+ */
+extern int HIDDEN write_ledger_load(const char *path,
+				    write_ledger_entry_t ***entriesp,
+				    size_t *np);
+extern void HIDDEN write_ledger_free(write_ledger_entry_t **entries,
+				     size_t n);
+
+#endif /* !EFIVAR_LEDGER_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -4,6 +4,8 @@
  * Copyright 2012-2013 Red Hat, Inc.
  */
 
+#define EFIVAR_PROBE_SEMAPHORES
+
 #include "fix_coverity.h"
 
 #include <errno.h>
@@ -12,54 +14,246 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "efivar.h"
 
-static int default_probe(void)
+EFIVAR_PROBE_SEMAPHORE(var_op_entry);
+EFIVAR_PROBE_SEMAPHORE(var_op_return);
+
+/*
+ * var_op_entry(op, guid *, name) and var_op_return(op, guid *, name, size,
+ * latency in ns, errno) bracket every efi_var_operations call.  We only
+ * look at the clock when someone is attached to var_op_return.  The same
+ * pair opens and closes the op's span when EFIVAR_TRACE is set.
+ */
+static inline uint64_t
+probe_op_entry(const char *op, const efi_guid_t *guid, const char *name)
+{
+	struct timespec ts;
+
+	if (guid)
+		efi_trace_begin(op, GUID_FORMAT "-%s", GUID_FORMAT_ARGS(guid),
+				name);
+	else
+		efi_trace_begin(op, NULL);
+	EFIVAR_PROBE3(var_op_entry, op, guid, name);
+	if (!EFIVAR_PROBE_ENABLED(var_op_return))
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void
+probe_op_return(const char *op, const efi_guid_t *guid, const char *name,
+		size_t size, uint64_t start, int rc)
+{
+	struct timespec ts;
+	uint64_t latency = 0;
+	int saved_errno = errno;
+
+	efi_trace_end();
+	if (!EFIVAR_PROBE_ENABLED(var_op_return))
+		return;
+	if (start) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		latency = ts.tv_sec * 1000000000ULL + ts.tv_nsec - start;
+	}
+	EFIVAR_PROBE6(var_op_return, op, guid, name, size, latency,
+		      rc < 0 ? saved_errno : 0);
+	errno = saved_errno;
+}
+
+static int
+default_probe(struct efi_ctx *ctx UNUSED)
 {
 	return 1;
 }
 
+static const char *
+default_get_default_path(void)
+{
+	return NULL;
+}
+
 struct efi_var_operations default_ops = {
 		.name = "default",
 		.probe = default_probe,
+		.get_default_path = default_get_default_path,
 	};
 
-struct efi_var_operations *ops = NULL;
+static struct efi_var_operations *ops_list[] = {
+	&efivarfs_ops,
+	&vars_ops,
+	&daemon_ops,
+	&default_ops,
+	NULL
+};
 
-VERSION(_efi_set_variable, _efi_set_variable@libefivar.so.0)
-int NONNULL(2, 3) PUBLIC
-_efi_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
-		  size_t data_size, uint32_t attributes)
+static struct efi_ctx default_ctx = {
+	.ops = &default_ops,
+	.ratelimit = -1,
+	.vars_sixtyfour_bit = -1,
+};
+
+efi_ctx_t PUBLIC *
+efi_ctx_default(void)
+{
+	return &default_ctx;
+}
+
+efi_ctx_t PUBLIC *
+efi_ctx_new(const char *ops_name, const char *path)
+{
+	struct efi_ctx *ctx;
+	size_t len;
+
+	ctx = efi_calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		efi_error("could not allocate memory");
+		return NULL;
+	}
+	ctx->ratelimit = -1;
+	ctx->vars_sixtyfour_bit = -1;
+
+	if (path) {
+		len = strlen(path);
+		if (len == 0) {
+			errno = EINVAL;
+			efi_error("empty variable store path");
+			goto err;
+		}
+		/* backends build paths as "%s%s-%guid", so keep the slash */
+		if (efi_asprintf(&ctx->path, "%s%s", path,
+			     path[len-1] == '/' ? "" : "/") < 0) {
+			efi_error("asprintf failed");
+			ctx->path = NULL;
+			goto err;
+		}
+	}
+
+	for (int i = 0; ops_list[i] != NULL; i++) {
+		if (ops_name != NULL) {
+			if (!strcmp(ops_list[i]->name, ops_name)) {
+				ctx->ops = ops_list[i];
+				break;
+			}
+		} else if (ops_list[i] != &default_ops &&
+			   !ops_list[i]->by_name_only) {
+			ctx->ops = ops_list[i];
+			int rc = ctx->ops->probe(ctx);
+			if (rc > 0)
+				break;
+			efi_error("ops_list[%d]->probe() failed", i);
+			if (ctx->ops->fini)
+				ctx->ops->fini(ctx);
+			ctx->ops = NULL;
+		}
+	}
+	if (!ctx->ops) {
+		errno = ENOENT;
+		if (ops_name)
+			efi_error("no variable backend named \"%s\"", ops_name);
+		else
+			efi_error("no variable backend found for %s",
+				  path ? path : "the default location");
+		goto err;
+	}
+
+	efi_error_clear();
+	return ctx;
+err:
+	efi_ctx_free(ctx);
+	return NULL;
+}
+
+void PUBLIC
+efi_ctx_free(efi_ctx_t *ctx)
+{
+	__typeof__(errno) errno_value = errno;
+
+	if (!ctx || ctx == &default_ctx)
+		return;
+
+	if (ctx->ops && ctx->ops->fini)
+		ctx->ops->fini(ctx);
+	if (ctx->dir)
+		closedir(ctx->dir);
+	efi_free(ctx->path);
+	efi_free(ctx);
+	errno = errno_value;
+}
+
+static void DESTRUCTOR
+libefivar_fini(void)
+{
+	if (default_ctx.ops->fini)
+		default_ctx.ops->fini(&default_ctx);
+	if (default_ctx.dir) {
+		closedir(default_ctx.dir);
+		default_ctx.dir = NULL;
+	}
+}
+
+const char NONNULL(1) PUBLIC *
+efi_ctx_get_ops_name(efi_ctx_t *ctx)
+{
+	return ctx->ops->name;
+}
+
+const char NONNULL(1) PUBLIC *
+efi_ctx_get_path(efi_ctx_t *ctx)
+{
+	return ctx_path(ctx);
+}
+
+int NONNULL(1) PUBLIC
+efi_ctx_set_ratelimit(efi_ctx_t *ctx, long usecs)
 {
+	ctx->ratelimit = usecs < 0 ? -1 : usecs;
+	return 0;
+}
+
+int NONNULL(1, 3, 4) PUBLIC
+efi_ctx_set_variable(efi_ctx_t *ctx, efi_guid_t guid, const char *name,
+		     const uint8_t *data, size_t data_size,
+		     uint32_t attributes, mode_t mode)
+{
+	uint64_t start;
 	int rc;
-	if (!ops->set_variable) {
+	if (!ctx->ops->set_variable) {
 		efi_error("set_variable() is not implemented");
 		errno = ENOSYS;
 		return -1;
 	}
-	rc = ops->set_variable(guid, name, data, data_size, attributes, 0600);
+	start = probe_op_entry("set_variable", &guid, name);
+	rc = ctx->ops->set_variable(ctx, guid, name, data, data_size,
+				    attributes, mode);
+	probe_op_return("set_variable", &guid, name, data_size, start, rc);
 	if (rc < 0)
 		efi_error("ops->set_variable() failed");
+	else
+		efi_error_clear();
 	return rc;
 }
 
+VERSION(_efi_set_variable, _efi_set_variable@libefivar.so.0)
+int NONNULL(2, 3) PUBLIC
+_efi_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
+		  size_t data_size, uint32_t attributes)
+{
+	return efi_ctx_set_variable(&default_ctx, guid, name, data, data_size,
+				    attributes, 0600);
+}
+
 VERSION(_efi_set_variable_variadic, efi_set_variable@libefivar.so.0)
 int NONNULL(2, 3) PUBLIC
 _efi_set_variable_variadic(efi_guid_t guid, const char *name, const uint8_t *data,
 			   size_t data_size, uint32_t attributes, ...)
 {
-	int rc;
-	if (!ops->set_variable) {
-		efi_error("set_variable() is not implemented");
-		errno = ENOSYS;
-		return -1;
-	}
-	rc = ops->set_variable(guid, name, data, data_size, attributes, 0600);
-	if (rc < 0)
-		efi_error("ops->set_variable() failed");
-	return rc;
+	return efi_ctx_set_variable(&default_ctx, guid, name, data, data_size,
+				    attributes, 0600);
 }
 
 VERSION(_efi_set_variable_mode,efi_set_variable@@LIBEFIVAR_0.24)
@@ -67,18 +261,8 @@ int NONNULL(2, 3) PUBLIC
 _efi_set_variable_mode(efi_guid_t guid, const char *name, const uint8_t *data,
 		       size_t data_size, uint32_t attributes, mode_t mode)
 {
-	int rc;
-	if (!ops->set_variable) {
-		efi_error("set_variable() is not implemented");
-		errno = ENOSYS;
-		return -1;
-	}
-	rc = ops->set_variable(guid, name, data, data_size, attributes, mode);
-	if (rc < 0)
-		efi_error("ops->set_variable() failed");
-	else
-		efi_error_clear();
-	return rc;
+	return efi_ctx_set_variable(&default_ctx, guid, name, data, data_size,
+				    attributes, mode);
 }
 
 int NONNULL(2, 3) PUBLIC
@@ -86,21 +270,29 @@ efi_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
 		 size_t data_size, uint32_t attributes, mode_t mode)
 	ALIAS(_efi_set_variable_mode);
 
-int NONNULL(2, 3) PUBLIC
-efi_append_variable(efi_guid_t guid, const char *name, const uint8_t *data,
-			size_t data_size, uint32_t attributes)
+int NONNULL(1, 3, 4) PUBLIC
+efi_ctx_append_variable(efi_ctx_t *ctx, efi_guid_t guid, const char *name,
+			const uint8_t *data, size_t data_size,
+			uint32_t attributes)
 {
+	uint64_t start;
 	int rc;
-	if (!ops->append_variable) {
-		rc = generic_append_variable(guid, name, data, data_size,
+
+	start = probe_op_entry("append_variable", &guid, name);
+	if (!ctx->ops->append_variable) {
+		rc = generic_append_variable(ctx, guid, name, data, data_size,
 					     attributes);
+		probe_op_return("append_variable", &guid, name, data_size,
+				start, rc);
 		if (rc < 0)
 			efi_error("generic_append_variable() failed");
 		else
 			efi_error_clear();
 		return rc;
 	}
-	rc = ops->append_variable(guid, name, data, data_size, attributes);
+	rc = ctx->ops->append_variable(ctx, guid, name, data, data_size,
+				       attributes);
+	probe_op_return("append_variable", &guid, name, data_size, start, rc);
 	if (rc < 0)
 		efi_error("ops->append_variable() failed");
 	else
@@ -108,16 +300,27 @@ efi_append_variable(efi_guid_t guid, const char *name, const uint8_t *data,
 	return rc;
 }
 
-int NONNULL(2) PUBLIC
-efi_del_variable(efi_guid_t guid, const char *name)
+int NONNULL(2, 3) PUBLIC
+efi_append_variable(efi_guid_t guid, const char *name, const uint8_t *data,
+			size_t data_size, uint32_t attributes)
+{
+	return efi_ctx_append_variable(&default_ctx, guid, name, data,
+				       data_size, attributes);
+}
+
+int NONNULL(1, 3) PUBLIC
+efi_ctx_del_variable(efi_ctx_t *ctx, efi_guid_t guid, const char *name)
 {
+	uint64_t start;
 	int rc;
-	if (!ops->del_variable) {
+	if (!ctx->ops->del_variable) {
 		efi_error("del_variable() is not implemented");
 		errno = ENOSYS;
 		return -1;
 	}
-	rc = ops->del_variable(guid, name);
+	start = probe_op_entry("del_variable", &guid, name);
+	rc = ctx->ops->del_variable(ctx, guid, name);
+	probe_op_return("del_variable", &guid, name, 0, start, rc);
 	if (rc < 0)
 		efi_error("ops->del_variable() failed");
 	else
@@ -125,17 +328,28 @@ efi_del_variable(efi_guid_t guid, const char *name)
 	return rc;
 }
 
-int NONNULL(2, 3, 4, 5) PUBLIC
-efi_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
-		  size_t *data_size, uint32_t *attributes)
+int NONNULL(2) PUBLIC
+efi_del_variable(efi_guid_t guid, const char *name)
+{
+	return efi_ctx_del_variable(&default_ctx, guid, name);
+}
+
+int NONNULL(1, 3, 4, 5, 6) PUBLIC
+efi_ctx_get_variable(efi_ctx_t *ctx, efi_guid_t guid, const char *name,
+		     uint8_t **data, size_t *data_size, uint32_t *attributes)
 {
+	uint64_t start;
 	int rc;
-	if (!ops->get_variable) {
+	if (!ctx->ops->get_variable) {
 		efi_error("get_variable() is not implemented");
 		errno = ENOSYS;
 		return -1;
 	}
-	rc = ops->get_variable(guid, name, data, data_size, attributes);
+	start = probe_op_entry("get_variable", &guid, name);
+	rc = ctx->ops->get_variable(ctx, guid, name, data, data_size,
+				    attributes);
+	probe_op_return("get_variable", &guid, name, rc < 0 ? 0 : *data_size,
+			start, rc);
 	if (rc < 0)
 		efi_error("ops->get_variable failed");
 	else
@@ -143,17 +357,29 @@ efi_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 	return rc;
 }
 
-int NONNULL(2, 3) PUBLIC
-efi_get_variable_attributes(efi_guid_t guid, const char *name,
-			    uint32_t *attributes)
+int NONNULL(2, 3, 4, 5) PUBLIC
+efi_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
+		  size_t *data_size, uint32_t *attributes)
 {
+	return efi_ctx_get_variable(&default_ctx, guid, name, data, data_size,
+				    attributes);
+}
+
+int NONNULL(1, 3, 4) PUBLIC
+efi_ctx_get_variable_attributes(efi_ctx_t *ctx, efi_guid_t guid,
+				const char *name, uint32_t *attributes)
+{
+	uint64_t start;
 	int rc;
-	if (!ops->get_variable_attributes) {
+	if (!ctx->ops->get_variable_attributes) {
 		efi_error("get_variable_attributes() is not implemented");
 		errno = ENOSYS;
 		return -1;
 	}
-	rc = ops->get_variable_attributes(guid, name, attributes);
+	start = probe_op_entry("get_variable_attributes", &guid, name);
+	rc = ctx->ops->get_variable_attributes(ctx, guid, name, attributes);
+	probe_op_return("get_variable_attributes", &guid, name, 0, start,
+			rc);
 	if (rc < 0)
 		efi_error("ops->get_variable_attributes() failed");
 	else
@@ -161,23 +387,43 @@ efi_get_variable_attributes(efi_guid_t guid, const char *name,
 	return rc;
 }
 
+int NONNULL(2, 3) PUBLIC
+efi_get_variable_attributes(efi_guid_t guid, const char *name,
+			    uint32_t *attributes)
+{
+	return efi_ctx_get_variable_attributes(&default_ctx, guid, name,
+					       attributes);
+}
+
+int NONNULL(1, 3) PUBLIC
+efi_ctx_get_variable_exists(efi_ctx_t *ctx, efi_guid_t guid, const char *name)
+{
+	uint32_t unused_attributes = 0;
+	return efi_ctx_get_variable_attributes(ctx, guid, name,
+					       &unused_attributes);
+}
+
 int NONNULL(2) PUBLIC
 efi_get_variable_exists(efi_guid_t guid, const char *name)
 {
-	uint32_t unused_attributes = 0;
-	return efi_get_variable_attributes(guid, name, &unused_attributes);
+	return efi_ctx_get_variable_exists(&default_ctx, guid, name);
 }
 
-int NONNULL(2, 3) PUBLIC
-efi_get_variable_size(efi_guid_t guid, const char *name, size_t *size)
+int NONNULL(1, 3, 4) PUBLIC
+efi_ctx_get_variable_size(efi_ctx_t *ctx, efi_guid_t guid, const char *name,
+			  size_t *size)
 {
+	uint64_t start;
 	int rc;
-	if (!ops->get_variable_size) {
+	if (!ctx->ops->get_variable_size) {
 		efi_error("get_variable_size() is not implemented");
 		errno = ENOSYS;
 		return -1;
 	}
-	rc = ops->get_variable_size(guid, name, size);
+	start = probe_op_entry("get_variable_size", &guid, name);
+	rc = ctx->ops->get_variable_size(ctx, guid, name, size);
+	probe_op_return("get_variable_size", &guid, name, rc < 0 ? 0 : *size,
+			start, rc);
 	if (rc < 0)
 		efi_error("ops->get_variable_size() failed");
 	else
@@ -185,16 +431,26 @@ efi_get_variable_size(efi_guid_t guid, const char *name, size_t *size)
 	return rc;
 }
 
-int NONNULL(1, 2) PUBLIC
-efi_get_next_variable_name(efi_guid_t **guid, char **name)
+int NONNULL(2, 3) PUBLIC
+efi_get_variable_size(efi_guid_t guid, const char *name, size_t *size)
 {
+	return efi_ctx_get_variable_size(&default_ctx, guid, name, size);
+}
+
+int NONNULL(1, 2, 3) PUBLIC
+efi_ctx_get_next_variable_name(efi_ctx_t *ctx, efi_guid_t **guid, char **name)
+{
+	uint64_t start;
 	int rc;
-	if (!ops->get_next_variable_name) {
+	if (!ctx->ops->get_next_variable_name) {
 		efi_error("get_next_variable_name() is not implemented");
 		errno = ENOSYS;
 		return -1;
 	}
-	rc = ops->get_next_variable_name(guid, name);
+	start = probe_op_entry("get_next_variable_name", NULL, NULL);
+	rc = ctx->ops->get_next_variable_name(ctx, guid, name);
+	probe_op_return("get_next_variable_name", rc > 0 ? *guid : NULL,
+			rc > 0 ? *name : NULL, 0, start, rc);
 	if (rc < 0)
 		efi_error("ops->get_next_variable_name() failed");
 	else
@@ -202,16 +458,26 @@ efi_get_next_variable_name(efi_guid_t **guid, char **name)
 	return rc;
 }
 
-int NONNULL(2) PUBLIC
-efi_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
+int NONNULL(1, 2) PUBLIC
+efi_get_next_variable_name(efi_guid_t **guid, char **name)
+{
+	return efi_ctx_get_next_variable_name(&default_ctx, guid, name);
+}
+
+int NONNULL(1, 3) PUBLIC
+efi_ctx_chmod_variable(efi_ctx_t *ctx, efi_guid_t guid, const char *name,
+		       mode_t mode)
 {
+	uint64_t start;
 	int rc;
-	if (!ops->chmod_variable) {
+	if (!ctx->ops->chmod_variable) {
 		efi_error("chmod_variable() is not implemented");
 		errno = ENOSYS;
 		return -1;
 	}
-	rc = ops->chmod_variable(guid, name, mode);
+	start = probe_op_entry("chmod_variable", &guid, name);
+	rc = ctx->ops->chmod_variable(ctx, guid, name, mode);
+	probe_op_return("chmod_variable", &guid, name, 0, start, rc);
 	if (rc < 0)
 		efi_error("ops->chmod_variable() failed");
 	else
@@ -219,25 +485,31 @@ efi_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
 	return rc;
 }
 
-int PUBLIC
-efi_variables_supported(void)
+int NONNULL(2) PUBLIC
+efi_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
 {
-	if (ops == &default_ops)
+	return efi_ctx_chmod_variable(&default_ctx, guid, name, mode);
+}
+
+int NONNULL(1) PUBLIC
+efi_ctx_variables_supported(efi_ctx_t *ctx)
+{
+	if (ctx->ops == &default_ops)
 		return 0;
 	return 1;
 }
 
+int PUBLIC
+efi_variables_supported(void)
+{
+	return efi_ctx_variables_supported(&default_ctx);
+}
+
 static void CONSTRUCTOR libefivar_init(void);
 
 static void CONSTRUCTOR
 libefivar_init(void)
 {
-	struct efi_var_operations *ops_list[] = {
-		&efivarfs_ops,
-		&vars_ops,
-		&default_ops,
-		NULL
-	};
 	char *ops_name = getenv("LIBEFIVAR_OPS");
 	if (ops_name && strcasestr(ops_name, "help")) {
 		printf("LIBEFIVAR_OPS operations available:\n");
@@ -251,16 +523,18 @@ libefivar_init(void)
 		if (ops_name != NULL) {
 			if (!strcmp(ops_list[i]->name, ops_name) ||
 					!strcmp(ops_list[i]->name, "default")) {
-				ops = ops_list[i];
+				default_ctx.ops = ops_list[i];
 				break;
 			}
-		} else {
-			int rc = ops_list[i]->probe();
+		} else if (!ops_list[i]->by_name_only) {
+			default_ctx.ops = ops_list[i];
+			int rc = ops_list[i]->probe(&default_ctx);
 			if (rc <= 0) {
 				efi_error("ops_list[%d]->probe() failed", i);
+				if (ops_list[i]->fini)
+					ops_list[i]->fini(&default_ctx);
 			} else {
 				efi_error_clear();
-				ops = ops_list[i];
 				break;
 			}
 		}
@@ -9,7 +9,9 @@
 
 #include <dirent.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <stddef.h>
 
@@ -23,29 +25,101 @@ struct efi_variable {
 	size_t data_size;
 };
 
+struct efi_ctx;
+
+#define EFIVARFS_IMMUTABLE_SLOTS	64
+
 struct efi_var_operations {
 	char name[NAME_MAX];
-	int (*probe)(void);
-	int (*set_variable)(efi_guid_t guid, const char *name, const uint8_t *data,
+	int (*probe)(struct efi_ctx *ctx);
+	const char *(*get_default_path)(void);
+	int (*set_variable)(struct efi_ctx *ctx, efi_guid_t guid,
+			    const char *name, const uint8_t *data,
 			    size_t data_size, uint32_t attributes, mode_t mode);
-	int (*del_variable)(efi_guid_t guid, const char *name);
-	int (*get_variable)(efi_guid_t guid, const char *name, uint8_t **data,
+	int (*del_variable)(struct efi_ctx *ctx, efi_guid_t guid,
+			    const char *name);
+	int (*get_variable)(struct efi_ctx *ctx, efi_guid_t guid,
+			    const char *name, uint8_t **data,
 			    size_t *data_size, uint32_t *attributes);
-	int (*get_variable_attributes)(efi_guid_t guid, const char *name,
-				       uint32_t *attributes);
-	int (*get_variable_size)(efi_guid_t guid, const char *name,
-				 size_t *size);
-	int (*get_next_variable_name)(efi_guid_t **guid, char **name);
-	int (*append_variable)(efi_guid_t guid, const char *name,
-			       const uint8_t *data, size_t data_size,
-			       uint32_t attributes);
-	int (*chmod_variable)(efi_guid_t guid, const char *name, mode_t mode);
+	int (*get_variable_attributes)(struct efi_ctx *ctx, efi_guid_t guid,
+				       const char *name, uint32_t *attributes);
+	int (*get_variable_size)(struct efi_ctx *ctx, efi_guid_t guid,
+				 const char *name, size_t *size);
+	int (*get_next_variable_name)(struct efi_ctx *ctx, efi_guid_t **guid,
+				      char **name);
+	int (*append_variable)(struct efi_ctx *ctx, efi_guid_t guid,
+			       const char *name, const uint8_t *data,
+			       size_t data_size, uint32_t attributes);
+	int (*chmod_variable)(struct efi_ctx *ctx, efi_guid_t guid,
+			      const char *name, mode_t mode);
+	void (*fini)(struct efi_ctx *ctx);
+	/* only used when asked for by name, never probed for */
+	bool by_name_only;
+};
+
+/*
+ * Everything that's specific to one variable store.  The default context
+ * lives in lib.c and backs the plain efi_*() API; others come from
+ * efi_ctx_new().
+ */
+struct efi_ctx {
+	struct efi_var_operations *ops;
+	char *path;			/* NULL means ops->get_default_path() */
+	long ratelimit;			/* usecs per read; < 0 means auto */
+
+	/* generic_get_next_variable_name() state */
+	DIR *dir;
+	efi_guid_t next_guid;
+	char next_name[NAME_MAX+1];
+
+	/* vars backend: -1 until is_64bit() has looked */
+	int vars_sixtyfour_bit;
+
+	/* efivarfs backend: which variables we've seen to be immutable */
+	uint64_t efivarfs_immutable[EFIVARFS_IMMUTABLE_SLOTS];
+
+	/* anything else a backend needs; released by ops->fini() */
+	void *priv;
 };
 
+static inline const char UNUSED *
+ctx_path(struct efi_ctx *ctx)
+{
+	if (ctx->path)
+		return ctx->path;
+	return ctx->ops->get_default_path();
+}
+
+static inline useconds_t UNUSED
+ctx_ratelimit(struct efi_ctx *ctx)
+{
+	if (ctx->ratelimit >= 0)
+		return ctx->ratelimit;
+
+	/*
+	 * The kernel rate limiter hits us if we go faster than 100 efi
+	 * variable reads per second as non-root.  So if we're not root, just
+	 * delay this long after each read.  The user is not going to notice.
+	 *
+	 * 1s / 100 = 10000us.
+	 */
+	return geteuid() == 0 ? 0 : 10000;
+}
+
+static inline void UNUSED
+ratelimit_sleep(useconds_t ratelimit)
+{
+	EFIVAR_PROBE1(ratelimit_sleep, ratelimit);
+	efi_trace_begin("ratelimit_sleep", "%u us", ratelimit);
+	usleep(ratelimit);
+	efi_trace_end();
+}
+
 typedef unsigned long efi_status_t;
 
 extern struct efi_var_operations vars_ops;
 extern struct efi_var_operations efivarfs_ops;
+extern struct efi_var_operations daemon_ops;
 
 #endif /* LIBEFIVAR_LIB_H */
 
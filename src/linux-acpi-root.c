@@ -78,7 +78,7 @@ parse_acpi_root(struct device *dev, const char *path, const char *root UNUSED)
 	debug("current:'%s' rc:%d pos0:%d pos1:%d", current, rc, pos0, pos1);
 	dbgmk("         ", pos0, pos1);
 
-	dev->acpi_root.acpi_hid_str = strndup(current, pos1 + 1);
+	dev->acpi_root.acpi_hid_str = efi_strndup(current, pos1 + 1);
 	if (!dev->acpi_root.acpi_hid_str) {
 		efi_error("Could not allocate memory");
 		return -1;
@@ -39,7 +39,7 @@ parse_acpi_hid_uid(struct device *dev, const char *fmt, ...)
 		size_t l = strlen(fbuf);
 		if (l > 1) {
 			fbuf[l-1] = 0;
-			dev->acpi_root.acpi_cid_str = strdup(fbuf);
+			dev->acpi_root.acpi_cid_str = efi_strdup(fbuf);
 			debug("Setting ACPI root path to '%s'", fbuf);
 		}
 	}
@@ -93,7 +93,7 @@ hid_err:
 			int l = strlen((char *)fbuf);
 			if (l >= 1) {
 				fbuf[l-1] = '\0';
-				dev->acpi_root.acpi_uid_str = strdup(fbuf);
+				dev->acpi_root.acpi_uid_str = efi_strdup(fbuf);
 			}
 		}
 	}
@@ -87,7 +87,7 @@ make_part_name(struct device *dev)
 	if (dev->part < 1)
 	        return NULL;
 
-	rc = asprintf(&ret, "%sp%d", dev->disk_name, dev->part);
+	rc = efi_asprintf(&ret, "%sp%d", dev->disk_name, dev->part);
 	if (rc < 0) {
 	        efi_error("could not allocate memory");
 	        return NULL;
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * linux-net.c - network interface discovery through netlink
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/if_addr.h>
+#include <linux/if_arp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "efiboot.h"
+
+/*
+ * Gather every interface's link type, hardware address, and first global
+ * IPv4 and IPv6 address with one RTM_GETLINK and one RTM_GETADDR dump,
+ * rather than a round of ioctls per interface.
+ */
+
+struct net_state {
+	struct net_interface *ifaces;
+	size_t n_ifaces;
+};
+
+typedef int (*netlink_cb_t)(struct nlmsghdr *nh, struct net_state *state);
+
+static struct net_interface *
+find_iface(struct net_state *state, int ifindex)
+{
+	for (size_t i = 0; i < state->n_ifaces; i++)
+		if (state->ifaces[i].ifindex == ifindex)
+			return &state->ifaces[i];
+	return NULL;
+}
+
+static int
+add_link(struct nlmsghdr *nh, struct net_state *state)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(nh);
+	struct net_interface *iface;
+	struct rtattr *rta;
+	int len;
+
+	if (nh->nlmsg_type != RTM_NEWLINK)
+		return 0;
+	if (ifi->ifi_type == ARPHRD_LOOPBACK)
+		return 0;
+
+	iface = efi_reallocarray(state->ifaces, state->n_ifaces + 1,
+				 sizeof(*iface));
+	if (!iface) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	state->ifaces = iface;
+	iface = &state->ifaces[state->n_ifaces];
+	memset(iface, 0, sizeof(*iface));
+	iface->ifindex = ifi->ifi_index;
+	iface->link_type = ifi->ifi_type;
+
+	len = IFLA_PAYLOAD(nh);
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		size_t sz = RTA_PAYLOAD(rta);
+
+		switch (rta->rta_type) {
+		case IFLA_IFNAME:
+			if (sz > sizeof(iface->ifname))
+				sz = sizeof(iface->ifname);
+			memcpy(iface->ifname, RTA_DATA(rta), sz);
+			iface->ifname[sizeof(iface->ifname) - 1] = '\0';
+			break;
+		case IFLA_ADDRESS:
+			if (sz > sizeof(iface->mac_addr))
+				sz = sizeof(iface->mac_addr);
+			memcpy(iface->mac_addr, RTA_DATA(rta), sz);
+			iface->mac_addr_len = sz;
+			break;
+		}
+	}
+
+	debug("link %d %s type:%hu mac_addr_len:%zd", iface->ifindex,
+	      iface->ifname, iface->link_type, iface->mac_addr_len);
+	state->n_ifaces += 1;
+	return 0;
+}
+
+static int
+add_addr(struct nlmsghdr *nh, struct net_state *state)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+	struct net_interface *iface;
+	struct rtattr *rta;
+	const uint8_t *addr = NULL, *local = NULL;
+	uint32_t flags = ifa->ifa_flags;
+	int len;
+
+	if (nh->nlmsg_type != RTM_NEWADDR)
+		return 0;
+	if (ifa->ifa_scope != RT_SCOPE_UNIVERSE)
+		return 0;
+
+	iface = find_iface(state, ifa->ifa_index);
+	if (!iface)
+		return 0;
+
+	len = IFA_PAYLOAD(nh);
+	for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case IFA_ADDRESS:
+			addr = RTA_DATA(rta);
+			break;
+		case IFA_LOCAL:
+			local = RTA_DATA(rta);
+			break;
+		case IFA_FLAGS:
+			memcpy(&flags, RTA_DATA(rta), sizeof(flags));
+			break;
+		}
+	}
+	/* on point-to-point links IFA_ADDRESS is the peer */
+	if (local)
+		addr = local;
+	if (!addr)
+		return 0;
+
+	if (ifa->ifa_family == AF_INET && !iface->has_ipv4) {
+		uint32_t ipv4;
+
+		memcpy(&ipv4, addr, sizeof(ipv4));
+		iface->ipv4_addr = ntohl(ipv4);
+		iface->ipv4_prefix_len = ifa->ifa_prefixlen;
+		iface->ipv4_static = !!(flags & IFA_F_PERMANENT);
+		iface->has_ipv4 = true;
+	} else if (ifa->ifa_family == AF_INET6 && !iface->has_ipv6) {
+		memcpy(iface->ipv6_addr, addr, sizeof(iface->ipv6_addr));
+		iface->ipv6_prefix_len = ifa->ifa_prefixlen;
+		iface->ipv6_origin = (flags & IFA_F_PERMANENT)
+					? EFIDP_IPv6_ORIGIN_STATIC
+					: EFIDP_IPv6_ORIGIN_AUTOCONF;
+		iface->has_ipv6 = true;
+	}
+	return 0;
+}
+
+static int
+netlink_dump(int fd, uint16_t type, uint32_t seq, netlink_cb_t cb,
+	     struct net_state *state)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct rtgenmsg g;
+	} req;
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK, };
+	uint8_t buf[16384] __attribute__((__aligned__(NLMSG_ALIGNTO)));
+	ssize_t rc;
+
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.g));
+	req.nh.nlmsg_type = type;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.nh.nlmsg_seq = seq;
+	req.g.rtgen_family = AF_UNSPEC;
+
+	rc = sendto(fd, &req, req.nh.nlmsg_len, 0,
+		    (struct sockaddr *)&sa, sizeof(sa));
+	if (rc < 0) {
+		efi_error("could not send netlink request");
+		return -1;
+	}
+
+	while (true) {
+		struct nlmsghdr *nh;
+		int len;
+
+		rc = recv(fd, buf, sizeof(buf), 0);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			efi_error("could not read netlink reply");
+			return -1;
+		}
+		len = rc;
+
+		for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+		     nh = NLMSG_NEXT(nh, len)) {
+			if (nh->nlmsg_seq != seq)
+				continue;
+			if (nh->nlmsg_type == NLMSG_DONE)
+				return 0;
+			if (nh->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *e = NLMSG_DATA(nh);
+
+				errno = -e->error;
+				efi_error("netlink dump failed");
+				return -1;
+			}
+			if (cb(nh, state) < 0)
+				return -1;
+		}
+	}
+}
+
+int HIDDEN
+get_net_interfaces(struct net_interface **ifaces, size_t *n_ifaces)
+{
+	struct net_state state = { NULL, 0 };
+	int fd, rc = -1;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd < 0) {
+		efi_error("could not open netlink socket");
+		return -1;
+	}
+
+	if (netlink_dump(fd, RTM_GETLINK, 1, add_link, &state) < 0 ||
+	    netlink_dump(fd, RTM_GETADDR, 2, add_addr, &state) < 0) {
+		efi_free(state.ifaces);
+		goto err;
+	}
+
+	*ifaces = state.ifaces;
+	*n_ifaces = state.n_ifaces;
+	rc = 0;
+err:
+	close(fd);
+	return rc;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -59,10 +59,10 @@ parse_pci(struct device *dev, const char *path, const char *root)
 
 	        debug("found pci domain %04hx:%02hhx:%02hhx.%02hhx",
 	              domain, bus, device, function);
-	        pci_dev = realloc(dev->pci_dev,
+	        pci_dev = efi_realloc(dev->pci_dev,
 	                          sizeof(*pci_dev) * (i + 1));
 	        if (!pci_dev) {
-	                efi_error("realloc(%p, %zd * (%d + 1)) failed",
+	                efi_error("efi_realloc(%p, %zd * (%d + 1)) failed",
 	                          dev->pci_dev, sizeof(*pci_dev), i);
 	                return -1;
 	        }
@@ -72,7 +72,7 @@ parse_pci(struct device *dev, const char *path, const char *root)
 	        dev->pci_dev[i].pci_bus = bus;
 	        dev->pci_dev[i].pci_device = device;
 	        dev->pci_dev[i].pci_function = function;
-	        char *tmp = strndup(root, current-root+1);
+	        char *tmp = efi_strndup(root, current-root+1);
 	        char *linkbuf = NULL;
 	        if (!tmp) {
 	                efi_error("could not allocate memory");
@@ -88,14 +88,14 @@ parse_pci(struct device *dev, const char *path, const char *root)
 	                rc = sysfs_readlink(&linkbuf, "class/block/%s/driver", tmp);
 	                if (rc < 0 || !linkbuf) {
 	                        efi_error("Could not find driver for pci device %s", tmp);
-	                        free(tmp);
+	                        efi_free(tmp);
 	                        return -1;
 	                } else {
-	                        dev->pci_dev[i].driverlink = strdup(linkbuf);
+	                        dev->pci_dev[i].driverlink = efi_strdup(linkbuf);
 	                        debug("driver:%s\n", linkbuf);
 	                }
 	        }
-	        free(tmp);
+	        efi_free(tmp);
 	        dev->n_pci_devs += 1;
 	}
 
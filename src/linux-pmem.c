@@ -115,7 +115,7 @@ parse_pmem(struct device *dev, const char *path, const char *root UNUSED)
 	filebuf = NULL;
 	debug("nvdimm namespace is '%s'", namespace);
 	rc = read_sysfs_file(&filebuf, "bus/nd/devices/%s/uuid", namespace);
-	free(namespace);
+	efi_free(namespace);
 	if (rc < 0 || filebuf == NULL)
 	        return -1;
 
@@ -30,6 +30,22 @@
 
 #include "efiboot.h"
 
+const char HIDDEN *
+sysfs_path(void)
+{
+	const char *path = secure_getenv(SYSFS_ENV);
+
+	return (path && path[0]) ? path : "/sys";
+}
+
+const char HIDDEN *
+devfs_path(void)
+{
+	const char *path = secure_getenv(DEVFS_ENV);
+
+	return (path && path[0]) ? path : "/dev";
+}
+
 int HIDDEN
 find_parent_devpath(const char * const child, char **parent)
 {
@@ -62,7 +78,7 @@ find_parent_devpath(const char * const child, char **parent)
 	node++;
 
 	/* write out new path */
-	ret = asprintf(parent, "/dev/%s", node);
+	ret = efi_asprintf(parent, "/dev/%s", node);
 	if (ret < 0)
 	        return ret;
 
@@ -80,7 +96,7 @@ set_part_name(struct device *dev, const char * const fmt, ...)
 	        return 0;
 
 	va_start(ap, fmt);
-	rc = vasprintf(&dev->part_name, fmt, ap);
+	rc = efi_vasprintf(&dev->part_name, fmt, ap);
 	error = errno;
 	va_end(ap);
 	errno = error;
@@ -97,7 +113,7 @@ reset_part_name(struct device *dev)
 	int rc;
 
 	if (dev->part_name) {
-	        free(dev->part_name);
+	        efi_free(dev->part_name);
 	        dev->part_name = NULL;
 	}
 
@@ -111,7 +127,7 @@ reset_part_name(struct device *dev)
 	        dev->part_name = part;
 	        rc = 0;
 	} else {
-	        rc = asprintf(&dev->part_name, "%s%d",
+	        rc = efi_asprintf(&dev->part_name, "%s%d",
 	                      dev->disk_name, dev->part);
 	        if (rc < 0)
 	                efi_error("could not allocate memory");
@@ -143,7 +159,7 @@ set_disk_name(struct device *dev, const char * const fmt, ...)
 	int error;
 
 	va_start(ap, fmt);
-	rc = vasprintf(&dev->disk_name, fmt, ap);
+	rc = efi_vasprintf(&dev->disk_name, fmt, ap);
 	error = errno;
 	va_end(ap);
 	errno = error;
@@ -284,43 +300,43 @@ device_free(struct device *dev)
 	if (!dev)
 	        return;
 	if (dev->link)
-	        free(dev->link);
+	        efi_free(dev->link);
 
 	if (dev->device)
-	        free(dev->device);
+	        efi_free(dev->device);
 
 	if (dev->driver)
-	        free(dev->driver);
+	        efi_free(dev->driver);
 
 	if (dev->probes)
-	        free(dev->probes);
+	        efi_free(dev->probes);
 
 	if (dev->acpi_root.acpi_hid_str)
-	        free(dev->acpi_root.acpi_hid_str);
+	        efi_free(dev->acpi_root.acpi_hid_str);
 	if (dev->acpi_root.acpi_uid_str)
-	        free(dev->acpi_root.acpi_uid_str);
+	        efi_free(dev->acpi_root.acpi_uid_str);
 	if (dev->acpi_root.acpi_cid_str)
-	        free(dev->acpi_root.acpi_cid_str);
+	        efi_free(dev->acpi_root.acpi_cid_str);
 
 	if (dev->interface_type == network) {
 	        if (dev->ifname)
-	                free(dev->ifname);
+	                efi_free(dev->ifname);
 	} else {
 	        if (dev->disk_name)
-	                free(dev->disk_name);
+	                efi_free(dev->disk_name);
 	        if (dev->part_name)
-	                free(dev->part_name);
+	                efi_free(dev->part_name);
 	}
 
 	for (unsigned int i = 0; i < dev->n_pci_devs; i++)
 	        if (dev->pci_dev[i].driverlink)
-	                free(dev->pci_dev[i].driverlink);
+	                efi_free(dev->pci_dev[i].driverlink);
 
 	if (dev->pci_dev)
-	        free(dev->pci_dev);
+	        efi_free(dev->pci_dev);
 
 	memset(dev, 0, sizeof(*dev));
-	free(dev);
+	efi_free(dev);
 }
 
 static void
@@ -370,14 +386,13 @@ struct device HIDDEN
 {
 	struct device *dev;
 	char *linkbuf = NULL, *tmpbuf = NULL;
-	int i = 0;
-	unsigned int n = 0;
 	int rc;
+	efi_trace_scope("device_get", "fd %d partition %d", fd, partition);
 
 	size_t nmemb = (sizeof(dev_probes)
 	                / sizeof(dev_probes[0])) + 1;
 
-	dev = calloc(1, sizeof(*dev));
+	dev = efi_calloc(1, sizeof(*dev));
 	if (!dev) {
 	        efi_error("could not allocate %zd bytes", sizeof(*dev));
 	        return NULL;
@@ -385,7 +400,7 @@ struct device HIDDEN
 
 	dev->part = partition;
 	debug("partition:%d dev->part:%d", partition, dev->part);
-	dev->probes = calloc(nmemb, sizeof(struct dev_probe *));
+	dev->probes = efi_calloc(nmemb, sizeof(struct dev_probe *));
 	if (!dev->probes) {
 	        efi_error("could not allocate %zd bytes",
 	                  nmemb * sizeof(struct dev_probe *));
@@ -420,9 +435,9 @@ struct device HIDDEN
 	        goto err;
 	}
 
-	dev->link = strdup(linkbuf);
+	dev->link = efi_strdup(linkbuf);
 	if (!dev->link) {
-	        efi_error("strdup(\"%s\") failed", linkbuf);
+	        efi_error("efi_strdup(\"%s\") failed", linkbuf);
 	        goto err;
 	}
 	debug("dev->link: %s", dev->link);
@@ -446,19 +461,144 @@ struct device HIDDEN
 	debug("dev->disk_name: %s", dev->disk_name);
 	debug("dev->part_name: %s", dev->part_name);
 
+	/*
+	 * Everything past the names is only needed for a full hardware
+	 * path, so it's left for device_probe() to do on demand.
+	 */
+	return dev;
+err:
+	device_free(dev);
+	return NULL;
+}
+
+/*
+ * Run the probes in order over dev's sysfs link, starting at *current and
+ * leaving *current where the walk stopped.  If the device's interface
+ * type still isn't known when the probes run out, the segment nothing
+ * matched is skipped, which means only abbreviated paths can be made.
+ */
+static int
+probe_walk(struct device *dev, struct dev_probe **probes,
+	   const char **current)
+{
+	const char *path = *current;
+	bool needs_root = true;
+	int last_successful_probe = -1;
+	unsigned int n = 0;
+	int rc;
+
+	debug("searching for device nodes in %s", path);
+	for (int i = 0; probes[i] && probes[i]->parse && *path; i++) {
+		struct dev_probe *probe = probes[i];
+		int pos;
+
+		if (!needs_root &&
+		    (probe->flags & DEV_PROVIDES_ROOT)) {
+			debug("not testing %s because flags is 0x%x",
+			      probe->name, probe->flags);
+			continue;
+		}
+
+		debug("trying %s", probe->name);
+		efi_trace_begin(probe->name, "%s", path);
+		pos = probe->parse(dev, path, dev->link);
+		efi_trace_end();
+		if (pos < 0) {
+			debug("parsing %s failed", probe->name);
+			continue;
+		} else if (pos > 0) {
+			char match[pos+1];
+
+			strncpy(match, path, pos);
+			match[pos] = '\0';
+			debug("%s matched '%s'", probe->name, match);
+			EFIVAR_PROBE3(device_probe_match, probe->name,
+				      match, dev->link);
+			dev->flags |= probe->flags;
+
+			if (probe->flags & DEV_PROVIDES_HD ||
+			    probe->flags & DEV_PROVIDES_ROOT ||
+			    probe->flags & DEV_ABBREV_ONLY)
+				needs_root = false;
+
+			if (probe->create)
+				print_dev_dp_node(dev, probe);
+
+			dev->probes[n++] = probe;
+			path += pos;
+			if (path[0] == '\0')
+				debug("finished");
+			else
+				debug("current:'%s'", path);
+			last_successful_probe = i;
+
+			if (!*path || !strncmp(path, "block/", 6))
+				break;
+
+			continue;
+		}
+
+		debug("probes[%d]: %p dev->interface_type: %d\n",
+		      i+1, probes[i+1], dev->interface_type);
+		if (probes[i+1] == NULL && dev->interface_type == unknown) {
+			pos = 0;
+			rc = sscanf(path, "%*[^/]/%n", &pos);
+			if (rc < 0) {
+slash_err:
+				efi_error("Cannot parse device link segment \"%s\"", path);
+				return -1;
+			}
+
+			while (path[pos] == '/')
+				pos += 1;
+
+			if (!path[pos])
+				goto slash_err;
+
+			debug("Cannot parse device link segment '%s'", path);
+			debug("Skipping to '%s'", path + pos);
+			debug("This means we can only create abbreviated paths");
+			dev->flags |= DEV_ABBREV_ONLY;
+			i = last_successful_probe;
+			path += pos;
+
+			if (!*path || !strncmp(path, "block/", 6))
+				break;
+		}
+	}
+
+	*current = path;
+	return 0;
+}
+
+/*
+ * Read the device's driver and run the probe chain over its sysfs link,
+ * filling in what make_blockdev_path() needs.  This is most of the sysfs
+ * I/O, and HD() and File() abbreviated paths don't need any of it.
+ */
+int HIDDEN
+device_probe(struct device *dev)
+{
+	char *linkbuf = NULL, *tmpbuf = NULL;
+	int part = dev->part;
+	int rc;
+
+	if (dev->flags & DEV_PROBED)
+	        return 0;
+
 	rc = sysfs_readlink(&tmpbuf, "block/%s/device", dev->disk_name);
 	if (rc < 0 || !tmpbuf) {
 	        debug("readlink of /sys/block/%s/device failed",
 	                  dev->disk_name);
 
-	        dev->device = strdup("");
+	        dev->device = efi_strdup("");
 	} else {
-	        dev->device = strdup(tmpbuf);
+	        dev->device = efi_strdup(tmpbuf);
 	}
 
 	if (!dev->device) {
-	        efi_error("strdup(\"%s\") failed", tmpbuf);
-	        goto err;
+	        efi_error("efi_strdup(\"%s\") failed", tmpbuf);
+	        return -1;
 	}
 
 	/*
@@ -486,114 +626,131 @@ struct device HIDDEN
 		rc = sysfs_readlink(&tmpbuf, "%s", filepath);
 	        if (rc < 0 || !tmpbuf) {
 			efi_error("readlink of /sys/%s failed", filepath);
-	                goto err;
+	                return -1;
 	        }
 
 	        linkbuf = pathseg(tmpbuf, -1);
 	        if (!linkbuf) {
 	                efi_error("could not get segment -1 of \"%s\"", tmpbuf);
-	                goto err;
+	                return -1;
 	        }
 
-	        dev->driver = strdup(linkbuf);
+	        dev->driver = efi_strdup(linkbuf);
 	} else {
-		dev->driver = strdup("");
+		dev->driver = efi_strdup("");
 	}
 
 	if (!dev->driver) {
-	        efi_error("strdup(\"%s\") failed", linkbuf);
-	        goto err;
+	        efi_error("efi_strdup(\"%s\") failed", linkbuf);
+	        return -1;
 	}
 
 	const char *current = dev->link;
-	bool needs_root = true;
-	int last_successful_probe = -1;
 
-	debug("searching for device nodes in %s", dev->link);
-	for (i = 0;
-	     dev_probes[i] && dev_probes[i]->parse && *current;
-	     i++) {
-	        struct dev_probe *probe = dev_probes[i];
-	        int pos;
-
-	        if (!needs_root &&
-	            (probe->flags & DEV_PROVIDES_ROOT)) {
-	                debug("not testing %s because flags is 0x%x",
-	                      probe->name, probe->flags);
-	                continue;
-	        }
+	rc = probe_walk(dev, dev_probes, &current);
+	if (rc < 0)
+		return rc;
 
-	        debug("trying %s", probe->name);
-	        pos = probe->parse(dev, current, dev->link);
-	        if (pos < 0) {
-	                debug("parsing %s failed", probe->name);
-	                continue;
-	        } else if (pos > 0) {
-			char match[pos+1];
+	/*
+	 * The SCSI, ATA, and I2O probes work the partition out from the
+	 * minor number, which is 0 for a whole disk like /dev/sda even when
+	 * the caller asked for partition 1.  The partition device_get() was
+	 * given, or read from sysfs, wins.
+	 */
+	if (part >= 0) {
+		rc = set_part(dev, part);
+		if (rc < 0)
+			return rc;
+	}
 
-			strncpy(match, current, pos);
-			match[pos] = '\0';
-	                debug("%s matched '%s'", probe->name, match);
-	                dev->flags |= probe->flags;
+	if (dev->interface_type == unknown &&
+	    !(dev->flags & DEV_ABBREV_ONLY) &&
+	    !strcmp(current, "block/")) {
+	        efi_error("unknown storage interface");
+	        errno = ENOSYS;
+	        return -1;
+	}
 
-	                if (probe->flags & DEV_PROVIDES_HD ||
-	                    probe->flags & DEV_PROVIDES_ROOT ||
-	                    probe->flags & DEV_ABBREV_ONLY)
-	                        needs_root = false;
+	dev->flags |= DEV_PROBED;
+	return 0;
+}
 
-			if (probe->create)
-				print_dev_dp_node(dev, probe);
+/*
+ * Network interfaces only ever sit behind a root and some PCI bridges as
+ * far as firmware is concerned, i.e.:
+ * ../../devices/pci0000:00/0000:00:1c.0/0000:02:00.0/net/eth0
+ */
+static struct dev_probe *net_dev_probes[] = {
+	&acpi_root_parser,
+	&pci_root_parser,
+	&soc_root_parser,
+	&pci_parser,
+	NULL
+};
 
-	                dev->probes[n++] = dev_probes[i];
-	                current += pos;
-			if (current[0] == '\0')
-				debug("finished");
-			else
-				debug("current:'%s'", current);
-	                last_successful_probe = i;
+struct device HIDDEN
+*device_get_net(const char * const ifname)
+{
+	struct device *dev;
+	char *linkbuf = NULL;
+	const char *current;
+	int rc;
+	efi_trace_scope("device_get_net", "%s", ifname);
 
-	                if (!*current || !strncmp(current, "block/", 6))
-	                        break;
+	size_t nmemb = (sizeof(net_dev_probes)
+			/ sizeof(net_dev_probes[0])) + 1;
 
-	                continue;
-	        }
+	dev = efi_calloc(1, sizeof(*dev));
+	if (!dev) {
+		efi_error("could not allocate %zd bytes", sizeof(*dev));
+		return NULL;
+	}
 
-	        debug("dev_probes[%d]: %p dev->interface_type: %d\n",
-	              i+1, dev_probes[i+1], dev->interface_type);
-	        if (dev_probes[i+1] == NULL && dev->interface_type == unknown) {
-	                pos = 0;
-	                rc = sscanf(current, "%*[^/]/%n", &pos);
-	                if (rc < 0) {
-slash_err:
-	                        efi_error("Cannot parse device link segment \"%s\"", current);
-	                        goto err;
-	                }
+	/* dev->ifname would alias the PCI state, so it's not set here */
+	dev->interface_type = network;
+	dev->probes = efi_calloc(nmemb, sizeof(struct dev_probe *));
+	if (!dev->probes) {
+		efi_error("could not allocate %zd bytes",
+			  nmemb * sizeof(struct dev_probe *));
+		goto err;
+	}
+
+	dev->pci_root.pci_domain = 0xffff;
+	dev->pci_root.pci_bus = 0xff;
+
+	rc = sysfs_readlink(&linkbuf, "class/net/%s", ifname);
+	if (rc < 0 || !linkbuf) {
+		efi_error("readlink of /sys/class/net/%s failed", ifname);
+		goto err;
+	}
 
-	                while (current[pos] == '/')
-	                        pos += 1;
+	dev->link = efi_strdup(linkbuf);
+	if (!dev->link) {
+		efi_error("efi_strdup(\"%s\") failed", linkbuf);
+		goto err;
+	}
+	debug("dev->link: %s", dev->link);
 
-	                if (!current[pos])
-	                        goto slash_err;
+	current = dev->link;
+	rc = probe_walk(dev, net_dev_probes, &current);
+	if (rc < 0)
+		goto err;
 
-	                debug("Cannot parse device link segment '%s'", current);
-	                debug("Skipping to '%s'", current + pos);
-	                debug("This means we can only create abbreviated paths");
-	                dev->flags |= DEV_ABBREV_ONLY;
-	                i = last_successful_probe;
-	                current += pos;
+	/* virtio-net has its virtio device between the PCI function and net/ */
+	if (!strncmp(current, "virtio", 6)) {
+		int pos = 0;
 
-	                if (!*current || !strncmp(current, "block/", 6))
-	                        break;
-	        }
+		rc = sscanf(current, "virtio%*u/%n", &pos);
+		if (rc >= 0 && pos > 0)
+			current += pos;
 	}
 
-	if (dev->interface_type == unknown &&
-	    !(dev->flags & DEV_ABBREV_ONLY) &&
-	    !strcmp(current, "block/")) {
-	        efi_error("unknown storage interface");
-	        errno = ENOSYS;
-	        goto err;
+	if (!(dev->flags & DEV_PROVIDES_ROOT) || strncmp(current, "net/", 4)) {
+		efi_error("%s is not on a bus firmware can see", ifname);
+		errno = ENODEV;
+		goto err;
 	}
+	dev->flags |= DEV_PROBED;
 
 	return dev;
 err:
@@ -608,6 +765,11 @@ make_blockdev_path(uint8_t *buf, ssize_t size, struct device *dev)
 
 	debug("entry buf:%p size:%zd", buf, size);
 
+	if (device_probe(dev) < 0) {
+	        efi_error("could not probe device");
+	        return -1;
+	}
+
 	for (unsigned int i = 0; dev->probes[i] &&
 	                         dev->probes[i]->parse; i++) {
 	        struct dev_probe *probe = dev->probes[i];
@@ -148,6 +148,7 @@ struct device {
 };
 
 extern struct device HIDDEN *device_get(int fd, int partition);
+extern int HIDDEN device_probe(struct device *dev);
 extern void HIDDEN device_free(struct device *dev);
 extern int HIDDEN set_disk_and_part_name(struct device *dev);
 extern int HIDDEN set_part(struct device *dev, int value);
@@ -167,25 +168,58 @@ extern int HIDDEN find_parent_devpath(const char * const child,
 extern ssize_t HIDDEN make_mac_path(uint8_t *buf, ssize_t size,
 				    const char * const ifname);
 
+struct net_interface {
+	int ifindex;
+	char ifname[16];		/* IF_NAMESIZE */
+	uint16_t link_type;
+	uint8_t mac_addr[32];
+	size_t mac_addr_len;
+
+	bool has_ipv4;
+	bool ipv4_static;
+	uint32_t ipv4_addr;		/* host byte order */
+	uint8_t ipv4_prefix_len;
+
+	bool has_ipv6;
+	uint8_t ipv6_origin;
+	uint8_t ipv6_addr[16];
+	uint8_t ipv6_prefix_len;
+};
+
+extern int HIDDEN get_net_interfaces(struct net_interface **ifaces,
+				     size_t *n_ifaces);
+extern struct device HIDDEN *device_get_net(const char * const ifname);
+
+/*
+ * Set LIBEFIBOOT_SYSFS_PATH to read sysfs from somewhere other than /sys,
+ * such as a fake tree in the test suite, and LIBEFIBOOT_DEV_PATH to open
+ * disks somewhere other than /dev.
+ */
+#define SYSFS_ENV		"LIBEFIBOOT_SYSFS_PATH"
+#define DEVFS_ENV		"LIBEFIBOOT_DEV_PATH"
+extern const char HIDDEN *sysfs_path(void);
+extern const char HIDDEN *devfs_path(void);
+
 #define read_sysfs_file(buf, fmt, args...)				\
 	({								\
 		uint8_t *buf_ = NULL;					\
 		ssize_t bufsize_ = -1;					\
 		int error_;						\
 									\
-		bufsize_ = get_file(&buf_, "/sys/" fmt, ## args);	\
+		bufsize_ = get_file(&buf_, "%s/" fmt,			\
+				    sysfs_path(), ## args);		\
 		if (bufsize_ > 0) {					\
 			uint8_t *buf2_ = alloca(bufsize_);		\
 			error_ = errno;					\
 			if (buf2_)					\
 				memcpy(buf2_, buf_, bufsize_);		\
-			free(buf_);					\
+			efi_free(buf_);					\
 			*(buf) = (__typeof__(*(buf)))buf2_;		\
 			errno = error_;					\
 		} else if (buf_) {					\
 			/* covscan is _sure_ we leak buf_ if bufsize_ */\
 			/* is <= 0, which is wrong, but appease it.   */\
-			free(buf_);					\
+			efi_free(buf_);					\
 			buf_ = NULL;					\
 		}							\
 		bufsize_;						\
@@ -198,7 +232,8 @@ extern ssize_t HIDDEN make_mac_path(uint8_t *buf, ssize_t size,
 		int _rc;						\
 									\
 		*(linkbuf) = NULL;					\
-		_rc = asprintfa(&_pn, "/sys/" fmt, ## args);		\
+		_rc = asprintfa(&_pn, "%s/" fmt,			\
+				sysfs_path(), ## args);			\
 		if (_rc >= 0) {						\
 			ssize_t _linksz;				\
 			_rc = _linksz = readlink(_pn, _lb, PATH_MAX);   \
@@ -218,7 +253,8 @@ extern ssize_t HIDDEN make_mac_path(uint8_t *buf, ssize_t size,
 		int rc_;						\
 		char *pn_;						\
 									\
-		rc_ = asprintfa(&pn_, "/sys/" fmt, ## args);		\
+		rc_ = asprintfa(&pn_, "%s/" fmt,			\
+				sysfs_path(), ## args);			\
 		if (rc_ >= 0) {						\
 			rc_ = access(pn_, mode);			\
 			if (rc_ < 0)					\
@@ -234,7 +270,8 @@ extern ssize_t HIDDEN make_mac_path(uint8_t *buf, ssize_t size,
 		int rc_;						\
 		char *pn_;						\
 									\
-		rc_ = asprintfa(&pn_, "/sys/" fmt, ## args);		\
+		rc_ = asprintfa(&pn_, "%s/" fmt,			\
+				sysfs_path(), ## args);			\
 		if (rc_ >= 0) {						\
 			rc_ = stat(pn_, statbuf);			\
 			if (rc_ < 0)					\
@@ -251,7 +288,8 @@ extern ssize_t HIDDEN make_mac_path(uint8_t *buf, ssize_t size,
 		char *pn_;						\
 		DIR *dir_ = NULL;					\
 									\
-		rc_ = asprintfa(&pn_, "/sys/" fmt, ## args);		\
+		rc_ = asprintfa(&pn_, "%s/" fmt,			\
+				sysfs_path(), ## args);			\
 		if (rc_ >= 0) {						\
 			dir_ = opendir(pn_);				\
 			if (dir_ == NULL)				\
@@ -325,6 +363,7 @@ find_device_link_err_:								\
 #define DEV_PROVIDES_ROOT       1
 #define DEV_PROVIDES_HD	 2
 #define DEV_ABBREV_ONLY	 4
+#define DEV_PROBED	 8	/* device_probe() has run */
 
 struct dev_probe {
 	char *name;
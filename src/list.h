@@ -129,7 +129,7 @@ list_sort(struct list_head *head,
 
 	nmemb = list_size(head);
 
-	array = calloc(nmemb, sizeof (head));
+	array = efi_calloc(nmemb, sizeof (head));
 	if (!array)
 		return -1;
 
@@ -157,7 +157,7 @@ list_sort(struct list_head *head,
 		list_add(array[i], head);
 		head = head->next;
 	}
-	free(array);
+	efi_free(array);
 
 	return 0;
 }
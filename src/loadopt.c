@@ -347,7 +347,7 @@ static void DESTRUCTOR
 teardown(void)
 {
 	if (last_desc)
-		free(last_desc);
+		efi_free(last_desc);
 	last_desc = NULL;
 }
 
@@ -355,7 +355,7 @@ const unsigned char NONNULL(1) PUBLIC *
 efi_loadopt_desc(efi_load_option *opt, ssize_t limit)
 {
 	if (last_desc) {
-		free(last_desc);
+		efi_free(last_desc);
 		last_desc = NULL;
 	}
 
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * probes.h - USDT static tracepoints
+ *
+ * With <sys/sdt.h> available these expand to a nop and an ELF note, so
+ * tools like bpftrace can attach to them:
+ *
+ *   bpftrace -e 'usdt:/usr/lib64/libefivar.so.1:efivar:var_op_return
+ *                { @[str(arg0), str(arg2)] = hist(arg4); }'
+ *
+ * Without it, or with ENABLE_SDT=0, they compile away.  Arguments are
+ * always type checked, but must not have side effects.
+ *
+ * Probes whose arguments are expensive to compute can be guarded with
+ * EFIVAR_PROBE_ENABLED(name).  That needs a semaphore, which the
+ * translation unit defines with EFIVAR_PROBE_SEMAPHORE(name), and since
+ * <sys/sdt.h> then expects one for every probe in that file, it also has
+ * to #define EFIVAR_PROBE_SEMAPHORES before including anything.
+ */
+
+#ifndef EFIVAR_PROBES_H_
+#define EFIVAR_PROBES_H_
+
+#if !defined(EFIVAR_DISABLE_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define EFIVAR_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef EFIVAR_HAVE_SDT
+
+#ifdef EFIVAR_PROBE_SEMAPHORES
+#define _SDT_HAS_SEMAPHORES 1
+#endif
+#include <sys/sdt.h>
+
+#define EFIVAR_PROBE0(name) \
+	STAP_PROBE(efivar, name)
+#define EFIVAR_PROBE1(name, a) \
+	STAP_PROBE1(efivar, name, a)
+#define EFIVAR_PROBE2(name, a, b) \
+	STAP_PROBE2(efivar, name, a, b)
+#define EFIVAR_PROBE3(name, a, b, c) \
+	STAP_PROBE3(efivar, name, a, b, c)
+#define EFIVAR_PROBE4(name, a, b, c, d) \
+	STAP_PROBE4(efivar, name, a, b, c, d)
+#define EFIVAR_PROBE5(name, a, b, c, d, e) \
+	STAP_PROBE5(efivar, name, a, b, c, d, e)
+#define EFIVAR_PROBE6(name, a, b, c, d, e, f) \
+	STAP_PROBE6(efivar, name, a, b, c, d, e, f)
+
+#ifdef EFIVAR_PROBE_SEMAPHORES
+#define EFIVAR_PROBE_SEMAPHORE(name)					\
+	unsigned short HIDDEN efivar_##name##_semaphore			\
+		__attribute__((__section__(".probes")))
+#define EFIVAR_PROBE_ENABLED(name)					\
+	__builtin_expect(						\
+		*(volatile unsigned short *)&efivar_##name##_semaphore,	\
+		0)
+#endif
+
+#else /* !EFIVAR_HAVE_SDT */
+
+#define EFIVAR_PROBE0(name) do { } while (0)
+#define EFIVAR_PROBE1(name, a)						\
+	do { (void)(a); } while (0)
+#define EFIVAR_PROBE2(name, a, b)					\
+	do { (void)(a); (void)(b); } while (0)
+#define EFIVAR_PROBE3(name, a, b, c)					\
+	do { (void)(a); (void)(b); (void)(c); } while (0)
+#define EFIVAR_PROBE4(name, a, b, c, d)					\
+	do { (void)(a); (void)(b); (void)(c); (void)(d); } while (0)
+#define EFIVAR_PROBE5(name, a, b, c, d, e)				\
+	do {								\
+		(void)(a); (void)(b); (void)(c); (void)(d); (void)(e);	\
+	} while (0)
+#define EFIVAR_PROBE6(name, a, b, c, d, e, f)				\
+	do {								\
+		(void)(a); (void)(b); (void)(c); (void)(d); (void)(e);	\
+		(void)(f);						\
+	} while (0)
+
+#endif /* EFIVAR_HAVE_SDT */
+
+#ifndef EFIVAR_PROBE_ENABLED
+#define EFIVAR_PROBE_SEMAPHORE(name) \
+	extern int efivar_##name##_semaphore_unused_
+#define EFIVAR_PROBE_ENABLED(name) 0
+#endif
+
+#endif /* !EFIVAR_PROBES_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,457 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * profile.c - time variable reads and writes through the firmware
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "efivar.h"
+#include "profile.h"
+
+/*
+ * Scratch variables for --profile-writes live here, so we can't clobber
+ * anything real.  They're volatile, so a crash mid-run doesn't leave
+ * them around past the next boot, and we don't wear out the flash.
+ */
+#define PROFILE_GUID \
+	EFI_GUID(0xe4cca57e,0xb90d,0x4c89,0x8b29,0x26,0x2b,0x38,0xec,0xba,0x86)
+#define PROFILE_ATTRS (EFI_VARIABLE_BOOTSERVICE_ACCESS | \
+		       EFI_VARIABLE_RUNTIME_ACCESS)
+
+static const size_t write_sizes[] = { 16, 256, 1024, 4096, 16384 };
+#define N_WRITE_SIZES (sizeof(write_sizes) / sizeof(write_sizes[0]))
+
+/*
+ * Latency histogram buckets are powers of two in microseconds, from
+ * "under 1us" up to "at least 2^(N_LAT_BUCKETS-2)us".  Size buckets are
+ * powers of two in bytes.
+ */
+#define N_LAT_BUCKETS	24
+#define N_SIZE_BUCKETS	20
+
+typedef struct {
+	efi_guid_t guid;
+	char *name;
+	size_t size;
+	uint64_t *samples;	/* ns */
+	unsigned int n_samples;
+	unsigned int n_errors;
+} profile_var_t;
+
+typedef struct {
+	unsigned int n;
+	unsigned int buckets[N_LAT_BUCKETS];
+} histogram_t;
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int
+lat_bucket(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	unsigned int b = 0;
+
+	while (us && b < N_LAT_BUCKETS - 1) {
+		us >>= 1;
+		b++;
+	}
+	return b;
+}
+
+static unsigned int
+size_bucket(size_t size)
+{
+	unsigned int b = 0;
+
+	while (((size_t)1 << b) < size && b < N_SIZE_BUCKETS - 1)
+		b++;
+	return b;
+}
+
+static void
+histogram_add(histogram_t *h, uint64_t ns)
+{
+	h->buckets[lat_bucket(ns)] += 1;
+	h->n += 1;
+}
+
+static void
+histogram_print(const histogram_t *h, const char *indent)
+{
+	unsigned int max = 0;
+	int first = -1, last = -1;
+
+	for (int i = 0; i < N_LAT_BUCKETS; i++) {
+		if (!h->buckets[i])
+			continue;
+		if (first < 0)
+			first = i;
+		last = i;
+		if (h->buckets[i] > max)
+			max = h->buckets[i];
+	}
+	if (first < 0)
+		return;
+
+	for (int i = first; i <= last; i++) {
+		char range[48];
+		int width = max ? (h->buckets[i] * 40 + max - 1) / max : 0;
+
+		if (i == 0)
+			snprintf(range, sizeof(range), "< 1");
+		else if (i == N_LAT_BUCKETS - 1)
+			snprintf(range, sizeof(range), ">= %llu",
+				 1ULL << (i - 1));
+		else
+			snprintf(range, sizeof(range), "%llu - %llu",
+				 1ULL << (i - 1), 1ULL << i);
+		printf("%s%16s us |%-40.*s| %u\n", indent, range, width,
+		       "########################################",
+		       h->buckets[i]);
+	}
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t
+percentile(const uint64_t *sorted, unsigned int n, unsigned int pct)
+{
+	unsigned int i;
+
+	if (!n)
+		return 0;
+	i = (n * pct + 99) / 100;
+	if (i)
+		i -= 1;
+	return sorted[i];
+}
+
+static double
+mean(const uint64_t *samples, unsigned int n)
+{
+	double total = 0;
+
+	if (!n)
+		return 0;
+	for (unsigned int i = 0; i < n; i++)
+		total += samples[i];
+	return total / n;
+}
+
+static void
+print_stats_header(const char *label)
+{
+	printf("%-56s %8s %9s %9s %9s %9s\n", label, "size",
+	       "min", "p50", "p99", "max");
+}
+
+static void
+print_stats(const char *label, size_t size, uint64_t *samples,
+	    unsigned int n)
+{
+	qsort(samples, n, sizeof(samples[0]), cmp_u64);
+	printf("%-56s %8zu %9.1f %9.1f %9.1f %9.1f\n", label, size,
+	       samples[0] / 1000.0,
+	       percentile(samples, n, 50) / 1000.0,
+	       percentile(samples, n, 99) / 1000.0,
+	       samples[n - 1] / 1000.0);
+}
+
+static void
+free_vars(profile_var_t *vars, size_t n_vars)
+{
+	for (size_t i = 0; i < n_vars; i++) {
+		efi_free(vars[i].name);
+		free(vars[i].samples);
+	}
+	free(vars);
+}
+
+static int
+add_var(profile_var_t **vars, size_t *n_vars, const efi_guid_t *guid,
+	const char *name, unsigned int iterations)
+{
+	profile_var_t *new_vars, *var;
+
+	new_vars = reallocarray(*vars, *n_vars + 1, sizeof(**vars));
+	if (!new_vars)
+		return -1;
+	*vars = new_vars;
+
+	var = &new_vars[*n_vars];
+	memset(var, 0, sizeof(*var));
+	var->guid = *guid;
+	var->name = efi_strdup(name);
+	var->samples = calloc(iterations, sizeof(var->samples[0]));
+	if (!var->name || !var->samples) {
+		efi_free(var->name);
+		free(var->samples);
+		return -1;
+	}
+	*n_vars += 1;
+	return 0;
+}
+
+static int
+find_vars(efi_ctx_t *ctx, profile_var_t **vars, size_t *n_vars,
+	  unsigned int iterations)
+{
+	efi_guid_t *guid = NULL;
+	char *name = NULL;
+	int rc;
+
+	while ((rc = efi_ctx_get_next_variable_name(ctx, &guid, &name)) > 0) {
+		if (add_var(vars, n_vars, guid, name, iterations) < 0)
+			return -1;
+	}
+	return rc;
+}
+
+/*
+ * Read each variable once through a context with the library's default
+ * rate limiting, and compare against the unthrottled reads, so the
+ * report can say how much of what callers see is us sleeping rather
+ * than the firmware.
+ */
+static void
+profile_ratelimit(profile_var_t *vars, size_t n_vars)
+{
+	efi_ctx_t *ctx;
+	uint64_t throttled = 0, raw = 0;
+	unsigned int n = 0;
+
+	ctx = efi_ctx_new(NULL, NULL);
+	if (!ctx)
+		return;
+
+	for (size_t i = 0; i < n_vars && n < 8; i++) {
+		profile_var_t *var = &vars[i];
+		uint8_t *data = NULL;
+		size_t size = 0;
+		uint32_t attrs = 0;
+		uint64_t start;
+		int rc;
+
+		if (!var->n_samples)
+			continue;
+
+		start = now_ns();
+		rc = efi_ctx_get_variable(ctx, var->guid, var->name, &data,
+					  &size, &attrs);
+		throttled += now_ns() - start;
+		if (rc < 0)
+			continue;
+		efi_free(data);
+		raw += mean(var->samples, var->n_samples);
+		n += 1;
+	}
+	efi_ctx_free(ctx);
+
+	if (!n)
+		return;
+	printf("\nlibrary rate limiting adds %.1f us per read "
+	       "(%.1f us throttled vs %.1f us raw, %u variables)\n",
+	       throttled > raw ? (throttled - raw) / 1000.0 / n : 0.0,
+	       throttled / 1000.0 / n, raw / 1000.0 / n, n);
+}
+
+static void
+profile_reads(efi_ctx_t *ctx, profile_var_t *vars, size_t n_vars,
+	      unsigned int iterations)
+{
+	histogram_t *by_size;
+	histogram_t all = { 0, };
+
+	by_size = calloc(N_SIZE_BUCKETS, sizeof(*by_size));
+	if (!by_size)
+		err(1, "could not allocate memory");
+
+	/*
+	 * Go round-robin rather than hammering one variable at a time, so
+	 * any caching in the kernel or firmware gets exercised the way it
+	 * would be by a real caller.
+	 */
+	for (unsigned int it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < n_vars; i++) {
+			profile_var_t *var = &vars[i];
+			uint8_t *data = NULL;
+			size_t size = 0;
+			uint32_t attrs = 0;
+			uint64_t start, elapsed;
+			int rc;
+
+			start = now_ns();
+			rc = efi_ctx_get_variable(ctx, var->guid, var->name,
+						  &data, &size, &attrs);
+			elapsed = now_ns() - start;
+			if (rc < 0) {
+				var->n_errors += 1;
+				continue;
+			}
+			efi_free(data);
+			var->size = size;
+			var->samples[var->n_samples++] = elapsed;
+			histogram_add(&all, elapsed);
+			histogram_add(&by_size[size_bucket(size)], elapsed);
+		}
+	}
+
+	printf("reads, %u per variable, library rate limiting off "
+	       "(times in us):\n", iterations);
+	print_stats_header("variable");
+	for (size_t i = 0; i < n_vars; i++) {
+		profile_var_t *var = &vars[i];
+		char label[128];
+
+		snprintf(label, sizeof(label), GUID_FORMAT "-%s",
+			 GUID_FORMAT_ARGS(&var->guid), var->name);
+		if (!var->n_samples) {
+			printf("%-56s %8s %9s (%u errors)\n", label, "-", "-",
+			       var->n_errors);
+			continue;
+		}
+		print_stats(label, var->size, var->samples, var->n_samples);
+	}
+
+	printf("\nread latency, all variables:\n");
+	histogram_print(&all, "  ");
+
+	printf("\nread latency by size:\n");
+	for (unsigned int b = 0; b < N_SIZE_BUCKETS; b++) {
+		if (!by_size[b].n)
+			continue;
+		printf("  <= %zu bytes (%u reads):\n", (size_t)1 << b,
+		       by_size[b].n);
+		histogram_print(&by_size[b], "    ");
+	}
+	free(by_size);
+}
+
+static int
+profile_writes(efi_ctx_t *ctx, unsigned int iterations)
+{
+	efi_guid_t guid = PROFILE_GUID;
+	uint64_t *samples;
+	uint8_t *data;
+	size_t max = write_sizes[N_WRITE_SIZES - 1];
+	int ret = 0;
+
+	samples = calloc(iterations, sizeof(samples[0]));
+	data = calloc(1, max);
+	if (!samples || !data)
+		err(1, "could not allocate memory");
+
+	printf("\nwrites of scratch variables in {" GUID_FORMAT "}, %u "
+	       "per size (times in us):\n", GUID_FORMAT_ARGS(&guid),
+	       iterations);
+	print_stats_header("variable");
+
+	for (size_t s = 0; s < N_WRITE_SIZES; s++) {
+		size_t size = write_sizes[s];
+		unsigned int n = 0;
+		char name[32];
+		char label[128];
+
+		snprintf(name, sizeof(name), "EfivarProfile%zu", size);
+		for (unsigned int it = 0; it < iterations; it++) {
+			uint64_t start;
+			int rc;
+
+			/* make sure every write actually changes something */
+			memset(data, it & 0xff, size);
+			start = now_ns();
+			rc = efi_ctx_set_variable(ctx, guid, name, data, size,
+						  PROFILE_ATTRS, 0600);
+			if (rc < 0) {
+				warn("could not write %s", name);
+				show_errors();
+				ret = -1;
+				break;
+			}
+			samples[n++] = now_ns() - start;
+		}
+		efi_ctx_del_variable(ctx, guid, name);
+
+		if (!n)
+			continue;
+		snprintf(label, sizeof(label), GUID_FORMAT "-%s",
+			 GUID_FORMAT_ARGS(&guid), name);
+		print_stats(label, size, samples, n);
+	}
+
+	free(data);
+	free(samples);
+	return ret;
+}
+
+int
+profile_variables(const efi_guid_t *guid, const char *name,
+		  unsigned int iterations, bool writes)
+{
+	efi_ctx_t *ctx;
+	profile_var_t *vars = NULL;
+	size_t n_vars = 0;
+	int rc = 0;
+
+	if (!iterations)
+		iterations = 1;
+
+	ctx = efi_ctx_new(NULL, NULL);
+	if (!ctx) {
+		warn("could not find a variable store");
+		show_errors();
+		return -1;
+	}
+	/*
+	 * Everything we time goes through this context, so what we
+	 * measure is the kernel and firmware, not our own usleep()s.
+	 */
+	efi_ctx_set_ratelimit(ctx, 0);
+
+	if (name)
+		rc = add_var(&vars, &n_vars, guid, name, iterations);
+	else
+		rc = find_vars(ctx, &vars, &n_vars, iterations);
+	if (rc < 0) {
+		warn("could not list variables");
+		show_errors();
+		goto out;
+	}
+
+	printf("profiling %s store at %s\n\n", efi_ctx_get_ops_name(ctx),
+	       efi_ctx_get_path(ctx));
+	if (n_vars) {
+		profile_reads(ctx, vars, n_vars, iterations);
+		profile_ratelimit(vars, n_vars);
+	}
+	if (writes)
+		rc = profile_writes(ctx, iterations);
+out:
+	free_vars(vars, n_vars);
+	efi_ctx_free(ctx);
+	return rc;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * profile.h - efivar --profile
+ * Copyright 2026 The efivar Authors
+ */
+
+#ifndef EFIVAR_PROFILE_H_
+#define EFIVAR_PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <efivar/efivar.h>
+
+/*
+ * Time reads of every variable (or just guid/name when name is set)
+ * iterations times each, and if writes is set, writes of scratch
+ * variables in a private namespace.  Prints the results to stdout.
+ */
+extern int profile_variables(const efi_guid_t *guid, const char *name,
+			     unsigned int iterations, bool writes);
+
+#endif /* !EFIVAR_PROFILE_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
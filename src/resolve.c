@@ -0,0 +1,733 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * resolve.c - find the Linux device and file an EFI device path names
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "efiboot.h"
+
+/*
+ * One entry per /sys/class/block device.  The signature is what an HD()
+ * node for the partition would carry; the prefix is everything before
+ * the HD() (or, for a whole disk, File()) node that the probe pipeline
+ * generates for it, which is costly enough that it's only made when a
+ * device path actually needs to be checked against it.
+ */
+struct resolver_entry {
+	char *name;
+	char *disk_name;
+	int partition;
+	dev_t devt;
+	char *mountpoint;
+
+	bool has_signature;
+	uint8_t signature_type;
+	partition_signature_t signature;
+
+	bool probed;
+	uint8_t *prefix;
+	ssize_t prefix_size;
+};
+
+struct efi_resolver {
+	struct resolver_entry *entries;
+	size_t n_entries;
+};
+
+static int
+cmp_entries(const void *a, const void *b)
+{
+	const struct resolver_entry *ea = a, *eb = b;
+	int rc;
+
+	rc = strcmp(ea->disk_name, eb->disk_name);
+	if (rc)
+		return rc;
+	return ea->partition - eb->partition;
+}
+
+/*
+ * This is separate from the loop in efi_resolver_new() so that the
+ * alloca() in read_sysfs_file() and sysfs_readlink() is released for
+ * each device.
+ */
+static int
+index_block_device(efi_resolver_t *resolver, const char *name)
+{
+	struct resolver_entry *entry;
+	char *buf = NULL, *link = NULL;
+	unsigned int maj, min;
+	int partition = 0;
+	char *disk_name;
+	ssize_t rc;
+
+	rc = read_sysfs_file(&buf, "class/block/%s/dev", name);
+	if (rc < 0 || !buf || sscanf(buf, "%u:%u", &maj, &min) != 2) {
+		debug("skipping %s: no dev node", name);
+		efi_error_clear();
+		return 0;
+	}
+
+	rc = read_sysfs_file(&buf, "class/block/%s/partition", name);
+	if (rc > 0 && buf && sscanf(buf, "%d", &partition) != 1)
+		partition = 0;
+	efi_error_clear();
+
+	if (partition > 0) {
+		char *slash;
+
+		rc = sysfs_readlink(&link, "class/block/%s", name);
+		if (rc < 0 || !link) {
+			debug("skipping %s: could not find its disk", name);
+			efi_error_clear();
+			return 0;
+		}
+		slash = strrchr(link, '/');
+		if (slash)
+			*slash = '\0';
+		slash = strrchr(link, '/');
+		disk_name = efi_strdup(slash ? slash + 1 : link);
+	} else {
+		disk_name = efi_strdup(name);
+	}
+	if (!disk_name) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+
+	entry = efi_reallocarray(resolver->entries, resolver->n_entries + 1,
+				 sizeof(*entry));
+	if (!entry) {
+		efi_error("could not allocate memory");
+		efi_free(disk_name);
+		return -1;
+	}
+	resolver->entries = entry;
+	entry = &resolver->entries[resolver->n_entries];
+	memset(entry, 0, sizeof(*entry));
+	entry->name = efi_strdup(name);
+	if (!entry->name) {
+		efi_error("could not allocate memory");
+		efi_free(disk_name);
+		return -1;
+	}
+	entry->disk_name = disk_name;
+	entry->partition = partition;
+	entry->devt = makedev(maj, min);
+	resolver->n_entries += 1;
+	return 0;
+}
+
+/*
+ * sysfs spells a '/' in a device name as '!', as in "cciss!c0d0".
+ */
+static char *
+dev_node_path(const char *name)
+{
+	const char *dev = devfs_path();
+	char *path = NULL, *p;
+
+	if (efi_asprintf(&path, "%s/%s", dev, name) < 0)
+		return NULL;
+	for (p = path + strlen(dev) + 1; *p; p++)
+		if (*p == '!')
+			*p = '/';
+	return path;
+}
+
+/*
+ * Read each disk's partition table once, for all of its partitions;
+ * entries are sorted by disk, so they're adjacent.
+ */
+static void
+index_signatures(efi_resolver_t *resolver)
+{
+	const char *disk_name = NULL;
+	int fd = -1;
+
+	for (size_t i = 0; i < resolver->n_entries; i++) {
+		struct resolver_entry *entry = &resolver->entries[i];
+		uint64_t start = 0, size = 0;
+		uint8_t mbr_type = 0;
+		int rc;
+
+		if (entry->partition <= 0)
+			continue;
+
+		if (!disk_name || strcmp(disk_name, entry->disk_name)) {
+			char *path;
+
+			if (fd >= 0)
+				close(fd);
+			fd = -1;
+			disk_name = entry->disk_name;
+			path = dev_node_path(disk_name);
+			if (path) {
+				fd = open(path, O_RDONLY|O_CLOEXEC);
+				if (fd < 0)
+					debug("could not open %s: %m", path);
+				efi_free(path);
+			}
+		}
+		if (fd < 0)
+			continue;
+
+		rc = get_partition_info(fd, 0, entry->partition, &start, &size,
+					&entry->signature, &mbr_type,
+					&entry->signature_type);
+		if (rc < 0) {
+			debug("no partition info for %s", entry->name);
+			efi_error_clear();
+			continue;
+		}
+		entry->has_signature =
+			entry->signature_type == EFIDP_HD_SIGNATURE_MBR ||
+			entry->signature_type == EFIDP_HD_SIGNATURE_GUID;
+	}
+	if (fd >= 0)
+		close(fd);
+}
+
+static void
+unescape_mountinfo(char *s)
+{
+	char *out = s;
+
+	while (*s) {
+		if (s[0] == '\\' && s[1] >= '0' && s[1] <= '3' &&
+		    s[2] >= '0' && s[2] <= '7' && s[3] >= '0' && s[3] <= '7') {
+			*out++ = (s[1] - '0') << 6 | (s[2] - '0') << 3 |
+				 (s[3] - '0');
+			s += 4;
+		} else {
+			*out++ = *s++;
+		}
+	}
+	*out = '\0';
+}
+
+/*
+ * Only mounts of the filesystem's root count; a bind mount of some
+ * subdirectory can't be used to find a path relative to the top.
+ */
+static void
+index_mountpoints(efi_resolver_t *resolver)
+{
+	char *line = NULL;
+	size_t linesz = 0;
+	FILE *f;
+
+	f = fopen("/proc/self/mountinfo", "re");
+	if (!f) {
+		debug("could not open /proc/self/mountinfo: %m");
+		return;
+	}
+
+	while (getline(&line, &linesz, f) >= 0) {
+		char root[PATH_MAX + 1], dir[PATH_MAX + 1];
+		unsigned int maj, min;
+		dev_t devt;
+
+		if (sscanf(line, "%*u %*u %u:%u %4096s %4096s",
+			   &maj, &min, root, dir) != 4)
+			continue;
+		if (strcmp(root, "/"))
+			continue;
+
+		devt = makedev(maj, min);
+		for (size_t i = 0; i < resolver->n_entries; i++) {
+			struct resolver_entry *entry = &resolver->entries[i];
+
+			if (entry->devt != devt || entry->mountpoint)
+				continue;
+			unescape_mountinfo(dir);
+			entry->mountpoint = efi_strdup(dir);
+			break;
+		}
+	}
+	free(line);
+	fclose(f);
+}
+
+efi_resolver_t PUBLIC *
+efi_resolver_new(void)
+{
+	efi_resolver_t *resolver;
+	struct dirent *de;
+	DIR *dir;
+
+	resolver = efi_calloc(1, sizeof(*resolver));
+	if (!resolver) {
+		efi_error("could not allocate memory");
+		return NULL;
+	}
+
+	dir = sysfs_opendir("class/block");
+	if (!dir)
+		goto err;
+
+	while ((de = readdir(dir)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;
+		if (index_block_device(resolver, de->d_name) < 0) {
+			closedir(dir);
+			goto err;
+		}
+	}
+	closedir(dir);
+
+	if (resolver->n_entries)
+		qsort(resolver->entries, resolver->n_entries,
+		      sizeof(resolver->entries[0]), cmp_entries);
+
+	index_signatures(resolver);
+	index_mountpoints(resolver);
+	return resolver;
+err:
+	efi_resolver_free(resolver);
+	return NULL;
+}
+
+void PUBLIC
+efi_resolver_free(efi_resolver_t *resolver)
+{
+	if (!resolver)
+		return;
+
+	for (size_t i = 0; i < resolver->n_entries; i++) {
+		struct resolver_entry *entry = &resolver->entries[i];
+
+		efi_free(entry->name);
+		efi_free(entry->disk_name);
+		efi_free(entry->mountpoint);
+		efi_free(entry->prefix);
+	}
+	efi_free(resolver->entries);
+	efi_free(resolver);
+}
+
+/*
+ * The number of bytes before the first HD() or File() node, or before
+ * the end if there's neither.
+ */
+static ssize_t
+prefix_size(const_efidp dp, ssize_t limit)
+{
+	ssize_t off = 0;
+
+	while (off + (ssize_t)sizeof(efidp_header) <= limit) {
+		const_efidp node = (const_efidp)((const uint8_t *)dp + off);
+		ssize_t sz;
+
+		if (efidp_type(node) == EFIDP_END_TYPE)
+			break;
+		if (efidp_type(node) == EFIDP_MEDIA_TYPE &&
+		    (efidp_subtype(node) == EFIDP_MEDIA_HD ||
+		     efidp_subtype(node) == EFIDP_MEDIA_FILE))
+			break;
+		sz = efidp_node_size(node);
+		if (sz <= 0)
+			return -1;
+		off += sz;
+	}
+	return off;
+}
+
+/*
+ * Run the device through the same path creator.c would use to make a
+ * boot entry for it, and keep the part before the HD() node.
+ */
+static void
+probe_prefix(struct resolver_entry *entry)
+{
+	uint8_t *dp = NULL;
+	char *devpath;
+	ssize_t sz;
+
+	entry->probed = true;
+	entry->prefix_size = -1;
+
+	devpath = dev_node_path(entry->name);
+	if (!devpath)
+		return;
+
+	sz = efi_generate_file_device_path_from_esp(NULL, 0, devpath,
+						    entry->partition, "", 0);
+	if (sz > 0)
+		dp = efi_malloc(sz);
+	if (dp)
+		sz = efi_generate_file_device_path_from_esp(dp, sz, devpath,
+							    entry->partition,
+							    "", 0);
+	efi_free(devpath);
+	if (!dp || sz < 0) {
+		debug("could not make a device path for %s", entry->name);
+		efi_error_clear();
+		efi_free(dp);
+		return;
+	}
+
+	entry->prefix = dp;
+	entry->prefix_size = prefix_size((const_efidp)dp, sz);
+}
+
+static bool
+prefix_matches(struct resolver_entry *entry, const_efidp dp, ssize_t size)
+{
+	if (!entry->probed)
+		probe_prefix(entry);
+	return entry->prefix_size == size &&
+	       !memcmp(entry->prefix, dp, size);
+}
+
+static bool
+signature_matches(const struct resolver_entry *entry, const efidp_hd *hd)
+{
+	if (!entry->has_signature ||
+	    entry->partition != (int)hd->partition_number ||
+	    entry->signature_type != hd->signature_type)
+		return false;
+	if (hd->signature_type == EFIDP_HD_SIGNATURE_MBR)
+		return !memcmp(&entry->signature.mbr_signature,
+			       hd->signature,
+			       sizeof(entry->signature.mbr_signature));
+	return !memcmp(&entry->signature.gpt_signature, hd->signature,
+		       sizeof(entry->signature.gpt_signature));
+}
+
+/*
+ * Join the File() nodes into one path, with '/' for '\'.
+ */
+static int
+file_path(const_efidp dp, ssize_t limit, char **pathp)
+{
+	char *path = NULL;
+	size_t len = 0;
+	ssize_t off = 0;
+
+	while (off + (ssize_t)sizeof(efidp_header) <= limit) {
+		const_efidp node = (const_efidp)((const uint8_t *)dp + off);
+		ssize_t sz = efidp_node_size(node);
+		unsigned char *name;
+		size_t namelen;
+		char *new_path;
+
+		if (sz <= 0 || efidp_type(node) == EFIDP_END_TYPE)
+			break;
+		off += sz;
+		if (efidp_type(node) != EFIDP_MEDIA_TYPE ||
+		    efidp_subtype(node) != EFIDP_MEDIA_FILE)
+			continue;
+
+		name = ucs2_to_utf8(node->file.name,
+				    (sz - sizeof(efidp_header)) / 2);
+		if (!name)
+			goto err;
+		namelen = strlen((char *)name);
+		new_path = efi_realloc(path, len + namelen + 2);
+		if (!new_path) {
+			efi_free(name);
+			goto err;
+		}
+		path = new_path;
+		if (len == 0 || path[len - 1] != '/')
+			path[len++] = '/';
+		for (size_t i = name[0] == '\\' ? 1 : 0; i < namelen; i++)
+			path[len++] = name[i] == '\\' ? '/' : name[i];
+		path[len] = '\0';
+		efi_free(name);
+	}
+
+	*pathp = path;
+	return 0;
+err:
+	efi_free(path);
+	efi_error("could not allocate memory");
+	return -1;
+}
+
+static int
+fill_resolved(struct resolver_entry *entry, const char *path,
+	      efi_resolved_path_t *resolved)
+{
+	struct stat sb;
+	size_t mlen;
+
+	resolved->flags |= EFI_RESOLVED_DEVICE;
+	resolved->partition = entry->partition;
+	resolved->device = dev_node_path(entry->name);
+	if (!resolved->device)
+		goto err;
+
+	if (!entry->mountpoint)
+		return 0;
+	resolved->flags |= EFI_RESOLVED_MOUNTED;
+	resolved->mountpoint = efi_strdup(entry->mountpoint);
+	if (!resolved->mountpoint)
+		goto err;
+
+	if (!path)
+		return 0;
+	mlen = strlen(entry->mountpoint);
+	if (mlen && entry->mountpoint[mlen - 1] == '/')
+		mlen -= 1;
+	if (efi_asprintf(&resolved->path, "%.*s%s", (int)mlen,
+			 entry->mountpoint, path) < 0)
+		goto err;
+	resolved->flags |= EFI_RESOLVED_FILE;
+
+	if (stat(resolved->path, &sb) < 0)
+		resolved->file_errno = errno;
+	else
+		resolved->flags |= EFI_RESOLVED_EXISTS;
+	return 0;
+err:
+	efi_error("could not allocate memory");
+	return -1;
+}
+
+int NONNULL(1, 2, 4) PUBLIC
+efi_resolve_device_path(efi_resolver_t *resolver, const_efidp dp,
+			ssize_t limit, efi_resolved_path_t *resolved)
+{
+	struct resolver_entry *found = NULL;
+	const efidp_hd *hd = NULL;
+	char *path = NULL;
+	ssize_t psz;
+	int rc;
+
+	memset(resolved, 0, sizeof(*resolved));
+
+	if (limit < 0)
+		limit = efidp_size(dp);
+	if (limit < 0 || !efidp_is_valid(dp, limit)) {
+		errno = EINVAL;
+		efi_error("invalid device path");
+		return -1;
+	}
+
+	psz = prefix_size(dp, limit);
+	if (psz < 0) {
+		errno = EINVAL;
+		efi_error("invalid device path");
+		return -1;
+	}
+	if (psz + (ssize_t)sizeof(efidp_header) <= limit) {
+		const_efidp node = (const_efidp)((const uint8_t *)dp + psz);
+
+		if (efidp_type(node) == EFIDP_MEDIA_TYPE &&
+		    efidp_subtype(node) == EFIDP_MEDIA_HD &&
+		    efidp_node_size(node) >= (ssize_t)sizeof(efidp_hd))
+			hd = &node->hd;
+	}
+
+	rc = file_path(dp, limit, &path);
+	if (rc < 0)
+		return -1;
+
+	/*
+	 * A partition GUID or MBR signature can turn up on more than one
+	 * disk (think cloned images), so when the path says which bus the
+	 * disk is on, prefer the candidate the probes put there.
+	 */
+	for (size_t i = 0; i < resolver->n_entries; i++) {
+		struct resolver_entry *entry = &resolver->entries[i];
+
+		if (hd) {
+			if (!signature_matches(entry, hd))
+				continue;
+		} else if (entry->partition != 0 || psz == 0) {
+			continue;
+		}
+
+		if (psz == 0) {
+			found = entry;
+			break;
+		}
+		if (prefix_matches(entry, dp, psz)) {
+			found = entry;
+			resolved->flags |= EFI_RESOLVED_PREFIX;
+			break;
+		}
+		if (hd && !found)
+			found = entry;
+	}
+
+	if (found)
+		rc = fill_resolved(found, path, resolved);
+	efi_free(path);
+	if (rc < 0) {
+		efi_free_resolved_path(resolved);
+		return -1;
+	}
+	return 0;
+}
+
+void PUBLIC
+efi_free_resolved_path(efi_resolved_path_t *resolved)
+{
+	if (!resolved)
+		return;
+	efi_free(resolved->device);
+	efi_free(resolved->mountpoint);
+	efi_free(resolved->path);
+	memset(resolved, 0, sizeof(*resolved));
+}
+
+static bool
+parse_boot_number(const char *name, uint16_t *number)
+{
+	if (strncmp(name, "Boot", 4) || strlen(name) != 8)
+		return false;
+	for (int i = 4; i < 8; i++)
+		if (!isxdigit((unsigned char)name[i]))
+			return false;
+	*number = strtoul(name + 4, NULL, 16);
+	return true;
+}
+
+static int
+resolve_boot_entry(efi_resolver_t *resolver, const char *name,
+		   efi_boot_resolution_t *entry)
+{
+	efi_load_option *opt;
+	uint8_t *data = NULL;
+	size_t size = 0;
+	uint32_t attributes = 0;
+	const unsigned char *desc;
+	ssize_t pathlen;
+	int rc;
+
+	rc = efi_get_variable(efi_guid_global, name, &data, &size, &attributes);
+	if (rc < 0) {
+		entry->error = errno;
+		efi_error_clear();
+		return 0;
+	}
+
+	opt = (efi_load_option *)data;
+	if (!efi_loadopt_is_valid(opt, size)) {
+		entry->error = EINVAL;
+		efi_error_clear();
+		efi_free(data);
+		return 0;
+	}
+
+	entry->attributes = efi_loadopt_attrs(opt);
+	desc = efi_loadopt_desc(opt, size);
+	if (desc) {
+		entry->description = efi_strdup((const char *)desc);
+		if (!entry->description)
+			goto err;
+	}
+
+	pathlen = efi_loadopt_pathlen(opt, size);
+	rc = efi_resolve_device_path(resolver, efi_loadopt_path(opt, size),
+				     pathlen, &entry->resolved);
+	if (rc < 0) {
+		if (errno == ENOMEM)
+			goto err;
+		entry->error = errno;
+		efi_error_clear();
+	}
+	efi_free(data);
+	return 0;
+err:
+	efi_error("could not allocate memory");
+	efi_free(data);
+	return -1;
+}
+
+static int
+cmp_boot_resolutions(const void *a, const void *b)
+{
+	const efi_boot_resolution_t *ra = a, *rb = b;
+
+	return (int)ra->number - (int)rb->number;
+}
+
+ssize_t NONNULL(1) PUBLIC
+efi_resolve_boot_entries(efi_boot_resolution_t **entriesp)
+{
+	efi_boot_resolution_t *entries = NULL;
+	efi_resolver_t *resolver;
+	efi_guid_t *guid = NULL;
+	char *name = NULL;
+	bool failed = false;
+	size_t n = 0;
+	int rc;
+
+	resolver = efi_resolver_new();
+	if (!resolver) {
+		efi_error("could not index block devices");
+		return -1;
+	}
+
+	/*
+	 * Finish the walk even after a failure; stopping partway would
+	 * leave efi_get_next_variable_name() mid-iteration.
+	 */
+	while ((rc = efi_get_next_variable_name(&guid, &name)) > 0) {
+		efi_boot_resolution_t *new_entries;
+		uint16_t number;
+
+		if (failed || efi_guid_cmp(guid, &efi_guid_global) ||
+		    !parse_boot_number(name, &number))
+			continue;
+
+		new_entries = efi_reallocarray(entries, n + 1,
+					       sizeof(*entries));
+		if (!new_entries) {
+			efi_error("could not allocate memory");
+			failed = true;
+			continue;
+		}
+		entries = new_entries;
+		memset(&entries[n], 0, sizeof(entries[n]));
+		entries[n].number = number;
+		n += 1;
+		if (resolve_boot_entry(resolver, name, &entries[n - 1]) < 0)
+			failed = true;
+	}
+	efi_resolver_free(resolver);
+
+	if (rc < 0 || failed) {
+		efi_error("could not resolve boot entries");
+		efi_free_boot_resolutions(entries, n);
+		return -1;
+	}
+
+	if (n)
+		qsort(entries, n, sizeof(*entries), cmp_boot_resolutions);
+	*entriesp = entries;
+	return n;
+}
+
+void PUBLIC
+efi_free_boot_resolutions(efi_boot_resolution_t *entries, size_t n)
+{
+	if (!entries)
+		return;
+	for (size_t i = 0; i < n; i++) {
+		efi_free(entries[i].description);
+		efi_free_resolved_path(&entries[i].resolved);
+	}
+	efi_free(entries);
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * secdb-index.c - mmap-able sorted index of a security database
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "efisec.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * The file is a header, a table of contents, and one sorted array of
+ * fixed-size keys per algorithm, each starting on an 8-byte boundary.
+ * Hashes and RSA keys are their own keys; for the X509 hash types only
+ * the hash is kept, not the revocation time; and certificates are keyed
+ * by the SHA-256 of their DER encoding.  Like the ESLs it's built from,
+ * everything is little-endian.
+ *
+ * The source digest is the SHA-256 of whatever bytes the index was built
+ * from, so a checker can tell whether it's stale without parsing either.
+ */
+
+#define SECDB_INDEX_MAGIC	0x78697365u	/* "esix" */
+#define SECDB_INDEX_VERSION	1
+
+struct secdb_index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	uint8_t source_digest[SHA256_DIGEST_SIZE];
+	uint32_t n_tables;
+	uint32_t reserved;
+};
+
+struct secdb_index_table {
+	uint32_t algorithm;
+	uint32_t key_size;
+	uint64_t offset;
+	uint64_t count;
+};
+
+static const size_t key_sizes[MAX_SECDB_TYPE] = {
+	[X509_CERT] = SHA256_DIGEST_SIZE,
+	[X509_SHA256] = sizeof(efi_sha256_hash_t),
+	[SHA256] = sizeof(efi_sha256_hash_t),
+	[X509_SHA512] = sizeof(efi_sha512_hash_t),
+	[SHA512] = sizeof(efi_sha512_hash_t),
+	[X509_SHA384] = sizeof(efi_sha384_hash_t),
+	[SHA224] = sizeof(efi_sha224_hash_t),
+	[SHA384] = sizeof(efi_sha384_hash_t),
+	[SHA1] = sizeof(efi_sha1_hash_t),
+	[RSA2048] = sizeof(efi_rsa2048_sig_t),
+	[RSA2048_SHA1] = sizeof(efi_rsa2048_sig_t),
+	[RSA2048_SHA256] = sizeof(efi_rsa2048_sig_t),
+};
+
+/*
+ * Put the key for one signature in key, which must hold key_sizes[alg]
+ * bytes.  Returns -1 if the signature is too short to have one.
+ */
+static int
+make_key(efi_secdb_type_t algorithm, const efi_secdb_data_t *data,
+	 size_t datasz, uint8_t *key)
+{
+	if ((int)algorithm < 0 || algorithm >= MAX_SECDB_TYPE) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (algorithm == X509_CERT) {
+		sha256(data->raw, datasz, key);
+		return 0;
+	}
+	if (datasz < key_sizes[algorithm]) {
+		errno = EINVAL;
+		return -1;
+	}
+	memcpy(key, data->raw, key_sizes[algorithm]);
+	return 0;
+}
+
+struct index_builder {
+	uint8_t *keys[MAX_SECDB_TYPE];
+	size_t counts[MAX_SECDB_TYPE];
+};
+
+static efi_secdb_visitor_status_t
+collect_key(unsigned int listnum UNUSED, unsigned int signum UNUSED,
+	    const efi_guid_t * const owner UNUSED,
+	    const efi_secdb_type_t algorithm,
+	    const void * const header UNUSED, const size_t headersz UNUSED,
+	    const efi_secdb_data_t * const data, const size_t datasz,
+	    void *closure)
+{
+	struct index_builder *builder = closure;
+	size_t keysz;
+	uint8_t *keys;
+
+	if ((int)algorithm < 0 || algorithm >= MAX_SECDB_TYPE)
+		return CONTINUE;
+	keysz = key_sizes[algorithm];
+
+	keys = efi_reallocarray(builder->keys[algorithm],
+				builder->counts[algorithm] + 1, keysz);
+	if (!keys) {
+		efi_error("could not allocate memory");
+		return ERROR;
+	}
+	builder->keys[algorithm] = keys;
+	keys += builder->counts[algorithm] * keysz;
+	if (make_key(algorithm, data, datasz, keys) < 0) {
+		debug("skipping short %d signature", algorithm);
+		return CONTINUE;
+	}
+	builder->counts[algorithm] += 1;
+	return CONTINUE;
+}
+
+static int
+cmp_keys(const void *a, const void *b, void *keyszp)
+{
+	return memcmp(a, b, *(size_t *)keyszp);
+}
+
+static size_t
+sort_unique(uint8_t *keys, size_t count, size_t keysz)
+{
+	size_t n = 0;
+
+	if (!count)
+		return 0;
+	qsort_r(keys, count, keysz, cmp_keys, &keysz);
+	for (size_t i = 1; i < count; i++) {
+		if (!memcmp(keys + n * keysz, keys + i * keysz, keysz))
+			continue;
+		n += 1;
+		if (n != i)
+			memcpy(keys + n * keysz, keys + i * keysz, keysz);
+	}
+	return n + 1;
+}
+
+int PUBLIC
+efi_secdb_index_build(efi_secdb_t *secdb, const uint8_t *source,
+		      size_t sourcesz, void **out, size_t *outsize)
+{
+	struct index_builder builder;
+	struct secdb_index_header *hdr;
+	struct secdb_index_table *table;
+	void *realized = NULL;
+	size_t size, offset, n_tables = 0;
+	uint8_t *buf;
+	int rc = -1;
+
+	if (!secdb || !out || !outsize) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+
+	memset(&builder, 0, sizeof(builder));
+	if (efi_secdb_visit_entries(secdb, collect_key, &builder) < 0) {
+		efi_error("could not collect signatures");
+		goto err;
+	}
+
+	if (!source) {
+		if (efi_secdb_realize(secdb, &realized, &sourcesz) < 0) {
+			efi_error("could not realize signature lists");
+			goto err;
+		}
+		source = realized;
+	}
+
+	size = sizeof(*hdr);
+	for (int i = 0; i < MAX_SECDB_TYPE; i++) {
+		builder.counts[i] = sort_unique(builder.keys[i],
+						builder.counts[i],
+						key_sizes[i]);
+		if (builder.counts[i])
+			n_tables += 1;
+	}
+	size += n_tables * sizeof(*table);
+	for (int i = 0; i < MAX_SECDB_TYPE; i++) {
+		size = ALIGN_UP(size, 8);
+		size += builder.counts[i] * key_sizes[i];
+	}
+
+	buf = efi_calloc(1, size);
+	if (!buf) {
+		efi_error("could not allocate memory");
+		goto err;
+	}
+
+	hdr = (struct secdb_index_header *)buf;
+	hdr->magic = SECDB_INDEX_MAGIC;
+	hdr->version = SECDB_INDEX_VERSION;
+	hdr->size = size;
+	sha256(source, sourcesz, hdr->source_digest);
+	hdr->n_tables = n_tables;
+
+	table = (struct secdb_index_table *)(buf + sizeof(*hdr));
+	offset = sizeof(*hdr) + n_tables * sizeof(*table);
+	for (int i = 0; i < MAX_SECDB_TYPE; i++) {
+		if (!builder.counts[i])
+			continue;
+		offset = ALIGN_UP(offset, 8);
+		table->algorithm = i;
+		table->key_size = key_sizes[i];
+		table->offset = offset;
+		table->count = builder.counts[i];
+		memcpy(buf + offset, builder.keys[i],
+		       builder.counts[i] * key_sizes[i]);
+		offset += builder.counts[i] * key_sizes[i];
+		table++;
+	}
+
+	*out = buf;
+	*outsize = size;
+	rc = 0;
+err:
+	for (int i = 0; i < MAX_SECDB_TYPE; i++)
+		efi_free(builder.keys[i]);
+	efi_free(realized);
+	return rc;
+}
+
+/*
+ * Everything a query touches is checked here, once, so that
+ * efi_secdb_index_contains() can trust the map.
+ */
+static int
+validate_index(efi_secdb_index_t *index)
+{
+	const struct secdb_index_header *hdr;
+	const struct secdb_index_table *table;
+	uint64_t end;
+
+	if (index->size < sizeof(*hdr))
+		goto bad;
+	hdr = (const struct secdb_index_header *)index->map;
+	if (hdr->magic != SECDB_INDEX_MAGIC ||
+	    hdr->version != SECDB_INDEX_VERSION ||
+	    hdr->size != index->size ||
+	    hdr->n_tables > MAX_SECDB_TYPE)
+		goto bad;
+
+	table = (const struct secdb_index_table *)(index->map + sizeof(*hdr));
+	if (sizeof(*hdr) + hdr->n_tables * sizeof(*table) > index->size)
+		goto bad;
+
+	for (uint32_t i = 0; i < hdr->n_tables; i++, table++) {
+		uint32_t alg = table->algorithm;
+
+		if (alg >= MAX_SECDB_TYPE ||
+		    table->key_size != key_sizes[alg] ||
+		    index->keys[alg] ||
+		    table->offset % 8 ||
+		    table->count > index->size / table->key_size ||
+		    ADD(table->offset, table->count * table->key_size, &end) ||
+		    end > index->size)
+			goto bad;
+		index->keys[alg] = index->map + table->offset;
+		index->counts[alg] = table->count;
+	}
+	return 0;
+bad:
+	errno = EINVAL;
+	efi_error("invalid secdb index");
+	return -1;
+}
+
+int PUBLIC
+efi_secdb_index_open(const char *path, efi_secdb_index_t **indexp)
+{
+	efi_secdb_index_t *index;
+	struct stat sb;
+	void *map;
+	int fd, rc;
+
+	if (!path || !indexp) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
+		efi_error("could not open \"%s\"", path);
+		return -1;
+	}
+	rc = fstat(fd, &sb);
+	if (rc < 0 || sb.st_size <= 0) {
+		if (rc == 0)
+			errno = EINVAL;
+		efi_error("could not stat \"%s\"", path);
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		efi_error("could not map \"%s\"", path);
+		return -1;
+	}
+
+	index = efi_calloc(1, sizeof(*index));
+	if (!index) {
+		efi_error("could not allocate memory");
+		munmap(map, sb.st_size);
+		return -1;
+	}
+	if (secdb_index_init(index, map, sb.st_size) < 0) {
+		efi_secdb_index_close(index);
+		return -1;
+	}
+	*indexp = index;
+	return 0;
+}
+
+int HIDDEN
+secdb_index_init(efi_secdb_index_t *index, const uint8_t *buf, size_t size)
+{
+	memset(index, 0, sizeof(*index));
+	index->map = buf;
+	index->size = size;
+	return validate_index(index);
+}
+
+void PUBLIC
+efi_secdb_index_close(efi_secdb_index_t *index)
+{
+	if (!index)
+		return;
+	munmap((void *)index->map, index->size);
+	efi_free(index);
+}
+
+int PUBLIC
+efi_secdb_index_contains(const efi_secdb_index_t *index,
+			 efi_secdb_type_t algorithm,
+			 const efi_secdb_data_t *data, size_t datasz)
+{
+	uint8_t key[sizeof(efi_rsa2048_sig_t)];
+	const uint8_t *keys;
+	size_t keysz, lo = 0, hi;
+
+	if (!index || !data || make_key(algorithm, data, datasz, key) < 0) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+
+	keys = index->keys[algorithm];
+	keysz = key_sizes[algorithm];
+	hi = index->counts[algorithm];
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int rc = memcmp(key, keys + mid * keysz, keysz);
+
+		if (rc == 0)
+			return 1;
+		if (rc < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return 0;
+}
+
+int PUBLIC
+efi_secdb_index_is_current(const efi_secdb_index_t *index,
+			   const uint8_t *source, size_t sourcesz)
+{
+	const struct secdb_index_header *hdr;
+	uint8_t digest[SHA256_DIGEST_SIZE];
+
+	if (!index || !source) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+
+	hdr = (const struct secdb_index_header *)index->map;
+	sha256(source, sourcesz, digest);
+	return !memcmp(digest, hdr->source_digest, sizeof(digest));
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * secdb-snapshot.c - immutable, shareable copies of a security database
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "efisec.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * A snapshot is one allocation: this header, the realized signature
+ * lists, and an index of them in the same format efi_secdb_index_build()
+ * writes.  Nothing in it changes after efi_secdb_freeze() returns except
+ * the reference count, so any number of threads can read it at once.
+ */
+struct efi_secdb_snapshot {
+	uint32_t refcount;
+	efi_secdb_index_t index;
+	size_t eslsz;
+	uint8_t data[] __attribute__((__aligned__(8)));
+};
+
+/*
+ * Where the current snapshot is published.  Readers count themselves in
+ * and out, on the counter the epoch's low bit picks, around taking a
+ * reference, and count again if the epoch moved before they were
+ * counted.  A publisher swaps the pointer, flips the epoch so new
+ * readers use the other counter, and waits for the old one to drain
+ * before dropping the old snapshot, so no reader can be left holding a
+ * pointer it hasn't referenced yet.  Readers that come along later can't
+ * hold the publisher up.  Publishers take the lock so that only one of
+ * them flips the epoch at a time.
+ */
+struct efi_secdb_current {
+	efi_secdb_snapshot_t *snapshot;
+	uint32_t epoch;
+	uint32_t readers[2];
+	pthread_mutex_t lock;
+};
+
+int PUBLIC
+efi_secdb_freeze(efi_secdb_t *secdb, efi_secdb_snapshot_t **snapshotp)
+{
+	efi_secdb_snapshot_t *snapshot = NULL;
+	void *esl = NULL, *index = NULL;
+	size_t eslsz = 0, indexsz = 0, offset, size;
+	int rc = -1;
+
+	if (!secdb || !snapshotp) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+
+	if (efi_secdb_realize(secdb, &esl, &eslsz) < 0) {
+		efi_error("could not realize signature lists");
+		return -1;
+	}
+	if (efi_secdb_index_build(secdb, esl, eslsz, &index, &indexsz) < 0) {
+		efi_error("could not index signature lists");
+		goto err;
+	}
+
+	offset = ALIGN_UP(eslsz, 8);
+	if (ADD(sizeof(*snapshot), offset, &size) ||
+	    ADD(size, indexsz, &size)) {
+		errno = EOVERFLOW;
+		efi_error("snapshot size would overflow");
+		goto err;
+	}
+	snapshot = efi_calloc(1, size);
+	if (!snapshot) {
+		efi_error("could not allocate memory");
+		goto err;
+	}
+	memcpy(snapshot->data, esl, eslsz);
+	memcpy(snapshot->data + offset, index, indexsz);
+	snapshot->eslsz = eslsz;
+	if (secdb_index_init(&snapshot->index, snapshot->data + offset,
+			     indexsz) < 0) {
+		efi_error("could not load index");
+		efi_free(snapshot);
+		goto err;
+	}
+	snapshot->refcount = 1;
+
+	*snapshotp = snapshot;
+	rc = 0;
+err:
+	efi_free(index);
+	efi_free(esl);
+	return rc;
+}
+
+efi_secdb_snapshot_t PUBLIC *
+efi_secdb_snapshot_get(efi_secdb_snapshot_t *snapshot)
+{
+	if (snapshot)
+		__atomic_add_fetch(&snapshot->refcount, 1, __ATOMIC_RELAXED);
+	return snapshot;
+}
+
+void PUBLIC
+efi_secdb_snapshot_put(efi_secdb_snapshot_t *snapshot)
+{
+	if (!snapshot)
+		return;
+	if (__atomic_sub_fetch(&snapshot->refcount, 1, __ATOMIC_ACQ_REL))
+		return;
+	efi_free(snapshot);
+}
+
+int PUBLIC
+efi_secdb_snapshot_contains(const efi_secdb_snapshot_t *snapshot,
+			    efi_secdb_type_t algorithm,
+			    const efi_secdb_data_t *data, size_t datasz)
+{
+	if (!snapshot) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+	return efi_secdb_index_contains(&snapshot->index, algorithm, data,
+					datasz);
+}
+
+int PUBLIC
+efi_secdb_snapshot_data(const efi_secdb_snapshot_t *snapshot,
+			const uint8_t **data, size_t *datasz)
+{
+	if (!snapshot || !data || !datasz) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+	*data = snapshot->data;
+	*datasz = snapshot->eslsz;
+	return 0;
+}
+
+/*
+ * This walks the realized lists rather than a secdb, so the visitor sees
+ * the entries in the order efi_secdb_realize() wrote them.
+ */
+int PUBLIC
+efi_secdb_snapshot_visit_entries(const efi_secdb_snapshot_t *snapshot,
+				 efi_secdb_visitor_t *visitor,
+				 void *closure)
+{
+	esl_iter *iter = NULL;
+	int listnum = -1, signum = 0;
+	int rc;
+
+	if (!snapshot || !visitor) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+	if (!snapshot->eslsz)
+		return 0;
+
+	rc = esl_iter_new(&iter, (uint8_t *)snapshot->data, snapshot->eslsz);
+	if (rc < 0) {
+		efi_error("could not iterate signature lists");
+		return -1;
+	}
+
+	while (true) {
+		efi_guid_t type, owner;
+		uint8_t *data = NULL;
+		size_t len = 0;
+		efi_secdb_visitor_status_t status;
+
+		rc = esl_iter_next(iter, &type, &owner, &data, &len);
+		if (rc == ESL_ITER_DONE)
+			break;
+		if (rc < 0) {
+			efi_error("could not get next signature");
+			break;
+		}
+		if (rc == ESL_ITER_NEW_LIST) {
+			listnum += 1;
+			signum = 0;
+		}
+
+		status = visitor(listnum, signum++, &owner,
+				 secdb_entry_type_from_guid(&type), NULL, 0,
+				 (efi_secdb_data_t *)data, len, closure);
+		if (status == ERROR) {
+			rc = -1;
+			break;
+		}
+		if (status == BREAK) {
+			rc = 0;
+			break;
+		}
+	}
+	esl_iter_end(iter);
+	return rc < 0 ? -1 : 0;
+}
+
+int PUBLIC
+efi_secdb_snapshot_thaw(const efi_secdb_snapshot_t *snapshot,
+			efi_secdb_t **secdbp)
+{
+	efi_secdb_t *secdb;
+
+	if (!snapshot || !secdbp) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+
+	secdb = efi_secdb_new();
+	if (!secdb) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	if (snapshot->eslsz &&
+	    efi_secdb_parse((uint8_t *)snapshot->data, snapshot->eslsz,
+			    &secdb) < 0) {
+		efi_error("could not parse signature lists");
+		efi_secdb_free(secdb);
+		return -1;
+	}
+	*secdbp = secdb;
+	return 0;
+}
+
+int PUBLIC
+efi_secdb_current_new(efi_secdb_current_t **currentp)
+{
+	if (!currentp) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+	*currentp = efi_calloc(1, sizeof(**currentp));
+	if (!*currentp) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	pthread_mutex_init(&(*currentp)->lock, NULL);
+	return 0;
+}
+
+efi_secdb_snapshot_t PUBLIC *
+efi_secdb_current_acquire(efi_secdb_current_t *current)
+{
+	efi_secdb_snapshot_t *snapshot;
+	uint32_t *readers;
+	uint32_t epoch;
+
+	if (!current) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return NULL;
+	}
+
+	/*
+	 * A publisher that flipped the epoch between our load of it and our
+	 * count may already have stopped waiting on that counter, and the
+	 * next one will wait on the other, so count ourselves again.
+	 */
+	while (true) {
+		epoch = __atomic_load_n(&current->epoch, __ATOMIC_SEQ_CST);
+		readers = &current->readers[epoch & 1];
+		__atomic_add_fetch(readers, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&current->epoch, __ATOMIC_SEQ_CST) == epoch)
+			break;
+		__atomic_sub_fetch(readers, 1, __ATOMIC_SEQ_CST);
+	}
+	snapshot = __atomic_load_n(&current->snapshot, __ATOMIC_SEQ_CST);
+	efi_secdb_snapshot_get(snapshot);
+	__atomic_sub_fetch(readers, 1, __ATOMIC_SEQ_CST);
+
+	return snapshot;
+}
+
+int PUBLIC
+efi_secdb_current_publish(efi_secdb_current_t *current,
+			  efi_secdb_snapshot_t *snapshot)
+{
+	efi_secdb_snapshot_t *old;
+	uint32_t epoch;
+
+	if (!current) {
+		errno = EINVAL;
+		efi_error("invalid argument");
+		return -1;
+	}
+
+	efi_secdb_snapshot_get(snapshot);
+	pthread_mutex_lock(&current->lock);
+	old = __atomic_exchange_n(&current->snapshot, snapshot,
+				  __ATOMIC_SEQ_CST);
+	/*
+	 * Anyone who loaded old counted themselves in before that, and so
+	 * before the flip, on the counter for the old epoch.  Once it's zero
+	 * they've all taken their references.
+	 */
+	epoch = __atomic_fetch_add(&current->epoch, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&current->readers[epoch & 1],
+			       __ATOMIC_SEQ_CST))
+		sched_yield();
+	pthread_mutex_unlock(&current->lock);
+
+	efi_secdb_snapshot_put(old);
+	return 0;
+}
+
+void PUBLIC
+efi_secdb_current_free(efi_secdb_current_t *current)
+{
+	if (!current)
+		return;
+	efi_secdb_snapshot_put(current->snapshot);
+	pthread_mutex_destroy(&current->lock);
+	efi_free(current);
+}
+
+// vim:fenc=utf-8:tw=75:noet
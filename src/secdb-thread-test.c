@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * secdb-thread-test.c - stress publishing and acquiring secdb snapshots
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <alloca.h>
+#include <efisec.h>
+#include <err.h>
+#include <errno.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+static int verbosity = 0;
+static unsigned long publish_count = 20000;
+
+static efi_secdb_t *secdb;
+static efi_secdb_current_t *current;
+static uint8_t *expected;
+static size_t expectedsz;
+static bool publishing = true;
+
+/*
+ * Scribble over everything libefisec frees, so a reader that picks up a
+ * snapshot after its last reference is gone sees the wrong data instead
+ * of the right data that happens to still be there.
+ */
+static void *
+poison_malloc(size_t size, void *ctx __attribute__((__unused__)))
+{
+	return malloc(size);
+}
+
+static void *
+poison_realloc(void *ptr, size_t size, void *ctx __attribute__((__unused__)))
+{
+	return realloc(ptr, size);
+}
+
+static void
+poison_free(void *ptr, void *ctx __attribute__((__unused__)))
+{
+	if (ptr)
+		memset(ptr, 0x5a, malloc_usable_size(ptr));
+	free(ptr);
+}
+
+static const efi_allocator_t poison_allocator = {
+	.malloc = poison_malloc,
+	.realloc = poison_realloc,
+	.free = poison_free,
+};
+
+#define TEST_SUCCESS NULL
+#define TEST_FAIL ((void*)1)
+
+static void *
+publisher(void *_ __attribute__((__unused__)))
+{
+	void *result = TEST_SUCCESS;
+
+	for (unsigned long i = 0; i < publish_count; i++) {
+		efi_secdb_snapshot_t *snapshot = NULL;
+
+		if (efi_secdb_freeze(secdb, &snapshot) < 0 ||
+		    efi_secdb_current_publish(current, snapshot) < 0) {
+			warn("could not publish snapshot %lu", i);
+			efi_secdb_snapshot_put(snapshot);
+			result = TEST_FAIL;
+			break;
+		}
+		efi_secdb_snapshot_put(snapshot);
+	}
+	__atomic_store_n(&publishing, false, __ATOMIC_RELEASE);
+	return result;
+}
+
+static void *
+reader(void *_ __attribute__((__unused__)))
+{
+	unsigned long reads = 0;
+
+	while (__atomic_load_n(&publishing, __ATOMIC_ACQUIRE)) {
+		efi_secdb_snapshot_t *snapshot;
+		const uint8_t *data = NULL;
+		size_t datasz = 0;
+		bool ok;
+
+		snapshot = efi_secdb_current_acquire(current);
+		if (!snapshot) {
+			warnx("no snapshot after %lu reads", reads);
+			return TEST_FAIL;
+		}
+		ok = efi_secdb_snapshot_data(snapshot, &data, &datasz) >= 0 &&
+		     datasz == expectedsz && !memcmp(data, expected, datasz);
+		efi_secdb_snapshot_put(snapshot);
+		if (!ok) {
+			warnx("snapshot was freed under a reader after %lu reads",
+			      reads);
+			return TEST_FAIL;
+		}
+		/* on a single CPU, let the publisher keep up */
+		if (++reads % 16 == 0)
+			sched_yield();
+	}
+	if (verbosity >= 1)
+		printf("[READER] %lu reads\n", reads);
+	return TEST_SUCCESS;
+}
+
+static int
+setup(void)
+{
+	efi_secdb_snapshot_t *snapshot = NULL;
+	efi_secdb_data_t hash;
+	const uint8_t *data;
+	int rc = -1;
+
+	secdb = efi_secdb_new();
+	if (!secdb)
+		return -1;
+	memset(&hash, 0xa5, sizeof(hash.sha256));
+	if (efi_secdb_add_entry(secdb, &efi_guid_zero, SHA256, &hash,
+				sizeof(hash.sha256)) < 0 ||
+	    efi_secdb_freeze(secdb, &snapshot) < 0 ||
+	    efi_secdb_snapshot_data(snapshot, &data, &expectedsz) < 0)
+		goto out;
+	expected = malloc(expectedsz);
+	if (!expected)
+		goto out;
+	memcpy(expected, data, expectedsz);
+
+	if (efi_secdb_current_new(&current) < 0 ||
+	    efi_secdb_current_publish(current, snapshot) < 0)
+		goto out;
+	rc = 0;
+out:
+	efi_secdb_snapshot_put(snapshot);
+	return rc;
+}
+
+static int
+multithreaded_test(size_t count)
+{
+	pthread_t *threads = alloca(sizeof(pthread_t) * (count + 1));
+	void *worst_result = TEST_SUCCESS;
+	size_t i;
+
+	for (i = 0; i < count + 1; i++) {
+		if (pthread_create(&threads[i], NULL,
+				   i == 0 ? publisher : reader, NULL) != 0) {
+			warnx("pthread_create failed");
+			__atomic_store_n(&publishing, false, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+	count = i;
+	for (i = 0; i < count; i++) {
+		void *result;
+
+		if (pthread_join(threads[i], &result) != 0) {
+			warnx("pthread_join failed");
+			return 1;
+		}
+		if (result != TEST_SUCCESS)
+			worst_result = result;
+	}
+	return worst_result == TEST_SUCCESS ? 0 : -1;
+}
+
+static void __attribute__((__noreturn__))
+usage(int ret)
+{
+	FILE *out = ret == 0 ? stdout : stderr;
+	fprintf(out,
+		"Usage: %s [OPTION...]\n"
+		"  -v, --verbose                     be more verbose\n"
+		"  -t, --thread-count N              use N reader threads\n"
+		"  -n, --publish-count N             publish N snapshots\n"
+		"Help options:\n"
+		"  -?, --help                        Show this help message\n"
+		"      --usage                       Display brief usage message\n",
+		program_invocation_short_name);
+	exit(ret);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long thread_count = 8;
+	char *sopts = "vt:n:?";
+	struct option lopts[] = {
+		{"help", no_argument, 0, '?'},
+		{"publish-count", required_argument, 0, 'n'},
+		{"quiet", no_argument, 0, 'q'},
+		{"thread-count", required_argument, 0, 't'},
+		{"usage", no_argument, 0, 0},
+		{"verbose", no_argument, 0, 'v'},
+		{0, 0, 0, 0},
+	};
+	int c;
+	int i;
+	int rc;
+
+	while ((c = getopt_long(argc, argv, sopts, lopts, &i)) != -1) {
+		switch (c) {
+		case 'n':
+			publish_count = strtoul(optarg, NULL, 0);
+			if (errno == ERANGE || errno == EINVAL)
+				err(1, "invalid argument for -n: %s", optarg);
+			break;
+		case 'q':
+			verbosity -= 1;
+			break;
+		case 't':
+			thread_count = strtoul(optarg, NULL, 0);
+			if (errno == ERANGE || errno == EINVAL)
+				err(1, "invalid argument for -t: %s", optarg);
+			break;
+		case 'v':
+			verbosity += 1;
+			break;
+		case '?':
+			usage(EXIT_SUCCESS);
+			break;
+		case 0:
+			if (strcmp(lopts[i].name, "usage"))
+				usage(EXIT_SUCCESS);
+			break;
+		}
+	}
+
+	efi_set_allocator(&poison_allocator);
+	if (setup() < 0)
+		err(1, "could not set up the snapshot");
+
+	if (verbosity >= 1)
+		printf("%lu readers, %lu publishes\n", thread_count,
+		       publish_count);
+	rc = multithreaded_test(thread_count);
+	if (verbosity >= 0)
+		printf("secdb thread test %s\n", rc == 0 ? "passed" : "failed");
+
+	efi_secdb_current_free(current);
+	efi_secdb_free(secdb);
+	free(expected);
+	return rc;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -15,7 +15,7 @@ PUBLIC efi_secdb_t *
 efi_secdb_new(void)
 {
 	debug("Allocating new secdb");
-	efi_secdb_t *secdb = calloc(1, sizeof(*secdb));
+	efi_secdb_t *secdb = efi_calloc(1, sizeof(*secdb));
 	if (!secdb) {
 		efi_error("Could not allocate %zd bytes of memory", sizeof(*secdb));
 		return NULL;
@@ -37,18 +37,18 @@ efi_secdb_new(void)
 static inline efi_secdb_t *
 find_secdb_entry(efi_secdb_t *top, efi_secdb_type_t algorithm, size_t datasz)
 {
+	const secdb_alg_t *alg = secdb_alg_from_type(algorithm);
 	efi_secdb_t *secdb = NULL;
 	list_t *pos;
 	size_t sigsz = datasz + sizeof(efi_guid_t);
-	char *algstr = NULL;
 
+	if (!alg)
+		return NULL;
 	if (algorithm != X509_CERT)
-		sigsz = secdb_entry_size_from_type(algorithm);
+		sigsz = secdb_alg_entry_size(alg);
 
-	efi_guid_to_id_guid(secdb_guid_from_type(algorithm), &algstr);
-	debug("searching for entry with type:%s sz:%zd(0x%zx) datasz:%zd(0x%zx)",
-	      algstr, sigsz, sigsz, datasz, datasz);
-	xfree(algstr);
+	debug("searching for entry with type:%d sz:%zd(0x%zx) datasz:%zd(0x%zx)",
+	      algorithm, sigsz, sigsz, datasz, datasz);
 
 	for_each_secdb_prev(pos, &top->list) {
 		efi_secdb_t *candidate = list_entry(pos, efi_secdb_t, list);
@@ -72,11 +72,14 @@ alloc_secdb_entry(efi_secdb_t *top,
 		  efi_secdb_type_t algorithm,
 		  size_t datasz)
 {
+	const secdb_alg_t *alg = secdb_alg_from_type(algorithm);
 	efi_secdb_t *secdb = NULL;
 	size_t sigsz = datasz;
 
+	if (!alg)
+		return NULL;
 	if (algorithm != X509_CERT)
-		sigsz = secdb_entry_size_from_type(algorithm);
+		sigsz = secdb_alg_entry_size(alg);
 
 	debug("allocating new secdb entry alg %d", algorithm);
 	secdb = efi_secdb_new();
@@ -86,7 +89,8 @@ alloc_secdb_entry(efi_secdb_t *top,
 	INIT_LIST_HEAD(&secdb->entries);
 	INIT_LIST_HEAD(&secdb->list);
 	secdb->algorithm = algorithm;
-	secdb->hdrsz = secdb_header_size_from_type(algorithm);
+	secdb->alg = alg;
+	secdb->hdrsz = alg->header_size;
 	secdb->sigsz = sigsz;
 	secdb->flags = top->flags;
 	debug("Adding secdb:%p to top:%p with hdrsz:%"PRIu32"(0x%"PRIx32") sigsz:%"PRIu32"(0x%"PRIx32")",
@@ -105,11 +109,14 @@ find_or_alloc_secdb_entry(efi_secdb_t *top,
 			  efi_secdb_type_t algorithm,
 			  size_t datasz)
 {
+	const secdb_alg_t *alg = secdb_alg_from_type(algorithm);
 	efi_secdb_t *secdb = NULL;
 	size_t sigsz = datasz;
 
+	if (!alg)
+		return NULL;
 	if (algorithm != X509_CERT)
-		sigsz = secdb_entry_size_from_type(algorithm);
+		sigsz = secdb_alg_entry_size(alg);
 
 	secdb = find_secdb_entry(top, algorithm, datasz);
 	if (!secdb) {
@@ -120,6 +127,7 @@ find_or_alloc_secdb_entry(efi_secdb_t *top,
 			return NULL;
 	}
 	secdb->algorithm = algorithm;
+	secdb->alg = alg;
 	secdb->sigsz = sigsz;
 
 	return secdb;
@@ -135,16 +143,17 @@ efi_secdb_del_entry(efi_secdb_t *top,
 		    efi_secdb_data_t *data,
 		    size_t datasz)
 {
+	const secdb_alg_t *alg = secdb_alg_from_type(algorithm);
 	efi_secdb_t *secdb;
 	list_t *pos;
 	size_t sigsz = datasz;
-	bool has_owner = false;
-
-	if (algorithm != X509_CERT)
-		sigsz = secdb_entry_size_from_type(algorithm);
+	bool has_owner;
 
-	if (secdb_entry_has_owner_from_type(algorithm, &has_owner) < 0)
+	if (!alg)
 		return -1;
+	if (algorithm != X509_CERT)
+		sigsz = secdb_alg_entry_size(alg);
+	has_owner = alg->has_owner;
 
 	if (has_owner)
 		sigsz -= sizeof(efi_guid_t);
@@ -162,10 +171,11 @@ efi_secdb_del_entry(efi_secdb_t *top,
 		secdb_entry_t *entry = list_entry(pos, secdb_entry_t, list);
 
 		if (!memcmp(data, &entry->data, sigsz) &&
-		    (!has_owner || !efi_guid_cmp(owner, &entry->owner))) {
+		    (!has_owner || efi_guid_equal_(owner, &entry->owner))) {
 			debug("deleting entry at %p\n", &entry);
 			list_del(&entry->list);
-			free(entry);
+			efi_free(entry);
+			EFIVAR_PROBE3(secdb_del_entry, top, algorithm, datasz);
 			break;
 		}
 	}
@@ -187,7 +197,7 @@ secdb_add_entry_data(efi_secdb_t *secdb,
 	}
 
 	allocsz = offsetof(secdb_entry_t, data) + datasz;
-	new = calloc(1, allocsz);
+	new = efi_calloc(1, allocsz);
 	if (!new)
 		return -1;
 
@@ -221,9 +231,10 @@ efi_secdb_add_entry_or_secdb(efi_secdb_t *top,
 			     size_t datasz,
 			     bool force_new_secdb)
 {
+	const secdb_alg_t *alg = secdb_alg_from_type(algorithm);
 	list_t *pos;
 	efi_secdb_t *secdb = NULL;
-	bool has_owner = false;
+	bool has_owner;
 	size_t sigsz;
 	bool sort = false;
 	bool sort_data = false;
@@ -236,15 +247,17 @@ efi_secdb_add_entry_or_secdb(efi_secdb_t *top,
 		return -1;
 	}
 
-	if (secdb_entry_has_owner_from_type(algorithm, &has_owner) < 0)
+	if (!alg)
 		return -1;
+	has_owner = alg->has_owner;
 
 	sigsz = datasz + (has_owner ? sizeof(*owner) : 0);
 
 	if (force_new_secdb) {
 		debug("forcing new secdb entry (has_owner:%d)", has_owner);
 		secdb = alloc_secdb_entry(top, algorithm, sigsz);
-		secdb->algorithm = algorithm;
+		if (!secdb)
+			return -1;
 		secdb->sigsz = sigsz;
 	} else {
 		debug("finding secdb alg:%d datasz:%zd(0x%zx) sigsz:%zd(0x%zx) has_owner:%d",
@@ -278,6 +291,7 @@ efi_secdb_add_entry_or_secdb(efi_secdb_t *top,
 			              : secdb_cmp;
 		list_sort(&top->list, cmp, NULL);
 	}
+	EFIVAR_PROBE4(secdb_add_entry, top, algorithm, datasz, secdb->nsigs);
 
 	return 0;
 }
@@ -331,6 +345,7 @@ efi_secdb_parse(uint8_t *data, size_t datasz, efi_secdb_t **secdbp)
 	bool new_secdb = false;
 	bool sort = false;
 	bool sort_descending = true;
+	efi_trace_scope("efi_secdb_parse", "%zu bytes", datasz);
 
 	if (!data || !datasz) {
 		efi_error("Invalid secdb data (data=%p datasz=%zd(0x%zx))",
@@ -365,11 +380,18 @@ efi_secdb_parse(uint8_t *data, size_t datasz, efi_secdb_t **secdbp)
 		return rc;
 	}
 
+	/*
+	 * Consecutive entries are almost always from the same list, so only
+	 * look the type up again when the type guid changes.
+	 */
+	efi_guid_t secdb_type_guid = { 0, };
+	efi_guid_t last_type_guid = { 0, };
+	efi_secdb_type_t secdb_type = -1;
+
 	do {
 		uint8_t *sig = NULL;
 		size_t sigsz = 0;
-		efi_guid_t secdb_type_guid, owner;
-		efi_secdb_type_t secdb_type;
+		efi_guid_t owner;
 		bool corrected = false;
 		bool force = false;
 
@@ -389,7 +411,7 @@ efi_secdb_parse(uint8_t *data, size_t datasz, efi_secdb_t **secdbp)
 			efi_error("Could not get next security database entry");
 			esl_iter_end(iter);
 			if (new_secdb)
-				free(secdb);
+				efi_free(secdb);
 			return rc;
 		}
 		if (rc == ESL_ITER_DONE)
@@ -398,8 +420,12 @@ efi_secdb_parse(uint8_t *data, size_t datasz, efi_secdb_t **secdbp)
 		if (new_secdb)
 			secdb->sigsz = sigsz;
 		debug("sigsz:%zd", sigsz);
-                secdb_type = secdb_entry_type_from_guid(&secdb_type_guid);
-		debug("secdb_type:%d", secdb_type);
+		if (secdb_type < 0 ||
+		    !efi_guid_equal_(&secdb_type_guid, &last_type_guid)) {
+			secdb_type = secdb_entry_type_from_guid(&secdb_type_guid);
+			last_type_guid = secdb_type_guid;
+			debug("secdb_type:%d", secdb_type);
+		}
 
 		if (corrected)
 			force = true;
@@ -436,11 +462,366 @@ efi_secdb_parse(uint8_t *data, size_t datasz, efi_secdb_t **secdbp)
 	return 0;
 }
 
+/*
+ * Magic number at the front of efi_variable_export() output; see export.c
+ */
+#define EFIVAR_EXPORT_MAGIC 0xf3df1597u
+
+/*
+ * Is there something at data that looks like the start of an ESL we know
+ * how to parse?  This is only a sniff test; efi_secdb_parse() does the
+ * real validation.
+ */
+static bool
+looks_like_esl(const uint8_t *data, size_t datasz)
+{
+	efi_signature_list_t esl;
+	uint32_t payload;
+
+	if (datasz < sizeof(esl))
+		return false;
+	memcpy(&esl, data, sizeof(esl));
+
+	if (secdb_entry_type_from_guid(&esl.signature_type) < 0)
+		return false;
+	if (esl.signature_list_size < sizeof(esl) ||
+	    esl.signature_list_size > datasz)
+		return false;
+	if (SUB(esl.signature_list_size, sizeof(esl), &payload) ||
+	    SUB(payload, esl.signature_header_size, &payload))
+		return false;
+	if (esl.signature_size == 0 || payload % esl.signature_size)
+		return false;
+	return true;
+}
+
+int PUBLIC
+efi_secdb_sniff_format(const uint8_t *data, size_t datasz,
+		       efi_secdb_format_t *format, size_t *offset)
+{
+	win_certificate_header_t hdr;
+	size_t auth_offset;
+	uint32_t u32;
+
+	if (!data || !format || !offset) {
+		efi_error("Invalid argument (data=%p format=%p offset=%p)",
+			  data, format, offset);
+		errno = EINVAL;
+		return -1;
+	}
+
+	*format = EFI_SECDB_FORMAT_UNKNOWN;
+	*offset = 0;
+
+	if (looks_like_esl(data, datasz)) {
+		*format = EFI_SECDB_FORMAT_ESL;
+		goto out;
+	}
+
+	if (datasz < sizeof(u32))
+		goto out;
+	memcpy(&u32, data, sizeof(u32));
+
+	if (u32 == EFIVAR_EXPORT_MAGIC) {
+		*format = EFI_SECDB_FORMAT_EXPORT;
+		goto out;
+	}
+
+	if (!(u32 & ~0x7ffu) &&
+	    looks_like_esl(data + sizeof(u32), datasz - sizeof(u32))) {
+		*format = EFI_SECDB_FORMAT_ESL_ATTRS;
+		*offset = sizeof(u32);
+		goto out;
+	}
+
+	if (datasz < sizeof(efi_variable_authentication_2_t))
+		goto out;
+	memcpy(&hdr, data + offsetof(efi_variable_authentication_2_t,
+				     auth_info.hdr),
+	       sizeof(hdr));
+	if (hdr.revision != WIN_CERT_REVISION_2_0 ||
+	    hdr.cert_type != WIN_CERT_TYPE_EFI_GUID ||
+	    hdr.length < sizeof(win_certificate_uefi_guid_t))
+		goto out;
+	if (ADD(offsetof(efi_variable_authentication_2_t, auth_info),
+		hdr.length, &auth_offset) ||
+	    auth_offset > datasz)
+		goto out;
+	/*
+	 * An authenticated write with an empty payload is legitimate (it
+	 * deletes the variable), so don't insist on an ESL after it.
+	 */
+	if (auth_offset == datasz ||
+	    looks_like_esl(data + auth_offset, datasz - auth_offset)) {
+		*format = EFI_SECDB_FORMAT_AUTH2;
+		*offset = auth_offset;
+	}
+
+out:
+	debug("format:%d offset:%zd", *format, *offset);
+	return 0;
+}
+
+/*
+ * sniff the format and parse the ESLs inside it, exactly once
+ */
+int PUBLIC
+efi_secdb_parse_any(uint8_t *data, size_t datasz, efi_secdb_t **secdbp)
+{
+	efi_secdb_format_t format;
+	efi_variable_t *var = NULL;
+	uint8_t *vardata = NULL;
+	size_t vardatasz = 0;
+	size_t offset;
+	int rc;
+
+	rc = efi_secdb_sniff_format(data, datasz, &format, &offset);
+	if (rc < 0)
+		return rc;
+
+	switch (format) {
+	case EFI_SECDB_FORMAT_EXPORT:
+		if (efi_variable_import(data, datasz, &var) < 0) {
+			efi_error("Could not import exported variable");
+			return -1;
+		}
+		rc = efi_variable_get_data(var, &vardata, &vardatasz);
+		if (rc < 0) {
+			efi_error("Exported variable has no data");
+		} else {
+			rc = efi_secdb_parse(vardata, vardatasz, secdbp);
+		}
+		efi_variable_free(var, true);
+		return rc;
+	case EFI_SECDB_FORMAT_AUTH2:
+		if (offset == datasz) {
+			efi_error("Authenticated variable has no payload");
+			errno = ENODATA;
+			return -1;
+		}
+		/* fallthrough */
+	case EFI_SECDB_FORMAT_ESL:
+	case EFI_SECDB_FORMAT_ESL_ATTRS:
+		return efi_secdb_parse(data + offset, datasz - offset, secdbp);
+	case EFI_SECDB_FORMAT_UNKNOWN:
+	default:
+		/*
+		 * Let efi_secdb_parse() have a go; it knows how to fix up
+		 * some malformed lists that the sniffer won't vouch for.
+		 */
+		return efi_secdb_parse(data, datasz, secdbp);
+	}
+}
+
+static int
+write_all(int fd, const uint8_t *buf, size_t size)
+{
+	while (size > 0) {
+		ssize_t sz = write(fd, buf, size);
+
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += sz;
+		size -= sz;
+	}
+	return 0;
+}
+
+/*
+ * Filter the ESLs in data into outfd.  Each list is copied into a single
+ * buffer, header first, then only the signatures the filter keeps, and
+ * is written out once its size is known; the buffer only ever grows to
+ * the size of the largest input list.
+ */
+static int
+filter_esls(uint8_t *data, size_t datasz, efi_secdb_filter_t *filter,
+	    void *closure, int outfd, size_t *outsize)
+{
+	esl_list_iter *iter = NULL;
+	uint8_t *buf = NULL;
+	size_t bufsz = 0;
+	size_t written = 0;
+	int ret = -1;
+	int rc;
+
+	rc = esl_list_iter_new(&iter, data, datasz);
+	if (rc < 0) {
+		efi_error("Could not iterate security database");
+		return rc;
+	}
+
+	while (true) {
+		efi_signature_data_t *esd = NULL;
+		efi_signature_list_t *esl;
+		const secdb_alg_t *alg;
+		efi_secdb_type_t algorithm = MAX_SECDB_TYPE;
+		bool has_owner = true;
+		efi_guid_t type;
+		size_t sigsz = 0, hdrsz = 0, listsz = 0;
+		size_t nsigs, outsz;
+
+		rc = esl_list_iter_next(iter, &type, &esd, &sigsz);
+		if (rc < 0) {
+			efi_error("Could not get next signature list");
+			goto err;
+		}
+		if (rc == 0)
+			break;
+
+		if (esl_list_header_size(iter, &hdrsz) < 0 ||
+		    esl_list_signature_list_size(iter, &listsz) < 0 ||
+		    sigsz < 1 ||
+		    listsz < sizeof(*esl) + hdrsz) {
+			efi_error("EFI_SIGNATURE_LIST is malformed");
+			errno = EINVAL;
+			goto err;
+		}
+		nsigs = (listsz - sizeof(*esl) - hdrsz) / sigsz;
+
+		/*
+		 * Unknown types are still handed to the filter, as
+		 * MAX_SECDB_TYPE, so it can decide what to do with them.
+		 */
+		alg = secdb_alg_from_guid(&type);
+		if (alg) {
+			algorithm = alg - efi_secdb_algs_;
+			has_owner = alg->has_owner;
+		}
+		if (has_owner && sigsz < sizeof(efi_guid_t)) {
+			efi_error("signature size %zd is too small", sigsz);
+			errno = EINVAL;
+			goto err;
+		}
+
+		if (listsz > bufsz) {
+			uint8_t *newbuf = efi_realloc(buf, listsz);
+
+			if (!newbuf) {
+				efi_error("could not allocate %zd bytes", listsz);
+				goto err;
+			}
+			buf = newbuf;
+			bufsz = listsz;
+		}
+
+		/* the list and signature headers are right before the data */
+		memcpy(buf, (uint8_t *)esd - hdrsz - sizeof(*esl),
+		       sizeof(*esl) + hdrsz);
+		outsz = sizeof(*esl) + hdrsz;
+
+		for (size_t i = 0; i < nsigs; i++) {
+			uint8_t *sig = (uint8_t *)esd + i * sigsz;
+			const efi_guid_t *owner = NULL;
+			size_t skip = 0;
+
+			if (has_owner) {
+				owner = (const efi_guid_t *)sig;
+				skip = sizeof(efi_guid_t);
+			}
+			rc = filter(owner, algorithm,
+				    (const efi_secdb_data_t *)(sig + skip),
+				    sigsz - skip, closure);
+			if (rc < 0)
+				goto err;
+			if (rc == 0)
+				continue;
+			memcpy(buf + outsz, sig, sigsz);
+			outsz += sigsz;
+		}
+
+		debug("list of type " GUID_FORMAT " kept %zd of %zd bytes",
+		      GUID_FORMAT_ARGS(&type), outsz, listsz);
+		if (outsz == sizeof(*esl) + hdrsz)
+			continue;
+
+		esl = (efi_signature_list_t *)buf;
+		esl->signature_list_size = outsz;
+		if (outfd >= 0 && write_all(outfd, buf, outsz) < 0) {
+			efi_error("could not write signature list");
+			goto err;
+		}
+		written += outsz;
+	}
+
+	if (outsize)
+		*outsize = written;
+	ret = 0;
+err:
+	efi_free(buf);
+	esl_list_iter_end(iter);
+	return ret;
+}
+
+/*
+ * sniff the format and filter the ESLs inside it without building a secdb
+ */
+int PUBLIC
+efi_secdb_filter_stream(uint8_t *data, size_t datasz,
+			efi_secdb_filter_t *filter, void *closure,
+			int outfd, size_t *outsize)
+{
+	efi_secdb_format_t format;
+	efi_variable_t *var = NULL;
+	uint8_t *vardata = NULL;
+	size_t vardatasz = 0;
+	size_t offset;
+	int rc;
+
+	if (!data || !filter) {
+		efi_error("invalid argument");
+		errno = EINVAL;
+		return -1;
+	}
+	if (outsize)
+		*outsize = 0;
+
+	rc = efi_secdb_sniff_format(data, datasz, &format, &offset);
+	if (rc < 0)
+		return rc;
+
+	switch (format) {
+	case EFI_SECDB_FORMAT_EXPORT:
+		if (efi_variable_import(data, datasz, &var) < 0) {
+			efi_error("Could not import exported variable");
+			return -1;
+		}
+		rc = efi_variable_get_data(var, &vardata, &vardatasz);
+		if (rc < 0) {
+			efi_error("Exported variable has no data");
+		} else {
+			rc = filter_esls(vardata, vardatasz, filter, closure,
+					 outfd, outsize);
+		}
+		efi_variable_free(var, true);
+		return rc;
+	case EFI_SECDB_FORMAT_AUTH2:
+	case EFI_SECDB_FORMAT_ESL_ATTRS:
+		/*
+		 * An empty payload filters to nothing.
+		 */
+		if (offset == datasz)
+			return 0;
+		/* fallthrough */
+	case EFI_SECDB_FORMAT_ESL:
+		return filter_esls(data + offset, datasz - offset, filter,
+				   closure, outfd, outsize);
+	case EFI_SECDB_FORMAT_UNKNOWN:
+	default:
+		efi_error("Input is not a signature list");
+		errno = EINVAL;
+		return -1;
+	}
+}
+
 struct visitor_state {
 	/* listnum from the previous invocation */
 	unsigned int listnum;
 
 	efi_signature_list_t *esl;
+	const secdb_alg_t *alg;
 
 	char *buf;
 	size_t pos;
@@ -461,26 +842,30 @@ secdb_realize_visitor(unsigned int listnum,
 		      void *closure)
 {
 	struct visitor_state *state = closure;
-	const efi_guid_t *alg = secdb_guid_from_type(algorithm);
+	bool new_list = listnum > state->listnum || signum == 0;
 	char *buf;
 	size_t allocsz, esdsz;
 	ptrdiff_t skew;
 	efi_signature_list_t *esl;
 	efi_signature_data_t *esd;
-	bool has_owner = true;
-	int rc;
+	bool has_owner;
 
-	rc = secdb_entry_has_owner_from_type(algorithm, &has_owner);
-	if (rc < 0)
-		efi_error("could not determine signature type");
+	if (new_list || !state->alg) {
+		state->alg = secdb_alg_from_type(algorithm);
+		if (!state->alg) {
+			efi_error("could not determine signature type");
+			return ERROR;
+		}
+	}
+	has_owner = state->alg->has_owner;
 
 	esdsz = datasz + (has_owner ? sizeof(efi_guid_t) : 0);
 
 	debug("listnum:%d signum:%d has_owner:%d", listnum, signum, has_owner);
-	if (listnum > state->listnum || signum == 0) {
+	if (new_list) {
 		allocsz = state->pos + sizeof(state->esl) + headersz + esdsz;
 		allocsz = ALIGN_UP(allocsz, page_size);
-		buf = realloc(state->buf, allocsz);
+		buf = efi_realloc(state->buf, allocsz);
 		if (!buf) {
 			efi_error("could not allocate %zd bytes", allocsz);
 			return ERROR;
@@ -490,7 +875,8 @@ secdb_realize_visitor(unsigned int listnum,
 		state->esl = esl;
 		memset(buf + state->pos, 0, allocsz - state->pos);
 
-		memcpy(&esl->signature_type, alg, sizeof(efi_guid_t));
+		memcpy(&esl->signature_type, state->alg->guid,
+		       sizeof(efi_guid_t));
 		esl->signature_list_size = sizeof(efi_signature_list_t) + headersz;
 		esl->signature_header_size = headersz;
 		esl->signature_size = esdsz;
@@ -501,7 +887,7 @@ secdb_realize_visitor(unsigned int listnum,
 		esd = (efi_signature_data_t *)(buf + state->pos);
 	} else {
 		allocsz = ALIGN_UP(state->pos + esdsz, page_size);
-		buf = realloc(state->buf, allocsz);
+		buf = efi_realloc(state->buf, allocsz);
 		skew = buf - state->buf;
 		if (!buf) {
 			efi_error("could not allocate %zd bytes", allocsz);
@@ -533,8 +919,10 @@ efi_secdb_realize(efi_secdb_t *secdb, void **out, size_t *outsize)
 {
 
 	struct visitor_state state = { 0, };
+	efi_trace_scope("efi_secdb_realize", NULL);
 
-	state.buf = calloc(1, page_size);
+	EFIVAR_PROBE1(secdb_realize_start, secdb);
+	state.buf = efi_calloc(1, page_size);
 	state.esl = (efi_signature_list_t *)state.buf;
 	if (!state.buf) {
 		efi_error("could not allocate %zd bytes", page_size);
@@ -545,6 +933,7 @@ efi_secdb_realize(efi_secdb_t *secdb, void **out, size_t *outsize)
 
 	*out = state.buf;
 	*outsize = state.pos;
+	EFIVAR_PROBE2(secdb_realize_done, secdb, state.pos);
 
 	return 0;
 }
@@ -563,12 +952,6 @@ secdb_free_entry(efi_secdb_t *secdb)
 
 	for_each_secdb_entry_safe(pos, tmp, &secdb->entries) {
 		secdb_entry_t *entry = list_entry(pos, secdb_entry_t, list);
-		bool has_owner = true;
-		int rc;
-
-		rc = secdb_entry_has_owner_from_type(secdb->algorithm, &has_owner);
-		if (rc < 0)
-			efi_error("could not determine signature type");
 
 		list_del(&entry->list);
 		xfree(entry);
@@ -578,6 +961,253 @@ secdb_free_entry(efi_secdb_t *secdb)
 	xfree(secdb);
 }
 
+typedef struct {
+	secdb_entry_t *entry;
+	size_t pos;
+} secdb_dup_key_t;
+
+static int
+secdb_dup_key_cmp(const void *ap, const void *bp, void *state)
+{
+	const secdb_dup_key_t *a = ap, *b = bp;
+	int rc;
+
+	rc = secdb_entry_cmp(&a->entry, &b->entry, state);
+	if (rc)
+		return rc;
+	return a->pos < b->pos ? -1 : a->pos > b->pos;
+}
+
+/*
+ * drop every entry that has the same owner and data as an earlier one.
+ * Sorting by owner, data, and then position puts each set of duplicates
+ * next to each other with the first one leading, so this is
+ * O(n log n) rather than checking every pair.
+ */
+static int
+secdb_drop_duplicates(efi_secdb_t *secdb, size_t datasz)
+{
+	secdb_dup_key_t *keys;
+	list_t *pos = NULL;
+	size_t n = 0;
+
+	if (secdb->nsigs < 2)
+		return 0;
+
+	keys = efi_calloc(secdb->nsigs, sizeof(*keys));
+	if (!keys) {
+		efi_error("could not allocate memory");
+		return -1;
+	}
+	for_each_secdb_entry(pos, &secdb->entries) {
+		if (n == secdb->nsigs)
+			break;
+		keys[n].entry = list_entry(pos, secdb_entry_t, list);
+		keys[n].pos = n;
+		n += 1;
+	}
+
+	qsort_r(keys, n, sizeof(*keys), secdb_dup_key_cmp, &datasz);
+
+	for (size_t i = 1; i < n; i++) {
+		if (secdb_entry_cmp(&keys[i - 1].entry, &keys[i].entry,
+				    &datasz))
+			continue;
+		debug("dropping duplicate entry %p", keys[i].entry);
+		list_del(&keys[i].entry->list);
+		xfree(keys[i].entry);
+		/* keep comparing the rest of the run against the first */
+		keys[i].entry = keys[i - 1].entry;
+		secdb->nsigs -= 1;
+	}
+	efi_free(keys);
+
+	secdb->listsz = secdb_entry_size(secdb);
+	return 0;
+}
+
+/*
+ * move every entry from src onto the end of dst, and free src.
+ */
+static void
+secdb_merge(efi_secdb_t *dst, efi_secdb_t *src)
+{
+	list_t *pos = NULL, *tmp = NULL;
+
+	for_each_secdb_entry_safe(pos, tmp, &src->entries) {
+		secdb_entry_t *entry = list_entry(pos, secdb_entry_t, list);
+
+		list_del(&entry->list);
+		list_add_tail(&entry->list, &dst->entries);
+		dst->nsigs += 1;
+	}
+	src->nsigs = 0;
+	dst->listsz = secdb_entry_size(dst);
+
+	list_del(&src->list);
+	secdb_free_entry(src);
+}
+
+/*
+ * merge compatible signature lists so that each {algorithm, sigsz,
+ * header} only pays for one EFI_SIGNATURE_LIST header
+ */
+PUBLIC int
+efi_secdb_compact(efi_secdb_t *top, size_t *before, size_t *after)
+{
+	list_t *pos = NULL, *n = NULL, *tmp = NULL;
+
+	if (!top) {
+		efi_error("invalid secdb");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (before)
+		*before = secdb_size(top);
+
+	for_each_secdb_safe(pos, tmp, &top->list) {
+		efi_secdb_t *secdb = list_entry(pos, efi_secdb_t, list);
+		size_t datasz;
+
+		if (secdb->nsigs == 0) {
+			list_del(&secdb->list);
+			secdb_free_entry(secdb);
+			continue;
+		}
+
+		datasz = secdb_data_size(secdb);
+
+		for (n = pos->next; n != &top->list; ) {
+			efi_secdb_t *candidate = list_entry(n, efi_secdb_t, list);
+
+			n = n->next;
+			if (candidate->algorithm != secdb->algorithm ||
+			    candidate->sigsz != secdb->sigsz ||
+			    candidate->hdrsz != secdb->hdrsz ||
+			    (secdb->hdrsz &&
+			     (!candidate->header || !secdb->header ||
+			      memcmp(candidate->header, secdb->header,
+				     secdb->hdrsz))))
+				continue;
+
+			debug("merging secdb:%p into secdb:%p", candidate, secdb);
+			secdb_merge(secdb, candidate);
+		}
+		/* the next list may have been merged away under us */
+		tmp = pos->next;
+
+		if (secdb_drop_duplicates(secdb, datasz) < 0)
+			return -1;
+
+		if (secdb->flags & (1ul << EFI_SECDB_SORT_DATA))
+			list_sort(&secdb->entries,
+				  (secdb->flags & (1ul << EFI_SECDB_SORT_DESCENDING))
+					? secdb_entry_cmp_descending
+					: secdb_entry_cmp,
+				  &datasz);
+	}
+
+	if (after)
+		*after = secdb_size(top);
+	debug("compacted %zd bytes to %zd",
+	      before ? *before : 0, after ? *after : 0);
+
+	return 0;
+}
+
+/*
+ * does any list in top have an entry of this algorithm with this data?
+ * Owners are ignored; a hash in dbx means the same thing whoever owns it.
+ */
+static bool
+secdb_contains(efi_secdb_t *top, efi_secdb_type_t algorithm,
+	       const efi_secdb_data_t * const data, size_t datasz)
+{
+	list_t *pos, *epos;
+
+	if (!top)
+		return false;
+
+	for_each_secdb(pos, &top->list) {
+		efi_secdb_t *secdb = list_entry(pos, efi_secdb_t, list);
+
+		if (secdb->algorithm != algorithm ||
+		    secdb_data_size(secdb) != datasz)
+			continue;
+
+		for_each_secdb_entry(epos, &secdb->entries) {
+			secdb_entry_t *entry = list_entry(epos, secdb_entry_t,
+							  list);
+
+			if (!memcmp(&entry->data, data, datasz))
+				return true;
+		}
+	}
+	return false;
+}
+
+struct delta_state {
+	efi_secdb_t *have;
+	efi_secdb_t *delta;
+};
+
+static efi_secdb_visitor_status_t
+secdb_delta_visitor(unsigned int listnum UNUSED,
+		    unsigned int signum UNUSED,
+		    const efi_guid_t * const owner,
+		    const efi_secdb_type_t algorithm,
+		    const void * const header UNUSED,
+		    const size_t headersz UNUSED,
+		    const efi_secdb_data_t * const data,
+		    const size_t datasz,
+		    void *closure)
+{
+	struct delta_state *state = closure;
+	int rc;
+
+	if (secdb_contains(state->have, algorithm, data, datasz))
+		return CONTINUE;
+
+	rc = efi_secdb_add_entry(state->delta, owner, algorithm,
+				 (efi_secdb_data_t *)data, datasz);
+	if (rc < 0) {
+		efi_error("could not add entry to delta");
+		return ERROR;
+	}
+	return CONTINUE;
+}
+
+/*
+ * compute the entries of want that are missing from have
+ */
+PUBLIC int
+efi_secdb_delta(efi_secdb_t *want, efi_secdb_t *have, efi_secdb_t **deltap)
+{
+	struct delta_state state = { .have = have, };
+	int rc;
+
+	if (!want || !deltap) {
+		efi_error("invalid argument (want=%p deltap=%p)", want, deltap);
+		errno = EINVAL;
+		return -1;
+	}
+
+	state.delta = efi_secdb_new();
+	if (!state.delta)
+		return -1;
+	state.delta->flags = want->flags;
+
+	rc = efi_secdb_visit_entries(want, secdb_delta_visitor, &state);
+	if (rc < 0) {
+		efi_secdb_free(state.delta);
+		return rc;
+	}
+
+	*deltap = state.delta;
+	return 0;
+}
+
 /*
  * free a whole list of secdb entries
  */
@@ -594,7 +1224,7 @@ efi_secdb_free(efi_secdb_t *top)
 		list_del(&secdb->list);
 		secdb_free_entry(secdb);
 	}
-	free(top);
+	efi_free(top);
 }
 
 static efi_secdb_visitor_status_t
@@ -605,15 +1235,12 @@ secdb_visit_entries(efi_secdb_t *secdb, int i,
 	int j = 0;
 	list_t *pos;
 	size_t datasz;
-	bool has_owner = true;
-	int rc;
 
-	rc = secdb_entry_has_owner_from_type(secdb->algorithm, &has_owner);
-	if (rc < 0) {
+	if (!secdb->alg) {
 		efi_error("could not determine signature type");
 		return ERROR;
 	}
-	datasz = secdb->sigsz - (has_owner ? sizeof(efi_guid_t) : 0);
+	datasz = secdb_data_size(secdb);
 
 	for_each_secdb_entry(pos, &secdb->entries) {
 		secdb_entry_t *entry = list_entry(pos, secdb_entry_t, list);
@@ -45,6 +45,7 @@ struct efi_secdb {
 
 	uint64_t flags;			// bitmask of boolean flags
 	efi_secdb_type_t algorithm;	// signature type
+	const secdb_alg_t *alg;		// descriptor for algorithm, or NULL
 	uint32_t listsz;		// esl_size + (hdrsz + nsigs) * sigsz
 	uint32_t hdrsz;			// total size of header
 	uint32_t sigsz;			// size of each signature
@@ -66,19 +67,65 @@ extern const secdb_alg_t PUBLIC efi_secdb_algs_[MAX_SECDB_TYPE];
  *********************************************************/
 
 /*
- * does data (and datasz) include an owner guid?
+ * Find the descriptor for an algorithm.  Lookups by guid scan the table,
+ * so anything that works on a whole list should do this once and keep
+ * the pointer - efi_secdb_t does, in ->alg.
  */
-static inline int
-secdb_entry_has_owner_from_guid(efi_guid_t *alg_guid, bool *answer)
+static inline const secdb_alg_t *
+secdb_alg_from_type(const efi_secdb_type_t secdb_type)
+{
+	if (secdb_type < 0 || secdb_type >= MAX_SECDB_TYPE) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return &efi_secdb_algs_[secdb_type];
+}
+
+static inline const secdb_alg_t *
+secdb_alg_from_guid(const efi_guid_t * const alg_guid)
 {
 	for (efi_secdb_type_t i = 0; i < MAX_SECDB_TYPE; i++) {
-		if (!memcmp(alg_guid, efi_secdb_algs_[i].guid, sizeof(*alg_guid))) {
-			*answer = efi_secdb_algs_[i].has_owner;
-			return 0;
-		}
+		if (efi_guid_equal_(alg_guid, efi_secdb_algs_[i].guid))
+			return &efi_secdb_algs_[i];
 	}
 	errno = EINVAL;
-	return -1;
+	return NULL;
+}
+
+/*
+ * the size of one esl.Signatures array entry for a descriptor, including
+ * signature owner.  0 for X509_CERT, which varies.
+ */
+static inline size_t
+secdb_alg_entry_size(const secdb_alg_t * const alg)
+{
+	return alg->size + (alg->has_owner ? sizeof(efi_guid_t) : 0);
+}
+
+/*
+ * the size of the data in each of secdb's entries, i.e. sigsz without
+ * the owner
+ */
+static inline size_t
+secdb_data_size(const efi_secdb_t * const secdb)
+{
+	if (secdb->alg && secdb->alg->has_owner)
+		return secdb->sigsz - sizeof(efi_guid_t);
+	return secdb->sigsz;
+}
+
+/*
+ * does data (and datasz) include an owner guid?
+ */
+static inline int
+secdb_entry_has_owner_from_guid(efi_guid_t *alg_guid, bool *answer)
+{
+	const secdb_alg_t *alg = secdb_alg_from_guid(alg_guid);
+
+	if (!alg)
+		return -1;
+	*answer = alg->has_owner;
+	return 0;
 }
 
 /*
@@ -101,11 +148,11 @@ secdb_entry_has_owner_from_type(efi_secdb_type_t secdb_type, bool *answer)
 static inline efi_secdb_type_t
 secdb_entry_type_from_guid(const efi_guid_t * const guid)
 {
-	for (efi_secdb_type_t i = 0; i < MAX_SECDB_TYPE; i++) {
-		if (!memcmp(guid, efi_secdb_algs_[i].guid, sizeof(*guid)))
-			return i;
-	}
-	return -1;
+	const secdb_alg_t *alg = secdb_alg_from_guid(guid);
+
+	if (!alg)
+		return -1;
+	return alg - efi_secdb_algs_;
 }
 
 /*
@@ -127,14 +174,11 @@ secdb_guid_from_type(const efi_secdb_type_t secdb_type)
 static inline size_t
 secdb_entry_size_from_guid(const efi_guid_t * const alg_guid)
 {
-	efi_secdb_type_t type;
-
-	type = secdb_entry_type_from_guid(alg_guid);
-	if (type < 0)
-		return type;
+	const secdb_alg_t *alg = secdb_alg_from_guid(alg_guid);
 
-	return efi_secdb_algs_[type].size
-	       + (efi_secdb_algs_[type].has_owner ? sizeof(efi_guid_t) : 0);
+	if (!alg)
+		return -1;
+	return secdb_alg_entry_size(alg);
 }
 
 /*
@@ -224,4 +268,18 @@ extern int secdb_cmp_descending(const void *a, const void *b, void *state);
  */
 extern void secdb_dump(efi_secdb_t *secdb, bool annotate);
 
+/*
+ * a secdb index laid over some memory; map isn't ours unless the index
+ * came from efi_secdb_index_open()
+ */
+struct efi_secdb_index {
+	const uint8_t *map;
+	size_t size;
+	const uint8_t *keys[MAX_SECDB_TYPE];
+	size_t counts[MAX_SECDB_TYPE];
+};
+
+extern int HIDDEN secdb_index_init(efi_secdb_index_t *index,
+				   const uint8_t *buf, size_t size);
+
 #endif /* PRIVATE_SECDB_H */
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * sha256.h - SHA-256 for index digests and certificate fingerprints
+ * Copyright 2026 The efivar Authors
+ */
+#ifndef EFISEC_SHA256_H_
+#define EFISEC_SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE	32
+#define SHA256_BLOCK_SIZE	64
+
+typedef struct {
+	uint32_t state[8];
+	uint64_t count;		/* bytes hashed so far */
+	uint8_t block[SHA256_BLOCK_SIZE];
+} sha256_ctx_t;
+
+extern void HIDDEN sha256_init(sha256_ctx_t *ctx);
+extern void HIDDEN sha256_update(sha256_ctx_t *ctx, const void *data,
+				 size_t len);
+extern void HIDDEN sha256_final(sha256_ctx_t *ctx,
+				uint8_t digest[SHA256_DIGEST_SIZE]);
+
+static inline void UNUSED
+sha256(const void *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	sha256_ctx_t ctx;
+
+	sha256_init(&ctx);
+	sha256_update(&ctx, data, len);
+	sha256_final(&ctx, digest);
+}
+
+#endif /* !EFISEC_SHA256_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,618 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * bench.c - microbenchmarks for the CPU-bound parts of the libraries
+ * Copyright 2026 The efivar Authors
+ *
+ * This links the static libraries so it can reach internal helpers like
+ * crc32() and the esl iterator.  Each benchmark is timed for at least
+ * --time milliseconds, and where the kernel allows it, cycles,
+ * instructions, and cache misses are counted with perf_event_open().
+ */
+
+#include "fix_coverity.h"
+
+#include <err.h>
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "efivar.h"
+#include "efiboot.h"
+#include "efisec.h"
+#include "esl-iter.h"
+#include "ucs2.h"
+
+typedef struct {
+	const char *name;
+	size_t bytes;		/* bytes processed per op, or 0 */
+	void (*fn)(void);
+} bench_t;
+
+typedef struct {
+	uint64_t iterations;
+	uint64_t ns;
+	bool have_counters;
+	uint64_t cycles;
+	uint64_t instructions;
+	uint64_t cache_misses;
+} result_t;
+
+/*
+ * Results go somewhere the compiler can't see through, so it can't
+ * throw the work away.
+ */
+static volatile uintptr_t sink;
+
+static const char guid_text[] = "8be4df61-93ca-11d2-aa0d-00e098032b8c";
+static efi_guid_t guid = EFI_GLOBAL_GUID;
+static char guid_buf[sizeof(guid_text)];
+
+/*
+ * Lookups of every well known GUID, through the sorted table and through
+ * a guid_map of it.
+ */
+#define N_GUID_KEYS 64
+static efi_guid_t guid_keys[N_GUID_KEYS];
+static size_t n_guid_keys;
+static struct guid_map guid_map;
+
+static uint8_t crc_buf[4096];
+
+static const char utf8_text[] =
+	"Fedora Linux (6.5.6-300.fc39.x86_64) - HD(1,GPT) Windows Boot Manager";
+static uint16_t ucs2_text[sizeof(utf8_text)];
+
+#define N_DPS 4
+static uint8_t dp_buf[N_DPS][512];
+static unsigned char dp_text[4096];
+
+static uint8_t loadopt_buf[1024];
+static size_t loadopt_size;
+
+static uint8_t *esl_buf;
+static size_t esl_size;
+#define ESL_ENTRIES 256
+
+static uint8_t export_buf[1024];
+static size_t export_size;
+static efi_variable_t *export_var;
+
+static void
+bench_text_to_guid(void)
+{
+	efi_guid_t g;
+
+	text_to_guid(guid_text, &g);
+	sink += g.a;
+}
+
+static void
+bench_guid_to_str(void)
+{
+	char *p = guid_buf;
+
+	efi_guid_to_str(&guid, &p);
+	sink += p[0];
+}
+
+static void
+bench_guid_to_name(void)
+{
+	char *name = NULL;
+
+	if (efi_guid_to_name(&guid, &name) >= 0) {
+		sink += name[0];
+		efi_free(name);
+	}
+}
+
+static void
+bench_name_to_guid(void)
+{
+	efi_guid_t g;
+
+	efi_name_to_guid("efi_guid_global", &g);
+	sink += g.a;
+}
+
+static int
+cmp_guidname(const void *a, const void *b)
+{
+	return efi_guid_cmp(a, &((const struct efivar_guidname *)b)->guid);
+}
+
+static void
+bench_guid_cmp(void)
+{
+	for (size_t i = 0; i < n_guid_keys; i++)
+		sink += !efi_guid_cmp(&guid_keys[i], &guid);
+}
+
+static void
+bench_guid_equal(void)
+{
+	for (size_t i = 0; i < n_guid_keys; i++)
+		sink += efi_guid_equal(&guid_keys[i], &guid);
+}
+
+static void
+bench_guid_bsearch(void)
+{
+	for (size_t i = 0; i < n_guid_keys; i++)
+		sink += (uintptr_t)bsearch(&guid_keys[i],
+					   efi_well_known_guids,
+					   efi_n_well_known_guids,
+					   sizeof(efi_well_known_guids[0]),
+					   cmp_guidname);
+}
+
+static void
+bench_guid_map_find(void)
+{
+	for (size_t i = 0; i < n_guid_keys; i++)
+		sink += (uintptr_t)guid_map_find(&guid_map, &guid_keys[i],
+						 NULL);
+}
+
+static void
+bench_crc32(void)
+{
+	sink += efi_crc32(crc_buf, sizeof(crc_buf));
+}
+
+static void
+bench_ucs2_to_utf8(void)
+{
+	unsigned char *s = ucs2_to_utf8(ucs2_text, -1);
+
+	sink += s[0];
+	efi_free(s);
+}
+
+static void
+bench_utf8_to_ucs2(void)
+{
+	uint16_t buf[sizeof(utf8_text)];
+
+	sink += utf8_to_ucs2(buf, sizeof(buf), true,
+			     (const unsigned char *)utf8_text);
+}
+
+static void
+bench_format_device_path(void)
+{
+	for (int i = 0; i < N_DPS; i++)
+		sink += efidp_format_device_path(dp_text, sizeof(dp_text),
+						 (const_efidp)dp_buf[i], -1);
+}
+
+static void
+bench_loadopt_parse(void)
+{
+	efi_load_option *opt = (efi_load_option *)loadopt_buf;
+	uint8_t *data = NULL;
+	size_t datasz = 0;
+
+	if (!efi_loadopt_is_valid(opt, loadopt_size))
+		return;
+	sink += (uintptr_t)efi_loadopt_path(opt, loadopt_size);
+	sink += efi_loadopt_pathlen(opt, loadopt_size);
+	sink += (uintptr_t)efi_loadopt_desc(opt, loadopt_size);
+	efi_loadopt_optional_data(opt, loadopt_size, &data, &datasz);
+	sink += datasz;
+}
+
+static void
+bench_esl_iter(void)
+{
+	esl_iter *iter = NULL;
+	efi_guid_t type, owner;
+	uint8_t *data;
+	size_t len;
+
+	if (esl_iter_new(&iter, esl_buf, esl_size) < 0)
+		return;
+	while (esl_iter_next(iter, &type, &owner, &data, &len) > 0)
+		sink += len;
+	esl_iter_end(iter);
+}
+
+static void
+bench_variable_export(void)
+{
+	sink += efi_variable_export(export_var, export_buf,
+				    sizeof(export_buf));
+}
+
+static void
+bench_variable_import(void)
+{
+	efi_variable_t *var = NULL;
+
+	if (efi_variable_import(export_buf, export_size, &var) >= 0) {
+		sink += (uintptr_t)var;
+		efi_variable_free(var, true);
+	}
+}
+
+static ssize_t
+make_dp(uint8_t *buf, size_t size, int kind)
+{
+	static uint8_t sig[16] = { 0xde, 0xad, 0xbe, 0xef, };
+	static uint8_t eui[8] = { 0x00, 0x25, 0x38, 0x5c, 0x91, 0xb0, };
+	static uint8_t mac[6] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x56 };
+	char file[] = "\\EFI\\fedora\\shimx64.efi";
+	ssize_t off = 0, sz;
+
+#define add(x) ({							\
+		ssize_t sz_ = (x);					\
+		if (sz_ < 0)						\
+			return -1;					\
+		off += sz_;						\
+	})
+	if (kind != 3) {
+		add(efidp_make_acpi_hid(buf + off, size - off,
+					EFIDP_ACPI_PCI_ROOT_HID, 0));
+		add(efidp_make_pci(buf + off, size - off, kind + 1, 0));
+	}
+	switch (kind) {
+	case 0:
+		add(efidp_make_sata(buf + off, size - off, 0, -1, 0));
+		break;
+	case 1:
+		add(efidp_make_nvme(buf + off, size - off, 1, eui));
+		break;
+	case 2:
+		add(efidp_make_mac_addr(buf + off, size - off, 1, mac,
+					sizeof(mac)));
+		add(efidp_make_ipv4(buf + off, size - off, 0xc0a80102,
+				    0xc0a80101, 0xc0a80101, 0xffffff00,
+				    0, 69, 17, 0));
+		break;
+	}
+	if (kind != 2) {
+		add(efidp_make_hd(buf + off, size - off, 1, 2048, 1228800,
+				  sig, EFIDP_HD_FORMAT_GPT,
+				  EFIDP_HD_SIGNATURE_GUID));
+		add(efidp_make_file(buf + off, size - off, file));
+	}
+#undef add
+	sz = efidp_make_end_entire(buf + off, size - off);
+	if (sz < 0)
+		return -1;
+	return off + sz;
+}
+
+static void
+setup(void)
+{
+	efi_secdb_t *secdb;
+	uint8_t optional[] = { 'd', 'e', 'b', 'u', 'g' };
+	ssize_t sz;
+
+	n_guid_keys = efi_n_well_known_guids;
+	if (n_guid_keys > N_GUID_KEYS)
+		n_guid_keys = N_GUID_KEYS;
+	if (guid_map_init(&guid_map, n_guid_keys) < 0)
+		err(1, "could not allocate guid map");
+	for (size_t i = 0; i < n_guid_keys; i++) {
+		guid_keys[i] = efi_well_known_guids[i].guid;
+		if (guid_map_insert(&guid_map, &efi_well_known_guids[i].guid,
+				    NULL, (void *)&efi_well_known_guids[i]) < 0)
+			err(1, "could not build guid map");
+	}
+
+	for (size_t i = 0; i < sizeof(crc_buf); i++)
+		crc_buf[i] = i * 31 + 7;
+
+	utf8_to_ucs2(ucs2_text, sizeof(ucs2_text), true,
+		     (const unsigned char *)utf8_text);
+
+	for (int i = 0; i < N_DPS; i++) {
+		if (make_dp(dp_buf[i], sizeof(dp_buf[i]), i) < 0)
+			err(1, "could not build device path %d", i);
+	}
+
+	sz = efi_loadopt_create(loadopt_buf, sizeof(loadopt_buf),
+				1 /* LOAD_OPTION_ACTIVE */, (efidp)dp_buf[0],
+				efidp_size((efidp)dp_buf[0]),
+				(unsigned char *)"Fedora", optional,
+				sizeof(optional));
+	if (sz < 0)
+		err(1, "could not build load option");
+	loadopt_size = sz;
+
+	secdb = efi_secdb_new();
+	if (!secdb)
+		err(1, "could not allocate secdb");
+	for (int i = 0; i < ESL_ENTRIES; i++) {
+		efi_sha256_hash_t hash;
+
+		for (size_t j = 0; j < sizeof(hash); j++)
+			((uint8_t *)&hash)[j] = i * 13 + j;
+		if (efi_secdb_add_entry(secdb, &guid, SHA256,
+					(efi_secdb_data_t *)&hash,
+					sizeof(hash)) < 0)
+			err(1, "could not add secdb entry");
+	}
+	if (efi_secdb_realize(secdb, (void **)&esl_buf, &esl_size) < 0)
+		err(1, "could not realize secdb");
+	efi_secdb_free(secdb);
+
+	export_var = efi_variable_alloc();
+	if (!export_var)
+		err(1, "could not allocate variable");
+	efi_variable_set_name(export_var, (unsigned char *)"Boot0001");
+	efi_variable_set_guid(export_var, &guid);
+	efi_variable_set_attributes(export_var,
+				    EFI_VARIABLE_NON_VOLATILE |
+				    EFI_VARIABLE_BOOTSERVICE_ACCESS |
+				    EFI_VARIABLE_RUNTIME_ACCESS);
+	efi_variable_set_data(export_var, loadopt_buf, loadopt_size);
+	sz = efi_variable_export(export_var, export_buf, sizeof(export_buf));
+	if (sz < 0)
+		err(1, "could not export variable");
+	export_size = sz;
+}
+
+static const bench_t benches[] = {
+	{ "text_to_guid", sizeof(guid_text) - 1, bench_text_to_guid },
+	{ "efi_guid_to_str", 0, bench_guid_to_str },
+	{ "efi_guid_to_name", 0, bench_guid_to_name },
+	{ "efi_name_to_guid", 0, bench_name_to_guid },
+	{ "efi_guid_cmp", 0, bench_guid_cmp },
+	{ "efi_guid_equal", 0, bench_guid_equal },
+	{ "guid_bsearch", 0, bench_guid_bsearch },
+	{ "guid_map_find", 0, bench_guid_map_find },
+	{ "crc32", sizeof(crc_buf), bench_crc32 },
+	{ "ucs2_to_utf8", sizeof(utf8_text) - 1, bench_ucs2_to_utf8 },
+	{ "utf8_to_ucs2", sizeof(utf8_text) - 1, bench_utf8_to_ucs2 },
+	{ "efidp_format_device_path", 0, bench_format_device_path },
+	{ "efi_loadopt_parse", 0, bench_loadopt_parse },
+	{ "esl_iter_walk", 0, bench_esl_iter },
+	{ "efi_variable_export", 0, bench_variable_export },
+	{ "efi_variable_import", 0, bench_variable_import },
+	{ NULL, 0, NULL }
+};
+
+/*
+ * perf counters: one group led by cycles, read all at once.  If the
+ * kernel says no (perf_event_paranoid, containers, no PMU) we just
+ * report times.
+ */
+static int perf_fds[3] = { -1, -1, -1 };
+
+static int
+perf_open(uint64_t config, int group_fd)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = group_fd < 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static bool
+perf_init(void)
+{
+	static const uint64_t configs[] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+	};
+
+	for (int i = 0; i < 3; i++) {
+		perf_fds[i] = perf_open(configs[i], perf_fds[0]);
+		if (perf_fds[i] < 0) {
+			for (int j = 0; j < i; j++) {
+				close(perf_fds[j]);
+				perf_fds[j] = -1;
+			}
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+run_bench(const bench_t *b, uint64_t min_ns, result_t *r)
+{
+	uint64_t n = 1, start, elapsed;
+	struct {
+		uint64_t nr;
+		uint64_t values[3];
+	} counts;
+
+	memset(r, 0, sizeof(*r));
+
+	/* find an iteration count that takes about min_ns */
+	for (;;) {
+		start = now_ns();
+		for (uint64_t i = 0; i < n; i++)
+			b->fn();
+		elapsed = now_ns() - start;
+		if (elapsed >= min_ns / 4 || n >= (1ULL << 40))
+			break;
+		n *= 2;
+	}
+	if (elapsed)
+		n = n * min_ns / elapsed + 1;
+
+	if (perf_fds[0] >= 0) {
+		ioctl(perf_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(perf_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+	start = now_ns();
+	for (uint64_t i = 0; i < n; i++)
+		b->fn();
+	elapsed = now_ns() - start;
+	if (perf_fds[0] >= 0) {
+		ioctl(perf_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		if (read(perf_fds[0], &counts, sizeof(counts)) ==
+		    (ssize_t)sizeof(counts) && counts.nr == 3) {
+			r->have_counters = true;
+			r->cycles = counts.values[0];
+			r->instructions = counts.values[1];
+			r->cache_misses = counts.values[2];
+		}
+	}
+
+	r->iterations = n;
+	r->ns = elapsed;
+}
+
+static void
+print_text(const bench_t *b, const result_t *r)
+{
+	double ns_op = (double)r->ns / r->iterations;
+
+	printf("%-26s %12.1f ns/op", b->name, ns_op);
+	if (b->bytes)
+		printf(" %10.1f MB/s", b->bytes * 1000.0 / ns_op);
+	else
+		printf(" %10s     ", "");
+	if (r->have_counters)
+		printf(" %10.1f cyc/op %10.1f ins/op %8.3f miss/op",
+		       (double)r->cycles / r->iterations,
+		       (double)r->instructions / r->iterations,
+		       (double)r->cache_misses / r->iterations);
+	printf("\n");
+}
+
+static void
+print_json(const bench_t *b, const result_t *r, bool first)
+{
+	double ns_op = (double)r->ns / r->iterations;
+
+	printf("%s\n    {\"name\": \"%s\", \"iterations\": %" PRIu64
+	       ", \"ns_per_op\": %.3f", first ? "" : ",", b->name,
+	       r->iterations, ns_op);
+	if (b->bytes)
+		printf(", \"bytes_per_sec\": %.0f",
+		       b->bytes * 1000000000.0 / ns_op);
+	else
+		printf(", \"bytes_per_sec\": null");
+	if (r->have_counters)
+		printf(", \"cycles_per_op\": %.3f, \"instructions_per_op\": %.3f"
+		       ", \"cache_misses_per_op\": %.5f",
+		       (double)r->cycles / r->iterations,
+		       (double)r->instructions / r->iterations,
+		       (double)r->cache_misses / r->iterations);
+	else
+		printf(", \"cycles_per_op\": null"
+		       ", \"instructions_per_op\": null"
+		       ", \"cache_misses_per_op\": null");
+	printf("}");
+}
+
+static void __attribute__((__noreturn__))
+usage(int ret)
+{
+	FILE *out = ret == 0 ? stdout : stderr;
+	fprintf(out,
+		"Usage: %s [OPTION...] [BENCHMARK...]\n"
+		"  -j, --json                        print results as JSON\n"
+		"  -l, --list                        list benchmarks\n"
+		"  -t, --time=<ms>                   run each benchmark for about <ms>\n"
+		"                                    milliseconds (default 200)\n"
+		"  -?, --help                        Show this help message\n",
+		program_invocation_short_name);
+	exit(ret);
+}
+
+static bool
+selected(const char *name, int argc, char *argv[])
+{
+	if (optind >= argc)
+		return true;
+	for (int i = optind; i < argc; i++)
+		if (strstr(name, argv[i]))
+			return true;
+	return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool json = false;
+	bool first = true;
+	uint64_t min_ns = 200000000ULL;
+	char *sopts = "jlt:?";
+	struct option lopts[] = {
+		{"help", no_argument, 0, '?'},
+		{"json", no_argument, 0, 'j'},
+		{"list", no_argument, 0, 'l'},
+		{"time", required_argument, 0, 't'},
+		{0, 0, 0, 0}
+	};
+	int c, i = 0;
+
+	while ((c = getopt_long(argc, argv, sopts, lopts, &i)) != -1) {
+		switch (c) {
+		case 'j':
+			json = true;
+			break;
+		case 'l':
+			for (const bench_t *b = benches; b->name; b++)
+				printf("%s\n", b->name);
+			exit(0);
+		case 't':
+			min_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+			if (!min_ns)
+				errx(1, "invalid argument for -t: %s", optarg);
+			break;
+		case '?':
+			usage(EXIT_SUCCESS);
+		default:
+			usage(EXIT_FAILURE);
+		}
+	}
+
+	setup();
+	perf_init();
+
+	if (json)
+		printf("{\n  \"version\": %d,\n  \"benchmarks\": [",
+		       LIBEFIVAR_VERSION);
+	for (const bench_t *b = benches; b->name; b++) {
+		result_t r;
+
+		if (!selected(b->name, argc, argv))
+			continue;
+		run_bench(b, min_ns, &r);
+		if (json)
+			print_json(b, &r, first);
+		else
+			print_text(b, &r);
+		first = false;
+	}
+	if (json)
+		printf("\n  ]\n}\n");
+
+	efi_variable_free(export_var, false);
+	efi_free(esl_buf);
+	return 0;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,456 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * efiboot-test.c - tests for libefiboot internals
+ * Copyright 2026 The efivar Authors
+ *
+ * This links the static libraries so it can call the device probing code
+ * directly.  tests/test-efiboot builds a fake sysfs for it to probe and
+ * points LIBEFIBOOT_SYSFS_PATH at it.
+ */
+
+#include "fix_coverity.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "efivar.h"
+#include "efiboot.h"
+
+typedef struct {
+	const char *name;
+	int (*fn)(void);
+} test_t;
+
+#define fail(fmt, args...)						\
+	({								\
+		warnx(fmt, ## args);					\
+		-1;							\
+	})
+
+/*
+ * Format a device path, which must be terminated, and compare it to what
+ * was expected.
+ */
+static int
+check_dp(const char *what, const uint8_t *dp, ssize_t dpsz,
+	 const char *expected)
+{
+	char text[1024];
+	ssize_t sz;
+
+	sz = efidp_format_device_path((unsigned char *)text, sizeof(text),
+				      (const_efidp)dp, dpsz);
+	if (sz < 0)
+		return fail("%s: could not format device path", what);
+	if (strcmp(text, expected))
+		return fail("%s: got \"%s\", expected \"%s\"", what, text,
+			    expected);
+	return 0;
+}
+
+/*
+ * The bus part of a device path, terminated, as make_net_path() and
+ * efi_generate_file_device_path() would start it.
+ */
+static ssize_t
+bus_path(uint8_t *buf, ssize_t size, struct device *dev)
+{
+	ssize_t sz, end;
+
+	sz = make_blockdev_path(buf, size, dev);
+	if (sz < 0)
+		return -1;
+	end = efidp_make_end_entire(buf + sz, size - sz);
+	if (end < 0)
+		return -1;
+	return sz + end;
+}
+
+static int
+test_net_path(void)
+{
+	struct device *dev;
+	uint8_t buf[1024];
+	ssize_t sz;
+	int rc;
+
+	dev = device_get_net("eth0");
+	if (!dev)
+		return fail("could not probe eth0");
+	sz = bus_path(buf, sizeof(buf), dev);
+	device_free(dev);
+	if (sz < 0)
+		return fail("could not make a path for eth0");
+	rc = check_dp("eth0", buf, sz, "PciRoot(0x0)/Pci(0x4,0x0)");
+	if (rc < 0)
+		return rc;
+
+	dev = device_get_net("lo");
+	if (dev) {
+		device_free(dev);
+		return fail("lo isn't on a bus firmware can see");
+	}
+	if (errno != ENODEV)
+		return fail("lo: expected ENODEV, got %m");
+	efi_error_clear();
+	return 0;
+}
+
+/*
+ * EFIBOOT_TEST_ESP is a file on a disk that the fake sysfs says is vda1,
+ * behind virtio and PCI.  The tree has no block/vda/device link, so
+ * probing the disk leaves an error behind even though it succeeds.
+ */
+static int
+test_lazy_probe(void)
+{
+	const char *esp = getenv("EFIBOOT_TEST_ESP");
+	char *filename, *function, *message;
+	int line, error;
+	struct device *dev;
+	uint8_t buf[1024];
+	ssize_t sz;
+	int fd, rc;
+
+	if (!esp)
+		return fail("EFIBOOT_TEST_ESP isn't set");
+
+	/* An abbreviated path only needs the disk and partition. */
+	efi_error_clear();
+	sz = efi_generate_file_device_path_from_esp(buf, sizeof(buf), esp, 1,
+						    "EFI/test.efi",
+						    EFIBOOT_ABBREV_FILE);
+	if (sz < 0)
+		return fail("could not make an abbreviated path");
+	if (efi_error_get(0, &filename, &function, &line, &message,
+			  &error) > 0)
+		return fail("probed the device for an abbreviated path: %s",
+			    message);
+	rc = check_dp("File()", buf, sz, "EFI\\test.efi");
+	if (rc < 0)
+		return rc;
+
+	fd = open(esp, O_RDONLY);
+	if (fd < 0)
+		return fail("could not open %s: %m", esp);
+	dev = device_get(fd, 1);
+	close(fd);
+	if (!dev)
+		return fail("could not get the device for %s", esp);
+
+	rc = -1;
+	if (strcmp(dev->disk_name, "vda") || strcmp(dev->part_name, "vda1")) {
+		fail("got disk %s partition %s", dev->disk_name,
+		     dev->part_name);
+		goto out;
+	}
+	if ((dev->flags & DEV_PROBED) || dev->driver || dev->probes[0]) {
+		fail("device_get() probed the device");
+		goto out;
+	}
+
+	/* A full path does need the probe, which has to happen now. */
+	sz = bus_path(buf, sizeof(buf), dev);
+	if (sz < 0) {
+		fail("could not make a path for %s", esp);
+		goto out;
+	}
+	if (!(dev->flags & DEV_PROBED)) {
+		fail("made a full path without probing the device");
+		goto out;
+	}
+	rc = check_dp(esp, buf, sz, "PciRoot(0x0)/Pci(0x5,0x0)");
+	efi_error_clear();
+out:
+	device_free(dev);
+	return rc;
+}
+
+/*
+ * The cache checks the first sectors of the disk it names, which here is
+ * the image in $LIBEFIBOOT_DEV_PATH.
+ */
+static int
+test_dp_cache(void)
+{
+	const char *esp = getenv("EFIBOOT_TEST_ESP");
+	const char *dir = getenv("EFIBOOT_TEST_CACHE");
+	const uint32_t options = EFIBOOT_ABBREV_HD;
+	const uint8_t dp[] = { 0x04, 0x01, 0x2a, 0x00, 0xde, 0xad };
+	uint8_t *cached = NULL;
+	char path[PATH_MAX];
+	struct stat sb;
+	ssize_t sz;
+	int fd, rc = -1;
+
+	if (!esp || !dir)
+		return fail("EFIBOOT_TEST_ESP or EFIBOOT_TEST_CACHE isn't set");
+	if (stat(esp, &sb) < 0)
+		return fail("could not stat %s: %m", esp);
+	setenv(DP_CACHE_ENV, dir, 1);
+
+	if (dp_cache_lookup(esp, 1, options, &cached) >= 0) {
+		fail("hit in an empty cache");
+		goto out;
+	}
+
+	dp_cache_store(esp, 1, options, "vda", dp, sizeof(dp));
+	sz = dp_cache_lookup(esp, 1, options, &cached);
+	if (sz != sizeof(dp) || memcmp(cached, dp, sz)) {
+		fail("missed an entry that was just stored");
+		goto out;
+	}
+	efi_free(cached);
+	cached = NULL;
+
+	if (dp_cache_lookup(esp, 2, options, &cached) >= 0 ||
+	    dp_cache_lookup(esp, 1, options | EFIBOOT_ABBREV_FILE,
+			    &cached) >= 0) {
+		fail("hit for another partition or other options");
+		goto out;
+	}
+
+	/* anything that doesn't validate is a miss */
+	snprintf(path, sizeof(path), "%s/dp-%"PRIx64"-1-%"PRIx32, dir,
+		 (uint64_t)sb.st_dev, options);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		fail("could not open %s: %m", path);
+		goto out;
+	}
+	/* the last byte of the entry is the last byte of dp */
+	sz = lseek(fd, -1, SEEK_END) < 0 ? -1 : write(fd, "\xff", 1);
+	close(fd);
+	if (sz != 1) {
+		fail("could not change %s", path);
+		goto out;
+	}
+	if (dp_cache_lookup(esp, 1, options, &cached) >= 0) {
+		fail("hit on an entry that was changed");
+		goto out;
+	}
+	rc = 0;
+out:
+	efi_free(cached);
+	unsetenv(DP_CACHE_ENV);
+	return rc;
+}
+
+/*
+ * There's no /dev/sda to open here, so this gets the ESP's device and
+ * makes it look like device_get() found the whole disk at 8:0, which the
+ * fake sysfs puts behind SCSI.  The SCSI probe sets the partition from
+ * the minor number, but the one device_get() was given has to stick.
+ */
+static int
+test_scsi_part(void)
+{
+	const char *esp = getenv("EFIBOOT_TEST_ESP");
+	struct device *dev;
+	uint8_t buf[1024];
+	ssize_t sz;
+	int fd, rc = -1;
+
+	if (!esp)
+		return fail("EFIBOOT_TEST_ESP isn't set");
+
+	fd = open(esp, O_RDONLY);
+	if (fd < 0)
+		return fail("could not open %s: %m", esp);
+	dev = device_get(fd, 1);
+	close(fd);
+	if (!dev)
+		return fail("could not get the device for %s", esp);
+
+	dev->major = 8;
+	dev->minor = 0;
+	efi_free(dev->link);
+	efi_free(dev->disk_name);
+	efi_free(dev->part_name);
+	dev->disk_name = dev->part_name = NULL;
+	dev->link = efi_strdup("../../devices/pci0000:00/0000:00:06.0/host0/"
+			       "target0:0:0/0:0:0:0/block/sda");
+	if (!dev->link || set_disk_and_part_name(dev) < 0) {
+		fail("could not make the device look like sda");
+		goto out;
+	}
+
+	sz = bus_path(buf, sizeof(buf), dev);
+	if (sz < 0) {
+		fail("could not make a path for sda");
+		goto out;
+	}
+	if (check_dp("sda", buf, sz, "PciRoot(0x0)/Pci(0x6,0x0)/SCSI(0,0)") < 0)
+		goto out;
+	if (dev->part != 1 || !dev->part_name ||
+	    strcmp(dev->part_name, "sda1")) {
+		fail("probing sda changed partition 1 to %d (%s)", dev->part,
+		     dev->part_name ? dev->part_name : "no name");
+		goto out;
+	}
+	rc = 0;
+	efi_error_clear();
+out:
+	device_free(dev);
+	return rc;
+}
+
+static efidp_hd *
+find_hd(uint8_t *dp, ssize_t dpsz)
+{
+	ssize_t off = 0;
+
+	while (off + (ssize_t)sizeof(efidp_header) <= dpsz) {
+		efidp node = (efidp)(dp + off);
+		ssize_t sz = efidp_node_size(node);
+
+		if (sz <= 0 || efidp_type(node) == EFIDP_END_TYPE)
+			break;
+		if (efidp_type(node) == EFIDP_MEDIA_TYPE &&
+		    efidp_subtype(node) == EFIDP_MEDIA_HD)
+			return &node->hd;
+		off += sz;
+	}
+	return NULL;
+}
+
+/*
+ * $LIBEFIBOOT_DEV_PATH/vda is an image of an MBR disk with signature
+ * 0x12345678, which the fake sysfs puts at vda1's partition table, and
+ * vda1 is a file on the same filesystem as EFIBOOT_TEST_ESP.
+ */
+static int
+test_resolve(void)
+{
+	const char *dev = getenv(DEVFS_ENV);
+	efi_resolved_path_t resolved;
+	efi_resolver_t *resolver = NULL;
+	efidp_hd *hd;
+	char *vda1 = NULL;
+	uint8_t buf[1024];
+	ssize_t sz;
+	int rc = -1;
+
+	if (!dev)
+		return fail("%s isn't set", DEVFS_ENV);
+	if (asprintf(&vda1, "%s/vda1", dev) < 0)
+		return fail("could not allocate memory");
+
+	resolver = efi_resolver_new();
+	if (!resolver) {
+		fail("could not index block devices");
+		goto out;
+	}
+
+	sz = efi_generate_file_device_path_from_esp(buf, sizeof(buf), vda1, 1,
+						    "EFI/test.efi", 0);
+	if (sz < 0) {
+		fail("could not make a path for %s", vda1);
+		goto out;
+	}
+	if (check_dp(vda1, buf, sz, "PciRoot(0x0)/Pci(0x5,0x0)/"
+		     "HD(1,MBR,0x12345678,0x800,0x800)/EFI\\test.efi") < 0)
+		goto out;
+
+	if (efi_resolve_device_path(resolver, (const_efidp)buf, sz,
+				    &resolved) < 0) {
+		fail("could not resolve the path for %s", vda1);
+		goto out;
+	}
+	if (!(resolved.flags & EFI_RESOLVED_DEVICE) ||
+	    !(resolved.flags & EFI_RESOLVED_PREFIX) ||
+	    resolved.partition != 1 || strcmp(resolved.device, vda1)) {
+		fail("resolved to %s partition %d flags 0x%x",
+		     resolved.device ? resolved.device : "nothing",
+		     resolved.partition, resolved.flags);
+		efi_free_resolved_path(&resolved);
+		goto out;
+	}
+	efi_free_resolved_path(&resolved);
+
+	/* no disk has this signature */
+	hd = find_hd(buf, sz);
+	if (!hd) {
+		fail("no HD() node in the path for %s", vda1);
+		goto out;
+	}
+	hd->signature[0] ^= 0xff;
+	if (efi_resolve_device_path(resolver, (const_efidp)buf, sz,
+				    &resolved) < 0) {
+		fail("could not resolve a path to a missing disk");
+		goto out;
+	}
+	if (resolved.flags & EFI_RESOLVED_DEVICE) {
+		fail("resolved a missing disk to %s", resolved.device);
+		efi_free_resolved_path(&resolved);
+		goto out;
+	}
+	efi_free_resolved_path(&resolved);
+	rc = 0;
+out:
+	efi_resolver_free(resolver);
+	free(vda1);
+	return rc;
+}
+
+static const test_t tests[] = {
+	{"net-path", test_net_path},
+	{"lazy-probe", test_lazy_probe},
+	{"dp-cache", test_dp_cache},
+	{"resolve", test_resolve},
+	{"scsi-part", test_scsi_part},
+	{NULL, NULL}
+};
+
+static void __attribute__((__noreturn__))
+usage(int ret)
+{
+	FILE *out = ret == 0 ? stdout : stderr;
+	fprintf(out, "Usage: %s [TEST...]\n", program_invocation_short_name);
+	exit(ret);
+}
+
+static bool
+selected(const char *name, int argc, char *argv[])
+{
+	if (argc < 2)
+		return true;
+	for (int i = 1; i < argc; i++)
+		if (!strcmp(name, argv[i]))
+			return true;
+	return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int failed = 0;
+
+	if (argc > 1 && (!strcmp(argv[1], "-?") || !strcmp(argv[1], "--help")))
+		usage(EXIT_SUCCESS);
+
+	for (const test_t *t = tests; t->name; t++) {
+		if (!selected(t->name, argc, argv))
+			continue;
+		printf("testing %s...", t->name);
+		fflush(stdout);
+		if (t->fn() < 0) {
+			printf("failed\n");
+			show_errors();
+			failed += 1;
+		} else {
+			printf("passed\n");
+		}
+	}
+	return failed ? 1 : 0;
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * hpp-test.cpp - make sure efivar.hpp builds cleanly
+ * Copyright 2026 The efivar Authors
+ *
+ * This is only compiled, never run.  The templates in efivar.hpp aren't
+ * checked until something instantiates them, so everything here uses
+ * every part of the header once.  The Makefile builds it as C++20, where
+ * efivar::result is the header's own stand-in, and as C++23, where it's
+ * std::expected if the library has it.
+ */
+
+#include <efivar/efivar.hpp>
+
+#include <unordered_map>
+
+#if __cplusplus <= 202002L && defined(EFIVAR_HPP_HAVE_EXPECTED)
+#error "C++20 shouldn't have <expected>"
+#endif
+#if !defined(EFIVAR_HPP_HAVE_EFIBOOT) || !defined(EFIVAR_HPP_HAVE_EFISEC)
+#error "efiboot.h and efisec.h should have been found"
+#endif
+
+int
+use_variables(efi_ctx_t *ctx)
+{
+	std::unordered_map<efi_guid_t, int, efivar::guid_hash,
+			   efivar::guid_equal> seen;
+	int n = 0;
+
+	auto guid = efivar::guid_from_string(
+			"8be4df61-93ca-11d2-aa0d-00e098032b8c");
+	if (!guid)
+		return -1;
+	auto s = efivar::to_string(*guid);
+	if (!s || s->view().empty())
+		return -1;
+
+	auto var = efivar::get_variable(*guid, "BootOrder");
+	if (!var)
+		return var.error().value();
+	efivar::buffer data = std::move(var->data);
+	std::span<const std::uint8_t> bytes = data;
+	if (!efivar::set_variable(ctx, *guid, "BootOrder", bytes,
+				  var->attributes) ||
+	    !efivar::append_variable(*guid, "BootOrder", data.bytes(),
+				     var->attributes) ||
+	    !efivar::del_variable(*guid, "BootOrder"))
+		return -1;
+	efi_free(data.release());
+
+	efivar::variable_names names(ctx);
+	for (auto &&v : names) {
+		seen[v.guid] += 1;
+		n += !v.name.empty();
+	}
+	if (names.error())
+		return -1;
+	return n + static_cast<int>(seen.size());
+}
+
+int
+use_load_option(std::span<const std::uint8_t> bytes)
+{
+	efivar::load_option_view opt(bytes);
+	int n = 0;
+
+	if (!opt.valid())
+		return -1;
+	n += static_cast<int>(opt.attributes() & 1);
+	n += static_cast<int>(opt.description().size());
+	n += static_cast<int>(opt.description_utf8().size());
+	n += static_cast<int>(opt.optional_data().size());
+
+	efivar::device_path_view path = opt.path();
+	if (!path.valid())
+		return -1;
+	for (const_efidp node : path)
+		n += efidp_type(node);
+	auto text = path.format();
+	if (!text)
+		return text.error().value();
+	return n + static_cast<int>(text->size() + path.bytes().size());
+}
+
+int
+use_secdb(std::span<std::uint8_t> bytes)
+{
+	efivar::esl_entries entries(bytes);
+	int n = 0;
+
+	for (const auto &e : entries)
+		n += static_cast<int>(e.data.size()) + e.owner.a - e.type.a;
+	if (entries.error())
+		return -1;
+
+	auto empty = efivar::secdb::create();
+	auto db = efivar::secdb::parse(bytes);
+	if (!empty || !db)
+		return -1;
+	*empty = std::move(*db);
+	auto visited = empty->visit([&n](const efi_guid_t &,
+					 efi_secdb_type_t,
+					 std::span<const std::uint8_t> data) {
+		n += static_cast<int>(data.size());
+		return true;
+	});
+	if (!visited)
+		return -1;
+	auto realized = empty->realize();
+	if (!realized)
+		return -1;
+	efi_secdb_free(empty->release());
+	return n + static_cast<int>(realized->size());
+}
+
+// vim:fenc=utf-8:tw=75:noet
@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * trace.c - timeline tracing in Chrome's trace event format
+ * Copyright 2026 The efivar Authors
+ */
+
+#include "fix_coverity.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "efivar.h"
+
+/*
+ * Each thread records its finished spans in its own buffer, so nothing
+ * is shared while a program runs except the list of buffers, which is
+ * only touched the first time a thread traces anything.  Buffers are
+ * chunks that are never moved once written, and each chunk's count is
+ * published with a release store, so the writer at exit can read any
+ * thread's buffer without stopping it.
+ *
+ * Nothing here goes through efi_malloc(): a program that hands us an
+ * arena shouldn't find our spans in it.
+ */
+
+#define TRACE_CHUNK_EVENTS	256
+
+struct trace_event {
+	const char *name;
+	char *detail;
+	uint64_t start;
+	uint64_t duration;
+};
+
+struct trace_chunk {
+	struct trace_chunk *next;
+	uint32_t nevents;
+	struct trace_event events[TRACE_CHUNK_EVENTS];
+};
+
+struct trace_span {
+	const char *name;
+	char *detail;
+	uint64_t start;
+};
+
+struct trace_buffer {
+	struct trace_buffer *next;
+	pid_t tid;
+	uint32_t depth;
+	uint32_t nevents;
+	uint32_t dropped;
+	struct trace_chunk *first;
+	struct trace_chunk *last;
+	struct trace_span stack[TRACE_MAX_DEPTH];
+};
+
+static bool trace_enabled;
+static char *trace_path;
+static uint64_t trace_epoch;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buffer *trace_buffers;
+static __thread struct trace_buffer *trace_buffer;
+
+static uint64_t
+trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct trace_buffer *
+get_trace_buffer(void)
+{
+	struct trace_buffer *buf = trace_buffer;
+
+	if (buf)
+		return buf;
+
+	buf = calloc(1, sizeof(*buf));
+	if (!buf)
+		return NULL;
+	buf->tid = syscall(SYS_gettid);
+
+	pthread_mutex_lock(&trace_lock);
+	buf->next = trace_buffers;
+	trace_buffers = buf;
+	pthread_mutex_unlock(&trace_lock);
+
+	trace_buffer = buf;
+	return buf;
+}
+
+static void
+add_event(struct trace_buffer *buf, struct trace_span *span, uint64_t end)
+{
+	struct trace_chunk *chunk = buf->last;
+	struct trace_event *event;
+
+	if (buf->nevents >= TRACE_MAX_EVENTS)
+		goto drop;
+
+	if (!chunk || chunk->nevents == TRACE_CHUNK_EVENTS) {
+		chunk = calloc(1, sizeof(*chunk));
+		if (!chunk)
+			goto drop;
+		if (buf->last)
+			__atomic_store_n(&buf->last->next, chunk,
+					 __ATOMIC_RELEASE);
+		else
+			__atomic_store_n(&buf->first, chunk,
+					 __ATOMIC_RELEASE);
+		buf->last = chunk;
+	}
+
+	event = &chunk->events[chunk->nevents];
+	event->name = span->name;
+	event->detail = span->detail;
+	event->start = span->start;
+	event->duration = end - span->start;
+	__atomic_store_n(&chunk->nevents, chunk->nevents + 1,
+			 __ATOMIC_RELEASE);
+	buf->nevents += 1;
+	return;
+drop:
+	free(span->detail);
+	buf->dropped += 1;
+}
+
+/*
+ * name must be a string that outlives the process, since only the
+ * pointer is kept; fmt, if it isn't NULL, formats the span's details.
+ */
+void PUBLIC NONNULL(1) PRINTF(2, 3)
+efi_trace_begin(const char *name, const char *fmt, ...)
+{
+	struct trace_buffer *buf;
+	struct trace_span *span;
+	int saved_errno;
+	va_list ap;
+	int rc;
+
+	if (!__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))
+		return;
+
+	saved_errno = errno;
+	buf = get_trace_buffer();
+	if (!buf)
+		goto out;
+
+	if (buf->depth++ >= TRACE_MAX_DEPTH)
+		goto out;
+
+	span = &buf->stack[buf->depth - 1];
+	span->name = name;
+	span->detail = NULL;
+	if (fmt) {
+		va_start(ap, fmt);
+		rc = vasprintf(&span->detail, fmt, ap);
+		va_end(ap);
+		if (rc < 0)
+			span->detail = NULL;
+	}
+	span->start = trace_now();
+out:
+	errno = saved_errno;
+}
+
+void PUBLIC
+efi_trace_end(void)
+{
+	struct trace_buffer *buf = trace_buffer;
+	int saved_errno;
+	uint64_t end;
+
+	if (!buf || !buf->depth)
+		return;
+
+	buf->depth -= 1;
+	if (buf->depth >= TRACE_MAX_DEPTH)
+		return;
+
+	saved_errno = errno;
+	end = trace_now();
+	if (__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))
+		add_event(buf, &buf->stack[buf->depth], end);
+	else
+		free(buf->stack[buf->depth].detail);
+	errno = saved_errno;
+}
+
+static void
+write_json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		unsigned char c = *s;
+
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void
+write_timestamp(FILE *f, const char *key, uint64_t ns)
+{
+	fprintf(f, "\"%s\":%"PRIu64".%03"PRIu64, key, ns / 1000, ns % 1000);
+}
+
+static void
+write_trace(FILE *f)
+{
+	pid_t pid = getpid();
+	struct trace_buffer *buf;
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+		   "\"args\":{\"name\":", pid);
+	write_json_string(f, program_invocation_short_name);
+	fprintf(f, "}}");
+
+	for (buf = trace_buffers; buf; buf = buf->next) {
+		struct trace_chunk *chunk;
+
+		chunk = __atomic_load_n(&buf->first, __ATOMIC_ACQUIRE);
+		for (; chunk;
+		     chunk = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE)) {
+			uint32_t n = __atomic_load_n(&chunk->nevents,
+						     __ATOMIC_ACQUIRE);
+
+			for (uint32_t i = 0; i < n; i++) {
+				struct trace_event *event = &chunk->events[i];
+
+				fprintf(f, ",\n{\"name\":");
+				write_json_string(f, event->name);
+				fprintf(f, ",\"ph\":\"X\",");
+				write_timestamp(f, "ts",
+						event->start - trace_epoch);
+				fputc(',', f);
+				write_timestamp(f, "dur", event->duration);
+				fprintf(f, ",\"pid\":%d,\"tid\":%d", pid,
+					buf->tid);
+				if (event->detail) {
+					fprintf(f, ",\"args\":{\"detail\":");
+					write_json_string(f, event->detail);
+					fputc('}', f);
+				}
+				fputc('}', f);
+			}
+		}
+
+		if (buf->dropped)
+			fprintf(f, ",\n{\"name\":\"dropped spans\",\"ph\":\"i\","
+				   "\"s\":\"t\",\"ts\":0,\"pid\":%d,\"tid\":%d,"
+				   "\"args\":{\"count\":%"PRIu32"}}",
+				pid, buf->tid, buf->dropped);
+	}
+
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+/*
+ * "%p" in EFIVAR_TRACE becomes our pid, so that a program which runs
+ * others that use libefivar doesn't have them all write the same file.
+ */
+static char *
+expand_trace_path(const char *env)
+{
+	char pid[16];
+	const char *p;
+	char *path, *q;
+	size_t len = 0;
+
+	snprintf(pid, sizeof(pid), "%d", getpid());
+	for (p = env; *p; p++) {
+		if (p[0] == '%' && p[1] == 'p') {
+			len += strlen(pid);
+			p++;
+		} else {
+			len += 1;
+		}
+	}
+
+	path = q = malloc(len + 1);
+	if (!path)
+		return NULL;
+	for (p = env; *p; p++) {
+		if (p[0] == '%' && p[1] == 'p') {
+			q = stpcpy(q, pid);
+			p++;
+		} else {
+			*q++ = *p;
+		}
+	}
+	*q = '\0';
+	return path;
+}
+
+static void CONSTRUCTOR
+efi_trace_init(void)
+{
+	const char *env = secure_getenv(TRACE_ENV);
+
+	if (!env || !env[0])
+		return;
+
+	trace_path = expand_trace_path(env);
+	if (!trace_path)
+		return;
+	trace_epoch = trace_now();
+	__atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+}
+
+static void DESTRUCTOR
+efi_trace_fini(void)
+{
+	FILE *f;
+
+	if (!__atomic_exchange_n(&trace_enabled, false, __ATOMIC_ACQ_REL))
+		return;
+
+	/*
+	 * Spans still open on any thread, including the ones main() is
+	 * inside of when it calls exit(), are left out.
+	 */
+	f = fopen(trace_path, "we");
+	if (f) {
+		pthread_mutex_lock(&trace_lock);
+		write_trace(f);
+		pthread_mutex_unlock(&trace_lock);
+		fclose(f);
+	}
+	free(trace_path);
+	trace_path = NULL;
+}
+
+// vim:fenc=utf-8:tw=75:noet
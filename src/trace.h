@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * trace.h - timeline tracing in Chrome's trace event format
+ * Copyright 2026 The efivar Authors
+ */
+#ifndef EFIVAR_TRACE_H_
+#define EFIVAR_TRACE_H_
+
+/*
+ * Set EFIVAR_TRACE to a file name to have every span begun with
+ * efi_trace_begin() in this process written there at exit, as a JSON
+ * trace that chrome://tracing or Perfetto can show as a timeline.  A "%p"
+ * in the name is replaced with the process id.  Setuid and setcap
+ * programs ignore it, so it can't be used to have them overwrite a file.
+ */
+#define TRACE_ENV		"EFIVAR_TRACE"
+
+/*
+ * Spans nested deeper than this on one thread aren't recorded, though
+ * they're still counted so their ends match up.  Each thread keeps at
+ * most TRACE_MAX_EVENTS spans; later ones are counted and dropped.
+ */
+#define TRACE_MAX_DEPTH		32
+#define TRACE_MAX_EVENTS	65536
+
+static inline void
+efi_trace_end_cleanup__(int *traced UNUSED)
+{
+	efi_trace_end();
+}
+
+/*
+ * Begin a span that ends when the enclosing block is left, by whatever
+ * path.  Only one can be used per block.
+ */
+#define efi_trace_scope(name, fmt, args...)				\
+	int efi_trace_scope__ CLEANUP_FUNC(efi_trace_end_cleanup__) =	\
+		(efi_trace_begin((name), (fmt), ## args), 0);		\
+	(void)efi_trace_scope__
+
+#endif /* !EFIVAR_TRACE_H_ */
+
+// vim:fenc=utf-8:tw=75:noet
@@ -116,7 +116,7 @@ ucs2_to_utf8(const void * const s, ssize_t limit)
 
 	if (limit < 0)
 		limit = ucs2len(chars, -1);
-	out = malloc(limit * 6 + 1);
+	out = efi_malloc(limit * 6 + 1);
 	if (!out)
 		return NULL;
 	memset(out, 0, limit * 6 +1);
@@ -160,9 +160,9 @@ ucs2_to_utf8(const void * const s, ssize_t limit)
 #endif
 	}
 	out[j++] = '\0';
-	ret = realloc(out, j);
+	ret = efi_realloc(out, j);
 	if (!ret) {
-		free(out);
+		efi_free(out);
 		return NULL;
 	}
 	return ret;
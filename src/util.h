@@ -31,6 +31,7 @@
 #include "include/efivar/efivar.h"
 
 #include "compiler.h"
+#include "probes.h"
 #include "list.h"
 
 static inline int UNUSED
@@ -42,7 +43,7 @@ read_file(int fd, uint8_t **result, size_t *bufsize)
 	ssize_t s = 0;
 	uint8_t *buf, *newbuf;
 
-	if (!(newbuf = calloc(size, sizeof (uint8_t)))) {
+	if (!(newbuf = efi_calloc(size, sizeof (uint8_t)))) {
 		efi_error("could not allocate memory");
 		*result = buf = NULL;
 		*bufsize = 0;
@@ -62,11 +63,12 @@ read_file(int fd, uint8_t **result, size_t *bufsize)
 			 * the kernel rate limiter.  Doing more reads is just
 			 * going to make it worse, so instead, give it a rest.
 			 */
+			EFIVAR_PROBE2(read_file_eagain, fd, filesize);
 			sched_yield();
 			continue;
 		} else if (s < 0) {
 			int saved_errno = errno;
-			free(buf);
+			efi_free(buf);
 			*result = buf = NULL;
 			*bufsize = 0;
 			errno = saved_errno;
@@ -81,17 +83,17 @@ read_file(int fd, uint8_t **result, size_t *bufsize)
 			/* See if we're going to overrun and return an error
 			 * instead. */
 			if (size > (size_t)-1 - 4096) {
-				free(buf);
+				efi_free(buf);
 				*result = buf = NULL;
 				*bufsize = 0;
 				errno = ENOMEM;
 				efi_error("could not read from file");
 				return -1;
 			}
-			newbuf = realloc(buf, size + 4096);
+			newbuf = efi_realloc(buf, size + 4096);
 			if (newbuf == NULL) {
 				int saved_errno = errno;
-				free(buf);
+				efi_free(buf);
 				*result = buf = NULL;
 				*bufsize = 0;
 				errno = saved_errno;
@@ -104,9 +106,9 @@ read_file(int fd, uint8_t **result, size_t *bufsize)
 		}
 	} while (1);
 
-	newbuf = realloc(buf, filesize+1);
+	newbuf = efi_realloc(buf, filesize+1);
 	if (!newbuf) {
-		free(buf);
+		efi_free(buf);
 		*result = buf = NULL;
 		efi_error("could not allocate memory");
 		return -1;
@@ -128,7 +130,7 @@ lcm(uint64_t x, uint64_t y)
 	return (x / n) * y;
 }
 
-#define xfree(x) ({ if (x) { free(x); x = NULL; } })
+#define xfree(x) ({ if (x) { efi_free(x); x = NULL; } })
 
 #ifndef strdupa
 #define strdupa(s)						\
@@ -245,7 +247,7 @@ get_file(uint8_t **result, const char * const fmt, ...)
 		 * cov-scan
 		 */
 		if (buf)
-			free(buf);
+			efi_free(buf);
 		*result = NULL;
 		efi_error("could not read file \"%s\"", path);
 		return -1;
@@ -421,7 +423,7 @@ typedef struct {
 static inline UNUSED void
 ptrlist_add(list_t *list, char *ptr)
 {
-	ptrlist_t *pl = calloc(1, sizeof(ptrlist_t));
+	ptrlist_t *pl = efi_calloc(1, sizeof(ptrlist_t));
 	if (!pl)
 		err(1, "could not allocate memory");
 	pl->ptr = ptr;
@@ -445,7 +447,7 @@ int16_t hexchar_to_bin(char hex)
 static inline UNUSED uint8_t *
 hex_to_bin(char *hex, size_t size)
 {
-	uint8_t *ret = calloc(1, size+1);
+	uint8_t *ret = efi_calloc(1, size+1);
 	if (!ret)
 		return NULL;
 
@@ -463,7 +465,7 @@ hex_to_bin(char *hex, size_t size)
 	};
 	return ret;
 out_of_range:
-	free(ret);
+	efi_free(ret);
 	errno = ERANGE;
 	return NULL;
 }
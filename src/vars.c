@@ -113,9 +113,9 @@ get_file_data_size(int dfd, char *name)
  * Submit your patch here today!
  */
 static int
-is_64bit(void)
+is_64bit(struct efi_ctx *ctx)
 {
-	static int sixtyfour_bit = -1;
+	int sixtyfour_bit = ctx->vars_sixtyfour_bit;
 	DIR *dir = NULL;
 	int dfd = -1;
 	int saved_errno;
@@ -123,7 +123,7 @@ is_64bit(void)
 	if (sixtyfour_bit != -1)
 		return sixtyfour_bit;
 
-	dir = opendir(get_vars_path());
+	dir = opendir(ctx_path(ctx));
 	if (!dir)
 		goto err;
 
@@ -153,6 +153,7 @@ is_64bit(void)
 	}
 	if (sixtyfour_bit == -1)
 		sixtyfour_bit = __SIZEOF_POINTER__ == 4 ? 0 : 1;
+	ctx->vars_sixtyfour_bit = sixtyfour_bit;
 err:
 	saved_errno = errno;
 
@@ -198,7 +199,7 @@ err:
 		close(fd);
 
 	if (buf != NULL)
-		free(buf);
+		efi_free(buf);
 
 	errno = errno_value;
 	return ret;
@@ -206,16 +207,16 @@ err:
 
 
 static int
-vars_probe(void)
+vars_probe(struct efi_ctx *ctx)
 {
 	char *newvar;
 
 	/* If we can't tell if it's 64bit or not, this interface is no good. */
-	if (is_64bit() < 0) {
+	if (is_64bit(ctx) < 0) {
 		efi_error("is_64bit() failed");
 		return 0;
 	}
-	if (asprintfa(&newvar, "%s%s", get_vars_path(), "new_var") < 0) {
+	if (asprintfa(&newvar, "%s%s", ctx_path(ctx), "new_var") < 0) {
 		efi_error("asprintfa failed");
 		return 0;
 	}
@@ -226,13 +227,14 @@ vars_probe(void)
 }
 
 static int
-vars_get_variable_size(efi_guid_t guid, const char *name, size_t *size)
+vars_get_variable_size(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		       size_t *size)
 {
 	int errno_value;
 	int ret = -1;
 
 	char *path = NULL;
-	int rc = asprintf(&path, "%s%s-"GUID_FORMAT"/size", get_vars_path(),
+	int rc = efi_asprintf(&path, "%s%s-"GUID_FORMAT"/size", ctx_path(ctx),
 			  name, GUID_FORMAT_ARGS(&guid));
 	if (rc < 0) {
 		efi_error("asprintf failed");
@@ -251,15 +253,19 @@ err:
 	errno_value = errno;
 
 	if (path)
-		free(path);
+		efi_free(path);
 
 	errno = errno_value;
 	return ret;
 }
 
+static int vars_get_variable(struct efi_ctx *ctx, efi_guid_t guid,
+			     const char *name, uint8_t **data,
+			     size_t *data_size, uint32_t *attributes);
+
 static int
-vars_get_variable_attributes(efi_guid_t guid, const char *name,
-			    uint32_t *attributes)
+vars_get_variable_attributes(struct efi_ctx *ctx, efi_guid_t guid,
+			     const char *name, uint32_t *attributes)
 {
 	int ret = -1;
 
@@ -267,21 +273,21 @@ vars_get_variable_attributes(efi_guid_t guid, const char *name,
 	size_t data_size;
 	uint32_t attribs;
 
-	ret = efi_get_variable(guid, name, &data, &data_size, &attribs);
+	ret = vars_get_variable(ctx, guid, name, &data, &data_size, &attribs);
 	if (ret < 0) {
-		efi_error("efi_get_variable() failed");
+		efi_error("vars_get_variable() failed");
 		return ret;
 	}
 
 	*attributes = attribs;
 	if (data)
-		free(data);
+		efi_free(data);
 	return ret;
 }
 
 static int
-vars_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
-		  size_t *data_size, uint32_t *attributes)
+vars_get_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		  uint8_t **data, size_t *data_size, uint32_t *attributes)
 {
 	int errno_value;
 	int ret = -1;
@@ -290,18 +296,9 @@ vars_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 	char *path = NULL;
 	int rc;
 	int fd = -1;
-	int ratelimit;
-
-	/*
-	 * The kernel rate limiter hits us if we go faster than 100 efi
-	 * variable reads per second as non-root.  So if we're not root, just
-	 * delay this long after each read.  The user is not going to notice.
-	 *
-	 * 1s / 100 = 10000us.
-	 */
-	ratelimit = geteuid() == 0 ? 0 : 10000;
-
-	rc = asprintf(&path, "%s%s-" GUID_FORMAT "/raw_var", get_vars_path(),
+	useconds_t ratelimit = ctx_ratelimit(ctx);
+
+	rc = efi_asprintf(&path, "%s%s-" GUID_FORMAT "/raw_var", ctx_path(ctx),
 		      name, GUID_FORMAT_ARGS(&guid));
 	if (rc < 0) {
 		efi_error("asprintf failed");
@@ -314,7 +311,7 @@ vars_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 		goto err;
 	}
 
-	usleep(ratelimit);
+	ratelimit_sleep(ratelimit);
 	rc = read_file(fd, &buf, &bufsize);
 	if (rc < 0) {
 		efi_error("read_file(%s) failed", path);
@@ -323,7 +320,7 @@ vars_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 
 	bufsize -= 1; /* read_file pads out 1 extra byte to NUL it */
 
-	if (is_64bit()) {
+	if (is_64bit(ctx)) {
 		efi_kernel_variable_64_t *var64;
 
 		if (bufsize != sizeof(efi_kernel_variable_64_t)) {
@@ -334,7 +331,7 @@ vars_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 		}
 
 		var64 = (void *)buf;
-		*data = malloc(var64->DataSize);
+		*data = efi_malloc(var64->DataSize);
 		if (!*data) {
 			efi_error("malloc failed");
 			goto err;
@@ -353,7 +350,7 @@ vars_get_variable(efi_guid_t guid, const char *name, uint8_t **data,
 		}
 
 		var32 = (void *)buf;
-		*data = malloc(var32->DataSize);
+		*data = efi_malloc(var32->DataSize);
 		if (!*data) {
 			efi_error("malloc failed");
 			goto err;
@@ -368,20 +365,20 @@ err:
 	errno_value = errno;
 
 	if (buf)
-		free(buf);
+		efi_free(buf);
 
 	if (fd >= 0)
 		close(fd);
 
 	if (path)
-		free(path);
+		efi_free(path);
 
 	errno = errno_value;
 	return ret;
 }
 
 static int
-vars_del_variable(efi_guid_t guid, const char *name)
+vars_del_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name)
 {
 	int errno_value;
 	int ret = -1;
@@ -392,7 +389,7 @@ vars_del_variable(efi_guid_t guid, const char *name)
 	size_t buf_size = 0;
 	char *delvar;
 
-	rc = asprintf(&path, "%s%s-" GUID_FORMAT "/raw_var", get_vars_path(),
+	rc = efi_asprintf(&path, "%s%s-" GUID_FORMAT "/raw_var", ctx_path(ctx),
 		      name, GUID_FORMAT_ARGS(&guid));
 	if (rc < 0) {
 		efi_error("asprintf failed");
@@ -422,7 +419,7 @@ vars_del_variable(efi_guid_t guid, const char *name)
 		goto err;
 	}
 
-	if (asprintfa(&delvar, "%s%s", get_vars_path(), "del_var") < 0) {
+	if (asprintfa(&delvar, "%s%s", ctx_path(ctx), "del_var") < 0) {
 		efi_error("asprintfa() failed");
 		goto err;
 	}
@@ -443,13 +440,13 @@ err:
 	errno_value = errno;
 
 	if (buf)
-		free(buf);
+		efi_free(buf);
 
 	if (fd >= 0)
 		close(fd);
 
 	if (path)
-		free(path);
+		efi_free(path);
 
 	errno = errno_value;
 	return ret;
@@ -467,7 +464,7 @@ _vars_chmod_variable(char *path, mode_t mode)
 	int ret = 0;
 	for (int i = 0; files[i] != NULL; i++) {
 		char *new_path = NULL;
-		int rc = asprintf(&new_path, "%s/%s", path, files[i]);
+		int rc = efi_asprintf(&new_path, "%s/%s", path, files[i]);
 		if (rc > 0) {
 			rc = chmod(new_path, mode & ~mask);
 			if (rc < 0) {
@@ -475,7 +472,7 @@ _vars_chmod_variable(char *path, mode_t mode)
 					saved_errno = errno;
 				ret = -1;
 			}
-			free(new_path);
+			efi_free(new_path);
 		} else if (rc < 0) {
 			if (saved_errno == 0)
 				saved_errno = errno;
@@ -487,7 +484,8 @@ _vars_chmod_variable(char *path, mode_t mode)
 }
 
 static int
-vars_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
+vars_chmod_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		    mode_t mode)
 {
 	if (strlen(name) > 1024) {
 		errno = EINVAL;
@@ -495,7 +493,7 @@ vars_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
 	}
 
 	char *path;
-	int rc = asprintf(&path, "%s%s-" GUID_FORMAT, get_vars_path(),
+	int rc = efi_asprintf(&path, "%s%s-" GUID_FORMAT, ctx_path(ctx),
 			  name, GUID_FORMAT_ARGS(&guid));
 	if (rc < 0) {
 		efi_error("asprintf failed");
@@ -505,14 +503,15 @@ vars_chmod_variable(efi_guid_t guid, const char *name, mode_t mode)
 	rc = _vars_chmod_variable(path, mode);
 	int saved_errno = errno;
 	efi_error("_vars_chmod_variable() failed");
-	free(path);
+	efi_free(path);
 	errno = saved_errno;
 	return rc;
 }
 
 static int
-vars_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
-		 size_t data_size, uint32_t attributes, mode_t mode)
+vars_set_variable(struct efi_ctx *ctx, efi_guid_t guid, const char *name,
+		  const uint8_t *data, size_t data_size, uint32_t attributes,
+		  mode_t mode)
 {
 	int errno_value;
 	size_t len;
@@ -533,7 +532,7 @@ vars_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
 	}
 
 	char *path;
-	int rc = asprintf(&path, "%s%s-" GUID_FORMAT "/data", get_vars_path(),
+	int rc = efi_asprintf(&path, "%s%s-" GUID_FORMAT "/data", ctx_path(ctx),
 			  name, GUID_FORMAT_ARGS(&guid));
 	if (rc < 0) {
 		efi_error("asprintf failed");
@@ -543,19 +542,19 @@ vars_set_variable(efi_guid_t guid, const char *name, const uint8_t *data,
 	len = rc;
 
 	if (!access(path, F_OK)) {
-		rc = efi_del_variable(guid, name);
+		rc = vars_del_variable(ctx, guid, name);
 		if (rc < 0) {
-			efi_error("efi_del_variable failed");
+			efi_error("vars_del_variable failed");
 			goto err;
 		}
 	}
 	char *newvar;
-	if (asprintfa(&newvar, "%s%s", get_vars_path(), "new_var") < 0) {
+	if (asprintfa(&newvar, "%s%s", ctx_path(ctx), "new_var") < 0) {
 		efi_error("asprintfa failed");
 		goto err;
 	}
 
-	if (is_64bit()) {
+	if (is_64bit(ctx)) {
 		efi_kernel_variable_64_t var64 = {
 			.VendorGuid = guid,
 			.DataSize = data_size,
@@ -608,7 +607,7 @@ err:
 	errno_value = errno;
 
 	if (path)
-		free(path);
+		efi_free(path);
 
 	if (fd >= 0)
 		close(fd);
@@ -618,11 +617,12 @@ err:
 }
 
 static int
-vars_get_next_variable_name(efi_guid_t **guid, char **name)
+vars_get_next_variable_name(struct efi_ctx *ctx, efi_guid_t **guid,
+			    char **name)
 {
 	int rc;
-	const char *vp = get_vars_path();
-	rc = generic_get_next_variable_name(vp, guid, name);
+	const char *vp = ctx_path(ctx);
+	rc = generic_get_next_variable_name(ctx, vp, guid, name);
 	if (rc < 0)
 		efi_error("generic_get_next_variable_name(%s,...) failed", vp);
 	return rc;
@@ -631,6 +631,7 @@ vars_get_next_variable_name(efi_guid_t **guid, char **name)
 struct efi_var_operations vars_ops = {
 	.name = "vars",
 	.probe = vars_probe,
+	.get_default_path = get_vars_path,
 	.set_variable = vars_set_variable,
 	.del_variable = vars_del_variable,
 	.get_variable = vars_get_variable,